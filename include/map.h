@@ -19,14 +19,34 @@ map_error_t map_create(map_t **map, void *(*usr_key_clone)(void *key),
                        void (*usr_free_key)(void *key),
                        void (*usr_free_value)(void *value));
 
+// Reset options to the defaults used by map_create().
+void map_options_init(map_options_t *options);
+
+// Create a new map like map_create(), with extra creation-time options
+// such as the storage engine. A NULL options pointer means the defaults.
+map_error_t map_create_ex(map_t **map, const map_options_t *options,
+                          void *(*usr_key_clone)(void *key),
+                          void *(*usr_value_clone)(void *value),
+                          uint64_t (*usr_hash)(void *key),
+                          char *(*usr_stringify)(void *key, void *data),
+                          int32_t (*usr_compare)(void *key1, void *key2),
+                          void (*usr_free_key)(void *key),
+                          void (*usr_free_value)(void *value));
+
 // Return the number of elements in the hashmap.
-map_error_t map_get_size(map_t *map, int *num_elements);
+map_error_t map_get_size(map_t *map, size_t *num_elements);
 
 // Return the number of buckets in the hashmap.
-map_error_t map_get_num_buckets(map_t *map, int *num_buckets);
+map_error_t map_get_num_buckets(map_t *map, size_t *num_buckets);
 
 // Allow the user to configure factors. Ensure that the factors make sense,
 // ex. the grow factor must be >1.
+// However long chains get (a large max_load_factor, a weak usr_hash, keys
+// that collide), a chaining map searches any chain of 8 or more nodes
+// through a sorted index in O(log n) usr_compare calls. That relies on
+// usr_compare being a consistent ordering, by sign (strcmp() will do). A
+// map whose usr_compare only tells equal from unequal is noticed once
+// colliding keys come out of order, and walks its chains from then on.
 map_error_t map_configure(map_t *map, float max_load_factor, float min_load_factor,
                           float grow_factor);// added *map argument
 
@@ -37,7 +57,9 @@ map_error_t map_destroy(map_t **map);
 // Insert a (key, value) pair into the map.
 // Hash the key, find the right bucket, insert the key, value pair.
 // Be careful: what if the key is already in the map?
-// Check load factor and resize if necessary.
+// Check load factor and resize if necessary. On a chaining map,
+// MAP_ERR_OVERFLOW means the buckets can't grow past what a size_t can
+// address; the pair is still inserted.
 map_error_t map_insert(map_t *map, void *key, void *value);
 
 // Retrieve value based on a key from the map.
@@ -55,15 +77,615 @@ map_error_t map_remove(map_t *map, void *key);
 // all map values by 10.
 
 // Initialize the iterator to the first valid map element. Handle the empty
-// map edge case.
+// map edge case. The iterator needs no setup beforehand, and restarting
+// one simply begins a new iteration.
 map_error_t map_iter_start(const map_t *map, map_iterator_t *iter);
 
 // Return the (key, value) pair at the current iterator location, then
 // advance the iterator. Reason about whether to return copies of the
 // key/value, or to return the internal pointers to the key/value.
+// Remove entries while iterating with map_iter_remove(). Anything else
+// that frees or moves entries, such as map_remove(), an insert that grows
+// the map or one that evicts from a cache, ends the iteration with
+// MAP_ERR_STALE_ITERATOR instead of skipping, repeating or touching freed
+// entries.
 map_error_t map_iter_next(const map_t *map, map_iterator_t *iter,
                           void **out_key, void **out_value);
+
+// Remove the entry map_iter_next() last returned, without hashing or
+// comparing its key again; iteration carries on with the next entry, and
+// the map shrinks once the iteration is done. MAP_ERR_NOT_FOUND if it is
+// already gone.
+map_error_t map_iter_remove(map_t *map, map_iterator_t *iter);
+
+// Stop iterating early. An iterator is done once map_iter_next() returns
+// anything but MAP_OK. Iterators keep no state in the map, so leaving a
+// loop without map_iter_end() is harmless; calling it after
+// map_iter_remove() lets the map shrink right away rather than on the
+// next map_remove(). Read-only iterations may run concurrently.
+map_error_t map_iter_end(const map_t *map, map_iterator_t *iter);
 //--------
 
-// Pretty printing.
+// Pretty printing: one line per non-empty bucket, each entry through
+// usr_stringify. For dumping big maps use map_export().
 map_error_t map_print(const map_t *map);
+
+//--------
+// Cloning.
+
+// Deep-copy src into a new map *dst with the same settings, callbacks,
+// allocator and engine. The copy starts at src's bucket count and chains are
+// copied bucket by bucket, so no key is rehashed and no resize happens.
+// Keys and values are copied with usr_key_clone/usr_value_clone (string
+// keys go into the copy's own arena). With nthreads > 1 and the default
+// allocator, bucket ranges are cloned on up to nthreads threads; the clone
+// callbacks must then be thread-safe. Custom allocators always clone on the
+// calling thread. On failure *dst is left untouched.
+map_error_t map_clone(const map_t *src, map_t **dst, int nthreads);
+//--------
+
+//--------
+// Merging and set operations.
+// Both maps must use the same key mode and compatible callbacks (keys and
+// values of one must be valid for the other's compare/clone/free). When a
+// key is in both maps, combine(ctx, key, dst_value, src_value) decides the
+// value dst keeps: it may update dst_value in place and return it, or
+// return a new value (dst then frees the old one), or NULL to fail with
+// MAP_ERR_NO_MEM. It must not keep src_value. If dst has live snapshots,
+// return a new value rather than updating in place.
+//
+// Chaining maps are handled on the chains: each key is hashed at most once
+// and dst is resized at most once. If both maps share usr_hash and bucket
+// count, no key is hashed at all. On failure both maps stay valid, with dst
+// holding part of the result.
+
+// Add every entry of src to dst, cloning it. For keys in both maps the
+// value is combine()'s result, or src's value if combine is NULL.
+map_error_t map_merge(map_t *dst, const map_t *src,
+                      void *(*combine)(void *ctx, void *key, void *dst_value, void *src_value),
+                      void *ctx);
+
+// Like map_merge(), but consumes src (setting *src to NULL): when both maps
+// use the same allocator its nodes and values are moved, not cloned.
+map_error_t map_merge_consume(map_t *dst, map_t **src,
+                              void *(*combine)(void *ctx, void *key, void *dst_value,
+                                               void *src_value),
+                              void *ctx);
+
+// Merge srcs[0..count) into dst and destroy them, setting each srcs[i] to
+// NULL. When the maps allow map_merge_consume() to move nodes, their
+// nodes are bucketed by dst bucket range and each range is merged on its
+// own thread, up to nthreads; combine, usr_compare and the free callbacks
+// are then called from all of them at once. Otherwise the sources are
+// merged one after another. If combine fails, the sources are still
+// destroyed and dst holds part of the result.
+map_error_t map_merge_parallel(map_t *dst, map_t **srcs, size_t count, int nthreads,
+                               void *(*combine)(void *ctx, void *key, void *dst_value,
+                                                void *src_value),
+                               void *ctx);
+
+// Remove from dst every key not in src. Kept entries take combine()'s
+// result, or keep their value if combine is NULL.
+map_error_t map_intersect(map_t *dst, const map_t *src,
+                          void *(*combine)(void *ctx, void *key, void *dst_value,
+                                           void *src_value),
+                          void *ctx);
+
+// Remove from dst every key that is in src.
+map_error_t map_difference(map_t *dst, const map_t *src);
+//--------
+
+//--------
+// Sets.
+// A map_set_t holds keys only. Inserting a key allocates nothing but the
+// key's clone and its node, with no value to clone or free; the node keeps
+// its value pointer, aimed at a shared placeholder. Sets work with any
+// engine but MAP_ENGINE_DISK, and can't have a write-ahead log, as values
+// decoded from a file would never be freed. Any key mode works. A set is a map_t: map_remove(),
+// map_get_size(), map_iter_start()/map_iter_end(), map_clone(),
+// map_print() and map_destroy() all work on it. Values handed out by the
+// map_* calls (and passed to usr_stringify) are a placeholder to ignore.
+
+// Create an empty set, like map_create() without the value callbacks.
+map_error_t map_set_create(map_set_t **set, void *(*usr_key_clone)(void *key),
+                           uint64_t (*usr_hash)(void *key),
+                           char *(*usr_stringify)(void *key, void *data),
+                           int32_t (*usr_compare)(void *key1, void *key2),
+                           void (*usr_free_key)(void *key));
+
+// Create an empty set with options, like map_create_ex(). MAP_ENGINE_DISK
+// is rejected with MAP_ERR_INVALID_ARG.
+map_error_t map_set_create_ex(map_set_t **set, const map_options_t *options,
+                              void *(*usr_key_clone)(void *key),
+                              uint64_t (*usr_hash)(void *key),
+                              char *(*usr_stringify)(void *key, void *data),
+                              int32_t (*usr_compare)(void *key1, void *key2),
+                              void (*usr_free_key)(void *key));
+
+// Add key to the set. Adding a key that is already in does nothing.
+map_error_t map_set_insert(map_set_t *set, void *key);
+
+// MAP_OK if key is in the set, MAP_ERR_NOT_FOUND if not.
+map_error_t map_set_contains(const map_set_t *set, void *key);
+
+// Like map_iter_next(), for keys only.
+map_error_t map_set_iter_next(const map_set_t *set, map_iterator_t *iter, void **out_key);
+
+// Set algebra, in place on dst, through map_merge(), map_intersect() and
+// map_difference(). Both arguments must be sets.
+map_error_t map_set_union(map_set_t *dst, const map_set_t *src);
+map_error_t map_set_intersect(map_set_t *dst, const map_set_t *src);
+map_error_t map_set_difference(map_set_t *dst, const map_set_t *src);
+//--------
+
+//--------
+// Snapshots.
+// A snapshot is a read-only, point-in-time view of a chaining map that
+// stays consistent while the map keeps taking inserts and removes. Taking
+// one copies the bucket head array (one pointer per bucket) and shares all
+// nodes. Afterwards the map copies a chain the first time it writes to it,
+// and keeps removed or overwritten keys and values alive until the
+// snapshots that may see them are released. Resizes and map_compact_keys()
+// are deferred while any snapshot is live.
+//
+// map_snapshot(), map_snapshot_retain() and map_snapshot_release() modify
+// the map and must be serialized with its writers. Lookups and iteration
+// on a snapshot only read shared, immutable data and need no lock.
+
+// Take a snapshot with a reference count of one. Only the chaining engine
+// supports snapshots.
+map_error_t map_snapshot(map_t *map, map_snapshot_t **out);
+
+// Add a reference, e.g. before handing the snapshot to another reader.
+map_error_t map_snapshot_retain(map_snapshot_t *snap);
+
+// Drop a reference, setting *snap to NULL. The last release frees the
+// snapshot and whatever only it kept alive. A map destroyed while snapshots
+// were live is freed by the last release.
+map_error_t map_snapshot_release(map_snapshot_t **snap);
+
+// Retrieve value based on a key, as of the time of the snapshot.
+map_error_t map_snapshot_get(const map_snapshot_t *snap, void *key, void **out_value);
+
+// Return the number of elements at the time of the snapshot.
+map_error_t map_snapshot_get_size(const map_snapshot_t *snap, size_t *num_elements);
+
+// Iterate over the snapshot, like map_iter_start()/map_iter_next().
+map_error_t map_snapshot_iter_start(const map_snapshot_t *snap, map_iterator_t *iter);
+map_error_t map_snapshot_iter_next(const map_snapshot_t *snap, map_iterator_t *iter,
+                                   void **out_key, void **out_value);
+//--------
+
+//--------
+// Cache mode.
+// Set options.max_entries and/or options.max_bytes to bound a chaining map.
+// Once an insert takes the map over a limit, map_insert() evicts entries with
+// CLOCK until it fits again, calling on_evict(evict_ctx, key, value) for each
+// just before it is freed (on_evict must not use the map). An entry is
+// charged entry_size(key, value) bytes, or just its node (plus its arena
+// record for string keys) when entry_size is NULL. The last remaining entry
+// is never evicted.
+//
+// Recency is kept per bucket: map_get() hits and inserts mark their bucket,
+// and a hit also moves its entry to the front of its chain. The CLOCK hand
+// evicts the least recently used entry of a bucket nobody touched since the
+// hand last went by. Nothing is allocated per access. Because map_get()
+// updates this state, lookups on a cache are writes: serialize them with
+// other calls, and don't call map_get() while iterating the same map.
+//
+// With max_entries set, the bucket array is sized for the limit at creation.
+
+// Fill *stats with the hit, miss and eviction counters and the bytes
+// currently charged. Fails with MAP_ERR_INVALID_ARG for maps without limits.
+map_error_t map_cache_stats(const map_t *map, map_cache_stats_t *stats);
+//--------
+
+//--------
+// Expiring entries.
+// Maps created with options.enable_ttl (chaining engine only) can give
+// entries a time to live. Time is measured by options.clock, in whatever
+// unit it counts (NULL means monotonic milliseconds). The deadline and the
+// timer live in the entry's own node, so a TTL costs no extra allocation.
+//
+// An expired entry is removed by the first map_get() that finds it, which
+// ends any iteration under way with MAP_ERR_STALE_ITERATOR, as
+// map_expire() removing anything does. Until then it is still counted by
+// map_get_size() and visited by iterators. Expiring maps can't be
+// snapshotted, and lookups on them may write, so serialize lookups with
+// everything else.
+
+// Insert like map_insert(), expiring the entry ttl clock units from now.
+// Inserting an existing key replaces its value and its deadline. A plain
+// map_insert() on an expiring map makes the entry permanent; values that
+// map_merge() or map_intersect() get from combine keep their deadline.
+map_error_t map_insert_ttl(map_t *map, void *key, void *value, uint64_t ttl);
+
+// Remove entries whose deadline is at or before now, in deadline order.
+// Every call does at most `budget` units of work (one per entry expired,
+// moved between wheel levels or moved in from beyond the wheel's 2^24
+// ticks), so call it often with a small budget rather
+// than rarely with a big one. Stretches of time with nothing due are
+// skipped at no cost. *out_expired (if not NULL) gets the number removed.
+map_error_t map_expire(map_t *map, uint64_t now, size_t budget, size_t *out_expired);
+
+// Read the map's clock, e.g. to pass to map_expire().
+map_error_t map_ttl_now(const map_t *map, uint64_t *out_now);
+//--------
+
+//--------
+// Negative lookup filter.
+// Maps created with options.enable_filter (chaining engine only) keep a
+// counting Bloom filter next to the buckets. map_get() and map_remove() on
+// a key the filter has never seen return MAP_ERR_NOT_FOUND after one cache
+// line, without walking the chain or calling usr_compare; about 3% of
+// misses get through to the chain. Keys are still hashed once per call.
+//
+// Removes count the key back out, so the filter stays exact in the "no"
+// direction however the map changes, and it is rebuilt to size whenever
+// the buckets resize. It costs four to eight bytes per entry. Worth it
+// when most lookups miss or usr_compare is expensive.
+//--------
+
+//--------
+// Write-ahead log.
+// map_wal_open() replays the log at path into the map, then appends a
+// record to it for every map_insert(), map_remove() and map_iter_remove()
+// before the change is applied, so the map can be rebuilt after a crash.
+// Records are buffered and fsync'ed in groups (see map_wal_options_t); a
+// crash loses at most the records since the last sync, and a torn last
+// record is dropped on replay. A change whose record can't be written fails
+// with MAP_ERR_IO and isn't applied; a half-written record is cut off
+// again, and if that fails too the log refuses every later change. Entries already in the map when the log is
+// opened are only logged by the next map_wal_compact(). Caches, expiring
+// maps, sets and string keys can't be logged. Destroying the map closes the log
+// and keeps it.
+
+// Defaults: fsync every record, 64 KiB buffer; the codec must be set.
+void map_wal_options_init(map_wal_options_t *options);
+
+// Replay path (created if missing) into map and attach it. The chaining
+// engine is presized for the logged inserts first.
+map_error_t map_wal_open(map_t *map, const char *path, const map_wal_options_t *options);
+
+// Write and fsync every buffered record. The group commit limits are only
+// checked when records are appended, so call this from a timer to bound
+// how long an idle log stays unsynced.
+map_error_t map_wal_sync(map_t *map);
+
+// Rewrite the log as one insert per current entry, then swap it in
+// atomically; the old log stays in place if anything fails.
+map_error_t map_wal_compact(map_t *map);
+
+// Sync and detach the log.
+map_error_t map_wal_close(map_t *map);
+//--------
+
+//--------
+// Disk engine.
+// With options.engine = MAP_ENGINE_DISK and options.disk set, keys are
+// split over hash partitions and only about ram_budget bytes of them stay
+// in memory; the partition a call needs is always loaded, whatever its
+// size. The least recently used partitions are written out to files in a
+// private directory under options.disk->dir (one file per partition) and
+// mapped back in when a call needs them. A partition that hasn't changed
+// since it was read is just dropped. Entries are charged their encoded
+// size plus a small overhead. Iteration reads the partitions in order, one
+// file front to back at a time, and spills each one first once it is done.
+//
+// Keys and values written out come back as new objects from decode_*, so
+// a pointer from map_get() or map_iter_next() is only valid until the next
+// call on the map. Lookups may read and write files: serialize them with
+// everything else. map_get_num_buckets() reports the partition count.
+// Destroying the map deletes its directory.
+
+// Defaults: 64 partitions and a 64 MiB budget; dir and the codec must be set.
+void map_disk_options_init(map_disk_options_t *options);
+
+// Copy the map's disk counters. MAP_ERR_INVALID_ARG unless the map uses
+// the disk engine.
+map_error_t map_disk_stats(const map_t *map, map_disk_stats_t *stats);
+//--------
+
+//--------
+// String key mode.
+// With options.key_mode = MAP_KEY_STRING, keys are NUL-terminated strings
+// that the map copies into its own append-only arena together with their
+// length and hash. usr_key_clone, usr_free_key and usr_compare are not used
+// and may be NULL; if usr_hash is NULL the built-in byte hash is used.
+// Keys handed out by map_iter_next() point into the arena.
+
+// Rewrite the key arena without the space left behind by removed keys.
+// Keys move, so pointers obtained from earlier iterations become invalid.
+// Does nothing while snapshots of the map are live.
+map_error_t map_compact_keys(map_t *map);
+//--------
+
+//--------
+// Allocators.
+// Set options.allocator to route everything the map allocates for itself
+// (the map_t, bucket arrays, nodes, engine storage and the string key
+// arena) through your own alloc/realloc/free. Keys and values still come
+// from usr_key_clone and usr_value_clone. The allocator struct is copied;
+// its ctx must outlive the map.
+//
+// The library ships a bump arena for maps that are built and discarded as a
+// whole. Freeing into an arena is (almost) a no-op. If a map's keys and
+// values need no freeing either (e.g. string keys and values cloned with
+// map_arena_alloc()), the map can simply be abandoned and the arena reset
+// or destroyed, skipping map_destroy() and every per-entry free.
+
+// Create an empty arena that grabs memory in chunk_size blocks (0 picks a
+// default). Larger requests get a chunk of their own.
+map_error_t map_arena_create(map_arena_t **arena, size_t chunk_size);
+
+// Fill *out with an allocator drawing from the arena.
+map_error_t map_arena_allocator(map_arena_t *arena, map_allocator_t *out);
+
+// Allocate size bytes, 16-byte aligned, from the arena. NULL on failure.
+void *map_arena_alloc(map_arena_t *arena, size_t size);
+
+// Release every allocation at once, keeping one chunk for reuse. Maps
+// living in the arena must not be used afterwards.
+map_error_t map_arena_reset(map_arena_t *arena);
+
+// Release the arena and all of its memory, setting *arena to NULL.
+map_error_t map_arena_destroy(map_arena_t **arena);
+//--------
+
+//--------
+// Huge-page allocator.
+// For very large tables, put bucket arrays and nodes on 2MB pages so random
+// lookups stop paying a TLB miss per probe, and optionally spread or pin
+// them across NUMA nodes. Explicit huge pages are used when
+// explicit_huge_pages is set and the system has some reserved; otherwise
+// mappings are aligned and advised for transparent huge pages. On systems
+// without either, or without NUMA, this still works with normal pages and
+// default placement. Not thread-safe, like the maps themselves.
+
+// Reset options to the defaults: transparent pages, default placement.
+void map_hugepage_options_init(map_hugepage_options_t *options);
+
+// Create a huge-page allocator. NULL options means the defaults. Binding to
+// a node the system doesn't have yields MAP_ERR_INVALID_ARG.
+map_error_t map_hugepage_create(map_hugepage_t **hp, const map_hugepage_options_t *options);
+
+// Fill *out with an allocator backed by hp, for options.allocator.
+map_error_t map_hugepage_allocator(map_hugepage_t *hp, map_allocator_t *out);
+
+// Unmap everything, setting *hp to NULL. Destroy the maps using it first.
+map_error_t map_hugepage_destroy(map_hugepage_t **hp);
+//--------
+
+//--------
+// Built-in hash functions.
+// Ready-made usr_hash implementations, so callers don't have to write
+// byte-at-a-time loops like djb2. Pass them straight to map_create(), or
+// look one up by name with map_hash_from_name().
+
+// Hash an arbitrary byte range. Length-aware: inputs that differ only in
+// length hash differently. Long inputs use SSE2/AVX2 when available; the
+// result is identical on every code path.
+uint64_t map_hash_bytes(const void *data, size_t len, uint64_t seed);
+
+// Hash a NUL-terminated string key.
+uint64_t map_hash_str(void *key);
+
+// Hash a key that points to a 32-bit integer (uint32_t or int).
+uint64_t map_hash_u32(void *key);
+
+// Hash a key that points to a 64-bit integer.
+uint64_t map_hash_u64(void *key);
+
+// Look up a built-in hash by name: "u32" (alias "int"), "u64" or "str".
+// Returns MAP_ERR_NOT_FOUND for unknown names.
+map_error_t map_hash_from_name(const char *name, uint64_t (**out_hash)(void *key));
+//--------
+
+//--------
+// Minimal perfect hashing.
+// A populated map whose key set will no longer change can be converted into
+// a map_perfect_t: no chain pointers, no empty buckets, and exactly one
+// entry probe per lookup, at roughly 3-4 bits of index per key.
+
+// Convert the map into a perfect hash table. On success the map's entries
+// are moved into *out and the map is destroyed (*map is set to NULL). On
+// failure the map is left untouched. Keys whose usr_hash values collide
+// completely cannot be separated and yield MAP_ERR_INVALID_ARG. Only maps
+// using the chaining engine and user-managed keys, with no live snapshots,
+// expiring entries or open write-ahead log, can be converted.
+map_error_t map_build_perfect(map_t **map, map_perfect_t **out);
+
+// Retrieve value based on a key, exactly like map_get().
+map_error_t map_perfect_get(const map_perfect_t *pmap, void *key,
+                            void **out_value);
+
+// Return the number of elements in the perfect hash table.
+map_error_t map_perfect_get_size(const map_perfect_t *pmap, size_t *num_elements);
+
+// Destroy the table and every key/value it owns, setting *pmap to NULL.
+map_error_t map_perfect_destroy(map_perfect_t **pmap);
+//--------
+
+//--------
+// Group-by aggregation.
+// A map_agg_t folds (key, value) pairs into one state per distinct key.
+// Groups are kept in a map until they are charged more than ram_budget.
+// Then every group in memory is appended, as a partial state, to one of
+// `partitions` files picked by the top bits of its key's mixed hash, and
+// aggregation starts over with an empty map. Finalizing merges each
+// partition file on its own, so about one budget's worth of groups is in
+// memory at a time; a partition that still doesn't fit is split again by
+// the next bits of the hash. Groups are charged their encoded key and
+// state plus a small overhead when they are created, not as they grow.
+
+// Defaults: 32 partitions and a 64 MiB budget; dir, the state callbacks
+// and the codec must be set.
+void map_agg_options_init(map_agg_options_t *options);
+
+// Create an empty group-by in a new private directory under options->dir.
+// Keys use the same callbacks as map_create(). options is copied.
+map_error_t map_agg_create(map_agg_t **agg, const map_agg_options_t *options,
+                           void *(*usr_key_clone)(void *key),
+                           uint64_t (*usr_hash)(void *key),
+                           int32_t (*usr_compare)(void *key1, void *key2),
+                           void (*usr_free_key)(void *key));
+
+// Fold value into key's group, creating the group with init first if it
+// isn't in memory. May write the groups out (MAP_ERR_IO if that fails).
+map_error_t map_agg_add(map_agg_t *agg, void *key, void *value);
+
+// Hand each group's final state to emit, once per group. key and state
+// are freed after emit returns; a result other than MAP_OK stops
+// finalizing and is returned. Spilled partitions are merged on up to
+// nthreads threads, each with an equal share of the budget, and emit is
+// then called from all of them at once. No more adds afterwards.
+map_error_t map_agg_finalize(map_agg_t *agg, int nthreads,
+                             map_error_t (*emit)(void *ctx, void *key, void *state),
+                             void *ctx);
+
+// Copy the group-by's counters.
+map_error_t map_agg_stats(const map_agg_t *agg, map_agg_stats_t *stats);
+
+// Free all groups, delete the spill directory and set *agg to NULL.
+map_error_t map_agg_destroy(map_agg_t **agg);
+//--------
+
+//--------
+// Hash join.
+// A map_join_t is built from the build side of a join: arrays of keys and
+// rows. Unlike a map, it keeps every row of a duplicate key, and a key's
+// rows are stored next to each other. Building takes two passes over the
+// input: the first finds each row's group and counts the rows of every
+// group, the second puts each row in place. Probing works on batches of
+// rows: it hashes every key of a batch and prefetches their directory
+// slots, then prefetches their groups, and only then compares keys, so the
+// cache misses within a batch overlap.
+// The table refers to the caller's keys and rows without copying them, so
+// they must outlive it.
+
+// Build a join table over rows[i] keyed by keys[i], for i < n. rows may be
+// NULL to use the keys as rows. More than UINT32_MAX - 1 distinct keys
+// yield MAP_ERR_OVERFLOW.
+map_error_t map_join_build(map_join_t **join, void *const *keys, void *const *rows, size_t n,
+                           uint64_t (*usr_hash)(void *key),
+                           int32_t (*usr_compare)(void *key1, void *key2));
+
+// Call emit(ctx, build_row, probe_row) for each build row whose key
+// matches keys[i], for every probe row rows[i], i < n (rows may be NULL as
+// above). Pairs come out in probe order, and then in build order. A result
+// other than MAP_OK from emit stops the probe and is returned.
+map_error_t map_join_probe(const map_join_t *join, void *const *keys, void *const *rows,
+                           size_t n,
+                           map_error_t (*emit)(void *ctx, void *build_row, void *probe_row),
+                           void *ctx);
+
+// Point *out_rows at the contiguous build rows matching key, and set
+// *out_count to how many there are. Returns MAP_ERR_NOT_FOUND if there are none.
+map_error_t map_join_find(const map_join_t *join, void *key, void *const **out_rows,
+                          size_t *out_count);
+
+// Return the number of build rows and of distinct keys among them.
+map_error_t map_join_get_size(const map_join_t *join, size_t *num_rows, size_t *num_keys);
+
+// Free the table (not the keys or rows) and set *join to NULL.
+map_error_t map_join_destroy(map_join_t **join);
+//--------
+
+//--------
+// Integer maps.
+// A map_imap_t maps uint64_t keys to uint64_t values without callbacks.
+// Entries are stored inline in a flat array and hashed with a built-in
+// mixer, so an insert allocates nothing until the table grows. Probes
+// compare four keys at a time with SSE2 where available. Every key can be
+// stored, including 0 and UINT64_MAX. Removed entries leave markers until
+// the next rehash, so removing never moves entries.
+
+// Create an empty integer map sized for `expected` entries (0 for a
+// small default).
+map_error_t map_imap_create(map_imap_t **imap, size_t expected);
+
+// Free the map and set *imap to NULL.
+map_error_t map_imap_destroy(map_imap_t **imap);
+
+// Insert or overwrite key's value. Overwriting never rehashes. An insert
+// that adds a key may rehash, which ends live iterations.
+map_error_t map_imap_insert(map_imap_t *imap, uint64_t key, uint64_t value);
+
+// Copy key's value to *out_value, or return MAP_ERR_NOT_FOUND.
+map_error_t map_imap_get(const map_imap_t *imap, uint64_t key, uint64_t *out_value);
+
+// Remove key, or return MAP_ERR_NOT_FOUND.
+map_error_t map_imap_remove(map_imap_t *imap, uint64_t key);
+
+// Return the number of entries.
+map_error_t map_imap_get_size(const map_imap_t *imap, size_t *num_elements);
+
+// Iterate like map_iter_start()/map_iter_next(). Removing entries and
+// overwriting values while iterating is safe. An insert that rehashes ends
+// the iteration with MAP_ERR_STALE_ITERATOR.
+map_error_t map_imap_iter_start(const map_imap_t *imap, map_iterator_t *iter);
+map_error_t map_imap_iter_next(const map_imap_t *imap, map_iterator_t *iter,
+                               uint64_t *out_key, uint64_t *out_value);
+//--------
+
+//--------
+// Streaming reduction.
+// A map_reducer_t gives each of num_locals threads a private map to fill
+// without locking, and a global map they are combined into. A thread
+// drains its map into the global one every so often with
+// map_reducer_drain(), which hands the thread a fresh empty map and merges
+// the full one under the reducer's lock, so the locals stay small and the
+// global map fills as work goes on. map_reducer_finish() merges what is
+// left with map_merge_parallel(). Keys in both maps are resolved by
+// combine as in map_merge().
+
+// Create a reducer around global, which must be empty and is taken over.
+// The locals are created like it, with the same settings and callbacks.
+map_error_t map_reducer_create(map_reducer_t **reducer, map_t *global, int num_locals,
+                               void *(*combine)(void *ctx, void *key, void *dst_value,
+                                                void *src_value),
+                               void *ctx);
+
+// Point *out_map at local map `local`. Only one thread may use it at a
+// time, and the pointer changes with every drain.
+map_error_t map_reducer_local(map_reducer_t *reducer, int local, map_t **out_map);
+
+// Merge local map `local` into the global map and replace it with an
+// empty one. Drains of different locals may run at once. If the merge
+// fails, the global map keeps what was merged and the rest is freed.
+map_error_t map_reducer_drain(map_reducer_t *reducer, int local);
+
+// Merge the locals into the global map on up to nthreads threads, hand the
+// global map to *out_map, and free the reducer, setting *reducer to NULL.
+// No thread may be using a local.
+map_error_t map_reducer_finish(map_reducer_t **reducer, int nthreads, map_t **out_map);
+
+// Free the reducer with all its maps and set *reducer to NULL.
+map_error_t map_reducer_destroy(map_reducer_t **reducer);
+//--------
+
+//--------
+// Export.
+// map_export() streams every entry through options->write in big chunks,
+// as CSV, JSON or binary records (see map_export_format_t). Keys and
+// values are serialized by the encode_* callbacks straight into a buffer
+// each thread reuses, so nothing is allocated per entry. Chaining maps
+// are exported bucket range by bucket range on up to nthreads threads;
+// write is then called by one thread at a time, chunks from different
+// ranges arrive in no particular order, and a chunk always holds whole
+// entries. Other engines are exported through their iterator on the
+// calling thread. The map must not change meanwhile.
+
+// Defaults: CSV and a 1 MiB buffer per thread; encode_value and write
+// must be set, and encode_key unless keys are strings.
+void map_export_options_init(map_export_options_t *options);
+
+// Export all of map's entries. A result other than MAP_OK from write, or
+// MAP_ERR_OVERFLOW for a binary record too long for its length field,
+// stops the export and is returned.
+map_error_t map_export(const map_t *map, const map_export_options_t *options, int nthreads);
+
+// A write callback for map_export() that appends to a FILE * given as
+// ctx, returning MAP_ERR_IO if fwrite() falls short.
+map_error_t map_export_file_writer(void *ctx, const uint8_t *buf, size_t len);
+//--------
@@ -3,10 +3,327 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <map.h>
 #include <types.h>
 
 const char* __map_error_str(map_error_t err);
 
 map_error_t __map_insert_no_resize(map_t *map, void *key, void *value);
+// Like __map_insert_no_resize(), also returning the node that holds the key.
+map_error_t __map_insert_entry(map_t *map, void *key, void *value, map_element_t **out_node);
+// Like map_insert(), but an existing expiring entry keeps its deadline.
+map_error_t __map_update_value(map_t *map, void *key, void *value);
 map_error_t __map_resize(map_t *map, float resize_factor);
+// Most buckets a chaining map can hold before the array size overflows.
+#define MAP_MAX_BUCKETS (SIZE_MAX / sizeof(map_element_t *))
+
+// Free every entry and all storage of the map, including the map_t.
+void __map_teardown(map_t *map);
+
+// Copy-on-write support for snapshots.
+map_error_t __map_cow_bucket(map_t *map, uint64_t index);
+map_error_t __map_retire_reserve(map_t *map, size_t count);
+void __map_retire(map_t *map, void *ptr, map_retired_kind_t kind);
+
+// Cache mode. CLOCK runs over buckets: lookups and inserts mark their
+// bucket referenced (and a hit moves its node to the chain head), and the
+// hand evicts the chain tail of the first unreferenced bucket it reaches.
+static inline size_t __map_bitmap_words(uint64_t num_bits) {
+    return (size_t)((num_bits + 63) / 64);
+}
+
+static inline void __map_cache_mark(const map_t *map, size_t index) {
+    map->cache_referenced[index / 64] |= (uint64_t)1 << (index % 64);
+}
+
+map_error_t __map_cache_init(map_t *map, const map_options_t *options);
+void __map_cache_free(map_t *map);
+size_t __map_cache_charge(const map_t *map, void *stored_key, void *value);
+void __map_cache_hit(const map_t *map, size_t index, map_element_t *prev,
+                     map_element_t *node);
+map_error_t __map_cache_evict(map_t *map);
+
+// Expiring entries. Maps with a timer wheel allocate map_ttl_element_t
+// nodes; __map_node_size() is what every node allocation must use.
+static inline size_t __map_node_size(const map_t *map) {
+    return map->ttl != NULL ? sizeof(map_ttl_element_t) : sizeof(map_element_t);
+}
+
+map_error_t __map_ttl_init(map_t *map, uint64_t (*clock)(void *ctx), void *clock_ctx,
+                           uint64_t now);
+void __map_ttl_free(map_t *map);
+void __map_ttl_set(map_t *map, map_element_t *node, uint64_t expires);
+void __map_ttl_unlink(map_element_t *node);
+int __map_ttl_due(const map_t *map, map_element_t *node);
+void __map_ttl_drop(map_t *map, size_t index, map_element_t *prev, map_element_t *node);
+
+// Write-ahead log. Mutations append their record before touching the map;
+// a remove record has no value.
+typedef enum {
+    MAP_WAL_INSERT = 1,
+    MAP_WAL_REMOVE = 2,
+} map_wal_op_t;
+
+map_error_t __map_wal_append(map_t *map, map_wal_op_t op, void *key, void *value);
+
+// Whether map was made by map_set_create_ex(). Sets keep whatever value
+// pointer they are given and never free it.
+int __map_is_set(const map_t *map);
+
+// Every allocation a map makes for itself goes through its allocator.
+extern const map_allocator_t __map_default_allocator;
+
+static inline void *__map_alloc(const map_t *map, size_t size) {
+    return map->allocator.alloc(map->allocator.ctx, size);
+}
+
+static inline void *__map_calloc(const map_t *map, size_t count, size_t size) {
+    if (size != 0 && count > SIZE_MAX / size) return NULL;
+    void *ptr = map->allocator.alloc(map->allocator.ctx, count * size);
+    if (ptr != NULL) memset(ptr, 0, count * size);
+    return ptr;
+}
+
+static inline void *__map_realloc(const map_t *map, void *ptr, size_t old_size,
+                                  size_t new_size) {
+    return map->allocator.realloc(map->allocator.ctx, ptr, old_size, new_size);
+}
+
+static inline void __map_free(const map_t *map, void *ptr, size_t size) {
+    if (ptr != NULL) map->allocator.free(map->allocator.ctx, ptr, size);
+}
+
+// Chaining-engine key handling. Every lookup builds a probe once, so maps
+// in MAP_KEY_STRING mode can match stored hashes and lengths before
+// touching key bytes, while MAP_KEY_USER maps go straight to usr_compare.
+typedef struct {
+    void *key;
+    uint64_t hash;
+    size_t length; // MAP_KEY_STRING only.
+} map_probe_t;
+
+map_probe_t __map_string_probe(const map_t *map, void *key);
+int32_t __map_string_compare(const map_probe_t *probe, void *stored_key);
+void *__map_string_clone(map_t *map, const map_probe_t *probe);
+void __map_string_free(map_t *map, void *stored_key);
+void __map_string_arena_free(map_t *map);
+void *__map_string_copy(const map_t *map, map_key_chunk_t **chunks, const void *stored_key);
+
+static inline const map_key_header_t *__map_key_header(const void *stored_key) {
+    return (const map_key_header_t *)((const char *)stored_key - sizeof(map_key_header_t));
+}
+
+static inline map_probe_t __map_probe(const map_t *map, void *key) {
+    if (map->key_mode == MAP_KEY_STRING) return __map_string_probe(map, key);
+
+    map_probe_t probe;
+    probe.key = key;
+    probe.hash = map->usr_hash(key);
+    probe.length = 0;
+    return probe;
+}
+
+// Compare a stored key against a probe; 0 means equal.
+static inline int32_t __map_probe_compare(const map_t *map, const map_probe_t *probe,
+                                          void *stored_key) {
+    if (map->key_mode == MAP_KEY_STRING) return __map_string_compare(probe, stored_key);
+    return map->usr_compare(stored_key, probe->key);
+}
+
+// Hash of a key already in the map (string keys carry theirs).
+static inline uint64_t __map_stored_hash(const map_t *map, void *stored_key) {
+    if (map->key_mode == MAP_KEY_STRING) return __map_key_header(stored_key)->hash;
+    return map->usr_hash(stored_key);
+}
+
+static inline void *__map_key_clone(map_t *map, const map_probe_t *probe) {
+    if (map->key_mode == MAP_KEY_STRING) return __map_string_clone(map, probe);
+    return map->usr_key_clone(probe->key);
+}
+
+static inline void __map_key_free(map_t *map, void *stored_key) {
+    if (map->key_mode == MAP_KEY_STRING) {
+        __map_string_free(map, stored_key);
+    } else {
+        map->usr_free_key(stored_key);
+    }
+}
+
+// Bulk work split across threads. fn runs once per worker on a contiguous
+// slice [begin, end) of count items; worker 0 runs on the calling thread.
+#define MAP_MAX_THREADS 64
+#define MAP_PARALLEL_MIN_ITEMS 4096 // Fewer items per thread isn't worth it.
+
+typedef map_error_t (*map_range_fn_t)(void *ctx, int worker, size_t begin, size_t end);
+
+int __map_parallel_workers(int nthreads, size_t count, size_t min_per_worker);
+map_error_t __map_parallel_for(int workers, size_t count, map_range_fn_t fn, void *ctx);
+
+// Only libc allocations are safe to make from several threads at once.
+static inline int __map_thread_safe_alloc(const map_t *map) {
+    return map->allocator.alloc == __map_default_allocator.alloc;
+}
+
+// Operations of a non-chaining storage engine. The public map_* functions
+// validate their arguments and then forward here when map->ops is set.
+typedef struct map_engine_ops {
+    map_error_t (*init)(map_t *map);
+    void (*destroy)(map_t *map); // Frees every entry and the engine storage.
+    // Fill dst (a copy of src's settings, without storage) with clones of
+    // src's entries. Leaves dst without storage on failure.
+    map_error_t (*clone)(const map_t *src, map_t *dst, int nthreads);
+    map_error_t (*insert)(map_t *map, void *key, void *value);
+    map_error_t (*get)(const map_t *map, void *key, void **out_value);
+    map_error_t (*remove)(map_t *map, void *key);
+    map_error_t (*iter_start)(const map_t *map, map_iterator_t *iter);
+    map_error_t (*iter_next)(const map_t *map, map_iterator_t *iter,
+                             void **out_key, void **out_value);
+    // Remove the entry iter_next last returned, without looking it up.
+    map_error_t (*iter_remove)(map_t *map, map_iterator_t *iter);
+    // Give memory back if the map is mostly empty; called when an
+    // iteration that removed entries is done, since iter_remove doesn't
+    // shrink.
+    void (*shrink)(map_t *map);
+    map_error_t (*print)(const map_t *map);
+} map_engine_ops_t;
+
+extern const map_engine_ops_t __map_cuckoo_ops;
+extern const map_engine_ops_t __map_dense_ops;
+extern const map_engine_ops_t __map_pool_ops;
+extern const map_engine_ops_t __map_disk_ops;
+
+// Validate the disk engine options and set up map->disk, before init.
+map_error_t __map_disk_prepare(map_t *map, const map_disk_options_t *options);
+
+// 64-bit finalizer (splitmix64). Spreads every input bit over the whole
+// output word, so weak user hashes can be post-mixed before reduction.
+static inline uint64_t __map_mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// Negative lookup filter. Every chaining entry is counted under the hash
+// __map_probe() gives its key; counters stick at 15 rather than wrap, so a
+// lookup the filter rejects is always a miss.
+#define MAP_FILTER_PROBES 4
+
+map_error_t __map_filter_init(map_t *map, map_filter_t *filter, uint64_t num_buckets);
+map_error_t __map_filter_clone(map_t *dst, const map_filter_t *src);
+void __map_filter_free(map_t *map, map_filter_t *filter);
+
+// Counter `probe` of hash's block: which word, and the shift within it.
+static inline uint64_t *__map_filter_counter(const map_filter_t *filter, uint64_t mixed,
+                                             int probe, unsigned *shift) {
+    unsigned counter = (unsigned)(mixed >> (32 + 7 * probe)) & 127;
+    *shift = (counter % 16) * 4;
+    return &filter->blocks[(mixed & filter->mask) * MAP_FILTER_BLOCK_WORDS + counter / 16];
+}
+
+static inline void __map_filter_add(const map_filter_t *filter, uint64_t hash) {
+    uint64_t mixed = __map_mix64(hash);
+    for (int i = 0; i < MAP_FILTER_PROBES; i++) {
+        unsigned shift;
+        uint64_t *word = __map_filter_counter(filter, mixed, i, &shift);
+        if (((*word >> shift) & 15) != 15) *word += (uint64_t)1 << shift;
+    }
+}
+
+static inline void __map_filter_remove(const map_filter_t *filter, uint64_t hash) {
+    uint64_t mixed = __map_mix64(hash);
+    for (int i = 0; i < MAP_FILTER_PROBES; i++) {
+        unsigned shift;
+        uint64_t *word = __map_filter_counter(filter, mixed, i, &shift);
+        uint64_t count = (*word >> shift) & 15;
+        if (count != 15 && count != 0) *word -= (uint64_t)1 << shift;
+    }
+}
+
+// 0 means hash's key is certainly not in the map.
+static inline int __map_filter_test(const map_filter_t *filter, uint64_t hash) {
+    uint64_t mixed = __map_mix64(hash);
+    for (int i = 0; i < MAP_FILTER_PROBES; i++) {
+        unsigned shift;
+        const uint64_t *word = __map_filter_counter(filter, mixed, i, &shift);
+        if (((*word >> shift) & 15) == 0) return 0;
+    }
+    return 1;
+}
+
+// Sorted chain indexes. A chain that reaches MAP_INDEX_BUILD_LENGTH nodes
+// gets one, and loses it again below MAP_INDEX_DROP_LENGTH. The chain stays
+// linked as before, so walkers that don't search (iterators, eviction,
+// snapshots) never look at the index. Building or growing one is best
+// effort: without memory the chain is simply walked.
+#define MAP_INDEX_BUILD_LENGTH 8
+#define MAP_INDEX_DROP_LENGTH 6
+
+static inline map_chain_index_t *__map_index_of(const map_t *map, size_t index) {
+    return map->chain_index != NULL ? map->chain_index[index] : NULL;
+}
+
+// Search bucket index's index for probe: MAP_OK with *out_node, or
+// MAP_ERR_NOT_FOUND.
+map_error_t __map_index_find(const map_t *map, size_t index, const map_probe_t *probe,
+                             map_element_t **out_node);
+// Add a node just linked into bucket index. On MAP_ERR_NO_MEM the chain's
+// index is dropped; on MAP_ERR_UNKNOWN usr_compare turned out not to order
+// keys and every index is. The node stays linked either way.
+map_error_t __map_index_add(map_t *map, size_t index, uint64_t hash, map_element_t *node);
+void __map_index_remove(map_t *map, size_t index, map_element_t *node);
+void __map_index_build(map_t *map, size_t index);
+void __map_index_drop(map_t *map, size_t index);
+void __map_index_drop_all(map_t *map);
+// Index every chain that is long enough, after chains were rebuilt wholesale.
+void __map_index_refresh(map_t *map);
+
+// Call after linking node into bucket index. Returns __map_index_add()'s
+// result; the insert itself has succeeded whatever it is.
+static inline map_error_t __map_index_linked(map_t *map, size_t index, uint64_t hash,
+                                             map_element_t *node) {
+    if (__map_index_of(map, index) != NULL) return __map_index_add(map, index, hash, node);
+    int length = 0;
+    for (map_element_t *cur = map->buckets[index];
+         cur != NULL && length < MAP_INDEX_BUILD_LENGTH; cur = cur->_next) {
+        length++;
+    }
+    if (length == MAP_INDEX_BUILD_LENGTH) __map_index_build(map, index);
+    return MAP_OK;
+}
+
+// Node before `node` in a chain, found by pointer compares alone.
+static inline map_element_t *__map_chain_prev(map_element_t *head, const map_element_t *node) {
+    map_element_t *prev = NULL;
+    for (map_element_t *cur = head; cur != node; cur = cur->_next) prev = cur;
+    return prev;
+}
+
+// Hint that the cache line at addr will be read soon; a no-op where the
+// compiler has no way to say so.
+#if defined(__GNUC__)
+#define __map_prefetch(addr) __builtin_prefetch(addr)
+#else
+#define __map_prefetch(addr) ((void)(addr))
+#endif
+
+// Map a 32-bit value uniformly onto [0, range) without a division.
+static inline uint32_t __map_fastrange32(uint32_t x, uint32_t range) {
+    return (uint32_t)(((uint64_t)x * range) >> 32);
+}
+
+// Stripe accumulator shared by the byte hash's long-input path. Exposed so
+// the scalar reference and the vectorized dispatch can be checked against
+// each other.
+#define MAP_HASH_LANES 8
+#define MAP_HASH_STRIPE 64
+#define MAP_HASH_STRIPES_PER_BLOCK 16
+#define MAP_HASH_LONG_INPUT 128
+
+void __map_hash_stripes_scalar(uint64_t acc[MAP_HASH_LANES], const uint8_t *p,
+                               size_t num_stripes, uint64_t seed);
+void __map_hash_stripes(uint64_t acc[MAP_HASH_LANES], const uint8_t *p,
+                        size_t num_stripes, uint64_t seed);
@@ -1,4 +1,5 @@
 #pragma once
+#include <pthread.h>
 
 typedef struct map_element {
   void *_key;
@@ -6,10 +7,352 @@ typedef struct map_element {
   struct map_element *_next;
 } map_element_t;
 
+// Storage engine behind a map_t, chosen at creation time.
+typedef enum {
+  MAP_ENGINE_CHAINING = 0, // Separate chaining (default).
+  MAP_ENGINE_CUCKOO,       // Bucketized cuckoo hashing, two buckets per key.
+  MAP_ENGINE_DENSE,        // Insertion-ordered entry array plus an index table.
+  MAP_ENGINE_POOL,         // Chaining with pooled nodes and 32-bit links.
+  MAP_ENGINE_DISK,         // Hash partitions spilled to files past a RAM budget.
+} map_engine_t;
+
+// How keys are stored.
+typedef enum {
+  MAP_KEY_USER = 0, // Opaque keys, managed by the usr_* key callbacks.
+  MAP_KEY_STRING,   // NUL-terminated strings copied into a map-owned arena.
+} map_key_mode_t;
+
+// Memory source for everything a map allocates itself: the map_t, bucket
+// arrays, nodes and engine storage. Keys and values still come from the
+// usr_* clone callbacks. The calls follow malloc/realloc/free, except that
+// the caller also passes the size of the block being resized or released.
+typedef struct {
+  void *(*alloc)(void *ctx, size_t size);
+  void *(*realloc)(void *ctx, void *ptr, size_t old_size, size_t new_size);
+  void (*free)(void *ctx, void *ptr, size_t size);
+  void *ctx;
+} map_allocator_t;
+
+// Bump arena. Allocations are carved out of large chunks and are only
+// given back all at once, by map_arena_reset() or map_arena_destroy().
+typedef struct map_arena_chunk {
+  struct map_arena_chunk *next;
+  size_t used;
+  size_t capacity;
+  char data[];
+} map_arena_chunk_t;
+
+typedef struct {
+  map_arena_chunk_t *chunks; // Newest chunk first.
+  size_t chunk_size;
+  char *last;                // Most recent allocation, resized in place.
+} map_arena_t;
+
+// Huge-page allocator. Large blocks (bucket arrays) get their own 2MB-
+// aligned mappings; small and medium blocks (nodes, key chunks) are carved
+// from 2MB slabs with one free list per size class. Every mapping is backed
+// by explicit (MAP_HUGETLB) or transparent huge pages where the system
+// allows, and placed according to the NUMA policy.
+#define MAP_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define MAP_HUGEPAGE_CLASSES 26 // 16 small ones, then powers of two up to 256KB.
+
+typedef enum {
+  MAP_NUMA_DEFAULT = 0, // Leave placement to the kernel (first touch).
+  MAP_NUMA_INTERLEAVE,  // Spread pages round-robin over all nodes.
+  MAP_NUMA_BIND,        // Keep pages on numa_node.
+} map_numa_policy_t;
+
+typedef struct {
+  int explicit_huge_pages;       // Try MAP_HUGETLB before transparent pages.
+  map_numa_policy_t numa_policy;
+  int numa_node;                 // MAP_NUMA_BIND only.
+} map_hugepage_options_t;
+
+typedef struct map_hugepage_slab {
+  struct map_hugepage_slab *next;
+} map_hugepage_slab_t;
+
+typedef struct {
+  map_hugepage_options_t options;
+  map_hugepage_slab_t *slabs;
+  char *slab_cursor;  // Bump pointer into the newest slab.
+  char *slab_end;
+  void *free_lists[MAP_HUGEPAGE_CLASSES];
+  int numa_nodes;     // Nodes found at creation; 1 means no NUMA work.
+
+  // Statistics.
+  size_t mapped_bytes;     // Currently mapped, slabs included.
+  size_t hugetlb_mappings; // Mappings that got explicit huge pages.
+  size_t numa_failures;    // Placement requests the kernel refused.
+} map_hugepage_t;
+
+// Disk engine settings. Start from map_disk_options_init(). The codec
+// works like map_wal_options_t's: encode_* write an object's bytes to buf
+// when they fit in cap (buf is NULL when cap is 0) and return how many
+// bytes it takes either way; decode_* build a new object from len bytes,
+// or return NULL.
+typedef struct {
+  const char *dir;     // Existing directory; the map makes its own inside.
+  size_t ram_budget;   // Bytes of partitions kept in memory.
+  uint32_t partitions; // A power of two, at most MAP_DISK_MAX_PARTITIONS.
+  size_t (*encode_key)(void *key, uint8_t *buf, size_t cap);
+  void *(*decode_key)(const uint8_t *buf, size_t len);
+  size_t (*encode_value)(void *value, uint8_t *buf, size_t cap);
+  void *(*decode_value)(const uint8_t *buf, size_t len);
+} map_disk_options_t;
+
+#define MAP_DISK_MAX_PARTITIONS 65536
+
+// Options for map_create_ex(). Always start from map_options_init().
+typedef struct {
+  map_engine_t engine;
+  map_key_mode_t key_mode;
+  const map_allocator_t *allocator; // NULL means malloc/realloc/free.
+
+  // Cache mode (chaining engine only): a non-zero limit bounds the map and
+  // map_insert() evicts entries with CLOCK to stay within it.
+  size_t max_entries; // 0 means no entry limit.
+  size_t max_bytes;   // 0 means no byte limit.
+  size_t (*entry_size)(void *key, void *value); // Bytes charged per entry, or NULL.
+  void (*on_evict)(void *ctx, void *key, void *value); // Optional.
+  void *evict_ctx;
+
+  // Expiring entries (chaining engine only): allow map_insert_ttl().
+  int enable_ttl;
+  uint64_t (*clock)(void *ctx); // Current time in TTL units; NULL means monotonic ms.
+  void *clock_ctx;
+
+  // Keep a membership filter that answers most misses without walking a
+  // chain (chaining engine only).
+  int enable_filter;
+
+  // Disk engine settings, required with MAP_ENGINE_DISK. Copied.
+  const map_disk_options_t *disk;
+} map_options_t;
+
+// Counters of a map in cache mode.
+typedef struct {
+  size_t hits;      // map_get() calls that found their key.
+  size_t misses;
+  size_t evictions;
+  size_t bytes;     // Sum of all entries' charges, as checked against max_bytes.
+} map_cache_stats_t;
+
+// Counters of a disk engine map.
+typedef struct {
+  size_t resident_bytes;      // Charged against ram_budget right now.
+  size_t resident_partitions;
+  size_t faults;              // Partitions read back from their files.
+  size_t spills;              // Partitions dropped from memory.
+  size_t bytes_read;
+  size_t bytes_written;
+} map_disk_stats_t;
+
+// Write-ahead log settings. encode_* write an object's bytes to buf when
+// they fit in cap (buf is NULL when cap is 0) and return how many bytes it
+// takes either way. decode_* build a new object from len bytes, or return
+// NULL; replay inserts it and frees it with usr_free_key/usr_free_value.
+typedef struct {
+  size_t (*encode_key)(void *key, uint8_t *buf, size_t cap);
+  void *(*decode_key)(const uint8_t *buf, size_t len);
+  size_t (*encode_value)(void *value, uint8_t *buf, size_t cap);
+  void *(*decode_value)(const uint8_t *buf, size_t len);
+
+  // Group commit: records are buffered and fsync'ed once either limit is
+  // reached. 0 disables a limit; with both 0 only map_wal_sync() syncs.
+  // Both are checked as records are appended, so an idle log stays
+  // unsynced until the next change; call map_wal_sync() to bound that.
+  size_t sync_every_records;
+  uint32_t sync_every_ms;
+  size_t buffer_size;        // Bytes buffered before a write(), 0 for the default.
+} map_wal_options_t;
+
+// String key arena. Keys are appended to chunks, each preceded by a header
+// holding the key's hash and length; a map_element_t's _key points at the
+// key bytes right after the header. Removed keys only become dead bytes
+// until map_compact_keys() rewrites the arena.
+typedef struct {
+  uint64_t hash;
+  uint32_t length;
+  uint32_t record_size; // Header + bytes + NUL, rounded up to 8.
+} map_key_header_t;
+
+typedef struct map_key_chunk {
+  struct map_key_chunk *next;
+  size_t used;
+  size_t capacity;
+  char data[];
+} map_key_chunk_t;
+
+// Cuckoo engine bucket: 8-bit fingerprints first so one vector compare
+// finds candidate slots before any key is touched. Tag 0 marks a free slot.
+// A bucket is 136 bytes and spans three cache lines, so a lookup reads the
+// tag line of each candidate bucket plus the line (two, if it straddles)
+// holding a matching slot: two lines for a miss and up to four for a hit,
+// more only on 8-bit tag collisions, before the key is dereferenced.
+#define MAP_CUCKOO_SLOTS 8
+
+typedef struct {
+  void *_key;
+  void *_value;
+} map_cuckoo_slot_t;
+
+typedef struct {
+  uint8_t tags[MAP_CUCKOO_SLOTS];
+  map_cuckoo_slot_t slots[MAP_CUCKOO_SLOTS];
+} map_cuckoo_bucket_t;
+
+// Stashed cuckoo entry. The full hash is matched before usr_compare runs.
+typedef struct {
+  uint64_t hash;
+  void *_key;
+  void *_value;
+} map_cuckoo_stashed_t;
+
+// Node of a map created with options.enable_ttl. The timer lives in the node
+// itself, so expiring entries need no allocation of their own; `base` comes
+// first, so every chain walk treats it as a plain map_element_t.
+typedef struct map_ttl_element {
+  map_element_t base;
+  uint64_t expires;                      // Clock time it expires at, 0 for never.
+  struct map_ttl_element *timer_next;    // Next node in the same wheel slot.
+  struct map_ttl_element **timer_link;   // Pointer to this node in its slot, or NULL.
+} map_ttl_element_t;
+
+// Hierarchical timer wheel: level l has 64 slots of 64^l ticks each, so the
+// wheel spans 2^24 ticks ahead; deadlines beyond that wait on `overflow`,
+// which moves to `pulling` each time the wheel turns over and is placed from
+// there a budget's worth at a time.
+// A node sits on the lowest level whose span still holds its deadline and
+// moves down a level each time the wheel reaches its slot.
+#define MAP_TTL_LEVELS 4
+#define MAP_TTL_SLOT_BITS 6
+#define MAP_TTL_SLOTS (1 << MAP_TTL_SLOT_BITS)
+
+typedef struct {
+  map_ttl_element_t *slots[MAP_TTL_LEVELS][MAP_TTL_SLOTS];
+  uint64_t occupied[MAP_TTL_LEVELS]; // Bit per slot; may be stale after removals.
+  map_ttl_element_t *overflow;
+  map_ttl_element_t *pulling;        // Overflow nodes still to place.
+  uint64_t now;                      // First tick not processed yet.
+  uint64_t (*clock)(void *ctx);
+  void *clock_ctx;
+} map_ttl_wheel_t;
+
+// Dense engine entry. Entries are appended in insertion order; a removed
+// entry keeps its place with a NULL key until the array is compacted.
+typedef struct {
+  uint64_t hash;
+  void *_key;
+  void *_value;
+} map_dense_entry_t;
+
+// Pool engine node. Links are positions in the pool plus one (0 ends a
+// chain), and hash is the low half of the mixed hash: it picks the bucket
+// and is compared before usr_compare. A free node has a NULL key.
+typedef struct {
+  void *_key;
+  void *_value;
+  uint32_t next;
+  uint32_t hash;
+} map_pool_node_t;
+
+// Disk engine entry. A removed entry keeps its position with a NULL key,
+// so iterator positions survive a partition being spilled and read back.
+typedef struct {
+  uint64_t hash;  // Mixed hash: top bits pick the partition, low bits the slot.
+  void *key;
+  void *value;
+  size_t bytes;   // Encoded size plus overhead, charged while resident.
+} map_disk_entry_t;
+
+// One hash partition. Counts stay valid while it is spilled; entries and
+// index only exist while it is resident.
+typedef struct {
+  map_disk_entry_t *entries;
+  uint32_t *index;       // Open addressing; positions plus one, 0 for empty.
+  uint32_t used;         // Positions handed out, removed entries included.
+  uint32_t live;
+  uint32_t capacity;
+  uint32_t index_size;   // A power of two, or 0 with no index.
+  size_t bytes;          // Sum of the live entries' charges.
+  size_t file_bytes;     // Spill file size, 0 when there is none.
+  uint64_t last_use;     // Eviction picks the smallest.
+  int resident;
+  int dirty;             // Changed since it was last read or written.
+} map_disk_part_t;
+
+typedef struct {
+  map_disk_options_t options;
+  char *path;            // Private directory; partition i's file is path/i.
+  size_t path_capacity;  // Room for the directory plus a file name.
+  size_t dir_length;
+  map_disk_part_t *parts;
+  uint64_t clock;
+  uint8_t *buffer;       // Spill and fault staging.
+  size_t buffer_capacity;
+  map_disk_stats_t stats;
+} map_disk_t;
+
+// Counting Bloom filter over the keys' hashes. Each block is one 64-byte
+// cache line of 128 four-bit counters; a key touches a single block.
+#define MAP_FILTER_BLOCK_WORDS 8
+
+typedef struct {
+  uint64_t *blocks;      // Aligned to 64 bytes; NULL when there is no filter.
+  void *allocation;      // What blocks was carved from.
+  size_t allocation_size;
+  uint64_t mask;         // Number of blocks minus one.
+} map_filter_t;
+
+// Sorted index of one long chain: its nodes ordered by stored hash, then
+// by key, so lookups binary search instead of walking the chain.
+typedef struct {
+  uint64_t hash;
+  map_element_t *node;
+} map_chain_entry_t;
+
+typedef struct {
+  uint32_t count;
+  uint32_t capacity;
+  map_chain_entry_t entries[];
+} map_chain_index_t;
+
+// An open write-ahead log: records not yet written sit in `buffer`.
+typedef struct {
+  int fd;
+  char *path;
+  uint8_t *buffer;
+  size_t buffer_used;
+  size_t buffer_capacity;
+  size_t unsynced;           // Records appended since the last fsync.
+  uint64_t last_sync_ms;
+  uint64_t file_size;        // Bytes in the file, all of them whole records.
+  int failed;                // A failed write couldn't be cut off again.
+  map_wal_options_t options;
+} map_wal_t;
+
+struct map_engine_ops;
+struct map_snapshot;
+
+// Memory a writer unlinked while snapshots could still see it. It is only
+// freed once every snapshot taken at or before `epoch` has been released.
+typedef enum {
+  MAP_RETIRED_NODE = 0, // A map_element_t; its key and value live on.
+  MAP_RETIRED_KEY,
+  MAP_RETIRED_VALUE,
+} map_retired_kind_t;
+
+typedef struct {
+  void *ptr;
+  uint64_t epoch;
+  map_retired_kind_t kind;
+} map_retired_t;
+
 typedef struct {
   map_element_t **buckets;
-  int32_t num_buckets;
-  int32_t num_entries;
+  size_t num_buckets;
+  size_t num_entries;
   float max_load_factor; // Set this to 2.0
   float min_load_factor; // Set this to max_load_factor/4.
   float grow_factor;     // Grow num_buckets by 2.0x on resize.
@@ -23,13 +366,196 @@ typedef struct {
   int32_t (*usr_compare)(void *key1, void *key2);
   void (*usr_free_key)(void *key);
   void (*usr_free_value)(void *value);
+
+  // Where the map's own memory comes from (copied from the options).
+  map_allocator_t allocator;
+
+  // Engine dispatch. ops is NULL for the built-in chaining engine.
+  map_engine_t engine;
+  const struct map_engine_ops *ops;
+
+  // String key mode state.
+  map_key_mode_t key_mode;
+  map_key_chunk_t *key_chunks; // Newest chunk first.
+  size_t key_live_bytes;
+  size_t key_dead_bytes;
+
+  // Cuckoo engine state (num_buckets is a power of two). Entries no
+  // displacement walk could place wait in the stash.
+  map_cuckoo_bucket_t *cuckoo_buckets;
+  map_cuckoo_stashed_t *cuckoo_stash;
+  size_t cuckoo_stash_size;
+  size_t cuckoo_stash_capacity;
+  uint64_t cuckoo_rng;
+
+  // Dense engine state. num_buckets is the index table size (a power of
+  // two); each index slot is dense_index_width bytes wide and holds an
+  // entry position plus one, 0 for empty.
+  map_dense_entry_t *dense_entries;
+  size_t dense_used;           // Entries appended so far, removed ones included.
+  size_t dense_capacity;
+  void *dense_index;
+  uint8_t dense_index_width;
+
+  // Pool engine state. num_buckets chain heads (a power of two) and the
+  // node pool, all linked by position plus one, so both arrays can move.
+  uint32_t *pool_heads;
+  map_pool_node_t *pool_nodes;
+  uint32_t pool_used;          // Nodes handed out so far, free ones included.
+  uint32_t pool_capacity;
+  uint32_t pool_free;          // First free node plus one, 0 if none.
+
+  // Disk engine state, NULL for the other engines. num_buckets is the
+  // number of partitions.
+  map_disk_t *disk;
+
+  // Snapshot state. While snapshots are live, chains are copied before
+  // their first write and nothing they can see is freed or relinked.
+  struct map_snapshot *snapshots; // Live snapshots, newest first.
+  uint64_t snapshot_seq;          // Id of the newest snapshot taken.
+  uint64_t *cow_private;          // Bit per bucket: copied since the newest snapshot.
+  map_retired_t *retired;         // Oldest first.
+  size_t num_retired;
+  size_t retired_capacity;
+  int destroy_pending;            // map_destroy() called while snapshots were live.
+
+  // Cache mode state. cache_referenced is NULL unless a limit was set.
+  size_t cache_max_entries;
+  size_t cache_max_bytes;
+  size_t cache_bytes;
+  size_t (*usr_entry_size)(void *key, void *value);
+  void (*usr_evict)(void *ctx, void *key, void *value);
+  void *evict_ctx;
+  uint64_t *cache_referenced;     // Bit per bucket: used since the hand last passed.
+  size_t cache_hand;              // Next bucket the CLOCK hand looks at.
+  size_t cache_hits;
+  size_t cache_misses;
+  size_t cache_evictions;
+
+  // Expiry state, NULL unless created with options.enable_ttl.
+  map_ttl_wheel_t *ttl;
+
+  // Bumped by anything that moves or frees entries other than
+  // map_iter_remove(), so stale iterators can tell.
+  uint32_t resize_epoch;
+
+  // Write-ahead log, NULL unless map_wal_open() attached one.
+  map_wal_t *wal;
+
+  // Negative lookup filter (options.enable_filter), sized with the buckets.
+  map_filter_t filter;
+
+  // Chaining only: index per bucket whose chain got long, NULL for the
+  // others. The array itself is NULL until the first chain needs one.
+  // chain_index_off is set once usr_compare is caught not ordering keys.
+  map_chain_index_t **chain_index;
+  size_t num_chain_indexes;
+  int32_t chain_index_off;
 } map_t;
 
+// A set is a map whose entries carry no value of their own: every entry
+// shares one static placeholder, so nothing is cloned or freed for it.
+typedef map_t map_set_t;
+
+// Read-only, point-in-time view of a chaining map. It owns a copy of the
+// bucket heads and shares every node with the map.
+typedef struct map_snapshot {
+  map_t *map;
+  map_element_t **buckets;
+  size_t num_buckets;
+  size_t num_entries;
+  uint64_t id;
+  int32_t refcount;
+  struct map_snapshot *next;
+  struct map_snapshot *prev;
+} map_snapshot_t;
+
 typedef struct {
-  int32_t current_bucket;         // Which bucket index we're on.
+  size_t current_bucket;          // Which bucket index (or slot) we're on.
   map_element_t *current_element; // Which element in the chain.
+  map_element_t *last_element;    // Chaining: node last returned, for map_iter_remove().
+  size_t current_slot;            // Disk: next position in partition current_bucket.
+  uint32_t epoch;                 // map->resize_epoch when the iterator started.
+  int32_t live;                   // Started and not yet done.
+  int32_t removed;                // map_iter_remove() ran: check for a shrink when done.
 } map_iterator_t;
 
+// Read-only minimal perfect hash table built from a populated map_t.
+// Every key owns exactly one slot in `entries`, so a lookup is one hash,
+// one pilot read and one entry probe.
+typedef struct {
+  void *_key;
+  void *_value;
+} map_perfect_entry_t;
+
+typedef struct {
+  map_perfect_entry_t *entries; // num_entries slots, one per key.
+  uint16_t *pilots;             // One displacement pilot per pilot bucket.
+  uint32_t *remap;              // Slots >= num_entries folded back below it.
+  uint64_t seed;
+  uint32_t num_entries;
+  uint32_t num_pilot_buckets;
+  uint32_t table_size;          // Slightly larger than num_entries.
+
+  // User provided functions, taken over from the source map.
+  uint64_t (*usr_hash)(void *key);
+  int32_t (*usr_compare)(void *key1, void *key2);
+  void (*usr_free_key)(void *key);
+  void (*usr_free_value)(void *value);
+  map_allocator_t allocator;
+} map_perfect_t;
+
+// Integer map: uint64_t keys and values stored inline. Open addressing
+// with linear probing over one array of key/value pairs, so a lookup
+// touches a single cache line. Two key values mark free slots; entries
+// with those keys are kept on the side.
+#define MAP_IMAP_EMPTY 0             // Key of a slot never used since the last rehash.
+#define MAP_IMAP_DELETED UINT64_MAX  // Key of a removed entry's slot.
+
+typedef struct {
+  uint64_t key;
+  uint64_t value;
+} map_imap_slot_t;
+
+typedef struct {
+  map_imap_slot_t *slots; // capacity slots, a power of two.
+  size_t capacity;
+  size_t size;           // Live entries, the side ones included.
+  size_t used;           // Slots that aren't empty, deleted ones included.
+  unsigned shift;        // 64 - log2(capacity): the top hash bits pick a home slot.
+  int has_side[2];       // Whether keys MAP_IMAP_EMPTY and MAP_IMAP_DELETED are in.
+  uint64_t side_values[2];
+  uint32_t epoch;        // Bumped by every rehash, to catch stale iterators.
+} map_imap_t;
+
+// Hash join table over caller-owned build rows. Rows are grouped by key:
+// each distinct key has one group, and a group's rows are contiguous in
+// `rows`, in the order they were given.
+typedef struct {
+  uint64_t hash;   // Mixed hash of the key.
+  void *key;       // The key of the group's first row.
+  size_t start;    // Position of the group's first row.
+  size_t count;
+} map_join_group_t;
+
+// Directory slot: the upper half of the group's hash and its position
+// plus one (0 for an empty slot), so most misses never touch a group.
+typedef struct {
+  uint32_t tag;
+  uint32_t group;
+} map_join_slot_t;
+
+typedef struct {
+  map_join_group_t *groups;
+  size_t num_groups;
+  void **rows;
+  size_t num_rows;
+  map_join_slot_t *slots;   // Open addressing over groups, load at most 1/2.
+  size_t slot_mask;
+  uint64_t (*usr_hash)(void *key);
+  int32_t (*usr_compare)(void *key1, void *key2);
+} map_join_t;
+
 typedef enum {
   MAP_OK = 0,          // Operation succeeded
   MAP_ERR_NO_MEM,      // Memory allocation failed
@@ -37,5 +563,98 @@ typedef enum {
   MAP_ERR_INVALID_ARG, // One or more arguments were invalid
   MAP_ERR_OVERFLOW,    // For example, table too large to resize
   MAP_ERR_END_OF_MAP,
+  MAP_ERR_STALE_ITERATOR, // The map changed under a live iterator
+  MAP_ERR_IO,             // Reading or writing a log file failed
   MAP_ERR_UNKNOWN // Catch-all for other errors
 } map_error_t;
+
+// Group-by settings. Start from map_agg_options_init(). A group's state is
+// created by init, folded with each added value by update, and combined
+// with a partial state of the same group (read back from a spill file) by
+// merge, which leaves other to be freed. The codec works like
+// map_disk_options_t's, with states in place of values.
+#define MAP_AGG_MAX_PARTITIONS 256
+
+typedef struct {
+  const char *dir;        // Existing directory; the group-by makes its own inside.
+  size_t ram_budget;      // Bytes of groups held in memory before spilling.
+  uint32_t partitions;    // Spill fan-out: a power of two, 2 to MAP_AGG_MAX_PARTITIONS.
+  void *ctx;              // Passed to init, update and merge.
+  void *(*init)(void *ctx, void *key);
+  void (*update)(void *ctx, void *state, void *value);
+  void (*merge)(void *ctx, void *state, void *other);
+  void (*free_state)(void *state);
+  size_t (*encode_key)(void *key, uint8_t *buf, size_t cap);
+  void *(*decode_key)(const uint8_t *buf, size_t len);
+  size_t (*encode_state)(void *state, uint8_t *buf, size_t cap);
+  void *(*decode_state)(const uint8_t *buf, size_t len);
+} map_agg_options_t;
+
+// Counters of a group-by.
+typedef struct {
+  size_t groups;          // Groups in memory right now.
+  size_t bytes;           // Charged against ram_budget right now.
+  size_t spills;          // Times the groups in memory were written out.
+  size_t bytes_written;
+  size_t bytes_read;
+  uint32_t max_level;     // Deepest level of partition files merged; 0 if none were.
+} map_agg_stats_t;
+
+// Groups aggregated in memory and the files they spill to: the group-by's
+// own while adding, and one per partition file that finalize merges.
+typedef struct {
+  map_t *groups;          // Partial states since the last spill.
+  size_t bytes;           // Charged to the groups in memory.
+  size_t budget;
+  uint32_t level;         // Spills pick files by the level'th group of hash bits.
+  char *path;             // Spill file prefix: the directory, or the file being split.
+  size_t prefix_length;
+  int spilled;
+  uint8_t written[MAP_AGG_MAX_PARTITIONS]; // Partition files this table made.
+  uint8_t *buffer;        // Encoding scratch.
+  size_t buffer_capacity;
+  map_agg_stats_t stats;
+} map_agg_table_t;
+
+typedef struct {
+  map_agg_options_t options;
+  void *(*usr_key_clone)(void *key);
+  uint64_t (*usr_hash)(void *key);
+  int32_t (*usr_compare)(void *key1, void *key2);
+  void (*usr_free_key)(void *key);
+  uint32_t bits;          // log2(partitions): hash bits used per level.
+  map_agg_table_t table;  // Spills into the private directory, one file per partition.
+  int closed;             // Finalized, or a failed spill left groups in doubt.
+} map_agg_t;
+
+// Streaming reducer: one private map per thread, drained into a shared
+// global map under a lock.
+typedef struct {
+  map_t *global;
+  pthread_mutex_t lock;    // Held while a local map is merged into global.
+  map_t **locals;
+  int num_locals;
+  map_t *empty;            // Kept empty; fresh locals are cloned from it.
+  void *(*combine)(void *ctx, void *key, void *dst_value, void *src_value);
+  void *ctx;
+} map_reducer_t;
+
+// Export formats. Text formats hold the encoded bytes as they are, quoted
+// and escaped as needed, so encoders should produce UTF-8 text for them.
+typedef enum {
+  MAP_EXPORT_CSV = 0, // A "key,value" header, then one line per entry.
+  MAP_EXPORT_JSON,    // One object, with keys and values as JSON strings.
+  MAP_EXPORT_BINARY,  // Per entry: key length (4) | value length (4) | key | value,
+                      // native byte order.
+} map_export_format_t;
+
+// Export settings. Start from map_export_options_init(). encode_* work
+// like map_wal_options_t's.
+typedef struct {
+  map_export_format_t format;
+  size_t (*encode_key)(void *key, uint8_t *buf, size_t cap); // NULL: string keys as they are.
+  size_t (*encode_value)(void *value, uint8_t *buf, size_t cap);
+  map_error_t (*write)(void *ctx, const uint8_t *buf, size_t len);
+  void *write_ctx;
+  size_t buffer_size; // Bytes buffered per thread before a write.
+} map_export_options_t;
@@ -8,6 +8,24 @@ void map_log_error(map_error_t err, const char *message) {
   fprintf(stderr, "[libmap ERROR] %s: %s\n", __map_error_str(err), message);
 }
 
+// Options Init Function
+void map_options_init(map_options_t *options) {
+    if (options == NULL) return;
+    options->engine = MAP_ENGINE_CHAINING;
+    options->key_mode = MAP_KEY_USER;
+    options->allocator = NULL;
+    options->max_entries = 0;
+    options->max_bytes = 0;
+    options->entry_size = NULL;
+    options->on_evict = NULL;
+    options->evict_ctx = NULL;
+    options->enable_ttl = 0;
+    options->clock = NULL;
+    options->clock_ctx = NULL;
+    options->enable_filter = 0;
+    options->disk = NULL;
+}
+
 // Create Function.
 map_error_t map_create(map_t **map,
                        void *(*usr_key_clone)(void *key),
@@ -18,28 +36,77 @@ map_error_t map_create(map_t **map,
                        void (*usr_free_key)(void *key),
                        void (*usr_free_value)(void *value)) {
 
-    if (!map || !usr_key_clone || !usr_value_clone || !usr_hash || !usr_stringify ||
-        !usr_compare || !usr_free_key || !usr_free_value) {
+    return map_create_ex(map, NULL, usr_key_clone, usr_value_clone, usr_hash,
+                         usr_stringify, usr_compare, usr_free_key, usr_free_value);
+}
+
+// Create With Options Function.
+map_error_t map_create_ex(map_t **map, const map_options_t *options,
+                          void *(*usr_key_clone)(void *key),
+                          void *(*usr_value_clone)(void *value),
+                          uint64_t (*usr_hash)(void *key),
+                          char *(*usr_stringify)(void *key, void *value),
+                          int32_t (*usr_compare)(void *key1, void *key2),
+                          void (*usr_free_key)(void *key),
+                          void (*usr_free_value)(void *value)) {
+
+    map_options_t defaults;
+    if (options == NULL) {
+        map_options_init(&defaults);
+        options = &defaults;
+    }
+
+    // String-keyed maps own their keys, so the key callbacks are optional
+    // (usr_hash too: the built-in byte hash is used when it is NULL).
+    int string_keys = options->key_mode == MAP_KEY_STRING;
+    if (!map || !usr_value_clone || !usr_stringify || !usr_free_value ||
+        (!string_keys && (!usr_key_clone || !usr_hash || !usr_compare || !usr_free_key))) {
+        return MAP_ERR_INVALID_ARG;
+    }
+    if (options->key_mode != MAP_KEY_USER &&
+        (!string_keys || options->engine != MAP_ENGINE_CHAINING)) {
+        return MAP_ERR_INVALID_ARG;
+    }
+    int cache = options->max_entries != 0 || options->max_bytes != 0;
+    if ((cache || options->enable_ttl || options->enable_filter) &&
+        options->engine != MAP_ENGINE_CHAINING) {
         return MAP_ERR_INVALID_ARG;
     }
 
-    // Allocate memory for map struct
-    *map = malloc(sizeof(map_t));
-    if (*map == NULL) {
-        return MAP_ERR_NO_MEM;
+    const map_allocator_t *allocator = options->allocator;
+    if (allocator == NULL) {
+        allocator = &__map_default_allocator;
+    } else if (!allocator->alloc || !allocator->realloc || !allocator->free) {
+        return MAP_ERR_INVALID_ARG;
     }
 
-    // Allocate memory for buckets
-    (*map)->buckets = malloc(NUM_INITIAL_BUCKETS * sizeof(map_element_t*));
-    if ((*map)->buckets == NULL) {
-        free(*map);
-        return MAP_ERR_NO_MEM;
+    const map_engine_ops_t *ops = NULL;
+    switch (options->engine) {
+    case MAP_ENGINE_CHAINING:
+        break;
+    case MAP_ENGINE_CUCKOO:
+        ops = &__map_cuckoo_ops;
+        break;
+    case MAP_ENGINE_DENSE:
+        ops = &__map_dense_ops;
+        break;
+    case MAP_ENGINE_POOL:
+        ops = &__map_pool_ops;
+        break;
+    case MAP_ENGINE_DISK:
+        ops = &__map_disk_ops;
+        break;
+    default:
+        return MAP_ERR_INVALID_ARG;
     }
 
-    // Initialize all buckets to NULL
-    for (int i = 0; i < NUM_INITIAL_BUCKETS; i++) {
-        (*map)->buckets[i] = NULL;
+    // Allocate memory for map struct
+    *map = allocator->alloc(allocator->ctx, sizeof(map_t));
+    if (*map == NULL) {
+        return MAP_ERR_NO_MEM;
     }
+    memset(*map, 0, sizeof(map_t));
+    (*map)->allocator = *allocator;
 
     // Initialize map fields
     (*map)->num_buckets = NUM_INITIAL_BUCKETS;
@@ -58,15 +125,81 @@ map_error_t map_create(map_t **map,
     (*map)->usr_free_key = usr_free_key;
     (*map)->usr_free_value = usr_free_value;
 
+    (*map)->key_mode = options->key_mode;
+    (*map)->engine = options->engine;
+    (*map)->ops = ops;
+    if (ops != NULL) {
+        map_error_t result = options->engine == MAP_ENGINE_DISK ?
+                             __map_disk_prepare(*map, options->disk) : MAP_OK;
+        if (result == MAP_OK) result = ops->init(*map);
+        if (result != MAP_OK) {
+            __map_free(*map, *map, sizeof(map_t));
+            *map = NULL;
+        }
+        return result;
+    }
+
+    // A cache with an entry limit gets all its buckets up front (load 1.0
+    // when full), so it never resizes on the way there.
+    if (options->max_entries > NUM_INITIAL_BUCKETS) {
+        if (options->max_entries > MAP_MAX_BUCKETS) {
+            __map_free(*map, *map, sizeof(map_t));
+            *map = NULL;
+            return MAP_ERR_OVERFLOW;
+        }
+        (*map)->num_buckets = options->max_entries;
+    }
+
+    // Allocate memory for buckets
+    (*map)->buckets = __map_alloc(*map, (*map)->num_buckets * sizeof(map_element_t*));
+    if ((*map)->buckets == NULL) {
+        __map_free(*map, *map, sizeof(map_t));
+        *map = NULL;
+        return MAP_ERR_NO_MEM;
+    }
+
+    // Initialize all buckets to NULL
+    for (size_t i = 0; i < (*map)->num_buckets; i++) {
+        (*map)->buckets[i] = NULL;
+    }
+
+    if ((cache && __map_cache_init(*map, options) != MAP_OK) ||
+        (options->enable_ttl &&
+         __map_ttl_init(*map, options->clock, options->clock_ctx, 0) != MAP_OK) ||
+        (options->enable_filter &&
+         __map_filter_init(*map, &(*map)->filter, (uint64_t)(*map)->num_buckets) != MAP_OK)) {
+        __map_cache_free(*map);
+        __map_ttl_free(*map);
+        __map_free(*map, (*map)->buckets, (*map)->num_buckets * sizeof(map_element_t*));
+        __map_free(*map, *map, sizeof(map_t));
+        *map = NULL;
+        return MAP_ERR_NO_MEM;
+    }
+
     return MAP_OK;
 }
 
-// Insert Function
-map_error_t map_insert(map_t *map, void *key, void *value) {
+// Insert, clearing the deadline of an existing expiring entry unless
+// keep_deadline is set.
+static map_error_t insert_value(map_t *map, void *key, void *value, int keep_deadline) {
     if (!map || !key || !value) return MAP_ERR_INVALID_ARG;
+    if (map->wal != NULL) {
+        map_error_t logged = __map_wal_append(map, MAP_WAL_INSERT, key, value);
+        if (logged != MAP_OK) return logged;
+    }
+    if (map->ops) return map->ops->insert(map, key, value);
 
-    map_error_t result = __map_insert_no_resize(map, key, value);
+    map_element_t *node;
+    map_error_t result = __map_insert_entry(map, key, value, &node);
     if (result != MAP_OK) return result;  // Propagate errors
+    // Plain inserts never expire. New nodes start without a deadline.
+    if (map->ttl != NULL && !keep_deadline) __map_ttl_set(map, node, 0);
+
+    // Caches make room by evicting rather than growing without bound.
+    if (map->cache_referenced != NULL) {
+        result = __map_cache_evict(map);
+        if (result != MAP_OK) return result;
+    }
 
     // Resize if needed
     if ((double)map->num_entries / map->num_buckets > map->max_load_factor) {
@@ -77,17 +210,28 @@ map_error_t map_insert(map_t *map, void *key, void *value) {
     return MAP_OK;
 }
 
+// Insert Function
+map_error_t map_insert(map_t *map, void *key, void *value) {
+    return insert_value(map, key, value, 0);
+}
+
+map_error_t __map_update_value(map_t *map, void *key, void *value) {
+    return insert_value(map, key, value, 1);
+}
+
 // Print Function
 map_error_t map_print(const map_t *map) {
    	if (map == NULL){
 		printf("Map is null\n");
 		return MAP_ERR_INVALID_ARG;
 	}
+	if (map->ops) return map->ops->print(map);
 
 	printf("Map contents:\n");
-	for (int i=0; i < map->num_buckets; i++){
+	for (size_t i=0; i < map->num_buckets; i++){
 		map_element_t *current = map->buckets[i];
-		printf("Buckets %d: ",i);
+		if (current == NULL) continue;
+		printf("Buckets %zu: ",i);
 
 		while (current != NULL){
 			char *entry_str = map->usr_stringify(current->_key, current->_value);
@@ -112,77 +256,142 @@ map_error_t map_get(const map_t *map, void *key, void **value) {
     if (map == NULL || key == NULL || value == NULL) {
         return MAP_ERR_INVALID_ARG;
     }
+    if (map->ops) return map->ops->get(map, key, value);
 
     // 2. Hashing the key to find correct bucket.
-    uint64_t hash = map->usr_hash(key);
-    int index = hash % map->num_buckets;
+    map_probe_t probe = __map_probe(map, key);
+    uint64_t index = probe.hash % map->num_buckets;
 
-    // Traverse the bucket's linked list.
-    map_element_t *current = map->buckets[index];
-
-    while (current != NULL) {
-        int cmp_result = map->usr_compare(current->_key, key);
+    // Most misses stop at the filter, without touching the chain.
+    if (map->filter.blocks != NULL && !__map_filter_test(&map->filter, probe.hash)) {
+        if (map->cache_referenced != NULL) ((map_t *)map)->cache_misses++;
+        return MAP_ERR_NOT_FOUND;
+    }
 
-        // Handle broken usr_compare function
-        if (cmp_result < -1 || cmp_result > 1) {
-            return MAP_ERR_UNKNOWN;
+    // Traverse the bucket's linked list, or search its index if it is long.
+    map_element_t *current = map->buckets[index];
+    map_element_t *prev = NULL;
+
+    if (__map_index_of(map, index) != NULL) {
+        map_error_t found = __map_index_find(map, index, &probe, &current);
+        if (found == MAP_ERR_UNKNOWN) return found;
+        if (found != MAP_OK) {
+            current = NULL;
+        } else if (map->ttl != NULL || map->cache_referenced != NULL) {
+            prev = __map_chain_prev(map->buckets[index], current);
+        }
+    } else {
+        while (current != NULL) {
+            int cmp_result = __map_probe_compare(map, &probe, current->_key);
+
+            // Handle broken usr_compare function
+            if (cmp_result < -1 || cmp_result > 1) {
+                return MAP_ERR_UNKNOWN;
+            }
+            if (cmp_result == 0) break;
+
+            prev = current;
+            current = current->_next; // Move to the next element
         }
+    }
 
-        if (cmp_result == 0) {
+    if (current != NULL) {
+        // Expired entries are dropped on sight; lookups on expiring maps write.
+        if (map->ttl != NULL && __map_ttl_due(map, current)) {
+            __map_ttl_drop((map_t *)map, index, prev, current);
+        } else {
             *value = current->_value; // Key found, set value.
+            if (map->cache_referenced != NULL) __map_cache_hit(map, index, prev, current);
             return MAP_OK;
         }
-        current = current->_next; // Move to the next element
     }
 
     // If key not found
+    if (map->cache_referenced != NULL) ((map_t *)map)->cache_misses++;
     return MAP_ERR_NOT_FOUND;
 }
 
 
-// Remove Function
-map_error_t map_remove(map_t *map, void *key){
-	if (map == NULL || key == NULL) {
-		return MAP_ERR_INVALID_ARG;
+// Shrink the chaining table while it is mostly empty. Resizing bumps
+// resize_epoch, so live iterators find out rather than lose their place.
+static void shrink_if_sparse(map_t *map) {
+	// Usually one step; more after removes made through an iterator.
+	while ((double)map->num_entries / map->num_buckets < map->min_load_factor &&
+	       map->num_buckets > 1) { // Checking if map needs to be resized and has multiple buckets
+		size_t before = map->num_buckets;
+		if (__map_resize(map, map->shrink_factor) != MAP_OK || map->num_buckets == before) break;
 	}
-	// Hashing the key
-	int64_t hash = map->usr_hash(key);
-	int index = hash % map->num_buckets; // Getting the index
-
-	// Current and previous pointers
+}
 
-	map_element_t *current = map->buckets[index];
-	map_element_t *prev = NULL;
+// Unlink node (found in bucket index, after prev) and free it.
+static void remove_node(map_t *map, uint64_t index, map_element_t *prev, map_element_t *current) {
+	// Key found remove node (2 cases head of the list or not)
 
-	// Linked list traversal
+	if (prev == NULL) { // case 1: Node to be removed is at the head of the list
+		map->buckets[index] = current->_next;
+	}
 
-	while (current != NULL){
-		if (map->usr_compare(key,current->_key) == 0) {
+	else {
+		prev->_next = current->_next;
+	}
 
-			// Key found remove node (2 cases head of the list or not)
+	if (map->cache_referenced != NULL) {
+		map->cache_bytes -= __map_cache_charge(map, current->_key, current->_value);
+	}
+	if (map->ttl != NULL) __map_ttl_unlink(current);
+	if (map->filter.blocks != NULL) {
+		__map_filter_remove(&map->filter, __map_stored_hash(map, current->_key));
+	}
+	__map_index_remove(map, index, current);
+
+	if (map->snapshots != NULL) { // Snapshots may still read them
+		__map_retire(map, current->_key, MAP_RETIRED_KEY);
+		__map_retire(map, current->_value, MAP_RETIRED_VALUE);
+	} else {
+		__map_key_free(map, current->_key);
+		map->usr_free_value(current->_value);
+	}
 
-			if (prev == NULL) { // case 1: Node to be removed is at the head of the list
-				map->buckets[index] = current->_next;
-			}
+	__map_free(map, current, __map_node_size(map));// freeing the node itself
+	map->num_entries--;// Decrement the number of entries in the map
+}
 
-			else {
-				prev->_next = current->_next;
-			}
+// Find key in a chaining map and unlink it, without shrinking.
+static map_error_t chaining_remove(map_t *map, void *key) {
+	// Hashing the key
+	map_probe_t probe = __map_probe(map, key);
+	uint64_t index = probe.hash % map->num_buckets; // Getting the index
+	if (map->filter.blocks != NULL && !__map_filter_test(&map->filter, probe.hash)) {
+		return MAP_ERR_NOT_FOUND;
+	}
 
-			map->usr_free_key(current->_key);
-			map->usr_free_value(current->_value);
+	// Current and previous pointers
 
-			free(current);// freeing the node itself
-			map->num_entries--;// Decrement the number of entries in the map
+	// With snapshots live, copy the chain first so the unlink below only
+	// touches private nodes.
+	if (map->snapshots != NULL) {
+		if (__map_cow_bucket(map, index) != MAP_OK || __map_retire_reserve(map, 2) != MAP_OK) {
+			return MAP_ERR_NO_MEM;
+		}
+	}
 
-			//Resize if necessary
+	map_element_t *current = map->buckets[index];
+	map_element_t *prev = NULL;
 
-			double load_factor = (double)map->num_entries / map->num_buckets;
-			if (load_factor < map->min_load_factor && map->num_buckets > 1) { // Checking if map needs to be resized and has multiple buckets
+	// Long chains: find the node through the index, then its predecessor.
+	if (__map_index_of(map, index) != NULL) {
+		if (__map_index_find(map, index, &probe, &current) != MAP_OK) {
+			return MAP_ERR_NOT_FOUND;
+		}
+		remove_node(map, index, __map_chain_prev(map->buckets[index], current), current);
+		return MAP_OK;
+	}
 
-				__map_resize(map,map->shrink_factor);
-			}
+	// Linked list traversal
 
+	while (current != NULL){
+		if (__map_probe_compare(map, &probe, current->_key) == 0) {
+			remove_node(map, index, prev, current);
 			return MAP_OK; // Deletion Successful!
 		}
 	prev = current;
@@ -191,6 +400,25 @@ map_error_t map_remove(map_t *map, void *key){
 	return MAP_ERR_NOT_FOUND; // Key not found
 }
 
+// Remove Function
+map_error_t map_remove(map_t *map, void *key){
+	if (map == NULL || key == NULL) {
+		return MAP_ERR_INVALID_ARG;
+	}
+	if (map->wal != NULL) {
+		map_error_t logged = __map_wal_append(map, MAP_WAL_REMOVE, key, NULL);
+		if (logged != MAP_OK) return logged;
+	}
+	// An iterator may be parked on the entry going away; only
+	// map_iter_remove() keeps iterators going.
+	map->resize_epoch++;
+	if (map->ops) return map->ops->remove(map, key);
+
+	map_error_t result = chaining_remove(map, key);
+	if (result == MAP_OK) shrink_if_sparse(map); //Resize if necessary
+	return result;
+}
+
 
 // Destroy Function
 map_error_t map_destroy(map_t **map){
@@ -198,28 +426,53 @@ map_error_t map_destroy(map_t **map){
 		return MAP_ERR_INVALID_ARG;
 	}
 
+	if ((*map)->wal != NULL) map_wal_close(*map); // The log outlives the map.
+
+	// Live snapshots still read the nodes; the last release finishes up.
+	if ((*map)->snapshots != NULL) {
+		(*map)->destroy_pending = 1;
+		*map = NULL;
+		return MAP_OK;
+	}
+
+	__map_teardown(*map);
+	*map = NULL; // Avoids dangling pointer
+
+	return MAP_OK;
+
+}
+
+// Teardown Function
+void __map_teardown(map_t *map) {
+	if (map->ops) {
+		map->ops->destroy(map);
+		__map_free(map, map, sizeof(map_t));
+		return;
+	}
+
 	// Loop through the buckets
 
-	for ( int i = 0; i < (*map)->num_buckets; i++) {
-		map_element_t *current = (*map)->buckets[i];
+	for ( size_t i = 0; i < map->num_buckets; i++) {
+		map_element_t *current = map->buckets[i];
 		// Loop through the linked list
 		while (current != NULL) {
 			map_element_t *next = current->_next;
 
-			(*map)->usr_free_key(current->_key);
-			(*map)->usr_free_value(current->_value);
+			__map_key_free(map, current->_key);
+			map->usr_free_value(current->_value);
 
-			free(current);
+			__map_free(map, current, __map_node_size(map));
 			current = next;
 		}
 	}
 
-	free((*map)->buckets); // Free buckets array
-	free(*map);
-	*map = NULL; // Avoids dangling pointer
-
-	return MAP_OK;
-
+	__map_string_arena_free(map); // String keys live here, if any
+	__map_cache_free(map);
+	__map_ttl_free(map);
+	__map_filter_free(map, &map->filter);
+	__map_index_drop_all(map);
+	__map_free(map, map->buckets, map->num_buckets * sizeof(map_element_t *)); // Free buckets array
+	__map_free(map, map, sizeof(map_t));
 }
 
 // Configure Function
@@ -235,20 +488,37 @@ map_error_t map_configure(map_t *map, float max_load_factor, float min_load_fact
 	return MAP_OK;
 }
 
+// Iterators keep no state in the map, so read-only iterations may run at
+// once; the epoch tells them when a writer moved or freed entries.
+static void iter_register(const map_t *map, map_iterator_t *iter) {
+	iter->epoch = map->resize_epoch;
+	iter->last_element = NULL;
+	iter->live = 1;
+}
+
 // Iterator Start Function
 map_error_t map_iter_start(const map_t *map, map_iterator_t *iter) {
 	if (map == NULL || iter == NULL) {
 		return MAP_ERR_INVALID_ARG;
 	}
 
-	iter->current_bucket = -1; //Not zero since first index is 0
+	iter->live = 0;
+	iter->removed = 0;
+	if (map->ops) {
+		map_error_t result = map->ops->iter_start(map, iter);
+		if (result == MAP_OK) iter_register(map, iter);
+		return result;
+	}
+
+	iter->current_bucket = SIZE_MAX; // Wraps to 0, the first index, on the next step.
 	iter->current_element = NULL;
 
-	for (int i = 0; i < map->num_buckets; i++){
+	for (size_t i = 0; i < map->num_buckets; i++){
 		if(map->buckets[i] != NULL) {
 			//Get the first bucket that points to an element
 			iter->current_bucket = i; // Properly set current bucket
 			iter->current_element = map->buckets[i];
+			iter_register(map, iter);
 			return MAP_OK; // First element found
 		}
 	}
@@ -256,16 +526,11 @@ map_error_t map_iter_start(const map_t *map, map_iterator_t *iter) {
 	return MAP_ERR_END_OF_MAP;// Map is empty
 }
 
-
-// Iterator Next Function
-map_error_t map_iter_next(const map_t *map, map_iterator_t *iter, void **out_key, void **out_value) {
-
-    if (map == NULL || iter == NULL || out_key == NULL || out_value == NULL) {
-        return MAP_ERR_INVALID_ARG;
-    }
-
+// Chaining Iterator Next Function
+static map_error_t chaining_iter_next(const map_t *map, map_iterator_t *iter, void **out_key, void **out_value) {
     // If current element exists, use it first
     if (iter->current_element != NULL) {
+        iter->last_element = iter->current_element;
         *out_key = iter->current_element->_key;
         *out_value = iter->current_element->_value;
 
@@ -280,6 +545,7 @@ map_error_t map_iter_next(const map_t *map, map_iterator_t *iter, void **out_key
         iter->current_element = map->buckets[iter->current_bucket];
 
         if (iter->current_element != NULL) {
+            iter->last_element = iter->current_element;
             *out_key = iter->current_element->_key;
             *out_value = iter->current_element->_value;
 
@@ -292,9 +558,97 @@ map_error_t map_iter_next(const map_t *map, map_iterator_t *iter, void **out_key
     return MAP_ERR_END_OF_MAP; // All elements iterated
 }
 
+// Iterator Next Function
+map_error_t map_iter_next(const map_t *map, map_iterator_t *iter, void **out_key, void **out_value) {
+
+    if (map == NULL || iter == NULL || out_key == NULL || out_value == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+    if (!iter->live) return MAP_ERR_END_OF_MAP; // Finished, or never started
+    if (iter->epoch != map->resize_epoch) {
+        map_iter_end(map, iter);
+        return MAP_ERR_STALE_ITERATOR;
+    }
+
+    map_error_t result = map->ops ? map->ops->iter_next(map, iter, out_key, out_value)
+                                  : chaining_iter_next(map, iter, out_key, out_value);
+    if (result == MAP_ERR_END_OF_MAP) map_iter_end(map, iter);
+    return result;
+}
+
+// Iterator Remove Function
+map_error_t map_iter_remove(map_t *map, map_iterator_t *iter) {
+	if (map == NULL || iter == NULL || !iter->live) {
+		return MAP_ERR_INVALID_ARG;
+	}
+	if (iter->epoch != map->resize_epoch) {
+		return MAP_ERR_STALE_ITERATOR;
+	}
+	if (map->ops) {
+		map_error_t result = map->ops->iter_remove(map, iter);
+		if (result == MAP_OK) iter->removed = 1;
+		return result;
+	}
+
+	map_element_t *node = iter->last_element;
+	if (node == NULL) {
+		return MAP_ERR_NOT_FOUND; // Nothing returned yet, or already removed
+	}
+	iter->last_element = NULL;
+
+	// The node is still in the bucket iter_next found it in: anything else
+	// that frees entries bumps the epoch. Finding its predecessor takes
+	// pointer compares only. With snapshots live the bucket may hold a
+	// private copy of the chain instead, found by key below.
+	uint64_t index = (uint64_t)iter->current_bucket;
+	map_element_t *prev = NULL;
+	map_element_t *current = map->buckets[index];
+	if (map->snapshots == NULL) {
+		while (current != NULL && current != node) {
+			prev = current;
+			current = current->_next;
+		}
+		if (current == NULL) {
+			return MAP_ERR_NOT_FOUND;
+		}
+	}
+	if (map->wal != NULL) {
+		map_error_t logged = __map_wal_append(map, MAP_WAL_REMOVE, node->_key, NULL);
+		if (logged != MAP_OK) return logged;
+	}
+
+	if (map->snapshots != NULL) {
+		map_error_t result = chaining_remove(map, node->_key);
+		if (result != MAP_OK) return result;
+	} else {
+		remove_node(map, index, prev, current);
+	}
+	iter->removed = 1; // Shrinking waits until the iteration is over.
+	return MAP_OK;
+}
+
+// Iterator End Function
+map_error_t map_iter_end(const map_t *map, map_iterator_t *iter) {
+	if (map == NULL || iter == NULL) {
+		return MAP_ERR_INVALID_ARG;
+	}
+	if (!iter->live) return MAP_OK;
+
+	iter->live = 0;
+	// Catch up on the shrinking map_iter_remove() put off. Only an
+	// iterator that removed entries writes the map here.
+	if (iter->removed) {
+		map_t *owner = (map_t *)map;
+		iter->removed = 0;
+		if (owner->ops) owner->ops->shrink(owner);
+		else shrink_if_sparse(owner);
+	}
+	return MAP_OK;
+}
+
 
 // Map Size Getting Function
-map_error_t map_get_size (map_t *map, int *num_elements) {
+map_error_t map_get_size (map_t *map, size_t *num_elements) {
 
 	if (map == NULL || num_elements == NULL) {
 		return MAP_ERR_INVALID_ARG;
@@ -306,7 +660,7 @@ map_error_t map_get_size (map_t *map, int *num_elements) {
 }
 
 // Map Buckets Getting Function
-map_error_t map_get_num_buckets (map_t *map, int *num_buckets) {
+map_error_t map_get_num_buckets (map_t *map, size_t *num_buckets) {
 
 	if (map == NULL || num_buckets == NULL) {
 		return MAP_ERR_INVALID_ARG;
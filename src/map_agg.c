@@ -0,0 +1,461 @@
+#define _POSIX_C_SOURCE 200809L
+#include <map.h>
+#include <map_internal.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Group-by with partitioned spilling. Groups live in a chaining map whose
+// values are the states themselves (the map adopts them rather than
+// cloning). Once they are charged more than the budget, all of them are
+// appended to the partition files and the map starts over empty, so a
+// file holds partial states and one group may appear in it many times.
+// Each record is
+//
+//   key length (4) | state length (4) | key | state
+//
+// in native byte order, the files being private. Level L picks a file by
+// bits [64 - (L + 1) * bits, 64 - L * bits) of the key's mixed hash:
+// partition p of the group-by is "dir/p", and when merging it spills again
+// its sub-partition q goes to "dir/p-q", and so on.
+
+#define AGG_DEFAULT_PARTITIONS 32
+#define AGG_DEFAULT_BUDGET ((size_t)64 * 1024 * 1024)
+#define AGG_BUFFER_SIZE (64 * 1024)
+#define AGG_RECORD_HEADER 8
+#define AGG_DIR_TEMPLATE "/libmap-agg-XXXXXX"
+#define AGG_NAME_SIZE 12 // "/" or "-", up to 10 digits and NUL.
+
+// Memory a group takes besides its encoded bytes: the node and, at the
+// map's default load, about two bucket slots.
+#define AGG_GROUP_OVERHEAD (sizeof(map_element_t) + 2 * sizeof(map_element_t *))
+
+typedef map_error_t (*agg_emit_fn_t)(void *ctx, void *key, void *state);
+
+// The groups map stores states as they are; the group-by owns them.
+static void *agg_adopt(void *state) { return state; }
+
+static char *agg_stringify(void *key, void *state) {
+    (void)key;
+    (void)state;
+    return NULL;
+}
+
+static uint64_t agg_hash(const map_agg_t *agg, void *key) {
+    return __map_mix64(agg->usr_hash(key));
+}
+
+// Whether a table at this level has hash bits left to spill by.
+static int agg_can_spill(const map_agg_t *agg, const map_agg_table_t *table) {
+    return (uint64_t)agg->bits * (table->level + 1) <= 64;
+}
+
+static map_error_t agg_groups_create(const map_agg_t *agg, map_t **groups) {
+    return map_create(groups, agg->usr_key_clone, agg_adopt, agg->usr_hash, agg_stringify,
+                      agg->usr_compare, agg->usr_free_key, agg->options.free_state);
+}
+
+// Set up an empty table; path (capacity prefix_length + AGG_NAME_SIZE) is
+// taken over.
+static map_error_t agg_table_init(const map_agg_t *agg, map_agg_table_t *table, uint32_t level,
+                                  size_t budget, char *path, size_t prefix_length) {
+    memset(table, 0, sizeof(*table));
+    table->level = level;
+    table->budget = budget;
+    table->path = path;
+    table->prefix_length = prefix_length;
+    table->buffer = malloc(AGG_BUFFER_SIZE);
+    if (table->buffer == NULL) return MAP_ERR_NO_MEM;
+    table->buffer_capacity = AGG_BUFFER_SIZE;
+    return agg_groups_create(agg, &table->groups);
+}
+
+static void agg_table_free(map_agg_table_t *table) {
+    if (table->groups != NULL) map_destroy(&table->groups);
+    free(table->buffer);
+    free(table->path);
+    table->buffer = NULL;
+    table->path = NULL;
+}
+
+// Write the name of partition file p after the table's prefix.
+static void agg_name(const map_agg_table_t *table, size_t p, char *out) {
+    snprintf(out, AGG_NAME_SIZE, "%c%u", table->level == 0 ? '/' : '-', (unsigned)p);
+}
+
+// Fold value, or a partial state read back from a file, into key's group.
+// A partial state is taken over either way.
+static map_error_t agg_fold(const map_agg_t *agg, map_agg_table_t *table, void *key,
+                            void *value, void *partial) {
+    const map_agg_options_t *options = &agg->options;
+    void *state;
+    if (map_get(table->groups, key, &state) == MAP_OK) {
+        if (partial != NULL) {
+            options->merge(options->ctx, state, partial);
+            options->free_state(partial);
+        } else {
+            options->update(options->ctx, state, value);
+        }
+        return MAP_OK;
+    }
+
+    state = partial;
+    if (state == NULL) {
+        state = options->init(options->ctx, key);
+        if (state == NULL) return MAP_ERR_NO_MEM;
+        options->update(options->ctx, state, value);
+    }
+    // A failed resize still leaves the group in; only a group that didn't
+    // make it in is ours to free.
+    size_t before = table->groups->num_entries;
+    map_error_t result = map_insert(table->groups, key, state);
+    if (table->groups->num_entries == before) {
+        options->free_state(state);
+        return result != MAP_OK ? result : MAP_ERR_UNKNOWN;
+    }
+    table->bytes += options->encode_key(key, NULL, 0) + options->encode_state(state, NULL, 0) +
+                    AGG_GROUP_OVERHEAD;
+    return MAP_OK;
+}
+
+// Append one record to file through the table's buffer, growing it once
+// if the record doesn't fit.
+static map_error_t agg_write(const map_agg_t *agg, map_agg_table_t *table, FILE *file,
+                             void *key, void *state) {
+    const map_agg_options_t *options = &agg->options;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        size_t room = table->buffer_capacity - AGG_RECORD_HEADER;
+        uint8_t *at = table->buffer + AGG_RECORD_HEADER;
+        size_t key_len = options->encode_key(key, at, room);
+        size_t state_len = options->encode_state(state, key_len < room ? at + key_len : NULL,
+                                                 key_len < room ? room - key_len : 0);
+        if (key_len > UINT32_MAX || state_len > UINT32_MAX) return MAP_ERR_INVALID_ARG;
+
+        size_t total = AGG_RECORD_HEADER + key_len + state_len;
+        if (total <= table->buffer_capacity) {
+            uint32_t lengths[2] = {(uint32_t)key_len, (uint32_t)state_len};
+            memcpy(table->buffer, lengths, sizeof(lengths));
+            if (fwrite(table->buffer, 1, total, file) != total) return MAP_ERR_IO;
+            table->stats.bytes_written += total;
+            return MAP_OK;
+        }
+
+        uint8_t *grown = realloc(table->buffer, total);
+        if (grown == NULL) return MAP_ERR_NO_MEM;
+        table->buffer = grown;
+        table->buffer_capacity = total;
+    }
+    return MAP_ERR_UNKNOWN; // The codec sized the same object differently.
+}
+
+// Append every group in memory to its partition file and start over with
+// an empty map.
+static map_error_t agg_spill(const map_agg_t *agg, map_agg_table_t *table) {
+    FILE *files[MAP_AGG_MAX_PARTITIONS];
+    memset(files, 0, sizeof(files));
+    unsigned shift = 64 - agg->bits * (table->level + 1);
+    size_t mask = agg->options.partitions - 1;
+
+    map_error_t result = MAP_OK;
+    map_iterator_t iter;
+    void *key, *state;
+    if (map_iter_start(table->groups, &iter) == MAP_OK) {
+        while (result == MAP_OK && map_iter_next(table->groups, &iter, &key, &state) == MAP_OK) {
+            size_t p = (size_t)(agg_hash(agg, key) >> shift) & mask;
+            if (files[p] == NULL) {
+                agg_name(table, p, table->path + table->prefix_length);
+                files[p] = fopen(table->path, "ab");
+                table->path[table->prefix_length] = '\0';
+                if (files[p] == NULL) {
+                    result = MAP_ERR_IO;
+                    break;
+                }
+                table->written[p] = 1;
+            }
+            result = agg_write(agg, table, files[p], key, state);
+        }
+        map_iter_end(table->groups, &iter);
+    }
+    for (size_t p = 0; p <= mask; p++) {
+        if (files[p] != NULL && fclose(files[p]) != 0 && result == MAP_OK) result = MAP_ERR_IO;
+    }
+    if (result != MAP_OK) return result;
+
+    map_t *empty;
+    result = agg_groups_create(agg, &empty);
+    if (result != MAP_OK) return result;
+    map_destroy(&table->groups);
+    table->groups = empty;
+    table->bytes = 0;
+    table->spilled = 1;
+    table->stats.spills++;
+    return MAP_OK;
+}
+
+// Call emit on every group in memory.
+static map_error_t agg_emit(map_agg_table_t *table, agg_emit_fn_t emit, void *ctx) {
+    map_iterator_t iter;
+    void *key, *state;
+    if (map_iter_start(table->groups, &iter) != MAP_OK) return MAP_OK;
+    while (map_iter_next(table->groups, &iter, &key, &state) == MAP_OK) {
+        map_error_t result = emit(ctx, key, state);
+        if (result != MAP_OK) {
+            map_iter_end(table->groups, &iter);
+            return result;
+        }
+    }
+    return MAP_OK;
+}
+
+// Fold every record of the table's file (its path) into its groups,
+// spilling to the next level whenever they outgrow the budget. The file is
+// deleted afterwards.
+static map_error_t agg_read(const map_agg_t *agg, map_agg_table_t *table) {
+    int fd = open(table->path, O_RDONLY);
+    if (fd < 0) return MAP_ERR_IO;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return MAP_ERR_IO;
+    }
+    size_t size = (size_t)st.st_size;
+    void *mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) return MAP_ERR_IO;
+    posix_madvise(mapped, size, POSIX_MADV_SEQUENTIAL);
+
+    const uint8_t *p = mapped;
+    map_error_t result = MAP_OK;
+    for (size_t offset = 0; offset < size && result == MAP_OK;) {
+        uint32_t lengths[2];
+        if (size - offset < AGG_RECORD_HEADER) {
+            result = MAP_ERR_IO;
+            break;
+        }
+        memcpy(lengths, p + offset, sizeof(lengths));
+        offset += AGG_RECORD_HEADER;
+        if (size - offset < (uint64_t)lengths[0] + lengths[1]) {
+            result = MAP_ERR_IO;
+            break;
+        }
+
+        void *key = agg->options.decode_key(p + offset, lengths[0]);
+        void *state = agg->options.decode_state(p + offset + lengths[0], lengths[1]);
+        offset += (size_t)lengths[0] + lengths[1];
+        if (key == NULL || state == NULL) {
+            if (key != NULL) agg->usr_free_key(key);
+            if (state != NULL) agg->options.free_state(state);
+            result = MAP_ERR_NO_MEM;
+            break;
+        }
+        result = agg_fold(agg, table, key, NULL, state);
+        agg->usr_free_key(key); // The groups map keeps a clone.
+        if (result == MAP_OK && table->bytes > table->budget && agg_can_spill(agg, table)) {
+            result = agg_spill(agg, table);
+        }
+    }
+    munmap(mapped, size);
+    table->stats.bytes_read += size;
+    if (unlink(table->path) != 0 && result == MAP_OK) result = MAP_ERR_IO;
+    return result;
+}
+
+typedef struct {
+    const map_agg_t *agg;
+    agg_emit_fn_t emit;
+    void *ctx;
+    size_t budget;
+    map_agg_stats_t stats[MAP_MAX_THREADS];
+} agg_job_t;
+
+static void agg_count(map_agg_stats_t *total, const map_agg_stats_t *stats) {
+    total->spills += stats->spills;
+    total->bytes_written += stats->bytes_written;
+    total->bytes_read += stats->bytes_read;
+    if (stats->max_level > total->max_level) total->max_level = stats->max_level;
+}
+
+// Finalize partition file p of parent: merge it, then emit its groups, or
+// if they had to be spilled again, finalize each sub-partition in turn.
+static map_error_t agg_merge(agg_job_t *job, int worker, const map_agg_table_t *parent,
+                             size_t p) {
+    const map_agg_t *agg = job->agg;
+    char *path = malloc(parent->prefix_length + 2 * AGG_NAME_SIZE);
+    if (path == NULL) return MAP_ERR_NO_MEM;
+    memcpy(path, parent->path, parent->prefix_length);
+    agg_name(parent, p, path + parent->prefix_length);
+    size_t prefix_length = strlen(path);
+
+    map_agg_table_t table;
+    map_error_t result = agg_table_init(agg, &table, parent->level + 1, job->budget, path,
+                                        prefix_length);
+    if (result == MAP_OK) result = agg_read(agg, &table);
+    table.stats.max_level = table.level;
+
+    if (result == MAP_OK && !table.spilled) {
+        result = agg_emit(&table, job->emit, job->ctx);
+    } else if (result == MAP_OK) {
+        if (table.groups->num_entries > 0) result = agg_spill(agg, &table);
+        map_destroy(&table.groups);
+        for (size_t q = 0; q < agg->options.partitions && result == MAP_OK; q++) {
+            if (table.written[q]) result = agg_merge(job, worker, &table, q);
+        }
+    }
+    agg_count(&job->stats[worker], &table.stats);
+    agg_table_free(&table);
+    return result;
+}
+
+static map_error_t agg_merge_range(void *ctx, int worker, size_t begin, size_t end) {
+    agg_job_t *job = (agg_job_t *)ctx;
+    for (size_t p = begin; p < end; p++) {
+        if (!job->agg->table.written[p]) continue;
+        map_error_t result = agg_merge(job, worker, &job->agg->table, p);
+        if (result != MAP_OK) return result;
+    }
+    return MAP_OK;
+}
+
+// Agg Options Init Function
+void map_agg_options_init(map_agg_options_t *options) {
+    if (options == NULL) return;
+    memset(options, 0, sizeof(*options));
+    options->ram_budget = AGG_DEFAULT_BUDGET;
+    options->partitions = AGG_DEFAULT_PARTITIONS;
+}
+
+// Agg Create Function
+map_error_t map_agg_create(map_agg_t **agg, const map_agg_options_t *options,
+                           void *(*usr_key_clone)(void *key),
+                           uint64_t (*usr_hash)(void *key),
+                           int32_t (*usr_compare)(void *key1, void *key2),
+                           void (*usr_free_key)(void *key)) {
+    if (agg == NULL) return MAP_ERR_INVALID_ARG;
+    *agg = NULL;
+    if (options == NULL || options->dir == NULL || !options->init || !options->update ||
+        !options->merge || !options->free_state || !options->encode_key ||
+        !options->decode_key || !options->encode_state || !options->decode_state ||
+        options->partitions < 2 || options->partitions > MAP_AGG_MAX_PARTITIONS ||
+        (options->partitions & (options->partitions - 1)) != 0 || !usr_key_clone ||
+        !usr_hash || !usr_compare || !usr_free_key) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    map_agg_t *a = calloc(1, sizeof(map_agg_t));
+    if (a == NULL) return MAP_ERR_NO_MEM;
+    a->options = *options;
+    a->options.dir = NULL; // Not kept; the table's path is the private directory.
+    a->usr_key_clone = usr_key_clone;
+    a->usr_hash = usr_hash;
+    a->usr_compare = usr_compare;
+    a->usr_free_key = usr_free_key;
+    while ((1u << a->bits) < options->partitions) a->bits++;
+
+    size_t prefix_length = strlen(options->dir) + strlen(AGG_DIR_TEMPLATE);
+    char *path = malloc(prefix_length + AGG_NAME_SIZE);
+    if (path == NULL) {
+        free(a);
+        return MAP_ERR_NO_MEM;
+    }
+    strcpy(path, options->dir);
+    strcat(path, AGG_DIR_TEMPLATE);
+    if (mkdtemp(path) == NULL) {
+        free(path);
+        free(a);
+        return MAP_ERR_IO;
+    }
+    map_error_t result = agg_table_init(a, &a->table, 0, options->ram_budget, path,
+                                        prefix_length);
+    if (result != MAP_OK) {
+        rmdir(path);
+        agg_table_free(&a->table);
+        free(a);
+        return result;
+    }
+    *agg = a;
+    return MAP_OK;
+}
+
+// Agg Add Function
+map_error_t map_agg_add(map_agg_t *agg, void *key, void *value) {
+    if (agg == NULL || key == NULL || agg->closed) return MAP_ERR_INVALID_ARG;
+    map_error_t result = agg_fold(agg, &agg->table, key, value, NULL);
+    if (result != MAP_OK || agg->table.bytes <= agg->table.budget) return result;
+
+    // Some groups may already be in the files; adding more would count them twice.
+    result = agg_spill(agg, &agg->table);
+    if (result != MAP_OK) agg->closed = 1;
+    return result;
+}
+
+// Agg Finalize Function
+map_error_t map_agg_finalize(map_agg_t *agg, int nthreads,
+                             map_error_t (*emit)(void *ctx, void *key, void *state),
+                             void *ctx) {
+    if (agg == NULL || emit == NULL || nthreads < 1 || agg->closed) {
+        return MAP_ERR_INVALID_ARG;
+    }
+    agg->closed = 1;
+    map_agg_table_t *table = &agg->table;
+    map_error_t result = MAP_OK;
+    if (!table->spilled) {
+        result = agg_emit(table, emit, ctx);
+    } else if (table->groups->num_entries > 0) {
+        result = agg_spill(agg, table);
+    }
+    map_destroy(&table->groups);
+    table->bytes = 0;
+    if (result != MAP_OK || !table->spilled) return result;
+
+    agg_job_t job;
+    memset(&job, 0, sizeof(job));
+    job.agg = agg;
+    job.emit = emit;
+    job.ctx = ctx;
+    int workers = __map_parallel_workers(nthreads, agg->options.partitions, 1);
+    job.budget = agg->options.ram_budget / (size_t)workers;
+    result = __map_parallel_for(workers, agg->options.partitions, agg_merge_range, &job);
+    for (int w = 0; w < workers; w++) agg_count(&table->stats, &job.stats[w]);
+    return result;
+}
+
+// Agg Stats Function
+map_error_t map_agg_stats(const map_agg_t *agg, map_agg_stats_t *stats) {
+    if (agg == NULL || stats == NULL) return MAP_ERR_INVALID_ARG;
+    *stats = agg->table.stats;
+    stats->groups = agg->table.groups != NULL ? agg->table.groups->num_entries : 0;
+    stats->bytes = agg->table.bytes;
+    return MAP_OK;
+}
+
+// Agg Destroy Function. Whatever files an error left behind go with the
+// directory.
+map_error_t map_agg_destroy(map_agg_t **agg) {
+    if (agg == NULL || *agg == NULL) return MAP_ERR_INVALID_ARG;
+    map_agg_table_t *table = &(*agg)->table;
+    table->path[table->prefix_length] = '\0';
+    DIR *dir = opendir(table->path);
+    if (dir != NULL) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] == '.') continue;
+            char *file = malloc(table->prefix_length + strlen(entry->d_name) + 2);
+            if (file == NULL) continue;
+            sprintf(file, "%s/%s", table->path, entry->d_name);
+            unlink(file);
+            free(file);
+        }
+        closedir(dir);
+    }
+    rmdir(table->path);
+
+    agg_table_free(table);
+    free(*agg);
+    *agg = NULL;
+    return MAP_OK;
+}
@@ -0,0 +1,162 @@
+#include <map.h>
+#include <map_internal.h>
+#include <string.h>
+
+// Allocators. The default one is libc; the bump arena serves maps that are
+// built, used and then thrown away as a whole.
+
+#define ARENA_DEFAULT_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGN 16
+
+static void *libc_alloc(void *ctx, size_t size) {
+    (void)ctx;
+    return malloc(size);
+}
+
+static void *libc_realloc(void *ctx, void *ptr, size_t old_size, size_t new_size) {
+    (void)ctx;
+    (void)old_size;
+    return realloc(ptr, new_size);
+}
+
+static void libc_free(void *ctx, void *ptr, size_t size) {
+    (void)ctx;
+    (void)size;
+    free(ptr);
+}
+
+const map_allocator_t __map_default_allocator = {
+    libc_alloc, libc_realloc, libc_free, NULL
+};
+
+// Offset of the next ARENA_ALIGN-aligned address at or after chunk->used.
+static size_t arena_aligned_offset(const map_arena_chunk_t *chunk) {
+    uintptr_t at = (uintptr_t)(chunk->data + chunk->used);
+    uintptr_t aligned = (at + (ARENA_ALIGN - 1)) & ~(uintptr_t)(ARENA_ALIGN - 1);
+    return chunk->used + (size_t)(aligned - at);
+}
+
+static void *arena_alloc(void *ctx, size_t size) {
+    return map_arena_alloc((map_arena_t *)ctx, size);
+}
+
+static void *arena_realloc(void *ctx, void *ptr, size_t old_size, size_t new_size) {
+    map_arena_t *arena = (map_arena_t *)ctx;
+    if (ptr == NULL) return map_arena_alloc(arena, new_size);
+    if (new_size <= old_size && ptr != arena->last) return ptr;
+
+    // The most recent allocation can grow or shrink where it is.
+    map_arena_chunk_t *chunk = arena->chunks;
+    if (ptr == arena->last) {
+        size_t offset = (size_t)((char *)ptr - chunk->data);
+        if (new_size <= chunk->capacity - offset) {
+            chunk->used = offset + new_size;
+            return ptr;
+        }
+    }
+
+    void *moved = map_arena_alloc(arena, new_size);
+    if (moved != NULL) memcpy(moved, ptr, old_size < new_size ? old_size : new_size);
+    return moved;
+}
+
+static void arena_free(void *ctx, void *ptr, size_t size) {
+    map_arena_t *arena = (map_arena_t *)ctx;
+    (void)size;
+
+    // Memory is only reclaimed in bulk, but undoing the latest allocation
+    // is free and keeps insert-then-fail paths from leaving holes.
+    if (ptr == arena->last) {
+        arena->chunks->used = (size_t)((char *)ptr - arena->chunks->data);
+        arena->last = NULL;
+    }
+}
+
+// Arena Create Function
+map_error_t map_arena_create(map_arena_t **arena, size_t chunk_size) {
+    if (arena == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    *arena = malloc(sizeof(map_arena_t));
+    if (*arena == NULL) {
+        return MAP_ERR_NO_MEM;
+    }
+    (*arena)->chunks = NULL;
+    (*arena)->chunk_size = chunk_size != 0 ? chunk_size : ARENA_DEFAULT_CHUNK_SIZE;
+    (*arena)->last = NULL;
+    return MAP_OK;
+}
+
+// Arena Allocation Function
+void *map_arena_alloc(map_arena_t *arena, size_t size) {
+    if (arena == NULL) return NULL;
+
+    map_arena_chunk_t *chunk = arena->chunks;
+    size_t offset = chunk != NULL ? arena_aligned_offset(chunk) : 0;
+    if (chunk == NULL || offset > chunk->capacity || chunk->capacity - offset < size) {
+        // Oversized requests get a chunk of their own.
+        size_t capacity = size + ARENA_ALIGN > arena->chunk_size ? size + ARENA_ALIGN
+                                                                 : arena->chunk_size;
+        if (capacity < size) return NULL;
+        chunk = malloc(sizeof(map_arena_chunk_t) + capacity);
+        if (chunk == NULL) return NULL;
+        chunk->used = 0;
+        chunk->capacity = capacity;
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        offset = arena_aligned_offset(chunk);
+    }
+
+    arena->last = chunk->data + offset;
+    chunk->used = offset + size;
+    return arena->last;
+}
+
+// Arena Allocator Function
+map_error_t map_arena_allocator(map_arena_t *arena, map_allocator_t *out) {
+    if (arena == NULL || out == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    out->alloc = arena_alloc;
+    out->realloc = arena_realloc;
+    out->free = arena_free;
+    out->ctx = arena;
+    return MAP_OK;
+}
+
+// Arena Reset Function
+map_error_t map_arena_reset(map_arena_t *arena) {
+    if (arena == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    // Keep the newest chunk around for the next round of allocations.
+    map_arena_chunk_t *chunk = arena->chunks;
+    if (chunk != NULL) {
+        map_arena_chunk_t *rest = chunk->next;
+        while (rest != NULL) {
+            map_arena_chunk_t *next = rest->next;
+            free(rest);
+            rest = next;
+        }
+        chunk->next = NULL;
+        chunk->used = 0;
+    }
+    arena->last = NULL;
+    return MAP_OK;
+}
+
+// Arena Destroy Function
+map_error_t map_arena_destroy(map_arena_t **arena) {
+    if (arena == NULL || *arena == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    map_arena_reset(*arena);
+    free((*arena)->chunks);
+    free(*arena);
+    *arena = NULL;
+    return MAP_OK;
+}
@@ -0,0 +1,141 @@
+#include <map.h>
+#include <map_internal.h>
+#include <string.h>
+
+// Bounded maps for cache use. Recency is tracked with one reference bit per
+// bucket plus chain order: a hit sets its bucket's bit and moves the node to
+// the chain head, so every chain runs from most to least recently used. To
+// make room, the CLOCK hand sweeps the buckets, clearing set bits, and
+// evicts the tail of the first non-empty bucket whose bit was already clear.
+// Nothing is allocated per access, and each set bit costs the hand one step,
+// so eviction is O(1) amortized.
+
+// Set up cache mode on a chaining map whose buckets already exist.
+map_error_t __map_cache_init(map_t *map, const map_options_t *options) {
+    map->cache_referenced = __map_calloc(map, __map_bitmap_words((uint64_t)map->num_buckets),
+                                         sizeof(uint64_t));
+    if (map->cache_referenced == NULL) {
+        return MAP_ERR_NO_MEM;
+    }
+
+    map->cache_max_entries = options->max_entries;
+    map->cache_max_bytes = options->max_bytes;
+    map->usr_entry_size = options->entry_size;
+    map->usr_evict = options->on_evict;
+    map->evict_ctx = options->evict_ctx;
+    return MAP_OK;
+}
+
+void __map_cache_free(map_t *map) {
+    __map_free(map, map->cache_referenced,
+               __map_bitmap_words((uint64_t)map->num_buckets) * sizeof(uint64_t));
+    map->cache_referenced = NULL;
+}
+
+// Bytes an entry counts against max_bytes: entry_size() if given, else the
+// node plus, for string keys, the key's arena record.
+size_t __map_cache_charge(const map_t *map, void *stored_key, void *value) {
+    if (map->usr_entry_size != NULL) return map->usr_entry_size(stored_key, value);
+
+    size_t charge = sizeof(map_element_t);
+    if (map->key_mode == MAP_KEY_STRING) charge += __map_key_header(stored_key)->record_size;
+    return charge;
+}
+
+// Record a hit on node, found in bucket index after prev (NULL at the head).
+void __map_cache_hit(const map_t *map, size_t index, map_element_t *prev,
+                     map_element_t *node) {
+    // Lookups on a cache update recency, so map_get() writes here.
+    map_t *cache = (map_t *)map;
+    cache->cache_hits++;
+    __map_cache_mark(map, index);
+
+    // Snapshots share the chains; leave their order alone.
+    if (prev != NULL && map->snapshots == NULL) {
+        prev->_next = node->_next;
+        node->_next = cache->buckets[index];
+        cache->buckets[index] = node;
+    }
+}
+
+static int cache_over_limit(const map_t *map) {
+    return (map->cache_max_entries != 0 &&
+            map->num_entries > map->cache_max_entries) ||
+           (map->cache_max_bytes != 0 && map->cache_bytes > map->cache_max_bytes);
+}
+
+// Advance the hand to the next victim bucket. The map is not empty, so two
+// sweeps at most: the first one clears every bit it passes.
+static size_t cache_next_victim(map_t *map) {
+    for (;;) {
+        size_t index = (size_t)map->cache_hand;
+        map->cache_hand = (map->cache_hand + 1) % map->num_buckets;
+        if (map->buckets[index] == NULL) continue;
+
+        uint64_t bit = (uint64_t)1 << (index % 64);
+        if (map->cache_referenced[index / 64] & bit) {
+            map->cache_referenced[index / 64] &= ~bit;
+            continue;
+        }
+        return index;
+    }
+}
+
+static map_error_t cache_evict_one(map_t *map) {
+    size_t index = cache_next_victim(map);
+
+    if (map->snapshots != NULL) {
+        if (__map_cow_bucket(map, index) != MAP_OK || __map_retire_reserve(map, 2) != MAP_OK) {
+            return MAP_ERR_NO_MEM;
+        }
+    }
+
+    map_element_t **link = &map->buckets[index];
+    while ((*link)->_next != NULL) link = &(*link)->_next;
+    map_element_t *victim = *link;
+    *link = NULL;
+
+    map->num_entries--;
+    map->resize_epoch++; // An iterator may be parked on the victim.
+    map->cache_bytes -= __map_cache_charge(map, victim->_key, victim->_value);
+    map->cache_evictions++;
+    if (map->usr_evict != NULL) map->usr_evict(map->evict_ctx, victim->_key, victim->_value);
+    if (map->ttl != NULL) __map_ttl_unlink(victim);
+    if (map->filter.blocks != NULL) {
+        __map_filter_remove(&map->filter, __map_stored_hash(map, victim->_key));
+    }
+    __map_index_remove(map, index, victim);
+
+    if (map->snapshots != NULL) {
+        __map_retire(map, victim->_key, MAP_RETIRED_KEY);
+        __map_retire(map, victim->_value, MAP_RETIRED_VALUE);
+    } else {
+        __map_key_free(map, victim->_key);
+        map->usr_free_value(victim->_value);
+    }
+    __map_free(map, victim, __map_node_size(map));
+    return MAP_OK;
+}
+
+// Evict until the map is within its limits again. The last entry is always
+// kept, even if it alone is over max_bytes.
+map_error_t __map_cache_evict(map_t *map) {
+    while (cache_over_limit(map) && map->num_entries > 1) {
+        map_error_t result = cache_evict_one(map);
+        if (result != MAP_OK) return result;
+    }
+    return MAP_OK;
+}
+
+// Cache Stats Function
+map_error_t map_cache_stats(const map_t *map, map_cache_stats_t *stats) {
+    if (map == NULL || stats == NULL || map->cache_referenced == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    stats->hits = map->cache_hits;
+    stats->misses = map->cache_misses;
+    stats->evictions = map->cache_evictions;
+    stats->bytes = map->cache_bytes;
+    return MAP_OK;
+}
@@ -0,0 +1,193 @@
+#include <map.h>
+#include <map_internal.h>
+#include <string.h>
+
+// Deep copy. The clone starts at the source's bucket count and every chain
+// is copied in place, so nothing is rehashed and no resize happens. Bucket
+// ranges can be cloned on several threads.
+
+typedef struct {
+    const map_t *src;
+    map_t *dst;
+    // String keys: one private chunk list per worker, spliced afterwards.
+    map_key_chunk_t *chunks[MAP_MAX_THREADS];
+    size_t key_bytes[MAP_MAX_THREADS];
+} clone_job_t;
+
+// Clone chains [begin, end), keeping their order. Only complete nodes are
+// linked in, so a failed clone can be torn down like any other map.
+static map_error_t clone_chains(void *ctx, int worker, size_t begin, size_t end) {
+    clone_job_t *job = (clone_job_t *)ctx;
+    const map_t *src = job->src;
+    map_t *dst = job->dst;
+
+    for (size_t i = begin; i < end; i++) {
+        map_element_t **tail = &dst->buckets[i];
+        for (map_element_t *cur = src->buckets[i]; cur != NULL; cur = cur->_next) {
+            map_element_t *node = __map_alloc(dst, __map_node_size(dst));
+            if (node == NULL) return MAP_ERR_NO_MEM;
+            if (dst->ttl != NULL) memset(node, 0, __map_node_size(dst));
+
+            if (src->key_mode == MAP_KEY_STRING) {
+                node->_key = __map_string_copy(dst, &job->chunks[worker], cur->_key);
+                if (node->_key != NULL) {
+                    job->key_bytes[worker] += __map_key_header(node->_key)->record_size;
+                }
+            } else {
+                node->_key = src->usr_key_clone(cur->_key);
+            }
+            if (node->_key == NULL) {
+                __map_free(dst, node, __map_node_size(dst));
+                return MAP_ERR_NO_MEM;
+            }
+
+            node->_value = src->usr_value_clone(cur->_value);
+            if (node->_value == NULL) {
+                // String keys stay in the worker's chunks until teardown.
+                if (src->key_mode != MAP_KEY_STRING) src->usr_free_key(node->_key);
+                __map_free(dst, node, __map_node_size(dst));
+                return MAP_ERR_NO_MEM;
+            }
+
+            // Expiring maps clone on one thread, so the wheel needs no lock.
+            if (dst->ttl != NULL) __map_ttl_set(dst, node, ((map_ttl_element_t *)cur)->expires);
+
+            node->_next = NULL;
+            *tail = node;
+            tail = &node->_next;
+        }
+    }
+    return MAP_OK;
+}
+
+static map_error_t clone_chaining(const map_t *src, map_t *dst, int nthreads) {
+    dst->buckets = __map_calloc(dst, src->num_buckets, sizeof(map_element_t *));
+    if (dst->buckets == NULL) {
+        return MAP_ERR_NO_MEM;
+    }
+    if (src->cache_referenced != NULL) {
+        dst->cache_referenced = __map_calloc(dst, __map_bitmap_words((uint64_t)src->num_buckets),
+                                             sizeof(uint64_t));
+        if (dst->cache_referenced == NULL) {
+            __map_free(dst, dst->buckets, src->num_buckets * sizeof(map_element_t *));
+            dst->buckets = NULL;
+            return MAP_ERR_NO_MEM;
+        }
+    }
+    if (src->filter.blocks != NULL && __map_filter_clone(dst, &src->filter) != MAP_OK) {
+        __map_cache_free(dst);
+        __map_free(dst, dst->buckets, src->num_buckets * sizeof(map_element_t *));
+        dst->buckets = NULL;
+        return MAP_ERR_NO_MEM;
+    }
+
+    clone_job_t job;
+    memset(&job, 0, sizeof(job));
+    job.src = src;
+    job.dst = dst;
+    int workers = __map_parallel_workers(nthreads, src->num_buckets,
+                                         MAP_PARALLEL_MIN_ITEMS);
+    map_error_t result = __map_parallel_for(workers, src->num_buckets,
+                                            clone_chains, &job);
+
+    for (int w = 0; w < workers; w++) {
+        map_key_chunk_t *chunk = job.chunks[w];
+        while (chunk != NULL) {
+            map_key_chunk_t *next = chunk->next;
+            chunk->next = dst->key_chunks;
+            dst->key_chunks = chunk;
+            chunk = next;
+        }
+        dst->key_live_bytes += job.key_bytes[w];
+    }
+
+    if (result != MAP_OK) {
+        // Partial keys were never linked; account them so teardown balances.
+        size_t linked = 0;
+        for (size_t i = 0; i < dst->num_buckets; i++) {
+            for (map_element_t *cur = dst->buckets[i]; cur != NULL; cur = cur->_next) {
+                if (dst->key_mode == MAP_KEY_STRING) {
+                    linked += __map_key_header(cur->_key)->record_size;
+                }
+            }
+        }
+        dst->key_dead_bytes = dst->key_live_bytes - linked;
+        dst->key_live_bytes = linked;
+    } else if (src->chain_index != NULL) {
+        __map_index_refresh(dst); // Same chains, new nodes.
+    }
+    return result;
+}
+
+// Clone Function
+map_error_t map_clone(const map_t *src, map_t **dst, int nthreads) {
+    if (src == NULL || dst == NULL || nthreads < 1 || src->destroy_pending) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    map_t *copy = src->allocator.alloc(src->allocator.ctx, sizeof(map_t));
+    if (copy == NULL) {
+        return MAP_ERR_NO_MEM;
+    }
+    memset(copy, 0, sizeof(map_t));
+
+    // Same settings, callbacks, allocator and engine; no snapshots.
+    copy->num_buckets = src->num_buckets;
+    copy->max_load_factor = src->max_load_factor;
+    copy->min_load_factor = src->min_load_factor;
+    copy->grow_factor = src->grow_factor;
+    copy->shrink_factor = src->shrink_factor;
+    copy->usr_key_clone = src->usr_key_clone;
+    copy->usr_value_clone = src->usr_value_clone;
+    copy->usr_hash = src->usr_hash;
+    copy->usr_stringify = src->usr_stringify;
+    copy->usr_compare = src->usr_compare;
+    copy->usr_free_key = src->usr_free_key;
+    copy->usr_free_value = src->usr_free_value;
+    copy->allocator = src->allocator;
+    copy->engine = src->engine;
+    copy->ops = src->ops;
+    copy->key_mode = src->key_mode;
+    copy->cuckoo_rng = src->cuckoo_rng;
+    copy->cache_max_entries = src->cache_max_entries;
+    copy->cache_max_bytes = src->cache_max_bytes;
+    copy->cache_bytes = src->cache_bytes;
+    copy->usr_entry_size = src->usr_entry_size;
+    copy->usr_evict = src->usr_evict;
+    copy->evict_ctx = src->evict_ctx;
+
+    // Custom allocators are not expected to be thread-safe.
+    if (!__map_thread_safe_alloc(src)) nthreads = 1;
+
+    if (src->ttl != NULL) {
+        nthreads = 1;
+        if (__map_ttl_init(copy, src->ttl->clock, src->ttl->clock_ctx, src->ttl->now) != MAP_OK) {
+            __map_free(copy, copy, sizeof(map_t));
+            return MAP_ERR_NO_MEM;
+        }
+    }
+
+    map_error_t result;
+    if (copy->ops) {
+        result = copy->ops->clone(src, copy, nthreads);
+        if (result != MAP_OK) {
+            __map_free(copy, copy, sizeof(map_t));
+            return result;
+        }
+    } else {
+        result = clone_chaining(src, copy, nthreads);
+        if (result != MAP_OK) {
+            if (copy->buckets == NULL) {
+                __map_ttl_free(copy);
+                __map_free(copy, copy, sizeof(map_t));
+            } else {
+                __map_teardown(copy);
+            }
+            return result;
+        }
+    }
+
+    copy->num_entries = src->num_entries;
+    *dst = copy;
+    return MAP_OK;
+}
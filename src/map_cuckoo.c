@@ -0,0 +1,571 @@
+#include <map.h>
+#include <map_internal.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Bucketized cuckoo engine. Every key lives in one of two candidate
+// buckets of MAP_CUCKOO_SLOTS slots, so a lookup reads at most two tag
+// words no matter how the hash clusters. The alternate bucket is derived
+// from the current bucket and the 8-bit tag alone (partial-key cuckoo
+// hashing), which lets entries be displaced without calling usr_hash.
+// Keys that cluster beyond what their two buckets hold go to a stash,
+// scanned by lookups only while it is non-empty, so no key is rejected.
+// The stash keeps each key's hash and is held to one entry per bucket
+// (CUCKOO_STASH_MIN at least); past that the table doubles instead, which
+// spreads clusters of distinct hashes. Keys with equal hashes share their
+// two buckets at any size, so only those stay stashed for long.
+
+#define CUCKOO_INITIAL_BUCKETS 2
+#define CUCKOO_MAX_KICKS 500
+#define CUCKOO_STASH_INITIAL 4
+#define CUCKOO_STASH_MIN 16
+#define CUCKOO_TAG_MUL 0xc6a4a7935bd1e995ULL
+
+// Hash, primary bucket and tag of a key.
+typedef struct {
+    uint64_t hash;
+    uint8_t tag;
+    uint32_t index;
+} cuckoo_pos_t;
+
+static cuckoo_pos_t cuckoo_locate(const map_t *map, void *key) {
+    cuckoo_pos_t pos;
+    // Post-mix so weak user hashes (e.g. key % prime) still spread out.
+    pos.hash = __map_mix64(map->usr_hash(key));
+    pos.tag = (uint8_t)(pos.hash >> 56);
+    if (pos.tag == 0) pos.tag = 1;
+    pos.index = (uint32_t)(pos.hash & (uint64_t)(map->num_buckets - 1));
+    return pos;
+}
+
+static uint32_t cuckoo_alt_index(uint32_t index, uint8_t tag, uint32_t num_buckets) {
+    return (uint32_t)((index ^ (tag * CUCKOO_TAG_MUL)) & (num_buckets - 1));
+}
+
+// Bitmask of slots in the bucket whose tag equals `tag`.
+static unsigned cuckoo_match(const map_cuckoo_bucket_t *bucket, uint8_t tag) {
+#if defined(__SSE2__)
+    __m128i tags = _mm_loadl_epi64((const __m128i *)bucket->tags);
+    __m128i eq = _mm_cmpeq_epi8(tags, _mm_set1_epi8((char)tag));
+    return (unsigned)_mm_movemask_epi8(eq) & ((1u << MAP_CUCKOO_SLOTS) - 1);
+#else
+    unsigned mask = 0;
+    for (int i = 0; i < MAP_CUCKOO_SLOTS; i++) {
+        if (bucket->tags[i] == tag) mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+static uint64_t cuckoo_next_random(map_t *map) {
+    map->cuckoo_rng ^= map->cuckoo_rng << 13;
+    map->cuckoo_rng ^= map->cuckoo_rng >> 7;
+    map->cuckoo_rng ^= map->cuckoo_rng << 17;
+    return map->cuckoo_rng;
+}
+
+// Find the bucket and slot holding `key`. Returns 0 if it is absent.
+static int cuckoo_find(const map_t *map, void *key, cuckoo_pos_t pos,
+                       map_cuckoo_bucket_t **out_bucket, int *out_slot) {
+    uint32_t indexes[2] = {pos.index,
+                           cuckoo_alt_index(pos.index, pos.tag, (uint32_t)map->num_buckets)};
+
+    for (int b = 0; b < 2; b++) {
+        map_cuckoo_bucket_t *bucket = &map->cuckoo_buckets[indexes[b]];
+        unsigned mask = cuckoo_match(bucket, pos.tag);
+        while (mask) {
+            int slot = __builtin_ctz(mask);
+            if (map->usr_compare(bucket->slots[slot]._key, key) == 0) {
+                *out_bucket = bucket;
+                *out_slot = slot;
+                return 1;
+            }
+            mask &= mask - 1;
+        }
+        if (indexes[1] == indexes[0]) break;
+    }
+    return 0;
+}
+
+// Find `key`, whose hash is `hash`, in the stash. Returns its position, or
+// stash_size if absent.
+static size_t cuckoo_stash_find(const map_t *map, void *key, uint64_t hash) {
+    for (size_t i = 0; i < map->cuckoo_stash_size; i++) {
+        const map_cuckoo_stashed_t *stashed = &map->cuckoo_stash[i];
+        if (stashed->hash == hash && map->usr_compare(stashed->_key, key) == 0) return i;
+    }
+    return map->cuckoo_stash_size;
+}
+
+// Append an entry to a stash. Returns 0 if it can't grow.
+static int cuckoo_stash_push(const map_t *map, map_cuckoo_stashed_t **stash, size_t *size,
+                             size_t *capacity, uint64_t hash, void *key, void *value) {
+    if (*size == *capacity) {
+        size_t new_capacity = *capacity > 0 ? *capacity * 2 : CUCKOO_STASH_INITIAL;
+        map_cuckoo_stashed_t *grown = __map_realloc(map, *stash,
+                                                    *capacity * sizeof(map_cuckoo_stashed_t),
+                                                    new_capacity * sizeof(map_cuckoo_stashed_t));
+        if (grown == NULL) return 0;
+        *stash = grown;
+        *capacity = new_capacity;
+    }
+    (*stash)[*size].hash = hash;
+    (*stash)[*size]._key = key;
+    (*stash)[*size]._value = value;
+    (*size)++;
+    return 1;
+}
+
+static int cuckoo_place_free(map_cuckoo_bucket_t *bucket, uint8_t tag,
+                             void *key, void *value) {
+    unsigned free_mask = cuckoo_match(bucket, 0);
+    if (free_mask == 0) return 0;
+
+    int slot = __builtin_ctz(free_mask);
+    bucket->tags[slot] = tag;
+    bucket->slots[slot]._key = key;
+    bucket->slots[slot]._value = value;
+    return 1;
+}
+
+// Place an entry that is known to be absent, displacing residents along a
+// random walk if both candidate buckets are full. On failure every move is
+// undone and 0 is returned.
+static int cuckoo_place(map_t *map, map_cuckoo_bucket_t *buckets, uint32_t num_buckets,
+                        uint32_t index, uint8_t tag, void *key, void *value) {
+    uint32_t alt = cuckoo_alt_index(index, tag, num_buckets);
+    if (cuckoo_place_free(&buckets[index], tag, key, value)) return 1;
+    if (cuckoo_place_free(&buckets[alt], tag, key, value)) return 1;
+
+    uint32_t path_bucket[CUCKOO_MAX_KICKS];
+    uint8_t path_slot[CUCKOO_MAX_KICKS];
+    uint32_t b = (cuckoo_next_random(map) & 1) ? index : alt;
+
+    for (int kick = 0; kick < CUCKOO_MAX_KICKS; kick++) {
+        int slot = (int)(cuckoo_next_random(map) % MAP_CUCKOO_SLOTS);
+        map_cuckoo_bucket_t *bucket = &buckets[b];
+
+        // Swap the homeless entry with a resident.
+        uint8_t t = bucket->tags[slot];
+        map_cuckoo_slot_t victim = bucket->slots[slot];
+        bucket->tags[slot] = tag;
+        bucket->slots[slot]._key = key;
+        bucket->slots[slot]._value = value;
+        tag = t;
+        key = victim._key;
+        value = victim._value;
+        path_bucket[kick] = b;
+        path_slot[kick] = (uint8_t)slot;
+
+        b = cuckoo_alt_index(b, tag, num_buckets);
+        if (cuckoo_place_free(&buckets[b], tag, key, value)) return 1;
+    }
+
+    // Walk back, restoring every displaced entry.
+    for (int kick = CUCKOO_MAX_KICKS - 1; kick >= 0; kick--) {
+        map_cuckoo_bucket_t *bucket = &buckets[path_bucket[kick]];
+        int slot = path_slot[kick];
+        uint8_t t = bucket->tags[slot];
+        map_cuckoo_slot_t resident = bucket->slots[slot];
+        bucket->tags[slot] = tag;
+        bucket->slots[slot]._key = key;
+        bucket->slots[slot]._value = value;
+        tag = t;
+        key = resident._key;
+        value = resident._value;
+    }
+    return 0;
+}
+
+typedef struct {
+    map_cuckoo_bucket_t *buckets;
+    uint32_t num_buckets;
+    map_cuckoo_stashed_t *stash;
+    size_t stash_size;
+    size_t stash_capacity;
+} cuckoo_table_t;
+
+// Place an entry in a table being rebuilt, stashing it if no walk can.
+static int cuckoo_rebuild_place(map_t *map, cuckoo_table_t *table, void *key, void *value) {
+    cuckoo_pos_t pos = cuckoo_locate(map, key);
+    return cuckoo_place(map, table->buckets, table->num_buckets, pos.index, pos.tag, key,
+                        value) ||
+           cuckoo_stash_push(map, &table->stash, &table->stash_size, &table->stash_capacity,
+                             pos.hash, key, value);
+}
+
+// Move every entry (plus an optional extra one) into a table of
+// new_num_buckets buckets, stashed ones included. The old table is kept
+// if memory runs out.
+static map_error_t cuckoo_rebuild(map_t *map, uint32_t new_num_buckets,
+                                  void *extra_key, void *extra_value) {
+    cuckoo_table_t table = {NULL, new_num_buckets, NULL, 0, 0};
+    table.buckets = __map_calloc(map, new_num_buckets, sizeof(map_cuckoo_bucket_t));
+    if (table.buckets == NULL) return MAP_ERR_NO_MEM;
+
+    size_t old_num_buckets = map->num_buckets;
+    map->num_buckets = new_num_buckets; // cuckoo_locate() masks with it.
+
+    int placed = 1;
+    for (size_t i = 0; i < old_num_buckets && placed; i++) {
+        map_cuckoo_bucket_t *bucket = &map->cuckoo_buckets[i];
+        for (int s = 0; s < MAP_CUCKOO_SLOTS && placed; s++) {
+            if (bucket->tags[s] == 0) continue;
+            placed = cuckoo_rebuild_place(map, &table, bucket->slots[s]._key,
+                                          bucket->slots[s]._value);
+        }
+    }
+    for (size_t i = 0; i < map->cuckoo_stash_size && placed; i++) {
+        placed = cuckoo_rebuild_place(map, &table, map->cuckoo_stash[i]._key,
+                                      map->cuckoo_stash[i]._value);
+    }
+    if (placed && extra_key != NULL) {
+        placed = cuckoo_rebuild_place(map, &table, extra_key, extra_value);
+    }
+
+    if (!placed) {
+        map->num_buckets = old_num_buckets;
+        __map_free(map, table.buckets, new_num_buckets * sizeof(map_cuckoo_bucket_t));
+        __map_free(map, table.stash, table.stash_capacity * sizeof(map_cuckoo_stashed_t));
+        return MAP_ERR_NO_MEM;
+    }
+
+    __map_free(map, map->cuckoo_buckets,
+               old_num_buckets * sizeof(map_cuckoo_bucket_t));
+    __map_free(map, map->cuckoo_stash, map->cuckoo_stash_capacity * sizeof(map_cuckoo_stashed_t));
+    map->cuckoo_buckets = table.buckets;
+    map->cuckoo_stash = table.stash;
+    map->cuckoo_stash_size = table.stash_size;
+    map->cuckoo_stash_capacity = table.stash_capacity;
+    map->resize_epoch++;
+    return MAP_OK;
+}
+
+// Init Function
+static map_error_t cuckoo_init(map_t *map) {
+    map->num_buckets = CUCKOO_INITIAL_BUCKETS;
+    map->cuckoo_rng = 0x9e3779b97f4a7c15ULL;
+    map->cuckoo_buckets = __map_calloc(map, CUCKOO_INITIAL_BUCKETS,
+                                       sizeof(map_cuckoo_bucket_t));
+    if (map->cuckoo_buckets == NULL) return MAP_ERR_NO_MEM;
+    return MAP_OK;
+}
+
+// Destroy Function
+static void cuckoo_destroy(map_t *map) {
+    for (size_t i = 0; i < map->num_buckets; i++) {
+        for (int s = 0; s < MAP_CUCKOO_SLOTS; s++) {
+            if (map->cuckoo_buckets[i].tags[s] == 0) continue;
+            map->usr_free_key(map->cuckoo_buckets[i].slots[s]._key);
+            map->usr_free_value(map->cuckoo_buckets[i].slots[s]._value);
+        }
+    }
+    for (size_t i = 0; i < map->cuckoo_stash_size; i++) {
+        map->usr_free_key(map->cuckoo_stash[i]._key);
+        map->usr_free_value(map->cuckoo_stash[i]._value);
+    }
+    __map_free(map, map->cuckoo_buckets,
+               map->num_buckets * sizeof(map_cuckoo_bucket_t));
+    __map_free(map, map->cuckoo_stash, map->cuckoo_stash_capacity * sizeof(map_cuckoo_stashed_t));
+    map->cuckoo_buckets = NULL;
+    map->cuckoo_stash = NULL;
+    map->cuckoo_stash_size = 0;
+    map->cuckoo_stash_capacity = 0;
+}
+
+typedef struct {
+    const map_t *src;
+    map_t *dst;
+} cuckoo_clone_job_t;
+
+// Clone buckets [begin, end). A slot's tag is only set once both its key
+// and value exist, so cuckoo_destroy() can clean up after a failure.
+static map_error_t cuckoo_clone_range(void *ctx, int worker, size_t begin, size_t end) {
+    cuckoo_clone_job_t *job = (cuckoo_clone_job_t *)ctx;
+    (void)worker;
+
+    for (size_t i = begin; i < end; i++) {
+        const map_cuckoo_bucket_t *from = &job->src->cuckoo_buckets[i];
+        map_cuckoo_bucket_t *to = &job->dst->cuckoo_buckets[i];
+        for (int s = 0; s < MAP_CUCKOO_SLOTS; s++) {
+            if (from->tags[s] == 0) continue;
+
+            void *key = job->src->usr_key_clone(from->slots[s]._key);
+            if (key == NULL) return MAP_ERR_NO_MEM;
+            void *value = job->src->usr_value_clone(from->slots[s]._value);
+            if (value == NULL) {
+                job->src->usr_free_key(key);
+                return MAP_ERR_NO_MEM;
+            }
+            to->slots[s]._key = key;
+            to->slots[s]._value = value;
+            to->tags[s] = from->tags[s];
+        }
+    }
+    return MAP_OK;
+}
+
+// Clone Function. Same bucket count and slot positions, so nothing is
+// rehashed or displaced.
+static map_error_t cuckoo_clone(const map_t *src, map_t *dst, int nthreads) {
+    dst->cuckoo_buckets = __map_calloc(dst, src->num_buckets,
+                                       sizeof(map_cuckoo_bucket_t));
+    if (dst->cuckoo_buckets == NULL) return MAP_ERR_NO_MEM;
+
+    cuckoo_clone_job_t job = {src, dst};
+    int workers = __map_parallel_workers(nthreads, src->num_buckets,
+                                         MAP_PARALLEL_MIN_ITEMS);
+    map_error_t result = __map_parallel_for(workers, src->num_buckets,
+                                            cuckoo_clone_range, &job);
+    for (size_t i = 0; i < src->cuckoo_stash_size && result == MAP_OK; i++) {
+        void *key = src->usr_key_clone(src->cuckoo_stash[i]._key);
+        void *value = key != NULL ? src->usr_value_clone(src->cuckoo_stash[i]._value) : NULL;
+        if (value == NULL ||
+            !cuckoo_stash_push(dst, &dst->cuckoo_stash, &dst->cuckoo_stash_size,
+                               &dst->cuckoo_stash_capacity, src->cuckoo_stash[i].hash, key,
+                               value)) {
+            if (key != NULL) src->usr_free_key(key);
+            if (value != NULL) src->usr_free_value(value);
+            result = MAP_ERR_NO_MEM;
+        }
+    }
+    if (result != MAP_OK) cuckoo_destroy(dst);
+    return result;
+}
+
+// Insert Function
+static map_error_t cuckoo_insert(map_t *map, void *key, void *value) {
+    cuckoo_pos_t pos = cuckoo_locate(map, key);
+
+    // Key exists, update value
+    map_cuckoo_bucket_t *bucket;
+    int slot;
+    void **existing = NULL;
+    if (cuckoo_find(map, key, pos, &bucket, &slot)) {
+        existing = &bucket->slots[slot]._value;
+    } else if (map->cuckoo_stash_size > 0) {
+        size_t i = cuckoo_stash_find(map, key, pos.hash);
+        if (i < map->cuckoo_stash_size) existing = &map->cuckoo_stash[i]._value;
+    }
+    if (existing != NULL) {
+        void *new_value = map->usr_value_clone(value);
+        if (new_value == NULL) return MAP_ERR_NO_MEM;
+        map->usr_free_value(*existing);
+        *existing = new_value;
+        return MAP_OK;
+    }
+
+    void *new_key = map->usr_key_clone(key);
+    if (new_key == NULL) return MAP_ERR_NO_MEM;
+    void *new_value = map->usr_value_clone(value);
+    if (new_value == NULL) {
+        map->usr_free_key(new_key);
+        return MAP_ERR_NO_MEM;
+    }
+
+    if (!cuckoo_place(map, map->cuckoo_buckets, (uint32_t)map->num_buckets, pos.index,
+                      pos.tag, new_key, new_value)) {
+        // A failed walk at low load means the hash clusters beyond what two
+        // buckets can hold, so stash the entry while the stash is short.
+        // Otherwise double: that spreads distinct hashes that clustered.
+        size_t capacity = map->num_buckets * MAP_CUCKOO_SLOTS;
+        size_t stash_max = map->num_buckets > CUCKOO_STASH_MIN ? map->num_buckets
+                                                               : CUCKOO_STASH_MIN;
+        map_error_t result = MAP_ERR_NO_MEM;
+        if ((map->num_entries * 2 >= capacity || map->cuckoo_stash_size >= stash_max) &&
+            map->num_buckets <= UINT32_MAX / 2) {
+            result = cuckoo_rebuild(map, (uint32_t)map->num_buckets * 2, new_key, new_value);
+        } else if (cuckoo_stash_push(map, &map->cuckoo_stash, &map->cuckoo_stash_size,
+                                     &map->cuckoo_stash_capacity, pos.hash, new_key,
+                                     new_value)) {
+            result = MAP_OK;
+        }
+        if (result != MAP_OK) {
+            map->usr_free_key(new_key);
+            map->usr_free_value(new_value);
+            return result;
+        }
+    }
+
+    map->num_entries++;
+    return MAP_OK;
+}
+
+// Get Function
+static map_error_t cuckoo_get(const map_t *map, void *key, void **out_value) {
+    map_cuckoo_bucket_t *bucket;
+    int slot;
+    cuckoo_pos_t pos = cuckoo_locate(map, key);
+    if (cuckoo_find(map, key, pos, &bucket, &slot)) {
+        *out_value = bucket->slots[slot]._value;
+        return MAP_OK;
+    }
+    if (map->cuckoo_stash_size > 0) {
+        size_t i = cuckoo_stash_find(map, key, pos.hash);
+        if (i < map->cuckoo_stash_size) {
+            *out_value = map->cuckoo_stash[i]._value;
+            return MAP_OK;
+        }
+    }
+    return MAP_ERR_NOT_FOUND;
+}
+
+// Free the entry in bucket's slot and clear it.
+static void cuckoo_clear(map_t *map, map_cuckoo_bucket_t *bucket, int slot) {
+    map->usr_free_key(bucket->slots[slot]._key);
+    map->usr_free_value(bucket->slots[slot]._value);
+    bucket->tags[slot] = 0;
+    bucket->slots[slot]._key = NULL;
+    bucket->slots[slot]._value = NULL;
+    map->num_entries--;
+}
+
+// Free the stashed entry at position i and close the gap, keeping the
+// order an iterator walks the stash in.
+static void cuckoo_stash_clear(map_t *map, size_t i) {
+    map->usr_free_key(map->cuckoo_stash[i]._key);
+    map->usr_free_value(map->cuckoo_stash[i]._value);
+    memmove(&map->cuckoo_stash[i], &map->cuckoo_stash[i + 1],
+            (map->cuckoo_stash_size - i - 1) * sizeof(map_cuckoo_stashed_t));
+    map->cuckoo_stash_size--;
+    map->num_entries--;
+}
+
+// Shrink Function. Halves the table while it is mostly empty; keeps the
+// old one if the entries don't fit the smaller table.
+static void cuckoo_shrink(map_t *map) {
+    while (map->num_buckets > CUCKOO_INITIAL_BUCKETS &&
+           (double)map->num_entries / ((double)map->num_buckets * MAP_CUCKOO_SLOTS) <
+               map->min_load_factor / 4) {
+        if (cuckoo_rebuild(map, (uint32_t)map->num_buckets / 2, NULL, NULL) != MAP_OK) break;
+    }
+}
+
+// Remove Function
+static map_error_t cuckoo_remove(map_t *map, void *key) {
+    map_cuckoo_bucket_t *bucket;
+    int slot;
+    cuckoo_pos_t pos = cuckoo_locate(map, key);
+    if (cuckoo_find(map, key, pos, &bucket, &slot)) {
+        cuckoo_clear(map, bucket, slot);
+    } else {
+        size_t i = cuckoo_stash_find(map, key, pos.hash);
+        if (i == map->cuckoo_stash_size) return MAP_ERR_NOT_FOUND;
+        cuckoo_stash_clear(map, i);
+    }
+    cuckoo_shrink(map);
+    return MAP_OK;
+}
+
+// Iterator Start Function. current_bucket holds the next slot to visit;
+// positions past the last bucket slot index the stash.
+static map_error_t cuckoo_iter_start(const map_t *map, map_iterator_t *iter) {
+    iter->current_bucket = 0;
+    iter->current_element = NULL;
+    return map->num_entries > 0 ? MAP_OK : MAP_ERR_END_OF_MAP;
+}
+
+// Iterator Next Function
+static map_error_t cuckoo_iter_next(const map_t *map, map_iterator_t *iter,
+                                    void **out_key, void **out_value) {
+    size_t total = map->num_buckets * MAP_CUCKOO_SLOTS;
+    while (iter->current_bucket < total) {
+        size_t pos = iter->current_bucket++;
+        const map_cuckoo_bucket_t *bucket = &map->cuckoo_buckets[pos / MAP_CUCKOO_SLOTS];
+        int slot = pos % MAP_CUCKOO_SLOTS;
+        if (bucket->tags[slot] != 0) {
+            *out_key = bucket->slots[slot]._key;
+            *out_value = bucket->slots[slot]._value;
+            return MAP_OK;
+        }
+    }
+    if (iter->current_bucket - total < map->cuckoo_stash_size) {
+        const map_cuckoo_stashed_t *stashed = &map->cuckoo_stash[iter->current_bucket++ - total];
+        *out_key = stashed->_key;
+        *out_value = stashed->_value;
+        return MAP_OK;
+    }
+    return MAP_ERR_END_OF_MAP;
+}
+
+// Iterator Remove Function. The entry sits in the slot just before
+// current_bucket.
+static map_error_t cuckoo_iter_remove(map_t *map, map_iterator_t *iter) {
+    if (iter->current_bucket == 0) return MAP_ERR_NOT_FOUND;
+
+    size_t pos = iter->current_bucket - 1;
+    size_t total = map->num_buckets * MAP_CUCKOO_SLOTS;
+    if (pos >= total) {
+        // The next stashed entry moves into this position.
+        if (pos - total >= map->cuckoo_stash_size) return MAP_ERR_NOT_FOUND;
+        if (map->wal != NULL) {
+            map_error_t result = __map_wal_append(map, MAP_WAL_REMOVE,
+                                                  map->cuckoo_stash[pos - total]._key, NULL);
+            if (result != MAP_OK) return result;
+        }
+        cuckoo_stash_clear(map, pos - total);
+        iter->current_bucket--;
+        return MAP_OK;
+    }
+    map_cuckoo_bucket_t *bucket = &map->cuckoo_buckets[pos / MAP_CUCKOO_SLOTS];
+    int slot = pos % MAP_CUCKOO_SLOTS;
+    if (bucket->tags[slot] == 0) return MAP_ERR_NOT_FOUND;
+    if (map->wal != NULL) {
+        map_error_t result = __map_wal_append(map, MAP_WAL_REMOVE, bucket->slots[slot]._key, NULL);
+        if (result != MAP_OK) return result;
+    }
+
+    cuckoo_clear(map, bucket, slot);
+    return MAP_OK;
+}
+
+// Print Function
+static map_error_t cuckoo_print(const map_t *map) {
+    printf("Map contents:\n");
+    for (size_t i = 0; i < map->num_buckets; i++) {
+        const map_cuckoo_bucket_t *bucket = &map->cuckoo_buckets[i];
+        int occupied = 0;
+        for (int s = 0; s < MAP_CUCKOO_SLOTS; s++) occupied |= bucket->tags[s];
+        if (!occupied) continue;
+        printf("Buckets %zu: ", i);
+        for (int s = 0; s < MAP_CUCKOO_SLOTS; s++) {
+            if (bucket->tags[s] == 0) continue;
+
+            char *entry_str = map->usr_stringify(bucket->slots[s]._key,
+                                                 bucket->slots[s]._value);
+            if (entry_str == NULL) return MAP_ERR_UNKNOWN;
+            printf("%s", entry_str);
+            free(entry_str);
+        }
+        printf("\n");
+    }
+    if (map->cuckoo_stash_size > 0) {
+        printf("Stash: ");
+        for (size_t i = 0; i < map->cuckoo_stash_size; i++) {
+            char *entry_str = map->usr_stringify(map->cuckoo_stash[i]._key,
+                                                 map->cuckoo_stash[i]._value);
+            if (entry_str == NULL) return MAP_ERR_UNKNOWN;
+            printf("%s", entry_str);
+            free(entry_str);
+        }
+        printf("\n");
+    }
+    return MAP_OK;
+}
+
+const map_engine_ops_t __map_cuckoo_ops = {
+    cuckoo_init,
+    cuckoo_destroy,
+    cuckoo_clone,
+    cuckoo_insert,
+    cuckoo_get,
+    cuckoo_remove,
+    cuckoo_iter_start,
+    cuckoo_iter_next,
+    cuckoo_iter_remove,
+    cuckoo_shrink,
+    cuckoo_print,
+};
@@ -0,0 +1,395 @@
+#include <map.h>
+#include <map_internal.h>
+#include <string.h>
+
+// Compact, insertion-ordered engine. Entries sit back to back in one array
+// in the order they were first inserted, and the hash table holds only
+// their positions, in 1, 2 or 4 bytes per slot depending on the table
+// size. The array grows by half at a time inside a fixed index, which is
+// rebuilt only when it would pass two thirds full or the array is mostly
+// holes. Iteration is a linear scan of the array, an entry costs its 24
+// bytes plus a few index bytes, and lookups probe the index linearly,
+// comparing stored hashes before calling usr_compare.
+
+#define DENSE_MIN_SLOTS 8
+#define DENSE_MAX_SLOTS ((int64_t)1 << 30)
+#define DENSE_EMPTY 0
+
+// Entries a table of `slots` index slots takes before it is rebuilt.
+static int64_t dense_usable(int64_t slots) {
+    return slots * 2 / 3;
+}
+
+static uint8_t dense_width(int64_t slots) {
+    if (slots <= 256) return 1;
+    if (slots <= 65536) return 2;
+    return 4;
+}
+
+// Index value marking a removed entry, so probes continue past it.
+static uint32_t dense_dummy(uint8_t width) {
+    return width == 1 ? UINT8_MAX : width == 2 ? UINT16_MAX : UINT32_MAX;
+}
+
+static uint32_t dense_slot(const map_t *map, size_t i) {
+    switch (map->dense_index_width) {
+    case 1:
+        return ((const uint8_t *)map->dense_index)[i];
+    case 2:
+        return ((const uint16_t *)map->dense_index)[i];
+    default:
+        return ((const uint32_t *)map->dense_index)[i];
+    }
+}
+
+static void dense_set_slot(map_t *map, size_t i, uint32_t value) {
+    switch (map->dense_index_width) {
+    case 1:
+        ((uint8_t *)map->dense_index)[i] = (uint8_t)value;
+        break;
+    case 2:
+        ((uint16_t *)map->dense_index)[i] = (uint16_t)value;
+        break;
+    default:
+        ((uint32_t *)map->dense_index)[i] = value;
+        break;
+    }
+}
+
+static uint64_t dense_hash(const map_t *map, void *key) {
+    // Post-mix: slots are picked from the low bits.
+    return __map_mix64(map->usr_hash(key));
+}
+
+// Find key's index slot. Returns -1 if it is absent, with *out_free set to
+// the slot an insert should use.
+static int64_t dense_find(const map_t *map, void *key, uint64_t hash, size_t *out_free) {
+    size_t mask = map->num_buckets - 1;
+    uint32_t dummy = dense_dummy(map->dense_index_width);
+    size_t free_slot = SIZE_MAX;
+
+    // At most two thirds of the slots are ever taken, so this ends.
+    for (size_t i = (size_t)hash & mask;; i = (i + 1) & mask) {
+        uint32_t value = dense_slot(map, i);
+        if (value == DENSE_EMPTY) {
+            if (out_free != NULL) *out_free = free_slot != SIZE_MAX ? free_slot : i;
+            return -1;
+        }
+        if (value == dummy) {
+            if (free_slot == SIZE_MAX) free_slot = i;
+            continue;
+        }
+
+        const map_dense_entry_t *entry = &map->dense_entries[value - 1];
+        if (entry->hash == hash && map->usr_compare(entry->_key, key) == 0) {
+            return (int64_t)i;
+        }
+    }
+}
+
+// First empty slot for hash, in an index without removed entries.
+static size_t dense_empty_slot(const map_t *map, uint64_t hash) {
+    size_t mask = map->num_buckets - 1;
+    size_t i = (size_t)hash & mask;
+    while (dense_slot(map, i) != DENSE_EMPTY) i = (i + 1) & mask;
+    return i;
+}
+
+// Move the live entries, in order, into fresh arrays with room for
+// `want` entries. The old arrays are kept if allocation fails.
+static map_error_t dense_rebuild(map_t *map, int64_t want) {
+    int64_t slots = DENSE_MIN_SLOTS;
+    while (dense_usable(slots) < want) {
+        if (slots >= DENSE_MAX_SLOTS) return MAP_ERR_OVERFLOW;
+        slots *= 2;
+    }
+
+    int64_t capacity = want > 1 ? want : 1;
+    uint8_t width = dense_width(slots);
+    map_dense_entry_t *entries = __map_alloc(map, (size_t)capacity * sizeof(map_dense_entry_t));
+    void *index = __map_calloc(map, (size_t)slots, width);
+    if (entries == NULL || index == NULL) {
+        __map_free(map, entries, (size_t)capacity * sizeof(map_dense_entry_t));
+        __map_free(map, index, (size_t)slots * width);
+        return MAP_ERR_NO_MEM;
+    }
+
+    map_dense_entry_t *old_entries = map->dense_entries;
+    void *old_index = map->dense_index;
+    size_t old_index_size = map->num_buckets * map->dense_index_width;
+    size_t old_used = map->dense_used;
+    size_t old_capacity = map->dense_capacity;
+
+    map->dense_entries = entries;
+    map->dense_index = index;
+    map->dense_index_width = width;
+    map->num_buckets = (size_t)slots;
+    map->dense_capacity = (size_t)capacity;
+    map->dense_used = 0;
+    for (size_t i = 0; i < old_used; i++) {
+        if (old_entries[i]._key == NULL) continue;
+        entries[map->dense_used] = old_entries[i];
+        dense_set_slot(map, dense_empty_slot(map, old_entries[i].hash),
+                       (uint32_t)++map->dense_used);
+    }
+
+    __map_free(map, old_entries, old_capacity * sizeof(map_dense_entry_t));
+    __map_free(map, old_index, old_index_size);
+    map->resize_epoch++;
+    return MAP_OK;
+}
+
+// Init Function
+static map_error_t dense_init(map_t *map) {
+    map->num_buckets = 0;
+    map->dense_index_width = 1;
+    return dense_rebuild(map, 1);
+}
+
+// Destroy Function
+static void dense_destroy(map_t *map) {
+    for (size_t i = 0; i < map->dense_used; i++) {
+        map_dense_entry_t *entry = &map->dense_entries[i];
+        if (entry->_key == NULL) continue;
+        map->usr_free_key(entry->_key);
+        map->usr_free_value(entry->_value);
+    }
+    __map_free(map, map->dense_entries, map->dense_capacity * sizeof(map_dense_entry_t));
+    __map_free(map, map->dense_index, map->num_buckets * map->dense_index_width);
+    map->dense_entries = NULL;
+    map->dense_index = NULL;
+}
+
+typedef struct {
+    const map_t *src;
+    map_t *dst;
+} dense_clone_job_t;
+
+// Clone entries [begin, end). A key is only stored once its value exists,
+// so dense_destroy() can clean up after a failure.
+static map_error_t dense_clone_range(void *ctx, int worker, size_t begin, size_t end) {
+    dense_clone_job_t *job = (dense_clone_job_t *)ctx;
+    (void)worker;
+
+    for (size_t i = begin; i < end; i++) {
+        const map_dense_entry_t *from = &job->src->dense_entries[i];
+        map_dense_entry_t *to = &job->dst->dense_entries[i];
+        to->hash = from->hash;
+        if (from->_key == NULL) continue;
+
+        void *key = job->src->usr_key_clone(from->_key);
+        if (key == NULL) return MAP_ERR_NO_MEM;
+        void *value = job->src->usr_value_clone(from->_value);
+        if (value == NULL) {
+            job->src->usr_free_key(key);
+            return MAP_ERR_NO_MEM;
+        }
+        to->_value = value;
+        to->_key = key;
+    }
+    return MAP_OK;
+}
+
+// Clone Function. Same arrays, index copied as is, so nothing is rehashed.
+static map_error_t dense_clone(const map_t *src, map_t *dst, int nthreads) {
+    size_t index_size = src->num_buckets * src->dense_index_width;
+    dst->dense_entries = __map_calloc(dst, src->dense_capacity,
+                                      sizeof(map_dense_entry_t));
+    dst->dense_index = __map_alloc(dst, index_size);
+    if (dst->dense_entries == NULL || dst->dense_index == NULL) {
+        __map_free(dst, dst->dense_entries,
+                   src->dense_capacity * sizeof(map_dense_entry_t));
+        __map_free(dst, dst->dense_index, index_size);
+        return MAP_ERR_NO_MEM;
+    }
+    memcpy(dst->dense_index, src->dense_index, index_size);
+    dst->dense_index_width = src->dense_index_width;
+    dst->dense_capacity = src->dense_capacity;
+    dst->dense_used = src->dense_used;
+
+    dense_clone_job_t job = {src, dst};
+    int workers = __map_parallel_workers(nthreads, src->dense_used,
+                                         MAP_PARALLEL_MIN_ITEMS);
+    map_error_t result = __map_parallel_for(workers, src->dense_used,
+                                            dense_clone_range, &job);
+    if (result != MAP_OK) dense_destroy(dst);
+    return result;
+}
+
+// The entry array is full. Grow it in place if the index has room and the
+// array is not mostly holes; otherwise compact into a bigger index.
+static map_error_t dense_make_room(map_t *map) {
+    int64_t usable = dense_usable((int64_t)map->num_buckets);
+    int64_t capacity = (int64_t)map->dense_capacity;
+    if (capacity < usable && (int64_t)map->num_entries >= capacity / 2) {
+        int64_t grown = capacity + capacity / 2 + 1;
+        if (grown > usable) grown = usable;
+        map_dense_entry_t *entries = __map_realloc(map, map->dense_entries,
+                                                   (size_t)capacity * sizeof(map_dense_entry_t),
+                                                   (size_t)grown * sizeof(map_dense_entry_t));
+        if (entries != NULL) {
+            map->dense_entries = entries;
+            map->dense_capacity = (size_t)grown;
+            return MAP_OK;
+        }
+    }
+    int64_t live = (int64_t)map->num_entries;
+    return dense_rebuild(map, live + live / 2 + 1);
+}
+
+// Insert Function
+static map_error_t dense_insert(map_t *map, void *key, void *value) {
+    uint64_t hash = dense_hash(map, key);
+    size_t free_slot;
+    int64_t slot = dense_find(map, key, hash, &free_slot);
+
+    // Key exists, update value in place (it keeps its position).
+    if (slot >= 0) {
+        map_dense_entry_t *entry = &map->dense_entries[dense_slot(map, (size_t)slot) - 1];
+        void *new_value = map->usr_value_clone(value);
+        if (new_value == NULL) return MAP_ERR_NO_MEM;
+        map->usr_free_value(entry->_value);
+        entry->_value = new_value;
+        return MAP_OK;
+    }
+
+    void *new_key = map->usr_key_clone(key);
+    if (new_key == NULL) return MAP_ERR_NO_MEM;
+    void *new_value = map->usr_value_clone(value);
+    if (new_value == NULL) {
+        map->usr_free_key(new_key);
+        return MAP_ERR_NO_MEM;
+    }
+
+    if (map->dense_used == map->dense_capacity) {
+        void *index = map->dense_index;
+        map_error_t result = dense_make_room(map);
+        if (result != MAP_OK) {
+            map->usr_free_key(new_key);
+            map->usr_free_value(new_value);
+            return result;
+        }
+        if (map->dense_index != index) free_slot = dense_empty_slot(map, hash);
+    }
+
+    map_dense_entry_t *entry = &map->dense_entries[map->dense_used];
+    entry->hash = hash;
+    entry->_key = new_key;
+    entry->_value = new_value;
+    dense_set_slot(map, free_slot, (uint32_t)++map->dense_used);
+    map->num_entries++;
+    return MAP_OK;
+}
+
+// Get Function
+static map_error_t dense_get(const map_t *map, void *key, void **out_value) {
+    int64_t slot = dense_find(map, key, dense_hash(map, key), NULL);
+    if (slot < 0) {
+        return MAP_ERR_NOT_FOUND;
+    }
+
+    *out_value = map->dense_entries[dense_slot(map, (size_t)slot) - 1]._value;
+    return MAP_OK;
+}
+
+// Free the entry behind index slot `slot`, leaving a hole in the array.
+static void dense_clear(map_t *map, size_t slot) {
+    map_dense_entry_t *entry = &map->dense_entries[dense_slot(map, slot) - 1];
+    map->usr_free_key(entry->_key);
+    map->usr_free_value(entry->_value);
+    entry->_key = NULL;
+    entry->_value = NULL;
+    dense_set_slot(map, slot, dense_dummy(map->dense_index_width));
+    map->num_entries--;
+}
+
+// Shrink Function. Gives memory back once the arrays are mostly holes;
+// keeps the old ones if the smaller allocation fails. Compacting moves
+// entries and bumps resize_epoch.
+static void dense_shrink(map_t *map) {
+    if (map->num_buckets > DENSE_MIN_SLOTS && map->num_entries < map->dense_capacity / 8) {
+        dense_rebuild(map, (int64_t)map->num_entries * 2);
+    }
+}
+
+// Remove Function
+static map_error_t dense_remove(map_t *map, void *key) {
+    int64_t slot = dense_find(map, key, dense_hash(map, key), NULL);
+    if (slot < 0) {
+        return MAP_ERR_NOT_FOUND;
+    }
+
+    dense_clear(map, (size_t)slot);
+    dense_shrink(map);
+    return MAP_OK;
+}
+
+// Iterator Start Function. current_bucket holds the next entry to visit.
+static map_error_t dense_iter_start(const map_t *map, map_iterator_t *iter) {
+    iter->current_bucket = 0;
+    iter->current_element = NULL;
+    return map->num_entries > 0 ? MAP_OK : MAP_ERR_END_OF_MAP;
+}
+
+// Iterator Next Function
+static map_error_t dense_iter_next(const map_t *map, map_iterator_t *iter,
+                                   void **out_key, void **out_value) {
+    while (iter->current_bucket < map->dense_used) {
+        const map_dense_entry_t *entry = &map->dense_entries[iter->current_bucket++];
+        if (entry->_key != NULL) {
+            *out_key = entry->_key;
+            *out_value = entry->_value;
+            return MAP_OK;
+        }
+    }
+    return MAP_ERR_END_OF_MAP;
+}
+
+// Iterator Remove Function. The entry is the one before current_bucket;
+// its index slot is found from the stored hash, comparing positions only.
+static map_error_t dense_iter_remove(map_t *map, map_iterator_t *iter) {
+    if (iter->current_bucket == 0) return MAP_ERR_NOT_FOUND;
+
+    uint32_t position = (uint32_t)iter->current_bucket;
+    const map_dense_entry_t *entry = &map->dense_entries[position - 1];
+    if (entry->_key == NULL) return MAP_ERR_NOT_FOUND;
+    if (map->wal != NULL) {
+        map_error_t result = __map_wal_append(map, MAP_WAL_REMOVE, entry->_key, NULL);
+        if (result != MAP_OK) return result;
+    }
+
+    size_t mask = map->num_buckets - 1;
+    size_t i = (size_t)entry->hash & mask;
+    while (dense_slot(map, i) != position) i = (i + 1) & mask;
+    dense_clear(map, i);
+    return MAP_OK;
+}
+
+// Print Function. Entries come out in insertion order.
+static map_error_t dense_print(const map_t *map) {
+    printf("Map contents:\n");
+    for (size_t i = 0; i < map->dense_used; i++) {
+        const map_dense_entry_t *entry = &map->dense_entries[i];
+        if (entry->_key == NULL) continue;
+
+        char *entry_str = map->usr_stringify(entry->_key, entry->_value);
+        if (entry_str == NULL) return MAP_ERR_UNKNOWN;
+        printf("Entry %zu: %s\n", i, entry_str);
+        free(entry_str);
+    }
+    return MAP_OK;
+}
+
+const map_engine_ops_t __map_dense_ops = {
+    dense_init,
+    dense_destroy,
+    dense_clone,
+    dense_insert,
+    dense_get,
+    dense_remove,
+    dense_iter_start,
+    dense_iter_next,
+    dense_iter_remove,
+    dense_shrink,
+    dense_print,
+};
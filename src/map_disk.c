@@ -0,0 +1,739 @@
+#define _POSIX_C_SOURCE 200809L
+#include <map.h>
+#include <map_internal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Out-of-core engine. Keys are split over a fixed number of partitions by
+// the top bits of their mixed hash. A partition is either resident (an
+// entry array plus an open addressing index over it) or spilled to its own
+// file, and the least recently used ones are spilled whenever the resident
+// ones are charged more than the RAM budget. A spill file is the
+// partition's entries in position order:
+//
+//   hash (8) | key length (4) | value length (4) | key | value
+//
+// with a key length of DISK_DEAD_LENGTH (and nothing after the header) for
+// a removed entry that an iterator may still count past. Files are private
+// to the map, so integers are in native byte order. Faulting a partition
+// back in maps its file and decodes it front to back.
+
+#define DISK_DEFAULT_PARTITIONS 64
+#define DISK_DEFAULT_BUDGET ((size_t)64 * 1024 * 1024)
+#define DISK_BUFFER_SIZE (256 * 1024)
+#define DISK_RECORD_HEADER 16
+#define DISK_DEAD_LENGTH UINT32_MAX
+#define DISK_MIN_ENTRIES 16
+#define DISK_MAX_ENTRIES (UINT32_MAX / 4) // Keeps the index size in a uint32_t.
+#define DISK_DIR_TEMPLATE "/libmap-XXXXXX"
+#define DISK_FILE_NAME_SIZE 12             // "/" and up to 10 digits, NUL.
+
+// Memory an entry takes besides its encoded bytes: the entry and, at the
+// index's lowest load, two slots.
+#define DISK_ENTRY_OVERHEAD (sizeof(map_disk_entry_t) + 2 * sizeof(uint32_t))
+
+static uint64_t disk_hash(const map_t *map, void *key) {
+    return __map_mix64(map->usr_hash(key));
+}
+
+static size_t disk_part_of(const map_t *map, uint64_t hash) {
+    return (size_t)(hash >> 48) & (map->num_buckets - 1);
+}
+
+// Path of partition i's file. The buffer is shared: use it right away.
+static const char *disk_file(const map_disk_t *disk, size_t i) {
+    snprintf(disk->path + disk->dir_length, DISK_FILE_NAME_SIZE, "/%u", (unsigned)i);
+    return disk->path;
+}
+
+static size_t disk_charge(const map_t *map, void *key, void *value) {
+    const map_disk_options_t *options = &map->disk->options;
+    return options->encode_key(key, NULL, 0) + options->encode_value(value, NULL, 0) +
+           DISK_ENTRY_OVERHEAD;
+}
+
+// Position (plus one) of key's entry, or 0; *out_slot gets the empty index
+// slot where the key would go.
+static uint32_t disk_find(const map_t *map, const map_disk_part_t *part, void *key,
+                          uint64_t hash, size_t *out_slot) {
+    if (part->index_size == 0) return 0;
+    size_t mask = part->index_size - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        uint32_t at = part->index[slot];
+        if (at == 0) {
+            if (out_slot != NULL) *out_slot = slot;
+            return 0;
+        }
+        const map_disk_entry_t *entry = &part->entries[at - 1];
+        if (entry->key != NULL && entry->hash == hash && map->usr_compare(entry->key, key) == 0) {
+            return at;
+        }
+    }
+}
+
+// Index every live entry in a fresh table with room for `want` positions
+// at a load of at most 1/2. Removed entries keep their slots until then.
+static map_error_t disk_reindex(const map_t *map, map_disk_part_t *part, uint32_t want) {
+    uint32_t size = DISK_MIN_ENTRIES;
+    while (size < 2 * (uint64_t)want) size *= 2;
+    uint32_t *index = __map_calloc(map, size, sizeof(uint32_t));
+    if (index == NULL) return MAP_ERR_NO_MEM;
+
+    __map_free(map, part->index, (size_t)part->index_size * sizeof(uint32_t));
+    part->index = index;
+    part->index_size = size;
+    for (uint32_t pos = 0; pos < part->used; pos++) {
+        if (part->entries[pos].key == NULL) continue;
+        size_t slot = part->entries[pos].hash & (size - 1);
+        while (index[slot] != 0) slot = (slot + 1) & (size - 1);
+        index[slot] = pos + 1;
+    }
+    return MAP_OK;
+}
+
+// Free a resident partition's entries and arrays.
+static void disk_drop(const map_t *map, map_disk_part_t *part) {
+    for (uint32_t pos = 0; pos < part->used && part->entries != NULL; pos++) {
+        map_disk_entry_t *entry = &part->entries[pos];
+        if (entry->key == NULL) continue;
+        map->usr_free_key(entry->key);
+        map->usr_free_value(entry->value);
+    }
+    __map_free(map, part->entries, (size_t)part->capacity * sizeof(map_disk_entry_t));
+    __map_free(map, part->index, (size_t)part->index_size * sizeof(uint32_t));
+    map->disk->stats.resident_bytes -= part->bytes;
+    part->entries = NULL;
+    part->index = NULL;
+    part->capacity = 0;
+    part->index_size = 0;
+    part->bytes = 0;
+    part->resident = 0;
+}
+
+// Move the live entries of a resident partition to the front. Iterator
+// positions change, so this bumps resize_epoch.
+static void disk_compact(map_t *map, map_disk_part_t *part) {
+    uint32_t kept = 0;
+    for (uint32_t pos = 0; pos < part->used; pos++) {
+        if (part->entries[pos].key != NULL) part->entries[kept++] = part->entries[pos];
+    }
+    part->used = kept;
+    part->dirty = 1; // The file, if any, still has the old positions.
+    map->resize_epoch++;
+    if (disk_reindex(map, part, kept) != MAP_OK) {
+        // Keep the old table's size; it still has room for every entry.
+        memset(part->index, 0, (size_t)part->index_size * sizeof(uint32_t));
+        for (uint32_t pos = 0; pos < kept; pos++) {
+            size_t slot = part->entries[pos].hash & (part->index_size - 1);
+            while (part->index[slot] != 0) slot = (slot + 1) & (part->index_size - 1);
+            part->index[slot] = pos + 1;
+        }
+    }
+}
+
+static void disk_compact_if_sparse(map_t *map, map_disk_part_t *part) {
+    if (part->resident && part->used >= DISK_MIN_ENTRIES && part->live < part->used / 2) {
+        disk_compact(map, part);
+    }
+}
+
+static map_error_t disk_write_all(int fd, const uint8_t *p, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return MAP_ERR_IO;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return MAP_OK;
+}
+
+// Encode one record at the end of the buffer, writing the buffer out (and
+// growing it) as needed. Removed entries take a header only.
+static map_error_t disk_encode(const map_t *map, int fd, const map_disk_entry_t *entry,
+                               size_t *used) {
+    map_disk_t *disk = map->disk;
+    for (int attempt = 0; attempt < 3; attempt++) {
+        size_t room = disk->buffer_capacity - *used;
+        uint8_t *record = disk->buffer + *used;
+
+        size_t key_len = 0, value_len = 0;
+        if (entry->key != NULL) {
+            size_t at = DISK_RECORD_HEADER;
+            key_len = disk->options.encode_key(entry->key, at < room ? record + at : NULL,
+                                               at < room ? room - at : 0);
+            at += key_len;
+            value_len = disk->options.encode_value(entry->value, at < room ? record + at : NULL,
+                                                   at < room ? room - at : 0);
+            if (key_len >= DISK_DEAD_LENGTH || value_len > UINT32_MAX) {
+                return MAP_ERR_INVALID_ARG;
+            }
+        }
+
+        size_t total = DISK_RECORD_HEADER + key_len + value_len;
+        if (total <= room) {
+            uint32_t lengths[2] = {entry->key != NULL ? (uint32_t)key_len : DISK_DEAD_LENGTH,
+                                   (uint32_t)value_len};
+            memcpy(record, &entry->hash, sizeof(uint64_t));
+            memcpy(record + 8, lengths, sizeof(lengths));
+            *used += total;
+            return MAP_OK;
+        }
+
+        map_error_t result = disk_write_all(fd, disk->buffer, *used);
+        if (result != MAP_OK) return result;
+        disk->stats.bytes_written += *used;
+        *used = 0;
+        if (total > disk->buffer_capacity) {
+            uint8_t *grown = __map_realloc(map, disk->buffer, disk->buffer_capacity, total);
+            if (grown == NULL) return MAP_ERR_NO_MEM;
+            disk->buffer = grown;
+            disk->buffer_capacity = total;
+        }
+    }
+    return MAP_ERR_UNKNOWN; // The codec sized the same object differently.
+}
+
+// Write a resident partition to its file; *out_records gets the number of
+// records. Removed entries are written as dead records, so positions only
+// ever change through disk_compact().
+static map_error_t disk_write(const map_t *map, size_t i, uint32_t *out_records) {
+    map_disk_t *disk = map->disk;
+    map_disk_part_t *part = &disk->parts[i];
+    if (part->live == 0) {
+        if (part->file_bytes != 0 && unlink(disk_file(disk, i)) != 0) return MAP_ERR_IO;
+        part->file_bytes = 0;
+        part->dirty = 0;
+        *out_records = 0;
+        return MAP_OK;
+    }
+
+    int fd = open(disk_file(disk, i), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) return MAP_ERR_IO;
+
+    size_t start = disk->stats.bytes_written;
+    size_t used = 0;
+    map_error_t result = MAP_OK;
+    for (uint32_t pos = 0; pos < part->used && result == MAP_OK; pos++) {
+        result = disk_encode(map, fd, &part->entries[pos], &used);
+    }
+    if (result == MAP_OK) result = disk_write_all(fd, disk->buffer, used);
+    if (close(fd) != 0 && result == MAP_OK) result = MAP_ERR_IO;
+    if (result != MAP_OK) return result;
+
+    disk->stats.bytes_written += used;
+    part->file_bytes = disk->stats.bytes_written - start;
+    part->dirty = 0;
+    *out_records = part->used;
+    return MAP_OK;
+}
+
+// Decode partition i's file into a fresh entry array.
+static map_error_t disk_read(const map_t *map, size_t i) {
+    map_disk_t *disk = map->disk;
+    map_disk_part_t *part = &disk->parts[i];
+    int fd = open(disk_file(disk, i), O_RDONLY);
+    if (fd < 0) return MAP_ERR_IO;
+    void *mapped = mmap(NULL, part->file_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) return MAP_ERR_IO;
+    posix_madvise(mapped, part->file_bytes, POSIX_MADV_SEQUENTIAL);
+
+    part->capacity = part->used;
+    part->entries = __map_calloc(map, part->capacity, sizeof(map_disk_entry_t));
+    map_error_t result = part->entries != NULL ? MAP_OK : MAP_ERR_NO_MEM;
+
+    const uint8_t *p = mapped;
+    size_t offset = 0;
+    for (uint32_t pos = 0; pos < part->used && result == MAP_OK; pos++) {
+        map_disk_entry_t *entry = &part->entries[pos];
+        uint32_t lengths[2];
+        if (part->file_bytes - offset < DISK_RECORD_HEADER) {
+            result = MAP_ERR_IO;
+            break;
+        }
+        memcpy(&entry->hash, p + offset, sizeof(uint64_t));
+        memcpy(lengths, p + offset + 8, sizeof(lengths));
+        offset += DISK_RECORD_HEADER;
+        if (lengths[0] == DISK_DEAD_LENGTH) continue;
+        if (part->file_bytes - offset < (uint64_t)lengths[0] + lengths[1]) {
+            result = MAP_ERR_IO;
+            break;
+        }
+
+        entry->key = disk->options.decode_key(p + offset, lengths[0]);
+        entry->value = disk->options.decode_value(p + offset + lengths[0], lengths[1]);
+        offset += (size_t)lengths[0] + lengths[1];
+        if (entry->key == NULL || entry->value == NULL) {
+            if (entry->key != NULL) map->usr_free_key(entry->key);
+            if (entry->value != NULL) map->usr_free_value(entry->value);
+            entry->key = NULL;
+            result = MAP_ERR_NO_MEM;
+            break;
+        }
+        entry->bytes = (size_t)lengths[0] + lengths[1] + DISK_ENTRY_OVERHEAD;
+        part->bytes += entry->bytes;
+    }
+    munmap(mapped, part->file_bytes);
+
+    disk->stats.resident_bytes += part->bytes;
+    if (result == MAP_OK) result = disk_reindex(map, part, part->used);
+    if (result != MAP_OK) {
+        disk_drop(map, part); // Entries not decoded are still zeroed.
+        return result;
+    }
+
+    part->resident = 1;
+    part->dirty = 0;
+    disk->stats.faults++;
+    disk->stats.bytes_read += part->file_bytes;
+    return MAP_OK;
+}
+
+// Write partition i out if it changed, then free it.
+static map_error_t disk_spill(const map_t *map, size_t i) {
+    map_disk_part_t *part = &map->disk->parts[i];
+    uint32_t records = part->used;
+    if (part->dirty) {
+        map_error_t result = disk_write(map, i, &records);
+        if (result != MAP_OK) return result;
+    }
+    disk_drop(map, part);
+    part->used = records;
+    map->disk->stats.spills++;
+    return MAP_OK;
+}
+
+// Spill the least recently used partitions other than `keep` until the
+// resident ones fit the budget.
+static map_error_t disk_fit(const map_t *map, size_t keep) {
+    map_disk_t *disk = map->disk;
+    while (disk->stats.resident_bytes > disk->options.ram_budget) {
+        size_t victim = map->num_buckets;
+        for (size_t i = 0; i < map->num_buckets; i++) {
+            const map_disk_part_t *part = &disk->parts[i];
+            if (i == keep || !part->resident || part->bytes == 0) continue;
+            if (victim == map->num_buckets || part->last_use < disk->parts[victim].last_use) {
+                victim = i;
+            }
+        }
+        if (victim == map->num_buckets) return MAP_OK;
+        map_error_t result = disk_spill(map, victim);
+        if (result != MAP_OK) return result;
+    }
+    return MAP_OK;
+}
+
+// Make partition i resident and most recently used, then fit the others
+// around it.
+static map_error_t disk_use(const map_t *map, size_t i) {
+    map_disk_part_t *part = &map->disk->parts[i];
+    if (!part->resident) {
+        if (part->file_bytes == 0) {
+            part->used = 0;
+            part->resident = 1;
+        } else {
+            map_error_t result = disk_read(map, i);
+            if (result != MAP_OK) return result;
+        }
+    }
+    part->last_use = ++map->disk->clock;
+    return disk_fit(map, i);
+}
+
+// Append a new entry, taking ownership of key and value.
+static map_error_t disk_append(const map_t *map, map_disk_part_t *part, uint64_t hash,
+                               void *key, void *value) {
+    if (part->used == DISK_MAX_ENTRIES) return MAP_ERR_OVERFLOW;
+    if (part->used == part->capacity) {
+        uint64_t grown = part->capacity < DISK_MIN_ENTRIES ? DISK_MIN_ENTRIES
+                                                          : part->capacity + part->capacity / 2;
+        if (grown > DISK_MAX_ENTRIES) grown = DISK_MAX_ENTRIES;
+        map_disk_entry_t *entries = __map_realloc(map, part->entries,
+                                                  (size_t)part->capacity * sizeof(map_disk_entry_t),
+                                                  (size_t)grown * sizeof(map_disk_entry_t));
+        if (entries == NULL) return MAP_ERR_NO_MEM;
+        part->entries = entries;
+        part->capacity = (uint32_t)grown;
+    }
+    if (2 * ((uint64_t)part->used + 1) > part->index_size) {
+        map_error_t result = disk_reindex(map, part, part->used + 1);
+        if (result != MAP_OK) return result;
+    }
+
+    size_t slot = hash & (part->index_size - 1);
+    while (part->index[slot] != 0) slot = (slot + 1) & (part->index_size - 1);
+    map_disk_entry_t *entry = &part->entries[part->used];
+    entry->hash = hash;
+    entry->key = key;
+    entry->value = value;
+    entry->bytes = disk_charge(map, key, value);
+    part->index[slot] = ++part->used;
+    part->live++;
+    part->bytes += entry->bytes;
+    part->dirty = 1;
+    map->disk->stats.resident_bytes += entry->bytes;
+    return MAP_OK;
+}
+
+static void disk_remove_at(map_t *map, map_disk_part_t *part, uint32_t pos) {
+    map_disk_entry_t *entry = &part->entries[pos];
+    map->usr_free_key(entry->key);
+    map->usr_free_value(entry->value);
+    entry->key = NULL;
+    entry->value = NULL;
+    part->bytes -= entry->bytes;
+    map->disk->stats.resident_bytes -= entry->bytes;
+    part->live--;
+    part->dirty = 1;
+    map->num_entries--;
+}
+
+// Set up empty partitions in a new private directory under options->dir.
+static map_error_t disk_setup(map_t *map, const map_disk_options_t *options) {
+    if (options == NULL || options->dir == NULL || !options->encode_key ||
+        !options->decode_key || !options->encode_value || !options->decode_value ||
+        options->partitions == 0 || options->partitions > MAP_DISK_MAX_PARTITIONS ||
+        (options->partitions & (options->partitions - 1)) != 0) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    map_disk_t *disk = __map_calloc(map, 1, sizeof(map_disk_t));
+    if (disk == NULL) return MAP_ERR_NO_MEM;
+    disk->options = *options;
+    disk->dir_length = strlen(options->dir) + strlen(DISK_DIR_TEMPLATE);
+    disk->path_capacity = disk->dir_length + DISK_FILE_NAME_SIZE;
+    disk->path = __map_alloc(map, disk->path_capacity);
+    disk->parts = __map_calloc(map, options->partitions, sizeof(map_disk_part_t));
+    disk->buffer = __map_alloc(map, DISK_BUFFER_SIZE);
+    if (disk->path == NULL || disk->parts == NULL || disk->buffer == NULL) {
+        __map_free(map, disk->path, disk->path_capacity);
+        __map_free(map, disk->parts, options->partitions * sizeof(map_disk_part_t));
+        __map_free(map, disk->buffer, DISK_BUFFER_SIZE);
+        __map_free(map, disk, sizeof(map_disk_t));
+        return MAP_ERR_NO_MEM;
+    }
+    disk->buffer_capacity = DISK_BUFFER_SIZE;
+
+    strcpy(disk->path, options->dir);
+    strcat(disk->path, DISK_DIR_TEMPLATE);
+    if (mkdtemp(disk->path) == NULL) {
+        __map_free(map, disk->path, disk->path_capacity);
+        __map_free(map, disk->parts, options->partitions * sizeof(map_disk_part_t));
+        __map_free(map, disk->buffer, DISK_BUFFER_SIZE);
+        __map_free(map, disk, sizeof(map_disk_t));
+        return MAP_ERR_IO;
+    }
+    disk->options.dir = NULL; // Not kept; path has the map's own directory.
+    for (uint32_t i = 0; i < options->partitions; i++) disk->parts[i].resident = 1;
+
+    map->disk = disk;
+    map->num_buckets = options->partitions;
+    return MAP_OK;
+}
+
+map_error_t __map_disk_prepare(map_t *map, const map_disk_options_t *options) {
+    return disk_setup(map, options);
+}
+
+// Init Function. The storage was set up by __map_disk_prepare().
+static map_error_t disk_init(map_t *map) {
+    return map->disk != NULL ? MAP_OK : MAP_ERR_INVALID_ARG;
+}
+
+// Destroy Function. Removes the files and the directory.
+static void disk_destroy(map_t *map) {
+    map_disk_t *disk = map->disk;
+    if (disk == NULL) return;
+    for (size_t i = 0; i < map->num_buckets; i++) {
+        map_disk_part_t *part = &disk->parts[i];
+        if (part->resident) disk_drop(map, part);
+        if (part->file_bytes != 0) unlink(disk_file(disk, i));
+    }
+    disk->path[disk->dir_length] = '\0';
+    rmdir(disk->path);
+
+    __map_free(map, disk->path, disk->path_capacity);
+    __map_free(map, disk->parts, map->num_buckets * sizeof(map_disk_part_t));
+    __map_free(map, disk->buffer, disk->buffer_capacity);
+    __map_free(map, disk, sizeof(map_disk_t));
+    map->disk = NULL;
+}
+
+// Copy src's file for partition i into dst's directory.
+static map_error_t disk_copy_file(const map_t *src, map_t *dst, size_t i) {
+    size_t size = src->disk->parts[i].file_bytes;
+    int in = open(disk_file(src->disk, i), O_RDONLY);
+    if (in < 0) return MAP_ERR_IO;
+    void *mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, in, 0);
+    close(in);
+    if (mapped == MAP_FAILED) return MAP_ERR_IO;
+    posix_madvise(mapped, size, POSIX_MADV_SEQUENTIAL);
+
+    map_error_t result = MAP_ERR_IO;
+    int out = open(disk_file(dst->disk, i), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (out >= 0) {
+        result = disk_write_all(out, mapped, size);
+        if (close(out) != 0 && result == MAP_OK) result = MAP_ERR_IO;
+    }
+    munmap(mapped, size);
+    if (result != MAP_OK) return result;
+
+    dst->disk->parts[i].file_bytes = size;
+    dst->disk->stats.bytes_read += size;
+    dst->disk->stats.bytes_written += size;
+    return MAP_OK;
+}
+
+// Clone Function. Spilled partitions are copied file to file, without
+// decoding; resident ones are cloned entry by entry, then spilled as
+// needed to fit the copy's budget. Single-threaded.
+static map_error_t disk_clone(const map_t *src, map_t *dst, int nthreads) {
+    (void)nthreads;
+
+    // The copy gets its own directory next to src's.
+    size_t parent_length = src->disk->dir_length - strlen(DISK_DIR_TEMPLATE);
+    char *parent = malloc(parent_length + 1);
+    if (parent == NULL) return MAP_ERR_NO_MEM;
+    memcpy(parent, src->disk->path, parent_length);
+    parent[parent_length] = '\0';
+    map_disk_options_t options = src->disk->options;
+    options.dir = parent;
+    map_error_t result = disk_setup(dst, &options);
+    free(parent);
+    if (result != MAP_OK) return result;
+
+    for (size_t i = 0; i < src->num_buckets && result == MAP_OK; i++) {
+        const map_disk_part_t *from = &src->disk->parts[i];
+        map_disk_part_t *to = &dst->disk->parts[i];
+        if (!from->resident) {
+            if (from->file_bytes != 0) result = disk_copy_file(src, dst, i);
+            to->used = from->used;
+            to->live = from->live;
+            to->resident = 0;
+            continue;
+        }
+        for (uint32_t pos = 0; pos < from->used && result == MAP_OK; pos++) {
+            const map_disk_entry_t *entry = &from->entries[pos];
+            if (entry->key == NULL) continue;
+            void *key = src->usr_key_clone(entry->key);
+            void *value = key != NULL ? src->usr_value_clone(entry->value) : NULL;
+            result = value != NULL ? disk_append(dst, to, entry->hash, key, value)
+                                   : MAP_ERR_NO_MEM;
+            if (result != MAP_OK) {
+                if (key != NULL) dst->usr_free_key(key);
+                if (value != NULL) dst->usr_free_value(value);
+            }
+        }
+        to->last_use = from->last_use;
+        if (result == MAP_OK) result = disk_fit(dst, dst->num_buckets);
+    }
+    dst->disk->clock = src->disk->clock;
+
+    if (result != MAP_OK) disk_destroy(dst);
+    return result;
+}
+
+// Insert Function
+static map_error_t disk_insert(map_t *map, void *key, void *value) {
+    uint64_t hash = disk_hash(map, key);
+    size_t i = disk_part_of(map, hash);
+    map_error_t result = disk_use(map, i);
+    if (result != MAP_OK) return result;
+
+    // Key exists, update value in place.
+    map_disk_part_t *part = &map->disk->parts[i];
+    uint32_t at = disk_find(map, part, key, hash, NULL);
+    if (at != 0) {
+        map_disk_entry_t *entry = &part->entries[at - 1];
+        void *new_value = map->usr_value_clone(value);
+        if (new_value == NULL) return MAP_ERR_NO_MEM;
+        map->usr_free_value(entry->value);
+        entry->value = new_value;
+
+        size_t bytes = disk_charge(map, entry->key, new_value);
+        part->bytes = part->bytes - entry->bytes + bytes;
+        map->disk->stats.resident_bytes = map->disk->stats.resident_bytes - entry->bytes + bytes;
+        entry->bytes = bytes;
+        part->dirty = 1;
+        return MAP_OK;
+    }
+
+    void *new_key = map->usr_key_clone(key);
+    if (new_key == NULL) return MAP_ERR_NO_MEM;
+    void *new_value = map->usr_value_clone(value);
+    if (new_value == NULL) {
+        map->usr_free_key(new_key);
+        return MAP_ERR_NO_MEM;
+    }
+    result = disk_append(map, part, hash, new_key, new_value);
+    if (result != MAP_OK) {
+        map->usr_free_key(new_key);
+        map->usr_free_value(new_value);
+        return result;
+    }
+    map->num_entries++;
+    return MAP_OK;
+}
+
+// Get Function
+static map_error_t disk_get(const map_t *map, void *key, void **out_value) {
+    uint64_t hash = disk_hash(map, key);
+    size_t i = disk_part_of(map, hash);
+    if (map->disk->parts[i].live == 0) return MAP_ERR_NOT_FOUND; // No need to fault it in.
+    map_error_t result = disk_use(map, i);
+    if (result != MAP_OK) return result;
+
+    const map_disk_part_t *part = &map->disk->parts[i];
+    uint32_t at = disk_find(map, part, key, hash, NULL);
+    if (at == 0) return MAP_ERR_NOT_FOUND;
+    *out_value = part->entries[at - 1].value;
+    return MAP_OK;
+}
+
+// Remove Function
+static map_error_t disk_remove(map_t *map, void *key) {
+    uint64_t hash = disk_hash(map, key);
+    size_t i = disk_part_of(map, hash);
+    if (map->disk->parts[i].live == 0) return MAP_ERR_NOT_FOUND;
+    map_error_t result = disk_use(map, i);
+    if (result != MAP_OK) return result;
+
+    map_disk_part_t *part = &map->disk->parts[i];
+    uint32_t at = disk_find(map, part, key, hash, NULL);
+    if (at == 0) return MAP_ERR_NOT_FOUND;
+    disk_remove_at(map, part, at - 1);
+    disk_compact_if_sparse(map, part);
+    return MAP_OK;
+}
+
+// Iterator Start Function. current_bucket is the partition and
+// current_slot the next position in it.
+static map_error_t disk_iter_start(const map_t *map, map_iterator_t *iter) {
+    iter->current_bucket = 0;
+    iter->current_slot = 0;
+    iter->current_element = NULL;
+    return map->num_entries > 0 ? MAP_OK : MAP_ERR_END_OF_MAP;
+}
+
+// Iterator Next Function. Partitions are read whole and in order; one that
+// has been walked is the first to be spilled again.
+static map_error_t disk_iter_next(const map_t *map, map_iterator_t *iter,
+                                  void **out_key, void **out_value) {
+    while (iter->current_bucket < map->num_buckets) {
+        map_disk_part_t *part = &map->disk->parts[iter->current_bucket];
+        if (part->live > 0 && iter->current_slot < part->used) {
+            map_error_t result = disk_use(map, iter->current_bucket);
+            if (result != MAP_OK) return result;
+            while (iter->current_slot < part->used) {
+                const map_disk_entry_t *entry = &part->entries[iter->current_slot++];
+                if (entry->key != NULL) {
+                    *out_key = entry->key;
+                    *out_value = entry->value;
+                    return MAP_OK;
+                }
+            }
+        }
+        part->last_use = 0;
+        iter->current_bucket++;
+        iter->current_slot = 0;
+    }
+    return MAP_ERR_END_OF_MAP;
+}
+
+// Iterator Remove Function. The entry is the one before current_slot;
+// positions survive spills.
+static map_error_t disk_iter_remove(map_t *map, map_iterator_t *iter) {
+    if (iter->current_slot == 0 || iter->current_bucket >= map->num_buckets) {
+        return MAP_ERR_NOT_FOUND;
+    }
+    map_disk_part_t *part = &map->disk->parts[iter->current_bucket];
+    uint32_t pos = (uint32_t)iter->current_slot - 1;
+    if (pos >= part->used || part->live == 0) return MAP_ERR_NOT_FOUND;
+    map_error_t result = disk_use(map, iter->current_bucket);
+    if (result != MAP_OK) return result;
+    if (part->entries[pos].key == NULL) return MAP_ERR_NOT_FOUND;
+    if (map->wal != NULL) {
+        result = __map_wal_append(map, MAP_WAL_REMOVE, part->entries[pos].key, NULL);
+        if (result != MAP_OK) return result;
+    }
+
+    disk_remove_at(map, part, pos);
+    return MAP_OK;
+}
+
+// Shrink Function. Compacts the resident partitions map_iter_remove()
+// left mostly dead.
+static void disk_shrink(map_t *map) {
+    for (size_t i = 0; i < map->num_buckets; i++) {
+        disk_compact_if_sparse(map, &map->disk->parts[i]);
+    }
+}
+
+// Print Function
+static map_error_t disk_print(const map_t *map) {
+    printf("Map contents:\n");
+    for (size_t i = 0; i < map->num_buckets; i++) {
+        const map_disk_part_t *part = &map->disk->parts[i];
+        if (part->live == 0) continue;
+        printf("Buckets %zu: ", i);
+        map_error_t result = disk_use(map, i);
+        if (result != MAP_OK) return result;
+        for (uint32_t pos = 0; pos < part->used && part->entries != NULL; pos++) {
+            const map_disk_entry_t *entry = &part->entries[pos];
+            if (entry->key == NULL) continue;
+            char *entry_str = map->usr_stringify(entry->key, entry->value);
+            if (entry_str == NULL) return MAP_ERR_UNKNOWN;
+            printf("%s", entry_str);
+            free(entry_str);
+        }
+        printf("\n");
+    }
+    return MAP_OK;
+}
+
+const map_engine_ops_t __map_disk_ops = {
+    disk_init,
+    disk_destroy,
+    disk_clone,
+    disk_insert,
+    disk_get,
+    disk_remove,
+    disk_iter_start,
+    disk_iter_next,
+    disk_iter_remove,
+    disk_shrink,
+    disk_print,
+};
+
+// Disk Options Init Function
+void map_disk_options_init(map_disk_options_t *options) {
+    if (options == NULL) return;
+    options->dir = NULL;
+    options->ram_budget = DISK_DEFAULT_BUDGET;
+    options->partitions = DISK_DEFAULT_PARTITIONS;
+    options->encode_key = NULL;
+    options->decode_key = NULL;
+    options->encode_value = NULL;
+    options->decode_value = NULL;
+}
+
+// Disk Stats Function
+map_error_t map_disk_stats(const map_t *map, map_disk_stats_t *stats) {
+    if (map == NULL || stats == NULL || map->disk == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    *stats = map->disk->stats;
+    stats->resident_partitions = 0;
+    for (size_t i = 0; i < map->num_buckets; i++) {
+        stats->resident_partitions += map->disk->parts[i].resident;
+    }
+    return MAP_OK;
+}
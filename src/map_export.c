@@ -0,0 +1,315 @@
+#define _POSIX_C_SOURCE 200809L
+#include <map.h>
+#include <map_internal.h>
+#include <pthread.h>
+
+// Bulk export. Each worker encodes an entry's key and value into its
+// scratch space, formats the entry into its output buffer and hands the
+// buffer to write when the next entry doesn't fit. Both only ever grow,
+// for an entry bigger than they are. JSON entries are formatted with a
+// leading comma, dropped from the first chunk written.
+
+#define EXPORT_DEFAULT_BUFFER ((size_t)1024 * 1024)
+#define EXPORT_SCRATCH_SIZE 256
+#define EXPORT_RECORD_HEADER 8
+#define EXPORT_BATCH 32
+#define EXPORT_PREFETCH_AHEAD 16 // Buckets whose first node is prefetched early.
+
+typedef struct {
+    const map_t *map;
+    const map_export_options_t *options;
+    pthread_mutex_t lock;   // Serializes write and guards the fields below.
+    int wrote;              // A chunk of entries has been written.
+    map_error_t result;     // First failure; the other workers stop at their next flush.
+} export_job_t;
+
+typedef struct {
+    export_job_t *job;
+    uint8_t *out;
+    size_t out_len;
+    size_t out_cap;
+    uint8_t *scratch;       // Encoded key, then encoded value.
+    size_t scratch_cap;
+} export_worker_t;
+
+static map_error_t export_flush(export_worker_t *w) {
+    export_job_t *job = w->job;
+    if (w->out_len == 0) return MAP_OK;
+
+    pthread_mutex_lock(&job->lock);
+    map_error_t result = job->result;
+    if (result == MAP_OK) {
+        size_t skip = job->options->format == MAP_EXPORT_JSON && !job->wrote;
+        result = job->options->write(job->options->write_ctx, w->out + skip, w->out_len - skip);
+        job->wrote = 1;
+        if (result != MAP_OK) job->result = result;
+    }
+    pthread_mutex_unlock(&job->lock);
+    w->out_len = 0;
+    return result;
+}
+
+// Make room for n more bytes of output.
+static map_error_t export_reserve(export_worker_t *w, size_t n) {
+    if (w->out_len + n <= w->out_cap) return MAP_OK;
+    map_error_t result = export_flush(w);
+    if (result != MAP_OK || n <= w->out_cap) return result;
+
+    uint8_t *grown = realloc(w->out, n);
+    if (grown == NULL) return MAP_ERR_NO_MEM;
+    w->out = grown;
+    w->out_cap = n;
+    return MAP_OK;
+}
+
+static void export_put(export_worker_t *w, const void *data, size_t len) {
+    memcpy(w->out + w->out_len, data, len);
+    w->out_len += len;
+}
+
+static size_t export_string_key(void *key, uint8_t *buf, size_t cap) {
+    size_t len = strlen((const char *)key);
+    if (len <= cap) memcpy(buf, key, len);
+    return len;
+}
+
+// Encode obj into the scratch space after its first `at` bytes.
+static map_error_t export_encode(export_worker_t *w, size_t at,
+                                 size_t (*encode)(void *obj, uint8_t *buf, size_t cap),
+                                 void *obj, size_t *out_len) {
+    size_t cap = w->scratch_cap - at;
+    size_t len = encode(obj, cap > 0 ? w->scratch + at : NULL, cap);
+    if (len > cap) {
+        cap = w->scratch_cap;
+        while (cap - at < len) {
+            if (cap > SIZE_MAX / 2) return MAP_ERR_OVERFLOW;
+            cap *= 2;
+        }
+        uint8_t *grown = realloc(w->scratch, cap);
+        if (grown == NULL) return MAP_ERR_NO_MEM;
+        w->scratch = grown;
+        w->scratch_cap = cap;
+        len = encode(obj, w->scratch + at, w->scratch_cap - at);
+    }
+    *out_len = len;
+    return MAP_OK;
+}
+
+// Bytes a field takes once quoted and escaped.
+static size_t export_text_size(map_export_format_t format, const uint8_t *data, size_t len) {
+    size_t size = 2;
+    int quote = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = data[i];
+        if (format == MAP_EXPORT_CSV) {
+            quote |= c == ',' || c == '"' || c == '\n' || c == '\r';
+            size += c == '"' ? 2 : 1;
+        } else if (c == '"' || c == '\\' || c == '\n' || c == '\r' || c == '\t') {
+            size += 2;
+        } else {
+            size += c < 0x20 ? 6 : 1; // \u00XX
+        }
+    }
+    return format == MAP_EXPORT_CSV && !quote ? len : size;
+}
+
+// Write a field sized by export_text_size().
+static void export_text(export_worker_t *w, map_export_format_t format, const uint8_t *data,
+                        size_t len, size_t size) {
+    static const char hex[] = "0123456789abcdef";
+    if (size == len) {
+        export_put(w, data, len); // CSV that needs no quotes.
+        return;
+    }
+
+    uint8_t *out = w->out + w->out_len;
+    *out++ = '"';
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = data[i];
+        if (format == MAP_EXPORT_CSV) {
+            if (c == '"') *out++ = '"';
+            *out++ = c;
+        } else if (c == '"' || c == '\\') {
+            *out++ = '\\';
+            *out++ = c;
+        } else if (c == '\n' || c == '\r' || c == '\t') {
+            *out++ = '\\';
+            *out++ = c == '\n' ? 'n' : c == '\r' ? 'r' : 't';
+        } else if (c < 0x20) {
+            memcpy(out, "\\u00", 4);
+            out[4] = (uint8_t)hex[c >> 4];
+            out[5] = (uint8_t)hex[c & 15];
+            out += 6;
+        } else {
+            *out++ = c;
+        }
+    }
+    *out++ = '"';
+    w->out_len = (size_t)(out - w->out);
+}
+
+static map_error_t export_entry(export_worker_t *w, void *key, void *value) {
+    const map_export_options_t *options = w->job->options;
+    size_t (*encode_key)(void *, uint8_t *, size_t) =
+        options->encode_key != NULL ? options->encode_key : export_string_key;
+    size_t key_len, value_len;
+    map_error_t result = export_encode(w, 0, encode_key, key, &key_len);
+    if (result == MAP_OK) {
+        result = export_encode(w, key_len, options->encode_value, value, &value_len);
+    }
+    if (result != MAP_OK) return result;
+    const uint8_t *key_bytes = w->scratch, *value_bytes = w->scratch + key_len;
+
+    if (options->format == MAP_EXPORT_BINARY) {
+        if (key_len > UINT32_MAX || value_len > UINT32_MAX) return MAP_ERR_OVERFLOW;
+        result = export_reserve(w, EXPORT_RECORD_HEADER + key_len + value_len);
+        if (result != MAP_OK) return result;
+        uint32_t header[2] = {(uint32_t)key_len, (uint32_t)value_len};
+        export_put(w, header, EXPORT_RECORD_HEADER);
+        export_put(w, key_bytes, key_len);
+        export_put(w, value_bytes, value_len);
+        return MAP_OK;
+    }
+
+    // CSV: key,value\n. JSON: ,\n"key":"value".
+    size_t key_size = export_text_size(options->format, key_bytes, key_len);
+    size_t value_size = export_text_size(options->format, value_bytes, value_len);
+    result = export_reserve(w, key_size + value_size + 3);
+    if (result != MAP_OK) return result;
+    if (options->format == MAP_EXPORT_JSON) export_put(w, ",\n", 2);
+    export_text(w, options->format, key_bytes, key_len, key_size);
+    export_put(w, options->format == MAP_EXPORT_JSON ? ":" : ",", 1);
+    export_text(w, options->format, value_bytes, value_len, value_size);
+    if (options->format == MAP_EXPORT_CSV) export_put(w, "\n", 1);
+    return MAP_OK;
+}
+
+static map_error_t export_worker_init(export_worker_t *w, export_job_t *job) {
+    w->job = job;
+    w->out_len = 0;
+    w->out_cap = job->options->buffer_size > 0 ? job->options->buffer_size
+                                               : EXPORT_DEFAULT_BUFFER;
+    w->out = malloc(w->out_cap);
+    w->scratch_cap = EXPORT_SCRATCH_SIZE;
+    w->scratch = malloc(w->scratch_cap);
+    if (w->out == NULL || w->scratch == NULL) {
+        free(w->out);
+        free(w->scratch);
+        return MAP_ERR_NO_MEM;
+    }
+    return MAP_OK;
+}
+
+// Flush what's left unless the export failed, and free the buffers.
+static map_error_t export_worker_finish(export_worker_t *w, map_error_t result) {
+    if (result == MAP_OK) result = export_flush(w);
+    free(w->out);
+    free(w->scratch);
+    return result;
+}
+
+static map_error_t export_batch(export_worker_t *w, map_element_t *const *batch, size_t count) {
+    map_error_t result = MAP_OK;
+    for (size_t b = 0; b < count && result == MAP_OK; b++) {
+        result = export_entry(w, batch[b]->_key, batch[b]->_value);
+    }
+    return result;
+}
+
+// Export the chains of buckets [begin, end).
+static map_error_t export_chains(void *ctx, int worker, size_t begin, size_t end) {
+    export_job_t *job = (export_job_t *)ctx;
+    export_worker_t w;
+    (void)worker;
+    map_error_t result = export_worker_init(&w, job);
+    if (result != MAP_OK) return result;
+
+    // Nodes are gathered EXPORT_BATCH at a time, prefetching their keys
+    // and values, so the cache misses overlap instead of stalling each
+    // entry in turn.
+    map_element_t *batch[EXPORT_BATCH];
+    size_t count = 0;
+    for (size_t i = begin; i < end && result == MAP_OK; i++) {
+        if (i + EXPORT_PREFETCH_AHEAD < end) {
+            __map_prefetch(job->map->buckets[i + EXPORT_PREFETCH_AHEAD]);
+        }
+        for (map_element_t *node = job->map->buckets[i]; node != NULL && result == MAP_OK;
+             node = node->_next) {
+            __map_prefetch(node->_key);
+            __map_prefetch(node->_value);
+            batch[count++] = node;
+            if (count == EXPORT_BATCH) {
+                result = export_batch(&w, batch, count);
+                count = 0;
+            }
+        }
+    }
+    if (result == MAP_OK) result = export_batch(&w, batch, count);
+    return export_worker_finish(&w, result);
+}
+
+static map_error_t export_iterate(export_job_t *job) {
+    export_worker_t w;
+    map_error_t result = export_worker_init(&w, job);
+    if (result != MAP_OK) return result;
+
+    map_iterator_t iter;
+    void *key, *value;
+    if (map_iter_start(job->map, &iter) == MAP_OK) {
+        while (result == MAP_OK && map_iter_next(job->map, &iter, &key, &value) == MAP_OK) {
+            result = export_entry(&w, key, value);
+        }
+        if (result != MAP_OK) map_iter_end(job->map, &iter);
+    }
+    return export_worker_finish(&w, result);
+}
+
+// Export Options Init Function
+void map_export_options_init(map_export_options_t *options) {
+    memset(options, 0, sizeof(*options));
+    options->format = MAP_EXPORT_CSV;
+    options->buffer_size = EXPORT_DEFAULT_BUFFER;
+}
+
+// Export Function
+map_error_t map_export(const map_t *map, const map_export_options_t *options, int nthreads) {
+    if (map == NULL || options == NULL || options->encode_value == NULL ||
+        options->write == NULL || nthreads < 1 ||
+        (options->encode_key == NULL && map->key_mode != MAP_KEY_STRING) ||
+        (options->format != MAP_EXPORT_CSV && options->format != MAP_EXPORT_JSON &&
+         options->format != MAP_EXPORT_BINARY)) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    export_job_t job;
+    job.map = map;
+    job.options = options;
+    job.wrote = 0;
+    job.result = MAP_OK;
+    if (pthread_mutex_init(&job.lock, NULL) != 0) return MAP_ERR_NO_MEM;
+
+    map_error_t result = MAP_OK;
+    if (options->format == MAP_EXPORT_CSV) {
+        result = options->write(options->write_ctx, (const uint8_t *)"key,value\n", 10);
+    } else if (options->format == MAP_EXPORT_JSON) {
+        result = options->write(options->write_ctx, (const uint8_t *)"{", 1);
+    }
+
+    if (result == MAP_OK && map->ops == NULL) {
+        int workers = __map_parallel_workers(nthreads, map->num_buckets, MAP_PARALLEL_MIN_ITEMS);
+        result = __map_parallel_for(workers, map->num_buckets, export_chains, &job);
+    } else if (result == MAP_OK) {
+        result = export_iterate(&job);
+    }
+
+    if (result == MAP_OK && options->format == MAP_EXPORT_JSON) {
+        result = options->write(options->write_ctx, (const uint8_t *)"\n}\n", 3);
+    }
+    pthread_mutex_destroy(&job.lock);
+    return result;
+}
+
+// Export File Writer Function
+map_error_t map_export_file_writer(void *ctx, const uint8_t *buf, size_t len) {
+    return fwrite(buf, 1, len, (FILE *)ctx) == len ? MAP_OK : MAP_ERR_IO;
+}
@@ -0,0 +1,55 @@
+#include <map.h>
+#include <map_internal.h>
+#include <string.h>
+
+// Negative lookup filter: a blocked counting Bloom filter. A key's hash
+// picks one 64-byte block and MAP_FILTER_PROBES four-bit counters in it, so
+// a lookup costs one cache line, and removes just count back down. The
+// filter is sized for as many entries as the buckets hold before the next
+// grow (num_buckets * max_load_factor), at 8 counters per entry, which
+// lets through roughly 3% of misses; __map_resize() rebuilds it along
+// with the buckets.
+
+#define FILTER_COUNTERS_PER_ENTRY 8
+#define FILTER_BLOCK_COUNTERS 128
+#define FILTER_BLOCK_BYTES (MAP_FILTER_BLOCK_WORDS * sizeof(uint64_t))
+
+// Allocate a zeroed filter of num_blocks (a power of two) blocks. The
+// allocator makes no alignment promise, so the blocks are carved out of a
+// slightly larger allocation.
+static map_error_t filter_alloc(map_t *map, map_filter_t *filter, uint64_t num_blocks) {
+    size_t size = (size_t)num_blocks * FILTER_BLOCK_BYTES + FILTER_BLOCK_BYTES - 1;
+    void *allocation = __map_calloc(map, 1, size);
+    if (allocation == NULL) return MAP_ERR_NO_MEM;
+
+    uintptr_t aligned = ((uintptr_t)allocation + FILTER_BLOCK_BYTES - 1) &
+                        ~(uintptr_t)(FILTER_BLOCK_BYTES - 1);
+    filter->blocks = (uint64_t *)aligned;
+    filter->allocation = allocation;
+    filter->allocation_size = size;
+    filter->mask = num_blocks - 1;
+    return MAP_OK;
+}
+
+// Empty filter sized for a table of num_buckets buckets.
+map_error_t __map_filter_init(map_t *map, map_filter_t *filter, uint64_t num_buckets) {
+    double entries = (double)num_buckets * map->max_load_factor;
+    double counters = entries * FILTER_COUNTERS_PER_ENTRY;
+    uint64_t num_blocks = 1;
+    while (num_blocks * FILTER_BLOCK_COUNTERS < counters && num_blocks < ((uint64_t)1 << 32)) {
+        num_blocks *= 2;
+    }
+    return filter_alloc(map, filter, num_blocks);
+}
+
+map_error_t __map_filter_clone(map_t *dst, const map_filter_t *src) {
+    map_error_t result = filter_alloc(dst, &dst->filter, src->mask + 1);
+    if (result != MAP_OK) return result;
+    memcpy(dst->filter.blocks, src->blocks, (size_t)(src->mask + 1) * FILTER_BLOCK_BYTES);
+    return MAP_OK;
+}
+
+void __map_filter_free(map_t *map, map_filter_t *filter) {
+    __map_free(map, filter->allocation, filter->allocation_size);
+    memset(filter, 0, sizeof(*filter));
+}
@@ -0,0 +1,291 @@
+#include <map.h>
+#include <map_internal.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define MAP_HASH_X86 1
+#endif
+
+// Built-in hash functions. The byte hash is wyhash-like for short inputs
+// and switches to an xxh3-style 8-lane stripe accumulator once the input is
+// long enough for vector code to pay off. The scalar, SSE2 and AVX2 stripe
+// loops perform the same integer operations, so every path returns the same
+// value for the same input.
+
+#define HASH_S0 0xa0761d6478bd642fULL
+#define HASH_S1 0xe7037ed1a0b428dbULL
+#define HASH_S2 0x8ebc6af09c88c6e3ULL
+#define HASH_S3 0x589965cc75374cc3ULL
+#define HASH_PRIME32 0x9E3779B1U
+#define HASH_STRIPE_KEY_STEP 0x9E3779B97F4A7C15ULL
+
+#if defined(__SIZEOF_INT128__)
+__extension__ typedef unsigned __int128 hash_u128_t;
+#endif
+
+// Full 64x64->128 multiply.
+static inline void hash_mul128(uint64_t a, uint64_t b, uint64_t *lo, uint64_t *hi) {
+#if defined(__SIZEOF_INT128__)
+    hash_u128_t r = (hash_u128_t)a * b;
+    *lo = (uint64_t)r;
+    *hi = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t)a, lb = (uint32_t)b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl;
+    *lo = t + (rm1 << 32);
+    c += *lo < t;
+    *hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+// 128-bit product folded back to 64 bits.
+static inline uint64_t hash_mum(uint64_t a, uint64_t b) {
+    uint64_t lo, hi;
+    hash_mul128(a, b, &lo, &hi);
+    return lo ^ hi;
+}
+
+// Unaligned little-endian style loads (native byte order).
+static inline uint64_t hash_r8(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint64_t hash_r4(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint64_t hash_r3(const uint8_t *p, size_t len) {
+    return ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+}
+
+// Per-lane keys for the stripe accumulator, derived from the seed.
+static void hash_stripe_keys(uint64_t seed, uint64_t keys[MAP_HASH_LANES]) {
+    for (int j = 0; j < MAP_HASH_LANES; j++) {
+        keys[j] = __map_mix64(seed + HASH_S2 * (uint64_t)(j + 1));
+    }
+}
+
+// Reference stripe loop. Each stripe of 64 bytes feeds one 64-bit word to
+// each lane; lane keys advance per stripe so stripe order matters, and the
+// accumulators are scrambled every MAP_HASH_STRIPES_PER_BLOCK stripes.
+void __map_hash_stripes_scalar(uint64_t acc[MAP_HASH_LANES], const uint8_t *p,
+                               size_t num_stripes, uint64_t seed) {
+    uint64_t keys[MAP_HASH_LANES];
+    hash_stripe_keys(seed, keys);
+
+    for (size_t s = 0; s < num_stripes; s++, p += MAP_HASH_STRIPE) {
+        for (int j = 0; j < MAP_HASH_LANES; j++) {
+            uint64_t d = hash_r8(p + 8 * j);
+            uint64_t dk = d ^ keys[j];
+            acc[j ^ 1] += d;
+            acc[j] += (dk & 0xffffffffULL) * (dk >> 32);
+            keys[j] += HASH_STRIPE_KEY_STEP;
+        }
+
+        if ((s + 1) % MAP_HASH_STRIPES_PER_BLOCK == 0) {
+            for (int j = 0; j < MAP_HASH_LANES; j++) {
+                acc[j] ^= acc[j] >> 47;
+                acc[j] ^= keys[j];
+                acc[j] *= HASH_PRIME32;
+            }
+        }
+    }
+}
+
+#if defined(MAP_HASH_X86)
+// SSE2 is part of the x86-64 baseline: two lanes per register.
+static void hash_stripes_sse2(uint64_t acc[MAP_HASH_LANES], const uint8_t *p,
+                              size_t num_stripes, uint64_t seed) {
+    uint64_t k[MAP_HASH_LANES];
+    hash_stripe_keys(seed, k);
+
+    __m128i a[4], key[4];
+    for (int r = 0; r < 4; r++) {
+        a[r] = _mm_loadu_si128((const __m128i *)(acc + 2 * r));
+        key[r] = _mm_loadu_si128((const __m128i *)(k + 2 * r));
+    }
+    const __m128i step = _mm_set1_epi64x((long long)HASH_STRIPE_KEY_STEP);
+    const __m128i prime = _mm_set1_epi32((int)HASH_PRIME32);
+
+    for (size_t s = 0; s < num_stripes; s++, p += MAP_HASH_STRIPE) {
+        for (int r = 0; r < 4; r++) {
+            __m128i d = _mm_loadu_si128((const __m128i *)(p + 16 * r));
+            __m128i dk = _mm_xor_si128(d, key[r]);
+            __m128i prod = _mm_mul_epu32(dk, _mm_srli_epi64(dk, 32));
+            __m128i swapped = _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+            a[r] = _mm_add_epi64(a[r], _mm_add_epi64(prod, swapped));
+            key[r] = _mm_add_epi64(key[r], step);
+        }
+
+        if ((s + 1) % MAP_HASH_STRIPES_PER_BLOCK == 0) {
+            for (int r = 0; r < 4; r++) {
+                __m128i x = _mm_xor_si128(a[r], _mm_srli_epi64(a[r], 47));
+                x = _mm_xor_si128(x, key[r]);
+                __m128i lo = _mm_mul_epu32(x, prime);
+                __m128i hi = _mm_mul_epu32(_mm_srli_epi64(x, 32), prime);
+                a[r] = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+            }
+        }
+    }
+
+    for (int r = 0; r < 4; r++) {
+        _mm_storeu_si128((__m128i *)(acc + 2 * r), a[r]);
+    }
+}
+
+// AVX2: four lanes per register, selected at run time.
+__attribute__((target("avx2")))
+static void hash_stripes_avx2(uint64_t acc[MAP_HASH_LANES], const uint8_t *p,
+                              size_t num_stripes, uint64_t seed) {
+    uint64_t k[MAP_HASH_LANES];
+    hash_stripe_keys(seed, k);
+
+    __m256i a[2], key[2];
+    for (int r = 0; r < 2; r++) {
+        a[r] = _mm256_loadu_si256((const __m256i *)(acc + 4 * r));
+        key[r] = _mm256_loadu_si256((const __m256i *)(k + 4 * r));
+    }
+    const __m256i step = _mm256_set1_epi64x((long long)HASH_STRIPE_KEY_STEP);
+    const __m256i prime = _mm256_set1_epi32((int)HASH_PRIME32);
+
+    for (size_t s = 0; s < num_stripes; s++, p += MAP_HASH_STRIPE) {
+        for (int r = 0; r < 2; r++) {
+            __m256i d = _mm256_loadu_si256((const __m256i *)(p + 32 * r));
+            __m256i dk = _mm256_xor_si256(d, key[r]);
+            __m256i prod = _mm256_mul_epu32(dk, _mm256_srli_epi64(dk, 32));
+            __m256i swapped = _mm256_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+            a[r] = _mm256_add_epi64(a[r], _mm256_add_epi64(prod, swapped));
+            key[r] = _mm256_add_epi64(key[r], step);
+        }
+
+        if ((s + 1) % MAP_HASH_STRIPES_PER_BLOCK == 0) {
+            for (int r = 0; r < 2; r++) {
+                __m256i x = _mm256_xor_si256(a[r], _mm256_srli_epi64(a[r], 47));
+                x = _mm256_xor_si256(x, key[r]);
+                __m256i lo = _mm256_mul_epu32(x, prime);
+                __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), prime);
+                a[r] = _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+            }
+        }
+    }
+
+    for (int r = 0; r < 2; r++) {
+        _mm256_storeu_si256((__m256i *)(acc + 4 * r), a[r]);
+    }
+}
+#endif
+
+// Run the fastest stripe loop the CPU supports.
+void __map_hash_stripes(uint64_t acc[MAP_HASH_LANES], const uint8_t *p,
+                        size_t num_stripes, uint64_t seed) {
+#if defined(MAP_HASH_X86)
+    if (__builtin_cpu_supports("avx2")) {
+        hash_stripes_avx2(acc, p, num_stripes, seed);
+    } else {
+        hash_stripes_sse2(acc, p, num_stripes, seed);
+    }
+#else
+    __map_hash_stripes_scalar(acc, p, num_stripes, seed);
+#endif
+}
+
+// Byte hash body; expects a seed already passed through hash_seed().
+static inline uint64_t hash_bytes(const uint8_t *p, size_t len, uint64_t seed) {
+    uint64_t a, b;
+
+    if (len <= 16) {
+        if (len >= 4) {
+            size_t mid = (len >> 3) << 2;
+            a = (hash_r4(p) << 32) | hash_r4(p + mid);
+            b = (hash_r4(p + len - 4) << 32) | hash_r4(p + len - 4 - mid);
+        } else if (len > 0) {
+            a = hash_r3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = len;
+
+        // Long inputs: bulk of the data through the stripe accumulator,
+        // leaving 1..64 bytes for the short-block loop below.
+        if (len > MAP_HASH_LONG_INPUT) {
+            uint64_t acc[MAP_HASH_LANES] = {HASH_S0, HASH_S1, HASH_S2, HASH_S3,
+                                            HASH_S3, HASH_S2, HASH_S1, HASH_S0};
+            size_t num_stripes = (len - 1) / MAP_HASH_STRIPE;
+            __map_hash_stripes(acc, p, num_stripes, seed);
+
+            for (int j = 0; j < MAP_HASH_LANES; j += 2) {
+                seed = hash_mum(acc[j] ^ seed ^ HASH_S1, acc[j + 1] ^ HASH_S2);
+            }
+            p += num_stripes * MAP_HASH_STRIPE;
+            i -= num_stripes * MAP_HASH_STRIPE;
+        }
+
+        while (i > 16) {
+            seed = hash_mum(hash_r8(p) ^ HASH_S1, hash_r8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = hash_r8(p + i - 16);
+        b = hash_r8(p + i - 8);
+    }
+
+    hash_mul128(a ^ HASH_S1, b ^ seed, &a, &b);
+    return hash_mum(a ^ HASH_S0 ^ (uint64_t)len, b ^ HASH_S1);
+}
+
+static inline uint64_t hash_seed(uint64_t seed) {
+    return seed ^ hash_mum(seed ^ HASH_S0, HASH_S1);
+}
+
+// Byte Hash Function
+uint64_t map_hash_bytes(const void *data, size_t len, uint64_t seed) {
+    return hash_bytes((const uint8_t *)data, len, hash_seed(seed));
+}
+
+// String Hash Function
+uint64_t map_hash_str(void *key) {
+    const char *str = (const char *)key;
+    return hash_bytes((const uint8_t *)str, strlen(str), hash_seed(0));
+}
+
+// 32-bit Integer Hash Function (key points to a uint32_t or int)
+uint64_t map_hash_u32(void *key) {
+    uint32_t x;
+    memcpy(&x, key, sizeof(x));
+    uint64_t h = (uint64_t)x * 0x9E3779B97F4A7C15ULL;
+    return h ^ (h >> 32);
+}
+
+// 64-bit Integer Hash Function (key points to a uint64_t)
+uint64_t map_hash_u64(void *key) {
+    uint64_t x;
+    memcpy(&x, key, sizeof(x));
+    return __map_mix64(x);
+}
+
+// Hash Lookup Function
+map_error_t map_hash_from_name(const char *name, uint64_t (**out_hash)(void *key)) {
+    if (name == NULL || out_hash == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    if (strcmp(name, "u32") == 0 || strcmp(name, "int") == 0) {
+        *out_hash = map_hash_u32;
+    } else if (strcmp(name, "u64") == 0) {
+        *out_hash = map_hash_u64;
+    } else if (strcmp(name, "str") == 0) {
+        *out_hash = map_hash_str;
+    } else {
+        return MAP_ERR_NOT_FOUND;
+    }
+
+    return MAP_OK;
+}
@@ -0,0 +1,297 @@
+#define _GNU_SOURCE
+#include <map.h>
+#include <map_internal.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Huge-page allocator. Everything is served from 2MB-aligned anonymous
+// mappings so random lookups walk far fewer TLB entries than with 4K
+// pages. Without Linux, huge pages or NUMA, it quietly degrades to plain
+// mappings (or malloc) with default placement.
+//
+// Size classes stop at 256KB, so a slab holds at least seven blocks of
+// any class; bigger blocks get mappings of their own, which are unmapped
+// as soon as they are freed. Freed class blocks wait on their free list
+// for reuse until the allocator is destroyed.
+
+#define HUGEPAGE_SMALL_CLASSES 16       // 16-byte steps up to 256 bytes.
+#define HUGEPAGE_SMALL_MAX 256
+#define HUGEPAGE_CLASS_MAX (256 * 1024) // Larger blocks get their own mapping.
+#define HUGEPAGE_SLAB_HEADER 16
+#define HUGEPAGE_MAX_NODES 1024
+
+// Linux memory policies, for mbind(2).
+#define HUGEPAGE_MPOL_BIND 2
+#define HUGEPAGE_MPOL_INTERLEAVE 3
+
+static int hugepage_class(size_t size) {
+    if (size <= HUGEPAGE_SMALL_MAX) return size == 0 ? 0 : (int)((size - 1) / 16);
+
+    int c = HUGEPAGE_SMALL_CLASSES;
+    size_t class_size = 2 * HUGEPAGE_SMALL_MAX;
+    while (class_size < size) {
+        class_size <<= 1;
+        c++;
+    }
+    return c;
+}
+
+static size_t hugepage_class_size(int c) {
+    if (c < HUGEPAGE_SMALL_CLASSES) return (size_t)(c + 1) * 16;
+    return (size_t)(2 * HUGEPAGE_SMALL_MAX) << (c - HUGEPAGE_SMALL_CLASSES);
+}
+
+static size_t hugepage_round(size_t size) {
+    return (size + (MAP_HUGE_PAGE_SIZE - 1)) & ~(size_t)(MAP_HUGE_PAGE_SIZE - 1);
+}
+
+// Number of NUMA nodes the kernel reports, 1 when unknown.
+static int hugepage_count_nodes(void) {
+    int nodes = 1;
+#if defined(__linux__)
+    FILE *f = fopen("/sys/devices/system/node/possible", "r");
+    if (f == NULL) return 1;
+
+    // Format is a list of ranges such as "0" or "0-3"; the last id wins.
+    int id = 0, c;
+    while ((c = fgetc(f)) != EOF) {
+        if (c >= '0' && c <= '9') {
+            id = id * 10 + (c - '0');
+        } else {
+            if (id + 1 > nodes) nodes = id + 1;
+            id = 0;
+        }
+    }
+    if (id + 1 > nodes) nodes = id + 1;
+    fclose(f);
+    if (nodes > HUGEPAGE_MAX_NODES) nodes = HUGEPAGE_MAX_NODES;
+#endif
+    return nodes;
+}
+
+// Apply the NUMA policy to a fresh, untouched mapping.
+static void hugepage_place(map_hugepage_t *hp, void *ptr, size_t size) {
+    if (hp->options.numa_policy == MAP_NUMA_DEFAULT || hp->numa_nodes <= 1) return;
+#if defined(__linux__) && defined(SYS_mbind)
+    unsigned long mask[HUGEPAGE_MAX_NODES / (8 * sizeof(unsigned long))];
+    const size_t bits = 8 * sizeof(unsigned long);
+    int mode;
+
+    memset(mask, 0, sizeof(mask));
+    if (hp->options.numa_policy == MAP_NUMA_INTERLEAVE) {
+        mode = HUGEPAGE_MPOL_INTERLEAVE;
+        for (int n = 0; n < hp->numa_nodes; n++) mask[n / bits] |= 1UL << (n % bits);
+    } else {
+        mode = HUGEPAGE_MPOL_BIND;
+        mask[hp->options.numa_node / bits] |= 1UL << (hp->options.numa_node % bits);
+    }
+    if (syscall(SYS_mbind, ptr, size, mode, mask, (unsigned long)hp->numa_nodes + 1, 0) != 0) {
+        hp->numa_failures++;
+    }
+#else
+    (void)ptr;
+    (void)size;
+    hp->numa_failures++;
+#endif
+}
+
+// Map size bytes (a multiple of MAP_HUGE_PAGE_SIZE), 2MB aligned.
+static void *hugepage_map(map_hugepage_t *hp, size_t size) {
+    void *ptr = NULL;
+#if defined(__linux__)
+#ifdef MAP_HUGETLB
+    if (hp->options.explicit_huge_pages) {
+        ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr == MAP_FAILED) {
+            ptr = NULL; // No reserved huge pages; use transparent ones.
+        } else {
+            hp->hugetlb_mappings++;
+        }
+    }
+#endif
+    if (ptr == NULL) {
+        // Over-map by one huge page and trim, so the whole range is aligned
+        // and eligible for transparent huge pages.
+        char *raw = mmap(NULL, size + MAP_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) return NULL;
+
+        uintptr_t aligned = ((uintptr_t)raw + (MAP_HUGE_PAGE_SIZE - 1)) &
+                            ~(uintptr_t)(MAP_HUGE_PAGE_SIZE - 1);
+        size_t head = (size_t)(aligned - (uintptr_t)raw);
+        if (head > 0) munmap(raw, head);
+        if (MAP_HUGE_PAGE_SIZE - head > 0) {
+            munmap((char *)aligned + size, MAP_HUGE_PAGE_SIZE - head);
+        }
+        ptr = (void *)aligned;
+#ifdef MADV_HUGEPAGE
+        madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+    }
+#else
+    ptr = malloc(size);
+    if (ptr == NULL) return NULL;
+#endif
+    hugepage_place(hp, ptr, size);
+    hp->mapped_bytes += size;
+    return ptr;
+}
+
+static void hugepage_unmap(map_hugepage_t *hp, void *ptr, size_t size) {
+#if defined(__linux__)
+    munmap(ptr, size);
+#else
+    free(ptr);
+#endif
+    hp->mapped_bytes -= size;
+}
+
+// Hand what is left of the current slab to the free lists, biggest
+// classes first, so a slab given up for a large class isn't wasted.
+// Every class size is a multiple of 16, so the pieces stay aligned.
+static void hugepage_recycle_tail(map_hugepage_t *hp) {
+    while (hp->slab_cursor != NULL && (size_t)(hp->slab_end - hp->slab_cursor) >= 16) {
+        size_t left = (size_t)(hp->slab_end - hp->slab_cursor);
+        int c = hugepage_class(left);
+        if (hugepage_class_size(c) > left) c--;
+        *(void **)hp->slab_cursor = hp->free_lists[c];
+        hp->free_lists[c] = hp->slab_cursor;
+        hp->slab_cursor += hugepage_class_size(c);
+    }
+}
+
+static void *hugepage_alloc(void *ctx, size_t size) {
+    map_hugepage_t *hp = (map_hugepage_t *)ctx;
+
+    if (size > HUGEPAGE_CLASS_MAX) {
+        size_t mapped = hugepage_round(size);
+        if (mapped < size) return NULL;
+        return hugepage_map(hp, mapped);
+    }
+
+    int c = hugepage_class(size);
+    void *block = hp->free_lists[c];
+    if (block != NULL) {
+        hp->free_lists[c] = *(void **)block;
+        return block;
+    }
+
+    // Carve from the current slab, starting a new one when it runs out.
+    size_t class_size = hugepage_class_size(c);
+    if (hp->slab_cursor == NULL || (size_t)(hp->slab_end - hp->slab_cursor) < class_size) {
+        hugepage_recycle_tail(hp);
+        map_hugepage_slab_t *slab = hugepage_map(hp, MAP_HUGE_PAGE_SIZE);
+        if (slab == NULL) return NULL;
+        slab->next = hp->slabs;
+        hp->slabs = slab;
+        hp->slab_cursor = (char *)slab + HUGEPAGE_SLAB_HEADER;
+        hp->slab_end = (char *)slab + MAP_HUGE_PAGE_SIZE;
+    }
+    block = hp->slab_cursor;
+    hp->slab_cursor += class_size;
+    return block;
+}
+
+static void hugepage_free(void *ctx, void *ptr, size_t size) {
+    map_hugepage_t *hp = (map_hugepage_t *)ctx;
+
+    if (size > HUGEPAGE_CLASS_MAX) {
+        hugepage_unmap(hp, ptr, hugepage_round(size));
+        return;
+    }
+
+    int c = hugepage_class(size);
+    *(void **)ptr = hp->free_lists[c];
+    hp->free_lists[c] = ptr;
+}
+
+static void *hugepage_realloc(void *ctx, void *ptr, size_t old_size, size_t new_size) {
+    if (ptr == NULL) return hugepage_alloc(ctx, new_size);
+
+    // Blocks already big enough stay where they are.
+    if (old_size <= HUGEPAGE_CLASS_MAX && new_size <= HUGEPAGE_CLASS_MAX &&
+        hugepage_class(old_size) == hugepage_class(new_size)) {
+        return ptr;
+    }
+    if (old_size > HUGEPAGE_CLASS_MAX && new_size > HUGEPAGE_CLASS_MAX &&
+        hugepage_round(old_size) == hugepage_round(new_size)) {
+        return ptr;
+    }
+
+    void *moved = hugepage_alloc(ctx, new_size);
+    if (moved == NULL) return NULL;
+    memcpy(moved, ptr, old_size < new_size ? old_size : new_size);
+    hugepage_free(ctx, ptr, old_size);
+    return moved;
+}
+
+// Hugepage Options Init Function
+void map_hugepage_options_init(map_hugepage_options_t *options) {
+    if (options == NULL) return;
+    options->explicit_huge_pages = 0;
+    options->numa_policy = MAP_NUMA_DEFAULT;
+    options->numa_node = 0;
+}
+
+// Hugepage Create Function
+map_error_t map_hugepage_create(map_hugepage_t **hp, const map_hugepage_options_t *options) {
+    map_hugepage_options_t defaults;
+    if (options == NULL) {
+        map_hugepage_options_init(&defaults);
+        options = &defaults;
+    }
+    if (hp == NULL || options->numa_policy < MAP_NUMA_DEFAULT ||
+        options->numa_policy > MAP_NUMA_BIND) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    int numa_nodes = hugepage_count_nodes();
+    if (options->numa_policy == MAP_NUMA_BIND &&
+        (options->numa_node < 0 || options->numa_node >= numa_nodes)) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    *hp = calloc(1, sizeof(map_hugepage_t));
+    if (*hp == NULL) {
+        return MAP_ERR_NO_MEM;
+    }
+    (*hp)->options = *options;
+    (*hp)->numa_nodes = numa_nodes;
+    return MAP_OK;
+}
+
+// Hugepage Allocator Function
+map_error_t map_hugepage_allocator(map_hugepage_t *hp, map_allocator_t *out) {
+    if (hp == NULL || out == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    out->alloc = hugepage_alloc;
+    out->realloc = hugepage_realloc;
+    out->free = hugepage_free;
+    out->ctx = hp;
+    return MAP_OK;
+}
+
+// Hugepage Destroy Function
+map_error_t map_hugepage_destroy(map_hugepage_t **hp) {
+    if (hp == NULL || *hp == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    map_hugepage_slab_t *slab = (*hp)->slabs;
+    while (slab != NULL) {
+        map_hugepage_slab_t *next = slab->next;
+        hugepage_unmap(*hp, slab, MAP_HUGE_PAGE_SIZE);
+        slab = next;
+    }
+    free(*hp);
+    *hp = NULL;
+    return MAP_OK;
+}
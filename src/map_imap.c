@@ -0,0 +1,271 @@
+#include <map.h>
+#include <map_internal.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Integer map. A key's home slot is the top bits of its mixed value and
+// probing is linear, four slots at a time where they don't wrap around the
+// end of the table. Keys and values are interleaved: a lookup pays for one
+// cache miss rather than one per array. Removing a key leaves MAP_IMAP_DELETED in its slot, so
+// probes carry on past it and iterators never see entries move; inserts
+// reuse those slots, and a rehash (at the same capacity, when enough of
+// them pile up) clears them. The keys that double as markers live in
+// has_side/side_values instead of a slot.
+
+#define IMAP_MIN_CAPACITY 8
+#define IMAP_GROUP 4
+#define IMAP_MAX_LOAD_NUM 3 // Used slots stay at or below 3/4 of capacity.
+#define IMAP_MAX_LOAD_DEN 4
+
+static int imap_side(uint64_t key) {
+    return key == MAP_IMAP_EMPTY ? 0 : key == MAP_IMAP_DELETED ? 1 : -1;
+}
+
+static size_t imap_home(const map_imap_t *imap, uint64_t key) {
+    return (size_t)(__map_mix64(key) >> imap->shift);
+}
+
+// Bitmasks of the IMAP_GROUP slots from slots: bit j set in *match when
+// slots[j] holds key, and in *empty when slots[j] is empty.
+static void imap_group(const map_imap_slot_t *slots, uint64_t key, unsigned *match,
+                       unsigned *empty) {
+#if defined(__SSE2__)
+    // Gather the four keys, then compare them. There is no 64-bit compare
+    // in SSE2: both 32-bit halves must be equal.
+    __m128i lo = _mm_unpacklo_epi64(_mm_loadu_si128((const __m128i *)&slots[0]),
+                                    _mm_loadu_si128((const __m128i *)&slots[1]));
+    __m128i hi = _mm_unpacklo_epi64(_mm_loadu_si128((const __m128i *)&slots[2]),
+                                    _mm_loadu_si128((const __m128i *)&slots[3]));
+    __m128i k = _mm_set1_epi64x((long long)key);
+    __m128i zero = _mm_setzero_si128();
+    __m128i m_lo = _mm_cmpeq_epi32(lo, k), m_hi = _mm_cmpeq_epi32(hi, k);
+    __m128i e_lo = _mm_cmpeq_epi32(lo, zero), e_hi = _mm_cmpeq_epi32(hi, zero);
+    m_lo = _mm_and_si128(m_lo, _mm_shuffle_epi32(m_lo, _MM_SHUFFLE(2, 3, 0, 1)));
+    m_hi = _mm_and_si128(m_hi, _mm_shuffle_epi32(m_hi, _MM_SHUFFLE(2, 3, 0, 1)));
+    e_lo = _mm_and_si128(e_lo, _mm_shuffle_epi32(e_lo, _MM_SHUFFLE(2, 3, 0, 1)));
+    e_hi = _mm_and_si128(e_hi, _mm_shuffle_epi32(e_hi, _MM_SHUFFLE(2, 3, 0, 1)));
+    *match = (unsigned)_mm_movemask_pd(_mm_castsi128_pd(m_lo)) |
+             (unsigned)_mm_movemask_pd(_mm_castsi128_pd(m_hi)) << 2;
+    *empty = (unsigned)_mm_movemask_pd(_mm_castsi128_pd(e_lo)) |
+             (unsigned)_mm_movemask_pd(_mm_castsi128_pd(e_hi)) << 2;
+#else
+    *match = 0;
+    *empty = 0;
+    for (int j = 0; j < IMAP_GROUP; j++) {
+        if (slots[j].key == key) *match |= 1u << j;
+        if (slots[j].key == MAP_IMAP_EMPTY) *empty |= 1u << j;
+    }
+#endif
+}
+
+// Slot holding key (a slotted one, not a marker), or SIZE_MAX. With
+// out_free set, also where it would be inserted: the first deleted slot
+// on its probe path, or else the empty slot that ends it.
+static size_t imap_find(const map_imap_t *imap, uint64_t key, size_t *out_free) {
+    size_t mask = imap->capacity - 1;
+    size_t free_slot = SIZE_MAX;
+    for (size_t i = imap_home(imap, key);;) {
+        if (i + IMAP_GROUP <= imap->capacity) {
+            unsigned match, empty;
+            imap_group(imap->slots + i, key, &match, &empty);
+            if (match != 0) return i + (size_t)__builtin_ctz(match);
+            unsigned end = empty != 0 ? (unsigned)__builtin_ctz(empty) : IMAP_GROUP;
+            if (out_free != NULL && free_slot == SIZE_MAX) {
+                for (unsigned j = 0; j < end; j++) {
+                    if (imap->slots[i + j].key == MAP_IMAP_DELETED) {
+                        free_slot = i + j;
+                        break;
+                    }
+                }
+            }
+            if (empty != 0) {
+                if (out_free != NULL) *out_free = free_slot != SIZE_MAX ? free_slot : i + end;
+                return SIZE_MAX;
+            }
+            i = (i + IMAP_GROUP) & mask;
+        } else {
+            uint64_t at = imap->slots[i].key;
+            if (at == key) return i;
+            if (at == MAP_IMAP_DELETED && free_slot == SIZE_MAX) free_slot = i;
+            if (at == MAP_IMAP_EMPTY) {
+                if (out_free != NULL) *out_free = free_slot != SIZE_MAX ? free_slot : i;
+                return SIZE_MAX;
+            }
+            i = (i + 1) & mask;
+        }
+    }
+}
+
+// Move every slotted entry into a fresh array of `capacity` slots.
+static map_error_t imap_rehash(map_imap_t *imap, size_t capacity) {
+    map_imap_slot_t *slots = calloc(capacity, sizeof(map_imap_slot_t)); // All MAP_IMAP_EMPTY.
+    if (slots == NULL) return MAP_ERR_NO_MEM;
+
+    map_imap_t fresh = *imap;
+    fresh.slots = slots;
+    fresh.capacity = capacity;
+    fresh.shift = 64;
+    for (size_t c = capacity; c > 1; c >>= 1) fresh.shift--;
+    fresh.used = 0;
+    for (size_t i = 0; i < imap->capacity; i++) {
+        uint64_t key = imap->slots[i].key;
+        if (key == MAP_IMAP_EMPTY || key == MAP_IMAP_DELETED) continue;
+        size_t slot;
+        imap_find(&fresh, key, &slot);
+        slots[slot] = imap->slots[i];
+        fresh.used++;
+    }
+    free(imap->slots);
+    *imap = fresh;
+    imap->epoch++;
+    return MAP_OK;
+}
+
+// Imap Create Function
+map_error_t map_imap_create(map_imap_t **imap, size_t expected) {
+    if (imap == NULL) return MAP_ERR_INVALID_ARG;
+    *imap = NULL;
+    size_t capacity = IMAP_MIN_CAPACITY;
+    while (capacity / IMAP_MAX_LOAD_DEN * IMAP_MAX_LOAD_NUM < expected) {
+        if (capacity > SIZE_MAX / 2 / sizeof(map_imap_slot_t)) return MAP_ERR_OVERFLOW;
+        capacity *= 2;
+    }
+
+    map_imap_t *created = calloc(1, sizeof(map_imap_t));
+    if (created == NULL) return MAP_ERR_NO_MEM;
+    if (imap_rehash(created, capacity) != MAP_OK) {
+        free(created);
+        return MAP_ERR_NO_MEM;
+    }
+    created->epoch = 0;
+    *imap = created;
+    return MAP_OK;
+}
+
+// Imap Destroy Function
+map_error_t map_imap_destroy(map_imap_t **imap) {
+    if (imap == NULL || *imap == NULL) return MAP_ERR_INVALID_ARG;
+    free((*imap)->slots);
+    free(*imap);
+    *imap = NULL;
+    return MAP_OK;
+}
+
+// Imap Insert Function
+map_error_t map_imap_insert(map_imap_t *imap, uint64_t key, uint64_t value) {
+    if (imap == NULL) return MAP_ERR_INVALID_ARG;
+    int side = imap_side(key);
+    if (side >= 0) {
+        imap->size += !imap->has_side[side];
+        imap->has_side[side] = 1;
+        imap->side_values[side] = value;
+        return MAP_OK;
+    }
+
+    size_t slot;
+    size_t at = imap_find(imap, key, &slot);
+    if (at != SIZE_MAX) {
+        imap->slots[at].value = value;
+        return MAP_OK;
+    }
+
+    // Taking an empty slot may push the table past its load; grow if the
+    // live entries need it, else just clear out the deleted slots.
+    if (imap->slots[slot].key == MAP_IMAP_EMPTY &&
+        (imap->used + 1) * IMAP_MAX_LOAD_DEN > imap->capacity * IMAP_MAX_LOAD_NUM) {
+        size_t capacity = imap->capacity;
+        if ((imap->size + 1) * 2 * IMAP_MAX_LOAD_DEN > capacity * IMAP_MAX_LOAD_NUM) {
+            if (capacity > SIZE_MAX / 2 / sizeof(map_imap_slot_t)) return MAP_ERR_OVERFLOW;
+            capacity *= 2;
+        }
+        map_error_t result = imap_rehash(imap, capacity);
+        if (result != MAP_OK) return result;
+        imap_find(imap, key, &slot);
+    }
+
+    imap->used += imap->slots[slot].key == MAP_IMAP_EMPTY;
+    imap->slots[slot].key = key;
+    imap->slots[slot].value = value;
+    imap->size++;
+    return MAP_OK;
+}
+
+// Imap Get Function
+map_error_t map_imap_get(const map_imap_t *imap, uint64_t key, uint64_t *out_value) {
+    if (imap == NULL || out_value == NULL) return MAP_ERR_INVALID_ARG;
+    int side = imap_side(key);
+    if (side >= 0) {
+        if (!imap->has_side[side]) return MAP_ERR_NOT_FOUND;
+        *out_value = imap->side_values[side];
+        return MAP_OK;
+    }
+
+    size_t at = imap_find(imap, key, NULL);
+    if (at == SIZE_MAX) return MAP_ERR_NOT_FOUND;
+    *out_value = imap->slots[at].value;
+    return MAP_OK;
+}
+
+// Imap Remove Function
+map_error_t map_imap_remove(map_imap_t *imap, uint64_t key) {
+    if (imap == NULL) return MAP_ERR_INVALID_ARG;
+    int side = imap_side(key);
+    if (side >= 0) {
+        if (!imap->has_side[side]) return MAP_ERR_NOT_FOUND;
+        imap->has_side[side] = 0;
+        imap->size--;
+        return MAP_OK;
+    }
+
+    size_t at = imap_find(imap, key, NULL);
+    if (at == SIZE_MAX) return MAP_ERR_NOT_FOUND;
+    imap->slots[at].key = MAP_IMAP_DELETED;
+    imap->size--;
+    return MAP_OK;
+}
+
+// Imap Get Size Function
+map_error_t map_imap_get_size(const map_imap_t *imap, size_t *num_elements) {
+    if (imap == NULL || num_elements == NULL) return MAP_ERR_INVALID_ARG;
+    *num_elements = imap->size;
+    return MAP_OK;
+}
+
+// Imap Iterator Start Function. current_bucket is the next slot; the two
+// side entries come after the last one.
+map_error_t map_imap_iter_start(const map_imap_t *imap, map_iterator_t *iter) {
+    if (imap == NULL || iter == NULL) return MAP_ERR_INVALID_ARG;
+    memset(iter, 0, sizeof(*iter));
+    iter->epoch = imap->epoch;
+    return imap->size > 0 ? MAP_OK : MAP_ERR_END_OF_MAP;
+}
+
+// Imap Iterator Next Function
+map_error_t map_imap_iter_next(const map_imap_t *imap, map_iterator_t *iter,
+                               uint64_t *out_key, uint64_t *out_value) {
+    if (imap == NULL || iter == NULL || out_key == NULL || out_value == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+    if (iter->epoch != imap->epoch) return MAP_ERR_STALE_ITERATOR;
+
+    while (iter->current_bucket < imap->capacity) {
+        size_t i = iter->current_bucket++;
+        uint64_t key = imap->slots[i].key;
+        if (key != MAP_IMAP_EMPTY && key != MAP_IMAP_DELETED) {
+            *out_key = key;
+            *out_value = imap->slots[i].value;
+            return MAP_OK;
+        }
+    }
+    while (iter->current_bucket < imap->capacity + 2) {
+        int side = (int)(iter->current_bucket++ - imap->capacity);
+        if (imap->has_side[side]) {
+            *out_key = side == 0 ? MAP_IMAP_EMPTY : MAP_IMAP_DELETED;
+            *out_value = imap->side_values[side];
+            return MAP_OK;
+        }
+    }
+    return MAP_ERR_END_OF_MAP;
+}
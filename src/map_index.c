@@ -0,0 +1,247 @@
+#include <map.h>
+#include <map_internal.h>
+#include <string.h>
+
+// Sorted chain indexes. With a weak usr_hash, colliding keys, or a large
+// max_load_factor, chains can run to hundreds of nodes. Once a chain is
+// MAP_INDEX_BUILD_LENGTH long, its nodes also go into an array of
+// (hash, node) pairs sorted by hash and then by key: usr_compare already
+// returns an ordering, and string keys order by length, then bytes. A
+// lookup is then a binary search that calls usr_compare only for entries
+// with the probe's exact hash, so at most O(log n) times. Only the sign of
+// usr_compare counts, so strcmp() works as is. A usr_compare that only
+// tells equal from unequal is caught when entries of one hash come out of
+// order; the map then drops its indexes for good and walks its chains.
+//
+// The chain itself is left linked as it was, so everything that walks
+// chains without searching them keeps working unchanged. Only code that
+// links or unlinks nodes keeps the index up to date.
+
+static size_t index_bytes(uint32_t capacity) {
+    return sizeof(map_chain_index_t) + (size_t)capacity * sizeof(map_chain_entry_t);
+}
+
+// Order of a stored key against the probe's key, for keys of equal hash.
+static int32_t key_order(const map_t *map, void *stored_key, const map_probe_t *probe) {
+    if (map->key_mode == MAP_KEY_STRING) {
+        size_t length = __map_key_header(stored_key)->length;
+        if (length != probe->length) return length < probe->length ? -1 : 1;
+        int cmp = memcmp(stored_key, probe->key, length);
+        return (cmp > 0) - (cmp < 0);
+    }
+    int32_t cmp = map->usr_compare(stored_key, probe->key);
+    return (cmp > 0) - (cmp < 0);
+}
+
+static map_probe_t stored_probe(const map_t *map, void *stored_key, uint64_t hash) {
+    map_probe_t probe = {stored_key, hash, 0};
+    if (map->key_mode == MAP_KEY_STRING) probe.length = __map_key_header(stored_key)->length;
+    return probe;
+}
+
+// Binary search: MAP_OK with *pos at the match, or MAP_ERR_NOT_FOUND with
+// *pos where the probe would go.
+static map_error_t index_search(const map_t *map, const map_chain_index_t *chain,
+                                const map_probe_t *probe, uint32_t *pos) {
+    uint32_t lo = 0, hi = chain->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const map_chain_entry_t *entry = &chain->entries[mid];
+        int32_t cmp;
+        if (entry->hash != probe->hash) {
+            cmp = entry->hash < probe->hash ? -1 : 1;
+        } else {
+            cmp = key_order(map, entry->node->_key, probe);
+        }
+        if (cmp == 0) {
+            *pos = mid;
+            return MAP_OK;
+        }
+        if (cmp < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    *pos = lo;
+    return MAP_ERR_NOT_FOUND;
+}
+
+static int entry_before(const map_t *map, const map_chain_entry_t *a,
+                        const map_chain_entry_t *b) {
+    if (a->hash != b->hash) return a->hash < b->hash;
+    map_probe_t probe = stored_probe(map, b->node->_key, b->hash);
+    return key_order(map, a->node->_key, &probe) < 0;
+}
+
+// Entries i and i + 1 are strictly ordered (or i + 1 is past the end).
+// Both directions are asked, so a compare that calls every unequal pair
+// "less" is caught too.
+static int entries_ordered(const map_t *map, const map_chain_index_t *chain, uint32_t i) {
+    return i + 1 >= chain->count ||
+           (entry_before(map, &chain->entries[i], &chain->entries[i + 1]) &&
+            !entry_before(map, &chain->entries[i + 1], &chain->entries[i]));
+}
+
+// usr_compare doesn't order keys: stop indexing this map.
+static void index_disable(map_t *map) {
+    __map_index_drop_all(map);
+    map->chain_index_off = 1;
+}
+
+// Bottom-up merge sort of n entries, using scratch of the same size.
+static void sort_entries(const map_t *map, map_chain_entry_t *entries,
+                         map_chain_entry_t *scratch, uint32_t n) {
+    map_chain_entry_t *from = entries, *to = scratch;
+    for (uint32_t width = 1; width < n; width *= 2) {
+        for (uint32_t lo = 0; lo < n; lo += 2 * width) {
+            uint32_t mid = lo + width < n ? lo + width : n;
+            uint32_t hi = lo + 2 * width < n ? lo + 2 * width : n;
+            uint32_t i = lo, j = mid, k = lo;
+            while (i < mid && j < hi) {
+                to[k++] = entry_before(map, &from[j], &from[i]) ? from[j++] : from[i++];
+            }
+            while (i < mid) to[k++] = from[i++];
+            while (j < hi) to[k++] = from[j++];
+        }
+        map_chain_entry_t *swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from != entries) memcpy(entries, from, (size_t)n * sizeof(map_chain_entry_t));
+}
+
+map_error_t __map_index_find(const map_t *map, size_t index, const map_probe_t *probe,
+                             map_element_t **out_node) {
+    const map_chain_index_t *chain = map->chain_index[index];
+    uint32_t pos;
+    map_error_t result = index_search(map, chain, probe, &pos);
+    if (result == MAP_OK) *out_node = chain->entries[pos].node;
+    return result;
+}
+
+map_error_t __map_index_add(map_t *map, size_t index, uint64_t hash, map_element_t *node) {
+    map_chain_index_t *chain = map->chain_index[index];
+    if (chain->count == chain->capacity) {
+        uint32_t capacity = chain->capacity * 2;
+        map_chain_index_t *grown = capacity > chain->capacity ?
+            __map_realloc(map, chain, index_bytes(chain->capacity), index_bytes(capacity)) : NULL;
+        if (grown == NULL) {
+            __map_index_drop(map, index); // The chain still has every node.
+            return MAP_ERR_NO_MEM;
+        }
+        grown->capacity = capacity;
+        map->chain_index[index] = chain = grown;
+    }
+
+    // The node is new, so finding its key means usr_compare can't be trusted.
+    map_probe_t probe = stored_probe(map, node->_key, hash);
+    uint32_t pos;
+    if (index_search(map, chain, &probe, &pos) == MAP_OK) {
+        index_disable(map);
+        return MAP_ERR_UNKNOWN;
+    }
+    memmove(&chain->entries[pos + 1], &chain->entries[pos],
+            (size_t)(chain->count - pos) * sizeof(map_chain_entry_t));
+    chain->entries[pos].hash = hash;
+    chain->entries[pos].node = node;
+    chain->count++;
+    if ((pos > 0 && !entries_ordered(map, chain, pos - 1)) || !entries_ordered(map, chain, pos)) {
+        index_disable(map);
+        return MAP_ERR_UNKNOWN;
+    }
+    return MAP_OK;
+}
+
+// Nodes are found by address, so removing one calls no user function.
+void __map_index_remove(map_t *map, size_t index, map_element_t *node) {
+    map_chain_index_t *chain = __map_index_of(map, index);
+    if (chain == NULL) return;
+    if (chain->count <= MAP_INDEX_DROP_LENGTH) {
+        __map_index_drop(map, index);
+        return;
+    }
+
+    uint32_t pos = 0;
+    while (pos < chain->count && chain->entries[pos].node != node) pos++;
+    if (pos == chain->count) return;
+    chain->count--;
+    memmove(&chain->entries[pos], &chain->entries[pos + 1],
+            (size_t)(chain->count - pos) * sizeof(map_chain_entry_t));
+}
+
+// (Re)build the index of bucket index from its chain. Any old one is
+// dropped first, so callers can use this after replacing a chain's nodes.
+void __map_index_build(map_t *map, size_t index) {
+    __map_index_drop(map, index);
+    if (map->chain_index_off) return;
+
+    size_t length = 0;
+    for (map_element_t *cur = map->buckets[index]; cur != NULL; cur = cur->_next) length++;
+    if (length < MAP_INDEX_BUILD_LENGTH || length > UINT32_MAX / 4) return;
+
+    if (map->chain_index == NULL) {
+        map->chain_index = __map_calloc(map, map->num_buckets,
+                                        sizeof(map_chain_index_t *));
+        if (map->chain_index == NULL) return;
+    }
+
+    uint32_t capacity = (uint32_t)(length + length / 2);
+    map_chain_index_t *chain = __map_alloc(map, index_bytes(capacity));
+    map_chain_entry_t *scratch = __map_alloc(map, length * sizeof(map_chain_entry_t));
+    if (chain == NULL || scratch == NULL) {
+        __map_free(map, chain, index_bytes(capacity));
+        __map_free(map, scratch, length * sizeof(map_chain_entry_t));
+        if (map->num_chain_indexes == 0) {
+            __map_free(map, map->chain_index,
+                       map->num_buckets * sizeof(map_chain_index_t *));
+            map->chain_index = NULL;
+        }
+        return;
+    }
+
+    chain->count = (uint32_t)length;
+    chain->capacity = capacity;
+    map_chain_entry_t *entry = chain->entries;
+    for (map_element_t *cur = map->buckets[index]; cur != NULL; cur = cur->_next, entry++) {
+        entry->hash = __map_stored_hash(map, cur->_key);
+        entry->node = cur;
+    }
+    sort_entries(map, chain->entries, scratch, chain->count);
+    __map_free(map, scratch, length * sizeof(map_chain_entry_t));
+
+    map->chain_index[index] = chain;
+    map->num_chain_indexes++;
+    for (uint32_t i = 0; i + 1 < chain->count; i++) {
+        if (!entries_ordered(map, chain, i)) {
+            index_disable(map);
+            return;
+        }
+    }
+}
+
+// The array of indexes goes with the last one.
+void __map_index_drop(map_t *map, size_t index) {
+    map_chain_index_t *chain = __map_index_of(map, index);
+    if (chain == NULL) return;
+    __map_free(map, chain, index_bytes(chain->capacity));
+    map->chain_index[index] = NULL;
+    if (--map->num_chain_indexes == 0) {
+        __map_free(map, map->chain_index, map->num_buckets * sizeof(map_chain_index_t *));
+        map->chain_index = NULL;
+    }
+}
+
+void __map_index_drop_all(map_t *map) {
+    for (size_t i = 0; i < map->num_buckets && map->chain_index != NULL; i++) {
+        __map_index_drop(map, i);
+    }
+}
+
+void __map_index_refresh(map_t *map) {
+    for (size_t i = 0; i < map->num_buckets; i++) {
+        int length = 0;
+        for (map_element_t *cur = map->buckets[i];
+             cur != NULL && length < MAP_INDEX_BUILD_LENGTH; cur = cur->_next) {
+            length++;
+        }
+        if (length == MAP_INDEX_BUILD_LENGTH) __map_index_build(map, i);
+    }
+}
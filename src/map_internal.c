@@ -17,6 +17,10 @@ const char *__map_error_str(map_error_t err) {
     return "MAP_ERR_OVERFLOW";
   case MAP_ERR_END_OF_MAP:
     return "MAP_ERR_END_OF_MAP";
+  case MAP_ERR_STALE_ITERATOR:
+    return "MAP_ERR_STALE_ITERATOR";
+  case MAP_ERR_IO:
+    return "MAP_ERR_IO";
   default:
     return "MAP_ERR_UNKNOWN";
   }
@@ -24,39 +28,69 @@ const char *__map_error_str(map_error_t err) {
 
 // Map insert no resize
 map_error_t __map_insert_no_resize(map_t *map, void *key, void *value) {
+    map_element_t *node;
+    return __map_insert_entry(map, key, value, &node);
+}
+
+map_error_t __map_insert_entry(map_t *map, void *key, void *value, map_element_t **out_node) {
     if (!map || !key || !value) return MAP_ERR_INVALID_ARG;
 
     // Calculate bucket index using hash function
-    uint64_t hash = map->usr_hash(key);
-    size_t index = hash % map->num_buckets;
+    map_probe_t probe = __map_probe(map, key);
+    size_t index = probe.hash % map->num_buckets;
+
+    // Snapshots may share this chain; give it private nodes first.
+    if (map->snapshots != NULL) {
+        if (__map_cow_bucket(map, index) != MAP_OK) return MAP_ERR_NO_MEM;
+        if (__map_retire_reserve(map, 1) != MAP_OK) return MAP_ERR_NO_MEM;
+    }
 
-    // Check if the key already exists
+    // Check if the key already exists (the filter can tell it doesn't)
     map_element_t *current = map->buckets[index];
+    if (map->filter.blocks != NULL && !__map_filter_test(&map->filter, probe.hash)) {
+        current = NULL;
+    } else if (__map_index_of(map, index) != NULL &&
+               __map_index_find(map, index, &probe, &current) != MAP_OK) {
+        current = NULL;
+    }
     while (current) {
-        if (map->usr_compare(current->_key, key) == 0) {
+        if (__map_probe_compare(map, &probe, current->_key) == 0) {
             // Key exists, update value
-            map->usr_free_value(current->_value);
-            current->_value = map->usr_value_clone(value);
-            if (!current->_value) return MAP_ERR_NO_MEM;
+            void *new_value = map->usr_value_clone(value);
+            if (!new_value) return MAP_ERR_NO_MEM;
+            if (map->cache_referenced != NULL) {
+                map->cache_bytes += __map_cache_charge(map, current->_key, new_value) -
+                                    __map_cache_charge(map, current->_key, current->_value);
+                __map_cache_mark(map, index);
+            }
+            if (map->snapshots != NULL) {
+                __map_retire(map, current->_value, MAP_RETIRED_VALUE);
+            } else {
+                map->usr_free_value(current->_value);
+            }
+            current->_value = new_value;
+            *out_node = current;
             return MAP_OK;
         }
         current = current->_next;
     }
 
     // Create new element
-    map_element_t *new_elem = malloc(sizeof(map_element_t));
+    size_t node_size = __map_node_size(map);
+    map_element_t *new_elem = __map_alloc(map, node_size);
     if (!new_elem) return MAP_ERR_NO_MEM;
+    if (map->ttl != NULL) memset(new_elem, 0, node_size); // No deadline yet.
 
-    new_elem->_key = map->usr_key_clone(key);
+    new_elem->_key = __map_key_clone(map, &probe);
     if (!new_elem->_key) {  // Key clone failed
-        free(new_elem);
+        __map_free(map, new_elem, node_size);
         return MAP_ERR_NO_MEM;
     }
 
     new_elem->_value = map->usr_value_clone(value);
     if (!new_elem->_value) {  // Value clone failed
-        map->usr_free_key(new_elem->_key);
-        free(new_elem);
+        __map_key_free(map, new_elem->_key);
+        __map_free(map, new_elem, node_size);
         return MAP_ERR_NO_MEM;
     }
 
@@ -64,7 +98,15 @@ map_error_t __map_insert_no_resize(map_t *map, void *key, void *value) {
     new_elem->_next = map->buckets[index];
     map->buckets[index] = new_elem;
     map->num_entries++;
+    if (map->filter.blocks != NULL) __map_filter_add(&map->filter, probe.hash);
+    // Only the index can fail here; without it the chain is walked.
+    (void)__map_index_linked(map, index, probe.hash, new_elem);
+    if (map->cache_referenced != NULL) {
+        map->cache_bytes += __map_cache_charge(map, new_elem->_key, new_elem->_value);
+        __map_cache_mark(map, index);
+    }
 
+    *out_node = new_elem;
     return MAP_OK;
 }
 
@@ -76,29 +118,62 @@ map_error_t __map_resize(map_t *map, float resize_factor){
 
 	}
 
-	uint64_t new_num_buckets = (uint64_t)(map->num_buckets * resize_factor);
-	if (new_num_buckets < 1) { // Atleast one bucket must exist
+	// Relinking would rewrite nodes that snapshots share; resize once the
+	// last snapshot is released.
+	if (map->snapshots != NULL) {
+		return MAP_OK;
+	}
+
+	// Computed in double: a float can't count past 2^24 exactly.
+	double target = (double)map->num_buckets * resize_factor;
+	if (target < 1) { // Atleast one bucket must exist
 		return MAP_ERR_INVALID_ARG;
 	}
+	if (target >= (double)MAP_MAX_BUCKETS) {
+		return MAP_ERR_OVERFLOW;
+	}
+	size_t new_num_buckets = (size_t)target;
 
 	// Allocating new buckets
-	map_element_t **new_buckets = malloc(new_num_buckets * sizeof(map_element_t *));
+	map_element_t **new_buckets = __map_alloc(map, new_num_buckets * sizeof(map_element_t *));
 
 	if (new_buckets == NULL) {
 	return MAP_ERR_NO_MEM;
 	}
+
+	// Caches need a reference bit per new bucket; recency restarts from zero.
+	uint64_t *new_referenced = NULL;
+	if (map->cache_referenced != NULL) {
+		new_referenced = __map_calloc(map, __map_bitmap_words(new_num_buckets), sizeof(uint64_t));
+		if (new_referenced == NULL) {
+			__map_free(map, new_buckets, new_num_buckets * sizeof(map_element_t *));
+			return MAP_ERR_NO_MEM;
+		}
+	}
+	// The filter is rebuilt for the new size from the same hashes.
+	map_filter_t new_filter = {NULL, NULL, 0, 0};
+	if (map->filter.blocks != NULL && __map_filter_init(map, &new_filter, new_num_buckets) != MAP_OK) {
+		__map_free(map, new_referenced, __map_bitmap_words(new_num_buckets) * sizeof(uint64_t));
+		__map_free(map, new_buckets, new_num_buckets * sizeof(map_element_t *));
+		return MAP_ERR_NO_MEM;
+	}
 	// all buckets->NULL
-	for (uint64_t i = 0; i < new_num_buckets; i++) {
+	for (size_t i = 0; i < new_num_buckets; i++) {
 		new_buckets[i] = NULL;
 
 	}
 
+	// Chain indexes point into the old chains; they are rebuilt below.
+	__map_index_drop_all(map);
+
 	// Going through the old buckets
-	for (int i = 0; i < map->num_buckets; i++) {
+	for (size_t i = 0; i < map->num_buckets; i++) {
 		map_element_t *current = map->buckets[i];
 		while (current != NULL) {
 			map_element_t *next = current->_next;
-			uint64_t new_index = map->usr_hash(current->_key) % new_num_buckets;
+			uint64_t hash = __map_stored_hash(map, current->_key);
+			uint64_t new_index = hash % new_num_buckets;
+			if (new_filter.blocks != NULL) __map_filter_add(&new_filter, hash);
 
 			// Insert into new bucket
 			current->_next = new_buckets[new_index];
@@ -108,9 +183,20 @@ map_error_t __map_resize(map_t *map, float resize_factor){
 
 	}
 	// Free old buckets not elements as elements have been moved
-	free(map->buckets);
+	__map_free(map, map->buckets, map->num_buckets * sizeof(map_element_t *));
+	if (new_referenced != NULL) {
+		__map_cache_free(map);
+		map->cache_referenced = new_referenced;
+		map->cache_hand = 0;
+	}
+	if (new_filter.blocks != NULL) {
+		__map_filter_free(map, &map->filter);
+		map->filter = new_filter;
+	}
 	map->buckets = new_buckets;
 	map->num_buckets = new_num_buckets;
+	map->resize_epoch++;
+	__map_index_refresh(map);
 
 	return MAP_OK;
 
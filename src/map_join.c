@@ -0,0 +1,206 @@
+#include <map.h>
+#include <map_internal.h>
+
+// Hash join. Building takes two passes over the input. The first finds
+// each row's group, adding a group whenever a new key turns up, and counts
+// the rows of every group. The second puts each row at its group's next
+// position. Probes run over batches of JOIN_BATCH rows in three stages,
+// and each stage prefetches what the next one reads. First every key is
+// hashed and its home slot prefetched. Then the slots are scanned for a
+// matching tag and that group is prefetched. Finally keys are compared and
+// matches emitted.
+
+#define JOIN_BATCH 16
+#define JOIN_MIN_SLOTS 16
+
+static uint64_t join_hash(const map_join_t *join, void *key) {
+    return __map_mix64(join->usr_hash(key));
+}
+
+// Scan from slot `at` for key's group. Sets *out_group to its position
+// plus one and returns its slot, or sets 0 and returns the empty slot the
+// group would take.
+static size_t join_scan(const map_join_t *join, void *key, uint64_t hash, size_t at,
+                        uint32_t *out_group) {
+    uint32_t tag = (uint32_t)(hash >> 32);
+    for (;; at = (at + 1) & join->slot_mask) {
+        const map_join_slot_t *slot = &join->slots[at];
+        if (slot->group == 0) {
+            *out_group = 0;
+            return at;
+        }
+        if (slot->tag != tag) continue;
+        const map_join_group_t *group = &join->groups[slot->group - 1];
+        if (group->hash == hash && join->usr_compare(group->key, key) == 0) {
+            *out_group = slot->group;
+            return at;
+        }
+    }
+}
+
+static void join_free(map_join_t *join) {
+    free(join->groups);
+    free(join->rows);
+    free(join->slots);
+    free(join);
+}
+
+// Join Build Function
+map_error_t map_join_build(map_join_t **join, void *const *keys, void *const *rows, size_t n,
+                           uint64_t (*usr_hash)(void *key),
+                           int32_t (*usr_compare)(void *key1, void *key2)) {
+    if (join == NULL) return MAP_ERR_INVALID_ARG;
+    *join = NULL;
+    if ((keys == NULL && n > 0) || usr_hash == NULL || usr_compare == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    size_t num_slots = JOIN_MIN_SLOTS;
+    while (num_slots / 2 < n) {
+        if (num_slots > SIZE_MAX / 2 / sizeof(map_join_slot_t)) return MAP_ERR_OVERFLOW;
+        num_slots *= 2;
+    }
+    if (n > SIZE_MAX / sizeof(map_join_group_t)) return MAP_ERR_OVERFLOW;
+    size_t capacity = n > 0 ? n : 1; // Every row might start a group.
+
+    map_join_t *table = calloc(1, sizeof(map_join_t));
+    if (table == NULL) return MAP_ERR_NO_MEM;
+    table->usr_hash = usr_hash;
+    table->usr_compare = usr_compare;
+    table->slot_mask = num_slots - 1;
+    table->slots = calloc(num_slots, sizeof(map_join_slot_t));
+    table->groups = malloc(capacity * sizeof(map_join_group_t));
+    table->rows = malloc(capacity * sizeof(void *));
+    uint32_t *row_group = malloc(capacity * sizeof(uint32_t));
+    if (table->slots == NULL || table->groups == NULL || table->rows == NULL ||
+        row_group == NULL) {
+        free(row_group);
+        join_free(table);
+        return MAP_ERR_NO_MEM;
+    }
+
+    // Group the rows and count each group's.
+    for (size_t i = 0; i < n; i++) {
+        uint64_t hash = join_hash(table, keys[i]);
+        uint32_t g;
+        size_t at = join_scan(table, keys[i], hash, hash & table->slot_mask, &g);
+        if (g == 0) {
+            if (table->num_groups >= UINT32_MAX - 1) {
+                free(row_group);
+                join_free(table);
+                return MAP_ERR_OVERFLOW;
+            }
+            map_join_group_t *group = &table->groups[table->num_groups++];
+            group->hash = hash;
+            group->key = keys[i];
+            group->start = 0;
+            group->count = 0;
+            g = (uint32_t)table->num_groups;
+            table->slots[at].tag = (uint32_t)(hash >> 32);
+            table->slots[at].group = g;
+        }
+        table->groups[g - 1].count++;
+        row_group[i] = g - 1;
+    }
+
+    // Lay the groups out one after another, then place the rows, using
+    // start as each group's cursor and winding it back afterwards.
+    size_t start = 0;
+    for (size_t g = 0; g < table->num_groups; g++) {
+        table->groups[g].start = start;
+        start += table->groups[g].count;
+    }
+    for (size_t i = 0; i < n; i++) {
+        table->rows[table->groups[row_group[i]].start++] = rows != NULL ? rows[i] : keys[i];
+    }
+    for (size_t g = 0; g < table->num_groups; g++) {
+        table->groups[g].start -= table->groups[g].count;
+    }
+    table->num_rows = n;
+    free(row_group);
+
+    if (table->num_groups > 0 && table->num_groups < capacity) {
+        map_join_group_t *shrunk = realloc(table->groups,
+                                           table->num_groups * sizeof(map_join_group_t));
+        if (shrunk != NULL) table->groups = shrunk;
+    }
+    *join = table;
+    return MAP_OK;
+}
+
+// Join Probe Function
+map_error_t map_join_probe(const map_join_t *join, void *const *keys, void *const *rows,
+                           size_t n,
+                           map_error_t (*emit)(void *ctx, void *build_row, void *probe_row),
+                           void *ctx) {
+    if (join == NULL || (keys == NULL && n > 0) || emit == NULL) return MAP_ERR_INVALID_ARG;
+
+    uint64_t hashes[JOIN_BATCH];
+    size_t at[JOIN_BATCH];
+    for (size_t base = 0; base < n; base += JOIN_BATCH) {
+        size_t count = n - base < JOIN_BATCH ? n - base : JOIN_BATCH;
+        void *const *batch = keys + base;
+
+        for (size_t b = 0; b < count; b++) {
+            hashes[b] = join_hash(join, batch[b]);
+            at[b] = hashes[b] & join->slot_mask;
+            __map_prefetch(&join->slots[at[b]]);
+        }
+
+        // Skip to the first slot with the key's tag, or the empty one.
+        for (size_t b = 0; b < count; b++) {
+            uint32_t tag = (uint32_t)(hashes[b] >> 32);
+            const map_join_slot_t *slot = &join->slots[at[b]];
+            while (slot->group != 0 && slot->tag != tag) {
+                at[b] = (at[b] + 1) & join->slot_mask;
+                slot = &join->slots[at[b]];
+            }
+            if (slot->group != 0) __map_prefetch(&join->groups[slot->group - 1]);
+        }
+
+        for (size_t b = 0; b < count; b++) {
+            uint32_t g;
+            join_scan(join, batch[b], hashes[b], at[b], &g);
+            if (g == 0) continue;
+            const map_join_group_t *group = &join->groups[g - 1];
+            void *probe_row = rows != NULL ? rows[base + b] : batch[b];
+            for (size_t r = group->start; r < group->start + group->count; r++) {
+                map_error_t result = emit(ctx, join->rows[r], probe_row);
+                if (result != MAP_OK) return result;
+            }
+        }
+    }
+    return MAP_OK;
+}
+
+// Join Find Function
+map_error_t map_join_find(const map_join_t *join, void *key, void *const **out_rows,
+                          size_t *out_count) {
+    if (join == NULL || key == NULL || out_rows == NULL || out_count == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    uint64_t hash = join_hash(join, key);
+    uint32_t g;
+    join_scan(join, key, hash, hash & join->slot_mask, &g);
+    if (g == 0) return MAP_ERR_NOT_FOUND;
+    *out_rows = join->rows + join->groups[g - 1].start;
+    *out_count = join->groups[g - 1].count;
+    return MAP_OK;
+}
+
+// Join Get Size Function
+map_error_t map_join_get_size(const map_join_t *join, size_t *num_rows, size_t *num_keys) {
+    if (join == NULL || num_rows == NULL || num_keys == NULL) return MAP_ERR_INVALID_ARG;
+    *num_rows = join->num_rows;
+    *num_keys = join->num_groups;
+    return MAP_OK;
+}
+
+// Join Destroy Function
+map_error_t map_join_destroy(map_join_t **join) {
+    if (join == NULL || *join == NULL) return MAP_ERR_INVALID_ARG;
+    join_free(*join);
+    *join = NULL;
+    return MAP_OK;
+}
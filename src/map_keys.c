@@ -0,0 +1,135 @@
+#include <map.h>
+#include <map_internal.h>
+#include <string.h>
+
+// String key mode. Keys are copied into an append-only arena of large
+// chunks instead of one malloc per key, and every key carries its hash and
+// length so chain walks reject non-matching keys without a strcmp.
+
+// Chunk payload, chosen so header + payload is exactly 64KB for allocators
+// that round to size classes.
+#define KEY_CHUNK_SIZE (64 * 1024 - sizeof(map_key_chunk_t))
+
+static size_t key_record_size(size_t length) {
+    size_t size = sizeof(map_key_header_t) + length + 1;
+    return (size + 7) & ~(size_t)7;
+}
+
+// Append a record to the arena rooted at *chunks, returning the key bytes.
+static char *key_arena_push(const map_t *map, map_key_chunk_t **chunks, uint64_t hash,
+                            const char *bytes, size_t length) {
+    size_t record_size = key_record_size(length);
+    map_key_chunk_t *chunk = *chunks;
+
+    if (chunk == NULL || chunk->capacity - chunk->used < record_size) {
+        size_t capacity = record_size > KEY_CHUNK_SIZE ? record_size : KEY_CHUNK_SIZE;
+        chunk = __map_alloc(map, sizeof(map_key_chunk_t) + capacity);
+        if (chunk == NULL) return NULL;
+        chunk->used = 0;
+        chunk->capacity = capacity;
+        chunk->next = *chunks;
+        *chunks = chunk;
+    }
+
+    map_key_header_t *header = (map_key_header_t *)(chunk->data + chunk->used);
+    header->hash = hash;
+    header->length = (uint32_t)length;
+    header->record_size = (uint32_t)record_size;
+
+    char *key = (char *)(header + 1);
+    memcpy(key, bytes, length);
+    key[length] = '\0';
+    chunk->used += record_size;
+    return key;
+}
+
+static void key_arena_release(const map_t *map, map_key_chunk_t *chunk) {
+    while (chunk != NULL) {
+        map_key_chunk_t *next = chunk->next;
+        __map_free(map, chunk, sizeof(map_key_chunk_t) + chunk->capacity);
+        chunk = next;
+    }
+}
+
+map_probe_t __map_string_probe(const map_t *map, void *key) {
+    map_probe_t probe;
+    probe.key = key;
+    probe.length = strlen((const char *)key);
+    probe.hash = map->usr_hash != NULL ? map->usr_hash(key)
+                                       : map_hash_bytes(key, probe.length, 0);
+    return probe;
+}
+
+int32_t __map_string_compare(const map_probe_t *probe, void *stored_key) {
+    const map_key_header_t *header = __map_key_header(stored_key);
+    if (header->hash != probe->hash || header->length != probe->length) return 1;
+    return memcmp(stored_key, probe->key, probe->length) != 0;
+}
+
+void *__map_string_clone(map_t *map, const map_probe_t *probe) {
+    if (probe->length > UINT32_MAX) return NULL;
+
+    char *key = key_arena_push(map, &map->key_chunks, probe->hash,
+                               (const char *)probe->key, probe->length);
+    if (key != NULL) map->key_live_bytes += key_record_size(probe->length);
+    return key;
+}
+
+// Copy a key stored in another map into the chunk list *chunks, which
+// callers on worker threads keep private and splice into the map later.
+void *__map_string_copy(const map_t *map, map_key_chunk_t **chunks, const void *stored_key) {
+    const map_key_header_t *header = __map_key_header(stored_key);
+    return key_arena_push(map, chunks, header->hash, (const char *)stored_key,
+                          header->length);
+}
+
+void __map_string_free(map_t *map, void *stored_key) {
+    size_t record_size = __map_key_header(stored_key)->record_size;
+    map->key_live_bytes -= record_size;
+    map->key_dead_bytes += record_size;
+}
+
+void __map_string_arena_free(map_t *map) {
+    key_arena_release(map, map->key_chunks);
+    map->key_chunks = NULL;
+    map->key_live_bytes = 0;
+    map->key_dead_bytes = 0;
+}
+
+// Key Compaction Function
+map_error_t map_compact_keys(map_t *map) {
+    if (map == NULL || map->key_mode != MAP_KEY_STRING) {
+        return MAP_ERR_INVALID_ARG;
+    }
+    // Nothing to do, or snapshots still point at the current key bytes.
+    if (map->key_dead_bytes == 0 || map->snapshots != NULL) {
+        return MAP_OK;
+    }
+
+    // A single chunk sized to the live keys means nothing can fail once it
+    // is allocated. Keys are copied in bucket order, so keys sharing a chain
+    // end up next to each other.
+    map_key_chunk_t *compacted = NULL;
+    if (map->key_live_bytes > 0) {
+        compacted = __map_alloc(map, sizeof(map_key_chunk_t) + map->key_live_bytes);
+        if (compacted == NULL) {
+            return MAP_ERR_NO_MEM;
+        }
+        compacted->next = NULL;
+        compacted->used = 0;
+        compacted->capacity = map->key_live_bytes;
+    }
+
+    for (size_t i = 0; i < map->num_buckets; i++) {
+        for (map_element_t *cur = map->buckets[i]; cur != NULL; cur = cur->_next) {
+            const map_key_header_t *header = __map_key_header(cur->_key);
+            cur->_key = key_arena_push(map, &compacted, header->hash, (const char *)cur->_key,
+                                       header->length);
+        }
+    }
+
+    key_arena_release(map, map->key_chunks);
+    map->key_chunks = compacted;
+    map->key_dead_bytes = 0;
+    return MAP_OK;
+}
@@ -0,0 +1,62 @@
+#define _POSIX_C_SOURCE 200809L
+#include <map.h>
+#include <map_internal.h>
+#include <pthread.h>
+
+// Splits an index range over a handful of threads. Used by the bulk
+// operations (cloning and the like) whose per-item work is independent.
+
+typedef struct {
+    map_range_fn_t fn;
+    void *ctx;
+    int worker;
+    size_t begin;
+    size_t end;
+    map_error_t result;
+} parallel_job_t;
+
+static void *parallel_run(void *arg) {
+    parallel_job_t *job = (parallel_job_t *)arg;
+    job->result = job->fn(job->ctx, job->worker, job->begin, job->end);
+    return NULL;
+}
+
+int __map_parallel_workers(int nthreads, size_t count, size_t min_per_worker) {
+    if (nthreads > MAP_MAX_THREADS) nthreads = MAP_MAX_THREADS;
+    size_t useful = min_per_worker > 0 ? count / min_per_worker : count;
+    if ((size_t)nthreads > useful) nthreads = (int)useful;
+    return nthreads < 1 ? 1 : nthreads;
+}
+
+map_error_t __map_parallel_for(int workers, size_t count, map_range_fn_t fn, void *ctx) {
+    if (workers <= 1) return fn(ctx, 0, 0, count);
+
+    parallel_job_t jobs[MAP_MAX_THREADS];
+    pthread_t threads[MAP_MAX_THREADS];
+    int started[MAP_MAX_THREADS];
+
+    for (int w = 0; w < workers; w++) {
+        jobs[w].fn = fn;
+        jobs[w].ctx = ctx;
+        jobs[w].worker = w;
+        jobs[w].begin = count * (size_t)w / (size_t)workers;
+        jobs[w].end = count * (size_t)(w + 1) / (size_t)workers;
+        jobs[w].result = MAP_OK;
+    }
+
+    // Worker 0 runs on the calling thread; a thread that can't be started
+    // has its range run here too.
+    for (int w = 1; w < workers; w++) {
+        started[w] = pthread_create(&threads[w], NULL, parallel_run, &jobs[w]) == 0;
+    }
+    parallel_run(&jobs[0]);
+    for (int w = 1; w < workers; w++) {
+        if (started[w]) pthread_join(threads[w], NULL);
+        else parallel_run(&jobs[w]);
+    }
+
+    for (int w = 0; w < workers; w++) {
+        if (jobs[w].result != MAP_OK) return jobs[w].result;
+    }
+    return MAP_OK;
+}
@@ -0,0 +1,338 @@
+#include <map.h>
+#include <map_internal.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Minimal perfect hashing in the style of PTHash: keys are spread over
+// small "pilot buckets", and each bucket (largest first) searches for a
+// 16-bit pilot that sends all of its keys to free slots of a table that is
+// ~1% larger than the key set. Slots that land past num_entries are folded
+// back onto the holes below it through the remap array.
+
+#define PERFECT_LOAD_FACTOR 0.99
+#define PERFECT_BUCKET_DENSITY 5.0 // Pilot buckets per key * log2(n).
+#define PERFECT_MAX_PILOT 65535
+#define PERFECT_MAX_ATTEMPTS 16
+
+static uint64_t perfect_seed(uint32_t attempt) {
+    return __map_mix64(0x9e3779b97f4a7c15ULL * (attempt + 1));
+}
+
+// Hash of a key after mixing in the table seed.
+static uint64_t perfect_key_hash(uint64_t raw_hash, uint64_t seed) {
+    return __map_mix64(raw_hash ^ seed);
+}
+
+static uint32_t perfect_bucket(uint64_t h, uint32_t num_pilot_buckets) {
+    return __map_fastrange32((uint32_t)h, num_pilot_buckets);
+}
+
+static uint32_t perfect_slot(uint64_t h, uint16_t pilot, uint64_t seed,
+                             uint32_t table_size) {
+    uint64_t pilot_hash = __map_mix64(seed + pilot);
+    return __map_fastrange32((uint32_t)(__map_mix64(h ^ pilot_hash) >> 32),
+                             table_size);
+}
+
+static int bit_test(const uint64_t *bits, uint32_t i) {
+    return (bits[i >> 6] >> (i & 63)) & 1;
+}
+
+static void bit_set(uint64_t *bits, uint32_t i) {
+    bits[i >> 6] |= (uint64_t)1 << (i & 63);
+}
+
+static void bit_clear(uint64_t *bits, uint32_t i) {
+    bits[i >> 6] &= ~((uint64_t)1 << (i & 63));
+}
+
+// Scratch space for one build attempt.
+typedef struct {
+    uint64_t *hashes;        // Seeded hash of every key.
+    uint32_t *bucket_start;  // Counting-sort offsets, num_pilot_buckets + 1.
+    uint32_t *bucket_keys;   // Key indices grouped by pilot bucket.
+    uint32_t *bucket_order;  // Pilot buckets, largest first.
+    uint32_t *slots;         // Candidate slots for the bucket being placed.
+    uint64_t *taken;         // Occupancy bitmap over table_size slots.
+} perfect_scratch_t;
+
+static void perfect_table_free(map_perfect_t *p) {
+    const map_allocator_t *a = &p->allocator;
+    if (p->pilots) a->free(a->ctx, p->pilots, p->num_pilot_buckets * sizeof(uint16_t));
+    if (p->entries) {
+        a->free(a->ctx, p->entries, ((size_t)p->num_entries + 1) * sizeof(map_perfect_entry_t));
+    }
+    if (p->remap) {
+        a->free(a->ctx, p->remap,
+                ((size_t)p->table_size - p->num_entries + 1) * sizeof(uint32_t));
+    }
+    a->free(a->ctx, p, sizeof(map_perfect_t));
+}
+
+static void perfect_scratch_free(perfect_scratch_t *s) {
+    free(s->hashes);
+    free(s->bucket_start);
+    free(s->bucket_keys);
+    free(s->bucket_order);
+    free(s->slots);
+    free(s->taken);
+}
+
+// Try to place every pilot bucket with the given seed. Returns MAP_OK,
+// MAP_ERR_INVALID_ARG when two keys share a full hash, or MAP_ERR_OVERFLOW
+// when some bucket exhausted its pilot space and a new seed is needed.
+static map_error_t perfect_search(map_perfect_t *p, const uint64_t *raw_hashes,
+                                  perfect_scratch_t *s) {
+    uint32_t n = p->num_entries;
+    uint32_t nb = p->num_pilot_buckets;
+
+    memset(s->bucket_start, 0, (size_t)(nb + 1) * sizeof(uint32_t));
+    memset(s->taken, 0, (size_t)((p->table_size + 63) / 64) * sizeof(uint64_t));
+
+    for (uint32_t i = 0; i < n; i++) {
+        s->hashes[i] = perfect_key_hash(raw_hashes[i], p->seed);
+        s->bucket_start[perfect_bucket(s->hashes[i], nb) + 1]++;
+    }
+
+    uint32_t max_size = 0;
+    for (uint32_t b = 0; b < nb; b++) {
+        uint32_t size = s->bucket_start[b + 1];
+        if (size > max_size) max_size = size;
+        s->bucket_start[b + 1] += s->bucket_start[b];
+    }
+
+    // Group keys by bucket; bucket_order doubles as the fill cursor.
+    memcpy(s->bucket_order, s->bucket_start, (size_t)nb * sizeof(uint32_t));
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t b = perfect_bucket(s->hashes[i], nb);
+        s->bucket_keys[s->bucket_order[b]++] = i;
+    }
+
+    // Order buckets by decreasing size (counting sort on size).
+    uint32_t *size_start = calloc((size_t)max_size + 2, sizeof(uint32_t));
+    if (size_start == NULL) return MAP_ERR_NO_MEM;
+    for (uint32_t b = 0; b < nb; b++) {
+        uint32_t size = s->bucket_start[b + 1] - s->bucket_start[b];
+        size_start[max_size - size + 1]++;
+    }
+    for (uint32_t k = 0; k <= max_size; k++) {
+        size_start[k + 1] += size_start[k];
+    }
+    for (uint32_t b = 0; b < nb; b++) {
+        uint32_t size = s->bucket_start[b + 1] - s->bucket_start[b];
+        s->bucket_order[size_start[max_size - size]++] = b;
+    }
+    free(size_start);
+
+    for (uint32_t k = 0; k < nb; k++) {
+        uint32_t b = s->bucket_order[k];
+        uint32_t first = s->bucket_start[b];
+        uint32_t size = s->bucket_start[b + 1] - first;
+        if (size == 0) break; // Remaining buckets are empty too.
+
+        // Identical hashes can never be separated by any pilot.
+        for (uint32_t i = 0; i < size; i++) {
+            for (uint32_t j = i + 1; j < size; j++) {
+                if (s->hashes[s->bucket_keys[first + i]] ==
+                    s->hashes[s->bucket_keys[first + j]]) {
+                    return MAP_ERR_INVALID_ARG;
+                }
+            }
+        }
+
+        int placed = 0;
+        for (uint32_t pilot = 0; pilot <= PERFECT_MAX_PILOT && !placed; pilot++) {
+            uint32_t i;
+            for (i = 0; i < size; i++) {
+                uint32_t slot = perfect_slot(s->hashes[s->bucket_keys[first + i]],
+                                             (uint16_t)pilot, p->seed,
+                                             p->table_size);
+                if (bit_test(s->taken, slot)) break;
+                bit_set(s->taken, slot); // Also catches in-bucket clashes.
+                s->slots[i] = slot;
+            }
+
+            if (i == size) {
+                p->pilots[b] = (uint16_t)pilot;
+                placed = 1;
+            } else {
+                while (i > 0) bit_clear(s->taken, s->slots[--i]);
+            }
+        }
+
+        if (!placed) return MAP_ERR_OVERFLOW;
+    }
+
+    return MAP_OK;
+}
+
+// Convert Function
+map_error_t map_build_perfect(map_t **map, map_perfect_t **out) {
+    if (map == NULL || *map == NULL || out == NULL ||
+        (*map)->engine != MAP_ENGINE_CHAINING || (*map)->key_mode != MAP_KEY_USER ||
+        (*map)->snapshots != NULL || (*map)->ttl != NULL ||
+        (*map)->wal != NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    map_t *src = *map;
+    if (src->num_entries > UINT32_MAX) {
+        return MAP_ERR_OVERFLOW;
+    }
+    uint32_t n = (uint32_t)src->num_entries;
+    uint64_t table_size = (uint64_t)ceil(n / PERFECT_LOAD_FACTOR);
+    if (table_size > UINT32_MAX) {
+        return MAP_ERR_OVERFLOW;
+    }
+
+    // The table lives in the map's allocator; build scratch uses libc.
+    map_perfect_t *p = __map_calloc(src, 1, sizeof(map_perfect_t));
+    if (p == NULL) {
+        return MAP_ERR_NO_MEM;
+    }
+    p->allocator = src->allocator;
+
+    double log_n = n > 2 ? log2((double)n) : 1.0;
+    p->num_entries = n;
+    p->table_size = (uint32_t)table_size;
+    p->num_pilot_buckets = (uint32_t)ceil(PERFECT_BUCKET_DENSITY * n / log_n);
+    if (p->num_pilot_buckets == 0) p->num_pilot_buckets = 1;
+    p->usr_hash = src->usr_hash;
+    p->usr_compare = src->usr_compare;
+    p->usr_free_key = src->usr_free_key;
+    p->usr_free_value = src->usr_free_value;
+
+    // Gather the nodes and their user hashes once; retries only reseed.
+    map_element_t **nodes = malloc(((size_t)n + 1) * sizeof(map_element_t *));
+    uint64_t *raw_hashes = malloc(((size_t)n + 1) * sizeof(uint64_t));
+    perfect_scratch_t s;
+    s.hashes = malloc(((size_t)n + 1) * sizeof(uint64_t));
+    s.bucket_start = malloc(((size_t)p->num_pilot_buckets + 1) * sizeof(uint32_t));
+    s.bucket_keys = malloc(((size_t)n + 1) * sizeof(uint32_t));
+    s.bucket_order = malloc((size_t)p->num_pilot_buckets * sizeof(uint32_t));
+    s.slots = malloc(((size_t)n + 1) * sizeof(uint32_t));
+    s.taken = malloc(((table_size + 63) / 64 + 1) * sizeof(uint64_t));
+    p->pilots = __map_calloc(src, p->num_pilot_buckets, sizeof(uint16_t));
+    p->entries = __map_alloc(src, ((size_t)n + 1) * sizeof(map_perfect_entry_t));
+    p->remap = __map_calloc(src, (size_t)(table_size - n + 1), sizeof(uint32_t));
+
+    map_error_t result = MAP_ERR_NO_MEM;
+    if (!nodes || !raw_hashes || !s.hashes || !s.bucket_start || !s.bucket_keys ||
+        !s.bucket_order || !s.slots || !s.taken || !p->pilots || !p->entries ||
+        !p->remap) {
+        goto fail;
+    }
+
+    uint32_t count = 0;
+    for (size_t i = 0; i < src->num_buckets; i++) {
+        for (map_element_t *cur = src->buckets[i]; cur != NULL; cur = cur->_next) {
+            nodes[count] = cur;
+            raw_hashes[count] = src->usr_hash(cur->_key);
+            count++;
+        }
+    }
+
+    result = MAP_ERR_OVERFLOW;
+    for (uint32_t attempt = 0; attempt < PERFECT_MAX_ATTEMPTS; attempt++) {
+        p->seed = perfect_seed(attempt);
+        result = perfect_search(p, raw_hashes, &s);
+        if (result != MAP_ERR_OVERFLOW) break;
+    }
+    if (result != MAP_OK) {
+        goto fail;
+    }
+
+    // Fold the slots past num_entries onto the free slots below it.
+    uint32_t hole = 0;
+    for (uint32_t slot = n; slot < p->table_size; slot++) {
+        if (!bit_test(s.taken, slot)) continue;
+        while (bit_test(s.taken, hole)) hole++;
+        p->remap[slot - n] = hole++;
+    }
+
+    // Nothing can fail from here on: move the entries and free the map.
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t b = perfect_bucket(s.hashes[i], p->num_pilot_buckets);
+        uint32_t slot = perfect_slot(s.hashes[i], p->pilots[b], p->seed,
+                                     p->table_size);
+        if (slot >= n) slot = p->remap[slot - n];
+        p->entries[slot]._key = nodes[i]->_key;
+        p->entries[slot]._value = nodes[i]->_value;
+        __map_free(src, nodes[i], sizeof(map_element_t));
+    }
+
+    free(nodes);
+    free(raw_hashes);
+    perfect_scratch_free(&s);
+
+    __map_cache_free(src);
+    __map_filter_free(src, &src->filter);
+    __map_index_drop_all(src);
+    __map_free(src, src->buckets, src->num_buckets * sizeof(map_element_t *));
+    __map_free(src, src, sizeof(map_t));
+    *map = NULL;
+    *out = p;
+    return MAP_OK;
+
+fail:
+    free(nodes);
+    free(raw_hashes);
+    perfect_scratch_free(&s);
+    perfect_table_free(p);
+    return result;
+}
+
+// Get Function
+map_error_t map_perfect_get(const map_perfect_t *pmap, void *key, void **out_value) {
+    if (pmap == NULL || key == NULL || out_value == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+    if (pmap->num_entries == 0) {
+        return MAP_ERR_NOT_FOUND;
+    }
+
+    uint64_t h = perfect_key_hash(pmap->usr_hash(key), pmap->seed);
+    uint16_t pilot = pmap->pilots[perfect_bucket(h, pmap->num_pilot_buckets)];
+    uint32_t slot = perfect_slot(h, pilot, pmap->seed, pmap->table_size);
+    if (slot >= pmap->num_entries) {
+        slot = pmap->remap[slot - pmap->num_entries];
+    }
+
+    // The slot is the only place the key can be; foreign keys land anywhere.
+    const map_perfect_entry_t *entry = &pmap->entries[slot];
+    if (pmap->usr_compare(entry->_key, key) != 0) {
+        return MAP_ERR_NOT_FOUND;
+    }
+
+    *out_value = entry->_value;
+    return MAP_OK;
+}
+
+// Size Getting Function
+map_error_t map_perfect_get_size(const map_perfect_t *pmap, size_t *num_elements) {
+    if (pmap == NULL || num_elements == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    *num_elements = pmap->num_entries;
+    return MAP_OK;
+}
+
+// Destroy Function
+map_error_t map_perfect_destroy(map_perfect_t **pmap) {
+    if (pmap == NULL || *pmap == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    map_perfect_t *p = *pmap;
+    for (uint32_t i = 0; i < p->num_entries; i++) {
+        p->usr_free_key(p->entries[i]._key);
+        p->usr_free_value(p->entries[i]._value);
+    }
+
+    perfect_table_free(p);
+    *pmap = NULL;
+
+    return MAP_OK;
+}
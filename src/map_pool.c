@@ -0,0 +1,390 @@
+#include <map.h>
+#include <map_internal.h>
+#include <string.h>
+
+// Pooled chaining engine. Chains work as in the default engine, but nodes
+// live back to back in one map-owned array and link to each other by
+// 32-bit position instead of by pointer. A node is 24 bytes with no malloc
+// header of its own, a bucket head is 4 bytes, and nothing holds a pointer
+// into the pool, so growing it is a plain realloc and growing the bucket
+// array never moves a node. Nodes keep the low 32 bits of the mixed hash,
+// which picks their bucket, so resizes never call usr_hash, and lookups
+// only call usr_compare on a hash match. Removed nodes go on a free list
+// threaded through `next`; the pool is compacted once it is mostly free.
+
+#define POOL_MIN_BUCKETS 16
+#define POOL_MAX_BUCKETS ((uint32_t)1 << 30)
+#define POOL_MIN_NODES 16
+#define POOL_MAX_NODES UINT32_MAX // Links hold positions plus one.
+
+static uint32_t pool_hash(const map_t *map, void *key) {
+    // Post-mix: buckets are picked from the low bits.
+    return (uint32_t)__map_mix64(map->usr_hash(key));
+}
+
+static map_pool_node_t *pool_node(const map_t *map, uint32_t at) {
+    return &map->pool_nodes[at - 1];
+}
+
+static uint32_t *pool_head(const map_t *map, uint32_t hash) {
+    return &map->pool_heads[hash & ((uint32_t)map->num_buckets - 1)];
+}
+
+// Position (plus one) of key's node, or 0; *out_prev gets the node before
+// it in the chain, 0 for the head.
+static uint32_t pool_find(const map_t *map, void *key, uint32_t hash, uint32_t *out_prev) {
+    uint32_t prev = 0;
+    for (uint32_t at = *pool_head(map, hash); at != 0; at = pool_node(map, at)->next) {
+        const map_pool_node_t *node = pool_node(map, at);
+        if (node->hash == hash && map->usr_compare(node->_key, key) == 0) {
+            if (out_prev != NULL) *out_prev = prev;
+            return at;
+        }
+        prev = at;
+    }
+    return 0;
+}
+
+// Relink every live node into a fresh head array of num_buckets. Nodes
+// stay where they are.
+static map_error_t pool_rehead(map_t *map, uint32_t num_buckets) {
+    uint32_t *heads = __map_calloc(map, num_buckets, sizeof(uint32_t));
+    if (heads == NULL) return MAP_ERR_NO_MEM;
+
+    __map_free(map, map->pool_heads, map->num_buckets * sizeof(uint32_t));
+    map->pool_heads = heads;
+    map->num_buckets = num_buckets;
+    for (uint32_t at = 1; at <= map->pool_used; at++) {
+        map_pool_node_t *node = pool_node(map, at);
+        if (node->_key == NULL) continue;
+        uint32_t *head = pool_head(map, node->hash);
+        node->next = *head;
+        *head = at;
+    }
+    return MAP_OK;
+}
+
+// Move the live nodes, in order, to the front of a smaller pool with room
+// for `capacity`, dropping the free list. Positions change, so this bumps
+// the resize epoch. The old pool is kept if allocation fails.
+static map_error_t pool_compact(map_t *map, uint32_t capacity) {
+    map_pool_node_t *nodes = __map_alloc(map, (size_t)capacity * sizeof(map_pool_node_t));
+    if (nodes == NULL) return MAP_ERR_NO_MEM;
+
+    uint32_t used = 0;
+    for (uint32_t at = 1; at <= map->pool_used; at++) {
+        if (pool_node(map, at)->_key != NULL) nodes[used++] = *pool_node(map, at);
+    }
+    __map_free(map, map->pool_nodes, (size_t)map->pool_capacity * sizeof(map_pool_node_t));
+    map->pool_nodes = nodes;
+    map->pool_capacity = capacity;
+    map->pool_used = used;
+    map->pool_free = 0;
+    map->resize_epoch++;
+
+    // Relinking into the same heads cannot fail.
+    memset(map->pool_heads, 0, map->num_buckets * sizeof(uint32_t));
+    for (uint32_t at = 1; at <= used; at++) {
+        uint32_t *head = pool_head(map, pool_node(map, at)->hash);
+        pool_node(map, at)->next = *head;
+        *head = at;
+    }
+    return MAP_OK;
+}
+
+// A node to fill: the first free one, else the next unused one.
+static uint32_t pool_take(map_t *map, map_error_t *out_result) {
+    if (map->pool_free != 0) {
+        uint32_t at = map->pool_free;
+        map->pool_free = pool_node(map, at)->next;
+        return at;
+    }
+    if (map->pool_used == map->pool_capacity) {
+        if (map->pool_capacity == POOL_MAX_NODES) {
+            *out_result = MAP_ERR_OVERFLOW;
+            return 0;
+        }
+        uint64_t grown = (uint64_t)map->pool_capacity + map->pool_capacity / 2 + 1;
+        if (grown > POOL_MAX_NODES) grown = POOL_MAX_NODES;
+        size_t node_size = sizeof(map_pool_node_t);
+        map_pool_node_t *nodes = __map_realloc(map, map->pool_nodes,
+                                               (size_t)map->pool_capacity * node_size,
+                                               (size_t)grown * node_size);
+        if (nodes == NULL) {
+            *out_result = MAP_ERR_NO_MEM;
+            return 0;
+        }
+        map->pool_nodes = nodes;
+        map->pool_capacity = (uint32_t)grown;
+    }
+    return ++map->pool_used;
+}
+
+// Init Function
+static map_error_t pool_init(map_t *map) {
+    map->pool_heads = __map_calloc(map, POOL_MIN_BUCKETS, sizeof(uint32_t));
+    map->pool_nodes = __map_alloc(map, POOL_MIN_NODES * sizeof(map_pool_node_t));
+    if (map->pool_heads == NULL || map->pool_nodes == NULL) {
+        __map_free(map, map->pool_heads, POOL_MIN_BUCKETS * sizeof(uint32_t));
+        __map_free(map, map->pool_nodes, POOL_MIN_NODES * sizeof(map_pool_node_t));
+        return MAP_ERR_NO_MEM;
+    }
+    map->num_buckets = POOL_MIN_BUCKETS;
+    map->pool_capacity = POOL_MIN_NODES;
+    map->pool_used = 0;
+    map->pool_free = 0;
+    return MAP_OK;
+}
+
+// Destroy Function
+static void pool_destroy(map_t *map) {
+    for (uint32_t at = 1; at <= map->pool_used; at++) {
+        map_pool_node_t *node = pool_node(map, at);
+        if (node->_key == NULL) continue;
+        map->usr_free_key(node->_key);
+        map->usr_free_value(node->_value);
+    }
+    __map_free(map, map->pool_nodes, (size_t)map->pool_capacity * sizeof(map_pool_node_t));
+    __map_free(map, map->pool_heads, map->num_buckets * sizeof(uint32_t));
+    map->pool_nodes = NULL;
+    map->pool_heads = NULL;
+}
+
+typedef struct {
+    const map_t *src;
+    map_t *dst;
+} pool_clone_job_t;
+
+// Clone the keys and values of nodes [begin, end). A key is only stored
+// once its value exists, so pool_destroy() can clean up after a failure.
+static map_error_t pool_clone_range(void *ctx, int worker, size_t begin, size_t end) {
+    pool_clone_job_t *job = (pool_clone_job_t *)ctx;
+    (void)worker;
+
+    for (size_t i = begin; i < end; i++) {
+        const map_pool_node_t *from = &job->src->pool_nodes[i];
+        map_pool_node_t *to = &job->dst->pool_nodes[i];
+        to->next = from->next;
+        to->hash = from->hash;
+        if (from->_key == NULL) continue;
+
+        void *key = job->src->usr_key_clone(from->_key);
+        if (key == NULL) return MAP_ERR_NO_MEM;
+        void *value = job->src->usr_value_clone(from->_value);
+        if (value == NULL) {
+            job->src->usr_free_key(key);
+            return MAP_ERR_NO_MEM;
+        }
+        to->_value = value;
+        to->_key = key;
+    }
+    return MAP_OK;
+}
+
+// Clone Function. The links are positions, so heads and links are copied
+// as they are and nothing is rehashed or relinked.
+static map_error_t pool_clone(const map_t *src, map_t *dst, int nthreads) {
+    size_t heads_size = src->num_buckets * sizeof(uint32_t);
+    dst->pool_heads = __map_alloc(dst, heads_size);
+    dst->pool_nodes = __map_calloc(dst, src->pool_capacity, sizeof(map_pool_node_t));
+    if (dst->pool_heads == NULL || dst->pool_nodes == NULL) {
+        __map_free(dst, dst->pool_heads, heads_size);
+        __map_free(dst, dst->pool_nodes, (size_t)src->pool_capacity * sizeof(map_pool_node_t));
+        dst->pool_heads = NULL;
+        dst->pool_nodes = NULL;
+        return MAP_ERR_NO_MEM;
+    }
+    memcpy(dst->pool_heads, src->pool_heads, heads_size);
+    dst->pool_capacity = src->pool_capacity;
+    dst->pool_used = src->pool_used;
+    dst->pool_free = src->pool_free;
+
+    pool_clone_job_t job = {src, dst};
+    int workers = __map_parallel_workers(nthreads, (size_t)src->pool_used,
+                                         MAP_PARALLEL_MIN_ITEMS);
+    map_error_t result = __map_parallel_for(workers, (size_t)src->pool_used,
+                                            pool_clone_range, &job);
+    if (result != MAP_OK) pool_destroy(dst);
+    return result;
+}
+
+// Insert Function
+static map_error_t pool_insert(map_t *map, void *key, void *value) {
+    uint32_t hash = pool_hash(map, key);
+    uint32_t at = pool_find(map, key, hash, NULL);
+
+    // Key exists, update value in place.
+    if (at != 0) {
+        void *new_value = map->usr_value_clone(value);
+        if (new_value == NULL) return MAP_ERR_NO_MEM;
+        map->usr_free_value(pool_node(map, at)->_value);
+        pool_node(map, at)->_value = new_value;
+        return MAP_OK;
+    }
+
+    void *new_key = map->usr_key_clone(key);
+    if (new_key == NULL) return MAP_ERR_NO_MEM;
+    void *new_value = map->usr_value_clone(value);
+    if (new_value == NULL) {
+        map->usr_free_key(new_key);
+        return MAP_ERR_NO_MEM;
+    }
+
+    map_error_t result = MAP_OK;
+    at = pool_take(map, &result);
+    if (at == 0) {
+        map->usr_free_key(new_key);
+        map->usr_free_value(new_value);
+        return result;
+    }
+
+    map_pool_node_t *node = pool_node(map, at);
+    node->_key = new_key;
+    node->_value = new_value;
+    node->hash = hash;
+    uint32_t *head = pool_head(map, hash);
+    node->next = *head;
+    *head = at;
+    map->num_entries++;
+
+    // Grow the heads past the load factor. Failing to is not an error;
+    // chains just get longer.
+    if ((double)map->num_entries > (double)map->num_buckets * map->max_load_factor &&
+        (uint32_t)map->num_buckets < POOL_MAX_BUCKETS) {
+        pool_rehead(map, (uint32_t)map->num_buckets * 2);
+    }
+    return MAP_OK;
+}
+
+// Get Function
+static map_error_t pool_get(const map_t *map, void *key, void **out_value) {
+    uint32_t at = pool_find(map, key, pool_hash(map, key), NULL);
+    if (at == 0) {
+        return MAP_ERR_NOT_FOUND;
+    }
+
+    *out_value = pool_node(map, at)->_value;
+    return MAP_OK;
+}
+
+// Unlink node `at` (after `prev` in its chain), free its entry and put it
+// on the free list.
+static void pool_clear(map_t *map, uint32_t prev, uint32_t at) {
+    map_pool_node_t *node = pool_node(map, at);
+    if (prev == 0) *pool_head(map, node->hash) = node->next;
+    else pool_node(map, prev)->next = node->next;
+
+    map->usr_free_key(node->_key);
+    map->usr_free_value(node->_value);
+    node->_key = NULL;
+    node->_value = NULL;
+    node->next = map->pool_free;
+    map->pool_free = at;
+    map->num_entries--;
+}
+
+// Shrink Function. Halves the heads while the map is under its minimum
+// load, and compacts the pool once it is mostly free nodes. Both move
+// nodes and bump resize_epoch.
+static void pool_shrink(map_t *map) {
+    uint32_t buckets = (uint32_t)map->num_buckets;
+    while (buckets > POOL_MIN_BUCKETS &&
+           (double)map->num_entries < buckets * map->min_load_factor) {
+        buckets /= 2;
+    }
+    if (buckets != (uint32_t)map->num_buckets) pool_rehead(map, buckets);
+
+    if (map->pool_capacity > POOL_MIN_NODES &&
+        (uint32_t)map->num_entries < map->pool_capacity / 8) {
+        uint32_t capacity = (uint32_t)map->num_entries * 2;
+        pool_compact(map, capacity > POOL_MIN_NODES ? capacity : POOL_MIN_NODES);
+    }
+}
+
+// Remove Function
+static map_error_t pool_remove(map_t *map, void *key) {
+    uint32_t prev;
+    uint32_t at = pool_find(map, key, pool_hash(map, key), &prev);
+    if (at == 0) {
+        return MAP_ERR_NOT_FOUND;
+    }
+
+    pool_clear(map, prev, at);
+    pool_shrink(map);
+    return MAP_OK;
+}
+
+// Iterator Start Function. current_bucket holds the next node to visit;
+// iteration is a scan of the pool, so growing the heads doesn't disturb it.
+static map_error_t pool_iter_start(const map_t *map, map_iterator_t *iter) {
+    iter->current_bucket = 0;
+    iter->current_element = NULL;
+    return map->num_entries > 0 ? MAP_OK : MAP_ERR_END_OF_MAP;
+}
+
+// Iterator Next Function
+static map_error_t pool_iter_next(const map_t *map, map_iterator_t *iter,
+                                  void **out_key, void **out_value) {
+    while (iter->current_bucket < map->pool_used) {
+        const map_pool_node_t *node = &map->pool_nodes[iter->current_bucket++];
+        if (node->_key != NULL) {
+            *out_key = node->_key;
+            *out_value = node->_value;
+            return MAP_OK;
+        }
+    }
+    return MAP_ERR_END_OF_MAP;
+}
+
+// Iterator Remove Function. The node is the one before current_bucket;
+// its predecessor is found from the stored hash, comparing positions only.
+static map_error_t pool_iter_remove(map_t *map, map_iterator_t *iter) {
+    if (iter->current_bucket == 0) return MAP_ERR_NOT_FOUND;
+
+    uint32_t at = (uint32_t)iter->current_bucket;
+    const map_pool_node_t *node = pool_node(map, at);
+    if (node->_key == NULL) return MAP_ERR_NOT_FOUND;
+    if (map->wal != NULL) {
+        map_error_t result = __map_wal_append(map, MAP_WAL_REMOVE, node->_key, NULL);
+        if (result != MAP_OK) return result;
+    }
+
+    uint32_t prev = 0;
+    for (uint32_t cur = *pool_head(map, node->hash); cur != at; cur = pool_node(map, cur)->next) {
+        prev = cur;
+    }
+    pool_clear(map, prev, at);
+    return MAP_OK;
+}
+
+// Print Function
+static map_error_t pool_print(const map_t *map) {
+    printf("Map contents:\n");
+    for (size_t i = 0; i < map->num_buckets; i++) {
+        if (map->pool_heads[i] == 0) continue;
+        printf("Buckets %zu: ", i);
+        for (uint32_t at = map->pool_heads[i]; at != 0; at = pool_node(map, at)->next) {
+            const map_pool_node_t *node = pool_node(map, at);
+            char *entry_str = map->usr_stringify(node->_key, node->_value);
+            if (entry_str == NULL) return MAP_ERR_UNKNOWN;
+            printf("%s", entry_str);
+            free(entry_str);
+        }
+        printf("\n");
+    }
+    return MAP_OK;
+}
+
+const map_engine_ops_t __map_pool_ops = {
+    pool_init,
+    pool_destroy,
+    pool_clone,
+    pool_insert,
+    pool_get,
+    pool_remove,
+    pool_iter_start,
+    pool_iter_next,
+    pool_iter_remove,
+    pool_shrink,
+    pool_print,
+};
@@ -0,0 +1,112 @@
+#define _POSIX_C_SOURCE 200809L
+#include <map.h>
+#include <map_internal.h>
+#include <pthread.h>
+
+// Streaming reduction. Each local map belongs to one thread. Draining
+// swaps in an empty clone of the reducer's template map, so the thread
+// can go on inserting, and merges the full map into the global one with
+// map_merge_consume() under the lock, moving its nodes when it can.
+
+static void reducer_free(map_reducer_t *reducer) {
+    if (reducer->locals != NULL) {
+        for (int i = 0; i < reducer->num_locals; i++) {
+            if (reducer->locals[i] != NULL) map_destroy(&reducer->locals[i]);
+        }
+    }
+    free(reducer->locals);
+    if (reducer->empty != NULL) map_destroy(&reducer->empty);
+    pthread_mutex_destroy(&reducer->lock);
+    free(reducer);
+}
+
+// Reducer Create Function
+map_error_t map_reducer_create(map_reducer_t **reducer, map_t *global, int num_locals,
+                               void *(*combine)(void *ctx, void *key, void *dst_value,
+                                                void *src_value),
+                               void *ctx) {
+    if (reducer == NULL || global == NULL || num_locals < 1) return MAP_ERR_INVALID_ARG;
+    size_t size;
+    if (map_get_size(global, &size) != MAP_OK || size != 0) return MAP_ERR_INVALID_ARG;
+
+    map_reducer_t *created = calloc(1, sizeof(map_reducer_t));
+    if (created == NULL) return MAP_ERR_NO_MEM;
+    if (pthread_mutex_init(&created->lock, NULL) != 0) {
+        free(created);
+        return MAP_ERR_NO_MEM;
+    }
+    created->num_locals = num_locals;
+    created->combine = combine;
+    created->ctx = ctx;
+    created->locals = calloc((size_t)num_locals, sizeof(map_t *));
+    map_error_t result = created->locals != NULL ? map_clone(global, &created->empty, 1)
+                                                 : MAP_ERR_NO_MEM;
+    for (int i = 0; i < num_locals && result == MAP_OK; i++) {
+        result = map_clone(global, &created->locals[i], 1);
+    }
+    if (result != MAP_OK) {
+        reducer_free(created);
+        return result;
+    }
+
+    created->global = global;
+    *reducer = created;
+    return MAP_OK;
+}
+
+// Reducer Local Function
+map_error_t map_reducer_local(map_reducer_t *reducer, int local, map_t **out_map) {
+    if (reducer == NULL || out_map == NULL || local < 0 || local >= reducer->num_locals) {
+        return MAP_ERR_INVALID_ARG;
+    }
+    *out_map = reducer->locals[local];
+    return MAP_OK;
+}
+
+// Reducer Drain Function
+map_error_t map_reducer_drain(map_reducer_t *reducer, int local) {
+    if (reducer == NULL || local < 0 || local >= reducer->num_locals) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    map_t *full = reducer->locals[local];
+    size_t size;
+    map_get_size(full, &size);
+    if (size == 0) return MAP_OK;
+
+    map_t *fresh;
+    map_error_t result = map_clone(reducer->empty, &fresh, 1);
+    if (result != MAP_OK) return result;
+    reducer->locals[local] = fresh;
+
+    pthread_mutex_lock(&reducer->lock);
+    result = map_merge_consume(reducer->global, &full, reducer->combine, reducer->ctx);
+    pthread_mutex_unlock(&reducer->lock);
+    if (full != NULL) map_destroy(&full); // Not merged, or only in part.
+    return result;
+}
+
+// Reducer Finish Function
+map_error_t map_reducer_finish(map_reducer_t **reducer, int nthreads, map_t **out_map) {
+    if (reducer == NULL || *reducer == NULL || out_map == NULL || nthreads < 1) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    map_reducer_t *r = *reducer;
+    map_error_t result = map_merge_parallel(r->global, r->locals, (size_t)r->num_locals,
+                                            nthreads, r->combine, r->ctx);
+    *out_map = r->global;
+    r->global = NULL;
+    reducer_free(r);
+    *reducer = NULL;
+    return result;
+}
+
+// Reducer Destroy Function
+map_error_t map_reducer_destroy(map_reducer_t **reducer) {
+    if (reducer == NULL || *reducer == NULL) return MAP_ERR_INVALID_ARG;
+    if ((*reducer)->global != NULL) map_destroy(&(*reducer)->global);
+    reducer_free(*reducer);
+    *reducer = NULL;
+    return MAP_OK;
+}
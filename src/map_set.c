@@ -0,0 +1,84 @@
+#include <map.h>
+#include <map_internal.h>
+
+// Keys-only maps. Every entry's value is the address of set_member, so the
+// value callbacks are an identity and a no-op, and the engines, resizing
+// and set operations are shared with maps unchanged.
+
+static char set_member;
+#define SET_MEMBER ((void *)&set_member)
+
+static void *set_value_clone(void *value) { return value; }
+
+static void set_free_value(void *value) { (void)value; }
+
+int __map_is_set(const map_t *map) {
+    return map->usr_value_clone == set_value_clone;
+}
+
+// Set Create Function
+map_error_t map_set_create(map_set_t **set, void *(*usr_key_clone)(void *key),
+                           uint64_t (*usr_hash)(void *key),
+                           char *(*usr_stringify)(void *key, void *data),
+                           int32_t (*usr_compare)(void *key1, void *key2),
+                           void (*usr_free_key)(void *key)) {
+    return map_set_create_ex(set, NULL, usr_key_clone, usr_hash, usr_stringify, usr_compare,
+                             usr_free_key);
+}
+
+// Set Create With Options Function
+map_error_t map_set_create_ex(map_set_t **set, const map_options_t *options,
+                              void *(*usr_key_clone)(void *key),
+                              uint64_t (*usr_hash)(void *key),
+                              char *(*usr_stringify)(void *key, void *data),
+                              int32_t (*usr_compare)(void *key1, void *key2),
+                              void (*usr_free_key)(void *key)) {
+    // The disk engine decodes a fresh value on every load and would leave
+    // set_free_value() nothing to free it with.
+    if (options != NULL && options->engine == MAP_ENGINE_DISK) return MAP_ERR_INVALID_ARG;
+    return map_create_ex(set, options, usr_key_clone, set_value_clone, usr_hash, usr_stringify,
+                         usr_compare, usr_free_key, set_free_value);
+}
+
+// Set Insert Function
+map_error_t map_set_insert(map_set_t *set, void *key) {
+    if (set == NULL || !__map_is_set(set)) return MAP_ERR_INVALID_ARG;
+    return map_insert(set, key, SET_MEMBER);
+}
+
+// Set Contains Function
+map_error_t map_set_contains(const map_set_t *set, void *key) {
+    if (set == NULL || !__map_is_set(set)) return MAP_ERR_INVALID_ARG;
+    void *value;
+    return map_get(set, key, &value);
+}
+
+// Set Iterator Next Function
+map_error_t map_set_iter_next(const map_set_t *set, map_iterator_t *iter, void **out_key) {
+    void *value;
+    return map_iter_next(set, iter, out_key, &value);
+}
+
+// Set Union Function
+map_error_t map_set_union(map_set_t *dst, const map_set_t *src) {
+    if (dst == NULL || src == NULL || !__map_is_set(dst) || !__map_is_set(src)) {
+        return MAP_ERR_INVALID_ARG;
+    }
+    return map_merge(dst, src, NULL, NULL);
+}
+
+// Set Intersect Function
+map_error_t map_set_intersect(map_set_t *dst, const map_set_t *src) {
+    if (dst == NULL || src == NULL || !__map_is_set(dst) || !__map_is_set(src)) {
+        return MAP_ERR_INVALID_ARG;
+    }
+    return map_intersect(dst, src, NULL, NULL);
+}
+
+// Set Difference Function
+map_error_t map_set_difference(map_set_t *dst, const map_set_t *src) {
+    if (dst == NULL || src == NULL || !__map_is_set(dst) || !__map_is_set(src)) {
+        return MAP_ERR_INVALID_ARG;
+    }
+    return map_difference(dst, src);
+}
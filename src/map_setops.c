@@ -0,0 +1,580 @@
+#include <map.h>
+#include <map_internal.h>
+#include <string.h>
+
+// Merge, intersection and difference. Two chaining maps work directly on
+// the chains: each key is hashed at most once, dst is resized at most once,
+// and a consumed src hands its nodes over instead of having them cloned.
+// When both maps use the same hash function and bucket count, bucket i of
+// one can only match bucket i of the other and nothing is hashed at all.
+// Other engines, and dst maps with live snapshots, go through the public
+// map_* calls. Many consumed sources can be merged at once, each thread
+// taking a range of dst's buckets.
+
+typedef void *(*combine_fn_t)(void *ctx, void *key, void *dst_value, void *src_value);
+
+// Chain-level access is possible (and safe) for this pair of maps. Caches
+// need their byte accounting and eviction, expiring maps their timers, a
+// logged dst its records and a filtered dst its filter, so they take the
+// public calls. So do maps with indexed chains, which the public calls
+// search in O(log n) instead of walking.
+static int setops_direct(const map_t *dst, const map_t *src) {
+    return dst->ops == NULL && src->ops == NULL && dst->snapshots == NULL &&
+           dst->cache_referenced == NULL && src->cache_referenced == NULL &&
+           dst->ttl == NULL && src->ttl == NULL && dst->wal == NULL &&
+           dst->filter.blocks == NULL && dst->chain_index == NULL &&
+           src->chain_index == NULL;
+}
+
+static int setops_lockstep(const map_t *dst, const map_t *src) {
+    return dst->usr_hash == src->usr_hash && dst->num_buckets == src->num_buckets;
+}
+
+static int setops_same_allocator(const map_t *a, const map_t *b) {
+    return a->allocator.alloc == b->allocator.alloc &&
+           a->allocator.free == b->allocator.free && a->allocator.ctx == b->allocator.ctx;
+}
+
+// Probe for a key stored in `from`, for a lookup in `to`. String keys
+// carry their hash; in lockstep user keys need none.
+static map_probe_t setops_probe(const map_t *from, const map_t *to, void *stored_key,
+                                int lockstep) {
+    if (from->key_mode == MAP_KEY_STRING && from->usr_hash == to->usr_hash) {
+        const map_key_header_t *header = __map_key_header(stored_key);
+        map_probe_t probe = {stored_key, header->hash, header->length};
+        return probe;
+    }
+    if (lockstep && to->key_mode == MAP_KEY_USER) {
+        map_probe_t probe = {stored_key, 0, 0};
+        return probe;
+    }
+    return __map_probe(to, stored_key);
+}
+
+static map_element_t **setops_find(const map_t *map, map_element_t **link,
+                                   const map_probe_t *probe) {
+    for (; *link != NULL; link = &(*link)->_next) {
+        if (__map_probe_compare(map, probe, (*link)->_key) == 0) return link;
+    }
+    return NULL;
+}
+
+// Resize once so the load factor ends up midway between its bounds.
+static void setops_fit(map_t *map, size_t entries) {
+    double load = (double)entries / map->num_buckets;
+    if (load <= map->max_load_factor &&
+        (load >= map->min_load_factor || map->num_buckets <= 1)) {
+        return;
+    }
+
+    double target = (double)entries / ((map->max_load_factor + map->min_load_factor) / 2);
+    if (target < 1) target = 1;
+    __map_resize(map, (float)(target / map->num_buckets));
+}
+
+// Merge src into dst on the chains. With `move`, src's nodes (and values)
+// are taken over and whatever is left in src is freed by the caller.
+static map_error_t merge_direct(map_t *dst, map_t *src, int move, combine_fn_t combine,
+                                void *ctx) {
+    int lockstep = setops_lockstep(dst, src);
+    if (!lockstep) setops_fit(dst, dst->num_entries + src->num_entries);
+
+    for (size_t i = 0; i < src->num_buckets; i++) {
+        map_element_t **link = &src->buckets[i];
+        while (*link != NULL) {
+            map_element_t *node = *link;
+            map_probe_t probe = setops_probe(src, dst, node->_key, lockstep);
+            size_t index = lockstep ? i : probe.hash % dst->num_buckets;
+            map_element_t **found = setops_find(dst, &dst->buckets[index], &probe);
+
+            if (found != NULL) {
+                map_element_t *target = *found;
+                void *value;
+                if (combine != NULL) {
+                    value = combine(ctx, target->_key, target->_value, node->_value);
+                    if (value == NULL) return MAP_ERR_NO_MEM;
+                } else if (move) {
+                    // Swap, so src frees the old dst value with its own node.
+                    value = node->_value;
+                    node->_value = target->_value;
+                    target->_value = value;
+                } else {
+                    value = dst->usr_value_clone(node->_value);
+                    if (value == NULL) return MAP_ERR_NO_MEM;
+                }
+                if (value != target->_value) {
+                    dst->usr_free_value(target->_value);
+                    target->_value = value;
+                }
+                link = &node->_next;
+                continue;
+            }
+
+            map_element_t *adopted;
+            void *key;
+            if (dst->key_mode == MAP_KEY_STRING) {
+                key = __map_string_copy(dst, &dst->key_chunks, node->_key);
+                if (key != NULL) dst->key_live_bytes += __map_key_header(key)->record_size;
+            } else {
+                key = move ? node->_key : dst->usr_key_clone(node->_key);
+            }
+            if (key == NULL) return MAP_ERR_NO_MEM;
+
+            if (move) {
+                *link = node->_next;
+                src->num_entries--;
+                adopted = node;
+            } else {
+                adopted = __map_alloc(dst, sizeof(map_element_t));
+                void *value = adopted != NULL ? dst->usr_value_clone(node->_value) : NULL;
+                if (value == NULL) {
+                    __map_free(dst, adopted, sizeof(map_element_t));
+                    __map_key_free(dst, key);
+                    return MAP_ERR_NO_MEM;
+                }
+                adopted->_value = value;
+                link = &node->_next;
+            }
+            adopted->_key = key;
+            adopted->_next = dst->buckets[index];
+            dst->buckets[index] = adopted;
+            dst->num_entries++;
+        }
+    }
+
+    setops_fit(dst, dst->num_entries);
+    __map_index_refresh(dst); // Chains may have grown long.
+    return MAP_OK;
+}
+
+// Merge through the public API, for other engines or snapshotted maps.
+static map_error_t merge_generic(map_t *dst, const map_t *src, combine_fn_t combine,
+                                 void *ctx) {
+    map_iterator_t iter;
+    void *key, *src_value, *dst_value;
+
+    if (map_iter_start(src, &iter) != MAP_OK) return MAP_OK;
+    while (map_iter_next(src, &iter, &key, &src_value) == MAP_OK) {
+        map_error_t result;
+        if (combine != NULL && map_get(dst, key, &dst_value) == MAP_OK) {
+            void *value = combine(ctx, key, dst_value, src_value);
+            if (value == NULL) {
+                map_iter_end(src, &iter);
+                return MAP_ERR_NO_MEM;
+            }
+            if (value == dst_value) continue;
+            result = __map_update_value(dst, key, value);
+            dst->usr_free_value(value);
+        } else {
+            result = map_insert(dst, key, src_value);
+        }
+        if (result != MAP_OK) {
+            map_iter_end(src, &iter);
+            return result;
+        }
+    }
+    return MAP_OK;
+}
+
+// Merge Function
+map_error_t map_merge(map_t *dst, const map_t *src,
+                      void *(*combine)(void *ctx, void *key, void *dst_value, void *src_value),
+                      void *ctx) {
+    if (dst == NULL || src == NULL || dst == src || dst->key_mode != src->key_mode) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    if (setops_direct(dst, src)) return merge_direct(dst, (map_t *)src, 0, combine, ctx);
+    return merge_generic(dst, src, combine, ctx);
+}
+
+// Consuming Merge Function
+map_error_t map_merge_consume(map_t *dst, map_t **src,
+                              void *(*combine)(void *ctx, void *key, void *dst_value,
+                                               void *src_value),
+                              void *ctx) {
+    if (dst == NULL || src == NULL || *src == NULL || dst == *src ||
+        dst->key_mode != (*src)->key_mode) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    // Nodes can only change hands when both maps free them the same way
+    // and no snapshot of src still reads them.
+    map_error_t result;
+    if (setops_direct(dst, *src) && setops_same_allocator(dst, *src) &&
+        (*src)->snapshots == NULL) {
+        result = merge_direct(dst, *src, 1, combine, ctx);
+    } else if (setops_direct(dst, *src)) {
+        result = merge_direct(dst, *src, 0, combine, ctx);
+    } else {
+        result = merge_generic(dst, *src, combine, ctx);
+    }
+    if (result != MAP_OK) {
+        return result;
+    }
+
+    map_destroy(src);
+    return MAP_OK;
+}
+
+// Parallel merge. Every source node is unlinked along with its dst bucket,
+// the nodes are sorted into `parts` contiguous bucket ranges, and each
+// range is merged by one worker, which alone touches its chains.
+typedef struct {
+    map_element_t *node;
+    size_t bucket;
+} reduce_item_t;
+
+typedef struct {
+    map_t *dst;
+    map_t **srcs;
+    size_t *sizes;          // Entries per source, taken before unlinking.
+    size_t parts;
+    reduce_item_t **items;  // Per source, its nodes in chain order.
+    size_t *offsets;        // [source * parts + part]: counts, then write positions.
+    size_t *part_starts;    // parts + 1 bounds into sorted.
+    reduce_item_t *sorted;  // All nodes, by part and then by source.
+    combine_fn_t combine;
+    void *ctx;
+    size_t added[MAP_MAX_THREADS];
+} reduce_job_t;
+
+static size_t reduce_part(const reduce_job_t *job, size_t bucket) {
+    return bucket * job->parts / job->dst->num_buckets;
+}
+
+// Unlink the nodes of sources [begin, end) and count them per part.
+static map_error_t reduce_take(void *ctx, int worker, size_t begin, size_t end) {
+    reduce_job_t *job = (reduce_job_t *)ctx;
+    const map_t *dst = job->dst;
+    (void)worker;
+
+    for (size_t s = begin; s < end; s++) {
+        map_t *src = job->srcs[s];
+        int lockstep = setops_lockstep(dst, src);
+        reduce_item_t *item = job->items[s];
+        for (size_t i = 0; i < src->num_buckets; i++) {
+            for (map_element_t *node = src->buckets[i]; node != NULL; node = node->_next) {
+                item->node = node;
+                item->bucket = lockstep ? i : dst->usr_hash(node->_key) % dst->num_buckets;
+                job->offsets[s * job->parts + reduce_part(job, item->bucket)]++;
+                item++;
+            }
+            src->buckets[i] = NULL;
+        }
+        src->num_entries = 0;
+    }
+    return MAP_OK;
+}
+
+// Copy the nodes of sources [begin, end) to their places in sorted.
+static map_error_t reduce_scatter(void *ctx, int worker, size_t begin, size_t end) {
+    reduce_job_t *job = (reduce_job_t *)ctx;
+    (void)worker;
+
+    for (size_t s = begin; s < end; s++) {
+        size_t *positions = &job->offsets[s * job->parts];
+        for (size_t i = 0; i < job->sizes[s]; i++) {
+            const reduce_item_t *item = &job->items[s][i];
+            job->sorted[positions[reduce_part(job, item->bucket)]++] = *item;
+        }
+    }
+    return MAP_OK;
+}
+
+// Free a node no map holds any more.
+static void reduce_drop(map_t *dst, map_element_t *node) {
+    dst->usr_free_key(node->_key);
+    dst->usr_free_value(node->_value);
+    __map_free(dst, node, sizeof(map_element_t));
+}
+
+// Link the nodes of parts [begin, end) into dst, as merge_direct() does
+// when moving. If combine fails, the part's remaining nodes are dropped.
+static map_error_t reduce_merge(void *ctx, int worker, size_t begin, size_t end) {
+    reduce_job_t *job = (reduce_job_t *)ctx;
+    map_t *dst = job->dst;
+    map_error_t result = MAP_OK;
+
+    for (size_t i = job->part_starts[begin]; i < job->part_starts[end]; i++) {
+        map_element_t *node = job->sorted[i].node;
+        if (result != MAP_OK) {
+            reduce_drop(dst, node);
+            continue;
+        }
+
+        map_probe_t probe = {node->_key, 0, 0};
+        map_element_t **link = &dst->buckets[job->sorted[i].bucket];
+        map_element_t **found = setops_find(dst, link, &probe);
+        if (found == NULL) {
+            node->_next = *link;
+            *link = node;
+            job->added[worker]++;
+            continue;
+        }
+
+        map_element_t *target = *found;
+        if (job->combine != NULL) {
+            void *value = job->combine(job->ctx, target->_key, target->_value, node->_value);
+            if (value == NULL) {
+                result = MAP_ERR_NO_MEM;
+                reduce_drop(dst, node);
+                continue;
+            }
+            if (value != target->_value) {
+                dst->usr_free_value(target->_value);
+                target->_value = value;
+            }
+            dst->usr_free_value(node->_value);
+        } else {
+            dst->usr_free_value(target->_value);
+            target->_value = node->_value;
+        }
+        dst->usr_free_key(node->_key);
+        __map_free(dst, node, sizeof(map_element_t));
+    }
+    return result;
+}
+
+// Whether every source can hand its nodes to dst on the chains.
+static int reduce_direct(const map_t *dst, map_t *const *srcs, size_t count) {
+    if (dst->key_mode != MAP_KEY_USER) return 0; // String keys live in each map's arena.
+    for (size_t s = 0; s < count; s++) {
+        if (!setops_direct(dst, srcs[s]) || !setops_same_allocator(dst, srcs[s]) ||
+            srcs[s]->snapshots != NULL) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void reduce_free(reduce_job_t *job, size_t count) {
+    if (job->items != NULL) {
+        for (size_t s = 0; s < count; s++) free(job->items[s]);
+    }
+    free(job->items);
+    free(job->sizes);
+    free(job->offsets);
+    free(job->part_starts);
+    free(job->sorted);
+}
+
+// Parallel Merge Function
+map_error_t map_merge_parallel(map_t *dst, map_t **srcs, size_t count, int nthreads,
+                               void *(*combine)(void *ctx, void *key, void *dst_value,
+                                                void *src_value),
+                               void *ctx) {
+    if (dst == NULL || srcs == NULL || nthreads < 1) return MAP_ERR_INVALID_ARG;
+    for (size_t s = 0; s < count; s++) {
+        if (srcs[s] == NULL || srcs[s] == dst || srcs[s]->key_mode != dst->key_mode) {
+            return MAP_ERR_INVALID_ARG;
+        }
+        for (size_t t = 0; t < s; t++) {
+            if (srcs[t] == srcs[s]) return MAP_ERR_INVALID_ARG;
+        }
+    }
+    if (count == 0) return MAP_OK;
+
+    if (!reduce_direct(dst, srcs, count)) {
+        map_error_t result = MAP_OK;
+        for (size_t s = 0; s < count; s++) {
+            if (result == MAP_OK) result = map_merge_consume(dst, &srcs[s], combine, ctx);
+            if (srcs[s] != NULL) map_destroy(&srcs[s]);
+        }
+        return result;
+    }
+
+    // Everything is allocated before the first node leaves its map.
+    reduce_job_t job;
+    memset(&job, 0, sizeof(job));
+    job.dst = dst;
+    job.srcs = srcs;
+    job.combine = combine;
+    job.ctx = ctx;
+    job.sizes = malloc(count * sizeof(size_t));
+    job.items = calloc(count, sizeof(reduce_item_t *));
+    if (job.sizes == NULL || job.items == NULL) {
+        reduce_free(&job, 0);
+        return MAP_ERR_NO_MEM;
+    }
+    size_t total = 0;
+    for (size_t s = 0; s < count; s++) {
+        job.sizes[s] = srcs[s]->num_entries;
+        total += job.sizes[s];
+        job.items[s] = malloc((job.sizes[s] > 0 ? job.sizes[s] : 1) * sizeof(reduce_item_t));
+        if (job.items[s] == NULL) {
+            reduce_free(&job, count);
+            return MAP_ERR_NO_MEM;
+        }
+    }
+
+    if (!__map_thread_safe_alloc(dst)) nthreads = 1;
+    job.parts = (size_t)__map_parallel_workers(nthreads, total, MAP_PARALLEL_MIN_ITEMS);
+    job.offsets = calloc(count * job.parts, sizeof(size_t));
+    job.part_starts = malloc((job.parts + 1) * sizeof(size_t));
+    job.sorted = malloc((total > 0 ? total : 1) * sizeof(reduce_item_t));
+    if (job.offsets == NULL || job.part_starts == NULL || job.sorted == NULL) {
+        reduce_free(&job, count);
+        return MAP_ERR_NO_MEM;
+    }
+
+    setops_fit(dst, dst->num_entries + total);
+    int workers = __map_parallel_workers((int)job.parts, count, 1);
+    __map_parallel_for(workers, count, reduce_take, &job);
+
+    // Part p's nodes follow those of the parts before it, source by source.
+    size_t position = 0;
+    for (size_t p = 0; p < job.parts; p++) {
+        job.part_starts[p] = position;
+        for (size_t s = 0; s < count; s++) {
+            size_t n = job.offsets[s * job.parts + p];
+            job.offsets[s * job.parts + p] = position;
+            position += n;
+        }
+    }
+    job.part_starts[job.parts] = position;
+    __map_parallel_for(workers, count, reduce_scatter, &job);
+
+    map_error_t result = __map_parallel_for((int)job.parts, job.parts, reduce_merge, &job);
+    for (size_t w = 0; w < job.parts; w++) dst->num_entries += job.added[w];
+    for (size_t s = 0; s < count; s++) map_destroy(&srcs[s]);
+    reduce_free(&job, count);
+
+    setops_fit(dst, dst->num_entries);
+    __map_index_refresh(dst); // Chains may have grown long.
+    return result;
+}
+
+// Free a node unlinked from a map without snapshots.
+static void setops_drop(map_t *map, map_element_t *node) {
+    __map_key_free(map, node->_key);
+    map->usr_free_value(node->_value);
+    __map_free(map, node, sizeof(map_element_t));
+    map->num_entries--;
+}
+
+// Keep the dst keys whose presence in src equals `keep_present`.
+static map_error_t filter_direct(map_t *dst, const map_t *src, int keep_present,
+                                 combine_fn_t combine, void *ctx) {
+    int lockstep = setops_lockstep(dst, src);
+
+    for (size_t i = 0; i < dst->num_buckets; i++) {
+        map_element_t **link = &dst->buckets[i];
+        while (*link != NULL) {
+            map_element_t *node = *link;
+            map_probe_t probe = setops_probe(dst, src, node->_key, lockstep);
+            size_t index = lockstep ? i : probe.hash % src->num_buckets;
+            map_element_t **found = setops_find(src, &src->buckets[index], &probe);
+
+            if ((found != NULL) != keep_present) {
+                *link = node->_next;
+                setops_drop(dst, node);
+                continue;
+            }
+            if (found != NULL && combine != NULL) {
+                void *value = combine(ctx, node->_key, node->_value, (*found)->_value);
+                if (value == NULL) return MAP_ERR_NO_MEM;
+                if (value != node->_value) {
+                    dst->usr_free_value(node->_value);
+                    node->_value = value;
+                }
+            }
+            link = &node->_next;
+        }
+    }
+
+    setops_fit(dst, dst->num_entries);
+    return MAP_OK;
+}
+
+// Filter through the public API. Keys are removed as the walk passes
+// them; combined values are collected and stored after it, since storing
+// them can evict entries from a cache. The collected keys are copies: a
+// disk partition the walk passed may be spilled, and its keys freed, by
+// the stores, and a cache may evict keys still waiting.
+typedef struct {
+    void *key;   // Copy, in dst's key storage.
+    void *value; // Combined value to store.
+} filter_change_t;
+
+static map_error_t filter_generic(map_t *dst, const map_t *src, int keep_present,
+                                  combine_fn_t combine, void *ctx) {
+    map_iterator_t iter;
+    void *key, *dst_value, *src_value;
+    filter_change_t *changes = NULL;
+    size_t num_changes = 0, capacity = 0;
+    map_error_t result = MAP_OK;
+
+    if (map_iter_start(dst, &iter) != MAP_OK) return MAP_OK;
+    while (map_iter_next(dst, &iter, &key, &dst_value) == MAP_OK) {
+        int present = map_get(src, key, &src_value) == MAP_OK;
+        if (present != keep_present) {
+            result = map_iter_remove(dst, &iter);
+            if (result != MAP_OK) break;
+            continue;
+        }
+        if (!present || combine == NULL) continue;
+
+        void *value = combine(ctx, key, dst_value, src_value);
+        if (value == NULL) {
+            result = MAP_ERR_NO_MEM;
+            break;
+        }
+        if (value == dst_value) continue;
+
+        map_probe_t probe = __map_probe(dst, key);
+        void *key_copy = __map_key_clone(dst, &probe);
+        if (key_copy != NULL && num_changes == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            filter_change_t *grown = realloc(changes, capacity * sizeof(filter_change_t));
+            if (grown == NULL) {
+                __map_key_free(dst, key_copy);
+                key_copy = NULL;
+            } else {
+                changes = grown;
+            }
+        }
+        if (key_copy == NULL) {
+            dst->usr_free_value(value);
+            result = MAP_ERR_NO_MEM;
+            break;
+        }
+        changes[num_changes].key = key_copy;
+        changes[num_changes].value = value;
+        num_changes++;
+    }
+    map_iter_end(dst, &iter);
+
+    for (size_t i = 0; i < num_changes; i++) {
+        if (result == MAP_OK) {
+            result = __map_update_value(dst, changes[i].key, changes[i].value);
+        }
+        __map_key_free(dst, changes[i].key);
+        dst->usr_free_value(changes[i].value);
+    }
+    free(changes);
+    return result;
+}
+
+// Intersect Function
+map_error_t map_intersect(map_t *dst, const map_t *src,
+                          void *(*combine)(void *ctx, void *key, void *dst_value,
+                                           void *src_value),
+                          void *ctx) {
+    if (dst == NULL || src == NULL || dst == src || dst->key_mode != src->key_mode) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    if (setops_direct(dst, src)) return filter_direct(dst, src, 1, combine, ctx);
+    return filter_generic(dst, src, 1, combine, ctx);
+}
+
+// Difference Function
+map_error_t map_difference(map_t *dst, const map_t *src) {
+    if (dst == NULL || src == NULL || dst == src || dst->key_mode != src->key_mode) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    if (setops_direct(dst, src)) return filter_direct(dst, src, 0, NULL, NULL);
+    return filter_generic(dst, src, 0, NULL, NULL);
+}
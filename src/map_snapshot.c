@@ -0,0 +1,264 @@
+#include <map.h>
+#include <map_internal.h>
+#include <string.h>
+
+// Copy-on-write snapshots. A snapshot copies the bucket heads and nothing
+// else. Afterwards the map copies a chain the first time it writes to it
+// (marking the bucket private), and anything a snapshot may still reach is
+// parked on the retired list instead of being freed. Resizes and key
+// compaction wait until the last snapshot is gone.
+
+static size_t cow_words(size_t num_buckets) {
+    return (num_buckets + 63) / 64;
+}
+
+// Smallest id among live snapshots, or UINT64_MAX when there are none.
+static uint64_t snapshot_min_id(const map_t *map) {
+    uint64_t min_id = UINT64_MAX;
+    for (const map_snapshot_t *s = map->snapshots; s != NULL; s = s->next) {
+        if (s->id < min_id) min_id = s->id;
+    }
+    return min_id;
+}
+
+// Free retired memory that no live snapshot can reach anymore.
+static void retired_collect(map_t *map) {
+    uint64_t min_id = snapshot_min_id(map);
+    size_t done = 0;
+
+    // Retired entries are appended in epoch order, so stop at the first one
+    // a live snapshot still covers.
+    while (done < map->num_retired && map->retired[done].epoch < min_id) {
+        map_retired_t *r = &map->retired[done++];
+        switch (r->kind) {
+        case MAP_RETIRED_NODE:
+            __map_free(map, r->ptr, sizeof(map_element_t));
+            break;
+        case MAP_RETIRED_KEY:
+            __map_key_free(map, r->ptr);
+            break;
+        case MAP_RETIRED_VALUE:
+            map->usr_free_value(r->ptr);
+            break;
+        }
+    }
+    map->num_retired -= done;
+    memmove(map->retired, map->retired + done, map->num_retired * sizeof(map_retired_t));
+
+    if (map->num_retired == 0) {
+        __map_free(map, map->retired, map->retired_capacity * sizeof(map_retired_t));
+        map->retired = NULL;
+        map->retired_capacity = 0;
+    }
+}
+
+// Make room for `count` more retired entries.
+map_error_t __map_retire_reserve(map_t *map, size_t count) {
+    if (map->retired_capacity - map->num_retired >= count) return MAP_OK;
+
+    size_t capacity = map->retired_capacity ? map->retired_capacity * 2 : 64;
+    while (capacity - map->num_retired < count) capacity *= 2;
+    map_retired_t *grown = __map_realloc(map, map->retired,
+                                         map->retired_capacity * sizeof(map_retired_t),
+                                         capacity * sizeof(map_retired_t));
+    if (grown == NULL) return MAP_ERR_NO_MEM;
+    map->retired = grown;
+    map->retired_capacity = capacity;
+    return MAP_OK;
+}
+
+// Park ptr until the snapshots that can see it are released. Space must
+// have been reserved with __map_retire_reserve().
+void __map_retire(map_t *map, void *ptr, map_retired_kind_t kind) {
+    map_retired_t *r = &map->retired[map->num_retired++];
+    r->ptr = ptr;
+    r->epoch = map->snapshot_seq;
+    r->kind = kind;
+}
+
+// Give bucket `index` a chain of its own before it is written to. Keys and
+// values are shared with the old nodes, which are retired.
+map_error_t __map_cow_bucket(map_t *map, uint64_t index) {
+    uint64_t bit = 1ULL << (index % 64);
+    if (map->cow_private[index / 64] & bit) return MAP_OK;
+
+    size_t length = 0;
+    for (map_element_t *cur = map->buckets[index]; cur != NULL; cur = cur->_next) length++;
+    if (__map_retire_reserve(map, length) != MAP_OK) return MAP_ERR_NO_MEM;
+
+    map_element_t *head = NULL;
+    map_element_t **tail = &head;
+    for (map_element_t *cur = map->buckets[index]; cur != NULL; cur = cur->_next) {
+        map_element_t *copy = __map_alloc(map, sizeof(map_element_t));
+        if (copy == NULL) {
+            while (head != NULL) {
+                map_element_t *next = head->_next;
+                __map_free(map, head, sizeof(map_element_t));
+                head = next;
+            }
+            return MAP_ERR_NO_MEM;
+        }
+        copy->_key = cur->_key;
+        copy->_value = cur->_value;
+        copy->_next = NULL;
+        *tail = copy;
+        tail = &copy->_next;
+    }
+
+    for (map_element_t *cur = map->buckets[index]; cur != NULL; cur = cur->_next) {
+        __map_retire(map, cur, MAP_RETIRED_NODE);
+    }
+    map->buckets[index] = head;
+    map->cow_private[index / 64] |= bit;
+    if (__map_index_of(map, index) != NULL) __map_index_build(map, index); // New nodes.
+    return MAP_OK;
+}
+
+// Snapshot Function
+map_error_t map_snapshot(map_t *map, map_snapshot_t **out) {
+    // Expiring maps free entries from lookups, which snapshots can't follow.
+    if (map == NULL || out == NULL || map->ops != NULL || map->ttl != NULL ||
+        map->destroy_pending) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    size_t heads_size = map->num_buckets * sizeof(map_element_t *);
+    map_snapshot_t *snap = __map_alloc(map, sizeof(map_snapshot_t));
+    if (snap == NULL) {
+        return MAP_ERR_NO_MEM;
+    }
+    snap->buckets = __map_alloc(map, heads_size);
+    if (snap->buckets == NULL) {
+        __map_free(map, snap, sizeof(map_snapshot_t));
+        return MAP_ERR_NO_MEM;
+    }
+
+    // Resizes are deferred while snapshots live, so the bitmap keeps its size.
+    if (map->cow_private == NULL) {
+        map->cow_private = __map_alloc(map, cow_words(map->num_buckets) * sizeof(uint64_t));
+        if (map->cow_private == NULL) {
+            __map_free(map, snap->buckets, heads_size);
+            __map_free(map, snap, sizeof(map_snapshot_t));
+            return MAP_ERR_NO_MEM;
+        }
+    }
+    memset(map->cow_private, 0, cow_words(map->num_buckets) * sizeof(uint64_t));
+
+    memcpy(snap->buckets, map->buckets, heads_size);
+    snap->map = map;
+    snap->num_buckets = map->num_buckets;
+    snap->num_entries = map->num_entries;
+    snap->id = ++map->snapshot_seq;
+    snap->refcount = 1;
+    snap->prev = NULL;
+    snap->next = map->snapshots;
+    if (map->snapshots != NULL) map->snapshots->prev = snap;
+    map->snapshots = snap;
+
+    *out = snap;
+    return MAP_OK;
+}
+
+// Snapshot Retain Function
+map_error_t map_snapshot_retain(map_snapshot_t *snap) {
+    if (snap == NULL || snap->refcount <= 0) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    snap->refcount++;
+    return MAP_OK;
+}
+
+// Snapshot Release Function
+map_error_t map_snapshot_release(map_snapshot_t **snap) {
+    if (snap == NULL || *snap == NULL || (*snap)->refcount <= 0) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    map_snapshot_t *s = *snap;
+    *snap = NULL;
+    if (--s->refcount > 0) {
+        return MAP_OK;
+    }
+
+    map_t *map = s->map;
+    if (s->prev != NULL) s->prev->next = s->next;
+    else map->snapshots = s->next;
+    if (s->next != NULL) s->next->prev = s->prev;
+    __map_free(map, s->buckets, s->num_buckets * sizeof(map_element_t *));
+    __map_free(map, s, sizeof(map_snapshot_t));
+
+    retired_collect(map);
+    if (map->snapshots == NULL) {
+        __map_free(map, map->cow_private, cow_words(map->num_buckets) * sizeof(uint64_t));
+        map->cow_private = NULL;
+        if (map->destroy_pending) __map_teardown(map);
+    }
+    return MAP_OK;
+}
+
+// Snapshot Get Function
+map_error_t map_snapshot_get(const map_snapshot_t *snap, void *key, void **out_value) {
+    if (snap == NULL || key == NULL || out_value == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    const map_t *map = snap->map;
+    map_probe_t probe = __map_probe(map, key);
+    map_element_t *current = snap->buckets[probe.hash % snap->num_buckets];
+    while (current != NULL) {
+        if (__map_probe_compare(map, &probe, current->_key) == 0) {
+            *out_value = current->_value;
+            return MAP_OK;
+        }
+        current = current->_next;
+    }
+    return MAP_ERR_NOT_FOUND;
+}
+
+// Snapshot Size Getting Function
+map_error_t map_snapshot_get_size(const map_snapshot_t *snap, size_t *num_elements) {
+    if (snap == NULL || num_elements == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    *num_elements = snap->num_entries;
+    return MAP_OK;
+}
+
+// Snapshot Iterator Start Function
+map_error_t map_snapshot_iter_start(const map_snapshot_t *snap, map_iterator_t *iter) {
+    if (snap == NULL || iter == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    iter->current_bucket = 0;
+    iter->current_element = NULL;
+    for (size_t i = 0; i < snap->num_buckets; i++) {
+        if (snap->buckets[i] != NULL) {
+            iter->current_bucket = i;
+            iter->current_element = snap->buckets[i];
+            return MAP_OK;
+        }
+    }
+    return MAP_ERR_END_OF_MAP;
+}
+
+// Snapshot Iterator Next Function
+map_error_t map_snapshot_iter_next(const map_snapshot_t *snap, map_iterator_t *iter,
+                                   void **out_key, void **out_value) {
+    if (snap == NULL || iter == NULL || out_key == NULL || out_value == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    while (iter->current_element == NULL) {
+        if (iter->current_bucket + 1 >= snap->num_buckets) return MAP_ERR_END_OF_MAP;
+        iter->current_bucket++;
+        iter->current_element = snap->buckets[iter->current_bucket];
+    }
+
+    *out_key = iter->current_element->_key;
+    *out_value = iter->current_element->_value;
+    iter->current_element = iter->current_element->_next;
+    return MAP_OK;
+}
@@ -0,0 +1,248 @@
+#define _POSIX_C_SOURCE 200809L
+#include <map.h>
+#include <map_internal.h>
+#include <string.h>
+#include <time.h>
+
+// Expiring entries. Each node carries its deadline and its place in a
+// hierarchical timer wheel (map_ttl_wheel_t), so setting a TTL allocates
+// nothing. map_expire() jumps from one occupied slot to the next using the
+// per-level bitmaps, so idle stretches cost nothing and every call does at
+// most `budget` units of work. Lookups also drop expired entries on sight.
+
+#define TTL_TOP_SHIFT (MAP_TTL_LEVELS * MAP_TTL_SLOT_BITS)
+
+static uint64_t ttl_monotonic_ms(void *ctx) {
+    (void)ctx;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static map_ttl_element_t *ttl_node(map_element_t *node) {
+    return (map_ttl_element_t *)node;
+}
+
+// Set up the wheel. clock NULL means the monotonic millisecond clock; a
+// clone passes its source's wheel time as `now`, everyone else 0.
+map_error_t __map_ttl_init(map_t *map, uint64_t (*clock)(void *ctx), void *clock_ctx,
+                           uint64_t now) {
+    map_ttl_wheel_t *wheel = __map_calloc(map, 1, sizeof(map_ttl_wheel_t));
+    if (wheel == NULL) {
+        return MAP_ERR_NO_MEM;
+    }
+
+    wheel->clock = clock != NULL ? clock : ttl_monotonic_ms;
+    wheel->clock_ctx = clock_ctx;
+    wheel->now = now != 0 ? now : wheel->clock(wheel->clock_ctx);
+    map->ttl = wheel;
+    return MAP_OK;
+}
+
+void __map_ttl_free(map_t *map) {
+    __map_free(map, map->ttl, sizeof(map_ttl_wheel_t));
+    map->ttl = NULL;
+}
+
+// Hook node into the slot its deadline falls in, relative to the wheel's
+// current tick. Late deadlines go into the current slot.
+static void ttl_place(map_ttl_wheel_t *wheel, map_ttl_element_t *node) {
+    uint64_t tick = node->expires > wheel->now ? node->expires : wheel->now;
+    map_ttl_element_t **head = &wheel->overflow;
+
+    if (tick >> TTL_TOP_SHIFT == wheel->now >> TTL_TOP_SHIFT) {
+        // Lowest level above which tick and now agree.
+        int level = 0;
+        while ((tick >> ((level + 1) * MAP_TTL_SLOT_BITS)) !=
+               (wheel->now >> ((level + 1) * MAP_TTL_SLOT_BITS))) {
+            level++;
+        }
+        int slot = (int)(tick >> (level * MAP_TTL_SLOT_BITS)) & (MAP_TTL_SLOTS - 1);
+        head = &wheel->slots[level][slot];
+        wheel->occupied[level] |= (uint64_t)1 << slot;
+    }
+
+    node->timer_next = *head;
+    if (*head != NULL) (*head)->timer_link = &node->timer_next;
+    node->timer_link = head;
+    *head = node;
+}
+
+void __map_ttl_unlink(map_element_t *node) {
+    map_ttl_element_t *timer = ttl_node(node);
+    if (timer->timer_link == NULL) return;
+
+    *timer->timer_link = timer->timer_next;
+    if (timer->timer_next != NULL) timer->timer_next->timer_link = timer->timer_link;
+    timer->timer_next = NULL;
+    timer->timer_link = NULL;
+}
+
+// Give node a new deadline (0 clears it).
+void __map_ttl_set(map_t *map, map_element_t *node, uint64_t expires) {
+    __map_ttl_unlink(node);
+    ttl_node(node)->expires = expires;
+    if (expires != 0) ttl_place(map->ttl, ttl_node(node));
+}
+
+int __map_ttl_due(const map_t *map, map_element_t *node) {
+    uint64_t expires = ttl_node(node)->expires;
+    return expires != 0 && expires <= map->ttl->clock(map->ttl->clock_ctx);
+}
+
+// Unlink node (found in bucket index, after prev) and free it. An iterator
+// may be parked on it, so this ends iterations.
+void __map_ttl_drop(map_t *map, size_t index, map_element_t *prev, map_element_t *node) {
+    if (prev == NULL) map->buckets[index] = node->_next;
+    else prev->_next = node->_next;
+    map->resize_epoch++;
+
+    __map_ttl_unlink(node);
+    if (map->cache_referenced != NULL) {
+        map->cache_bytes -= __map_cache_charge(map, node->_key, node->_value);
+    }
+    if (map->filter.blocks != NULL) {
+        __map_filter_remove(&map->filter, __map_stored_hash(map, node->_key));
+    }
+    __map_index_remove(map, index, node);
+    __map_key_free(map, node->_key);
+    map->usr_free_value(node->_value);
+    __map_free(map, node, sizeof(map_ttl_element_t));
+    map->num_entries--;
+}
+
+// Remove a node found through the wheel, which only knows the node.
+static void ttl_expire_node(map_t *map, map_element_t *node) {
+    size_t index = __map_stored_hash(map, node->_key) % map->num_buckets;
+    map_element_t *prev = NULL;
+    for (map_element_t *cur = map->buckets[index]; cur != node; cur = cur->_next) prev = cur;
+    __map_ttl_drop(map, index, prev, node);
+}
+
+// Find the next tick with work: expiring a level 0 slot, moving a higher
+// slot down, or redistributing the overflow list. Returns the level (or
+// MAP_TTL_LEVELS for the overflow list), or -1 if the wheel is empty. On
+// ties the higher level goes first, so entries reach level 0 in time.
+static int ttl_next_event(const map_ttl_wheel_t *wheel, uint64_t *out_tick) {
+    uint64_t now = wheel->now;
+    int found = -1;
+
+    // Finish placing the last turn-over's nodes before time moves on.
+    if (wheel->pulling != NULL) {
+        *out_tick = now;
+        return MAP_TTL_LEVELS;
+    }
+
+    for (int level = 0; level < MAP_TTL_LEVELS; level++) {
+        int shift = level * MAP_TTL_SLOT_BITS;
+        int current = (int)(now >> shift) & (MAP_TTL_SLOTS - 1);
+        uint64_t pending = wheel->occupied[level] & (~(uint64_t)0 << current);
+        if (pending == 0) continue;
+
+        uint64_t span = (uint64_t)1 << (shift + MAP_TTL_SLOT_BITS);
+        uint64_t tick = (now & ~(span - 1)) | ((uint64_t)__builtin_ctzll(pending) << shift);
+        if (tick < now) tick = now; // This slot's turn came; it is still being moved.
+        if (found < 0 || tick <= *out_tick) {
+            *out_tick = tick;
+            found = level;
+        }
+    }
+
+    if (wheel->overflow != NULL) {
+        uint64_t tick = ((now >> TTL_TOP_SHIFT) + 1) << TTL_TOP_SHIFT;
+        if (found < 0 || tick <= *out_tick) {
+            *out_tick = tick;
+            found = MAP_TTL_LEVELS;
+        }
+    }
+    return found;
+}
+
+// Insert With TTL Function
+map_error_t map_insert_ttl(map_t *map, void *key, void *value, uint64_t ttl) {
+    if (map == NULL || key == NULL || value == NULL || map->ttl == NULL || ttl == 0) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    map_element_t *node;
+    map_error_t result = __map_insert_entry(map, key, value, &node);
+    if (result != MAP_OK) return result;
+    __map_ttl_set(map, node, map->ttl->clock(map->ttl->clock_ctx) + ttl);
+
+    if (map->cache_referenced != NULL) {
+        result = __map_cache_evict(map);
+        if (result != MAP_OK) return result;
+    }
+    if ((double)map->num_entries / map->num_buckets > map->max_load_factor) {
+        result = __map_resize(map, map->grow_factor);
+        if (result != MAP_OK) return result;
+    }
+    return MAP_OK;
+}
+
+// Expire Function
+map_error_t map_expire(map_t *map, uint64_t now, size_t budget, size_t *out_expired) {
+    if (map == NULL || map->ttl == NULL || budget == 0) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    map_ttl_wheel_t *wheel = map->ttl;
+    size_t work = 0, expired = 0;
+    uint64_t tick = 0;
+    int level;
+
+    while (work < budget) {
+        level = ttl_next_event(wheel, &tick);
+        if (level < 0 || tick > now) {
+            // Nothing is due before now: skip straight past it.
+            if (now >= wheel->now) wheel->now = now + 1;
+            break;
+        }
+        wheel->now = tick;
+
+        if (level == MAP_TTL_LEVELS) {
+            // Once per 2^24 ticks: pull the overflow list into the wheel.
+            // Nodes still waiting stay linked on `pulling` for the next call.
+            if (wheel->pulling == NULL) {
+                wheel->pulling = wheel->overflow;
+                wheel->overflow = NULL;
+                if (wheel->pulling != NULL) wheel->pulling->timer_link = &wheel->pulling;
+            }
+            while (wheel->pulling != NULL && work < budget) {
+                map_ttl_element_t *node = wheel->pulling;
+                __map_ttl_unlink(&node->base);
+                ttl_place(wheel, node);
+                work++;
+            }
+            continue;
+        }
+
+        int slot = (int)(tick >> (level * MAP_TTL_SLOT_BITS)) & (MAP_TTL_SLOTS - 1);
+        map_ttl_element_t **head = &wheel->slots[level][slot];
+        while (*head != NULL && work < budget) {
+            map_ttl_element_t *node = *head;
+            if (level == 0) {
+                ttl_expire_node(map, &node->base);
+                expired++;
+            } else {
+                __map_ttl_unlink(&node->base);
+                ttl_place(wheel, node); // Lands on a lower level.
+            }
+            work++;
+        }
+        if (*head == NULL) wheel->occupied[level] &= ~((uint64_t)1 << slot);
+    }
+
+    if (out_expired != NULL) *out_expired = expired;
+    return MAP_OK;
+}
+
+// TTL Clock Function
+map_error_t map_ttl_now(const map_t *map, uint64_t *out_now) {
+    if (map == NULL || out_now == NULL || map->ttl == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    *out_now = map->ttl->clock(map->ttl->clock_ctx);
+    return MAP_OK;
+}
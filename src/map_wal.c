@@ -0,0 +1,516 @@
+#define _POSIX_C_SOURCE 200809L
+#include <map.h>
+#include <map_internal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Write-ahead log. The file starts with WAL_MAGIC, followed by records:
+//
+//   op (1 byte) | key length (4) | value length (4) | key | value | checksum (4)
+//
+// Integers are little-endian and the checksum covers everything before it.
+// Records go into an in-memory buffer that is written out when it fills up
+// and fsync'ed once the group commit limits say so, so one fsync covers
+// many records. Replay stops at the first short or damaged record (a torn
+// write from a crash) and cuts the file there.
+
+#define WAL_MAGIC "LIBMAPW1"
+#define WAL_MAGIC_SIZE 8
+#define WAL_HEADER_SIZE 9
+#define WAL_CHECKSUM_SIZE 4
+#define WAL_CHECKSUM_SEED 0x6c69626d61707761ULL
+#define WAL_DEFAULT_BUFFER (64 * 1024)
+#define WAL_READ_CHUNK (64 * 1024)
+
+static void wal_put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t wal_get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint32_t wal_checksum(const uint8_t *p, size_t len) {
+    return (uint32_t)map_hash_bytes(p, len, WAL_CHECKSUM_SEED);
+}
+
+static uint64_t wal_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static map_error_t wal_write_all(int fd, const uint8_t *p, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return MAP_ERR_IO;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return MAP_OK;
+}
+
+// fsync the directory holding path, so a new or renamed log survives a
+// crash. Best effort: not every file system allows it.
+static void wal_sync_dir(const char *path) {
+    const char *slash = strrchr(path, '/');
+    char dir[4096];
+    if (slash == NULL) {
+        strcpy(dir, ".");
+    } else {
+        size_t len = slash == path ? 1 : (size_t)(slash - path);
+        if (len >= sizeof(dir)) return;
+        memcpy(dir, path, len);
+        dir[len] = '\0';
+    }
+
+    int fd = open(dir, O_RDONLY);
+    if (fd < 0) return;
+    fsync(fd);
+    close(fd);
+}
+
+// Hand the buffered records to the kernel. A write that fails part way
+// is cut off again and the buffer kept whole, so a retry doesn't repeat
+// the bytes that got through; if the cut fails too, the log is failed
+// for good rather than replayed up to the damage.
+static map_error_t wal_flush(map_wal_t *wal) {
+    if (wal->failed) return MAP_ERR_IO;
+    if (wal_write_all(wal->fd, wal->buffer, wal->buffer_used) != MAP_OK) {
+        if (ftruncate(wal->fd, (off_t)wal->file_size) != 0) wal->failed = 1;
+        return MAP_ERR_IO;
+    }
+    wal->file_size += wal->buffer_used;
+    wal->buffer_used = 0;
+    return MAP_OK;
+}
+
+// Make everything flushed so far durable.
+static map_error_t wal_fsync(map_wal_t *wal) {
+    if (fsync(wal->fd) != 0) return MAP_ERR_IO;
+
+    wal->unsynced = 0;
+    wal->last_sync_ms = wal_now_ms();
+    return MAP_OK;
+}
+
+// Flush, then sync.
+static map_error_t wal_commit(map_wal_t *wal) {
+    map_error_t result = wal_flush(wal);
+    return result == MAP_OK ? wal_fsync(wal) : result;
+}
+
+// Make room for a record of `need` bytes at the end of the buffer.
+static map_error_t wal_reserve(map_t *map, size_t need) {
+    map_wal_t *wal = map->wal;
+    if (wal->buffer_capacity - wal->buffer_used >= need) return MAP_OK;
+
+    map_error_t result = wal_flush(wal);
+    if (result != MAP_OK || wal->buffer_capacity >= need) return result;
+
+    uint8_t *grown = __map_realloc(map, wal->buffer, wal->buffer_capacity, need);
+    if (grown == NULL) return MAP_ERR_NO_MEM;
+    wal->buffer = grown;
+    wal->buffer_capacity = need;
+    return MAP_OK;
+}
+
+// Encode one record straight into the buffer, growing it if the first try
+// didn't fit, and set *out_len to its size. Doesn't sync.
+static map_error_t wal_encode(map_t *map, map_wal_op_t op, void *key, void *value,
+                              size_t *out_len) {
+    map_wal_t *wal = map->wal;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        size_t room = wal->buffer_capacity - wal->buffer_used;
+        uint8_t *record = wal->buffer + wal->buffer_used;
+
+        size_t at = WAL_HEADER_SIZE;
+        size_t key_len = wal->options.encode_key(key, at < room ? record + at : NULL,
+                                                 at < room ? room - at : 0);
+        at += key_len;
+        size_t value_len = 0;
+        if (value != NULL) {
+            value_len = wal->options.encode_value(value, at < room ? record + at : NULL,
+                                                  at < room ? room - at : 0);
+            at += value_len;
+        }
+        if (key_len > UINT32_MAX || value_len > UINT32_MAX) return MAP_ERR_INVALID_ARG;
+
+        size_t total = at + WAL_CHECKSUM_SIZE;
+        if (total <= room) {
+            record[0] = (uint8_t)op;
+            wal_put_u32(record + 1, (uint32_t)key_len);
+            wal_put_u32(record + 5, (uint32_t)value_len);
+            wal_put_u32(record + at, wal_checksum(record, at));
+            wal->buffer_used += total;
+            *out_len = total;
+            return MAP_OK;
+        }
+
+        map_error_t result = wal_reserve(map, total);
+        if (result != MAP_OK) return result;
+    }
+    return MAP_ERR_UNKNOWN; // The codec gave two different sizes.
+}
+
+map_error_t __map_wal_append(map_t *map, map_wal_op_t op, void *key, void *value) {
+    map_wal_t *wal = map->wal;
+    if (wal->failed) return MAP_ERR_IO;
+    size_t len;
+    map_error_t result = wal_encode(map, op, key, value, &len);
+    if (result != MAP_OK) return result;
+
+    wal->unsynced++;
+    if ((wal->options.sync_every_records != 0 &&
+         wal->unsynced >= wal->options.sync_every_records) ||
+        (wal->options.sync_every_ms != 0 &&
+         wal_now_ms() - wal->last_sync_ms >= wal->options.sync_every_ms)) {
+        result = wal_flush(wal);
+        if (result != MAP_OK) {
+            // The caller won't apply the change, so it mustn't be logged;
+            // the failed flush left this record at the end of the buffer.
+            wal->buffer_used -= len;
+            wal->unsynced--;
+            return result;
+        }
+        return wal_fsync(wal);
+    }
+    return MAP_OK;
+}
+
+// Sequential reader over the log file.
+typedef struct {
+    const map_t *map;
+    int fd;
+    uint8_t *buffer;
+    size_t capacity;
+    size_t start;  // First unread byte in buffer.
+    size_t end;    // End of the bytes read so far.
+    off_t offset;  // File offset of buffer[start].
+    off_t size;    // File size.
+} wal_reader_t;
+
+// Point *out at the next n bytes, reading more as needed. *got is 0 if
+// the file ends first.
+static map_error_t wal_read(wal_reader_t *reader, size_t n, const uint8_t **out, int *got) {
+    *got = 0;
+    if (reader->end - reader->start < n) {
+        // Keep the unread bytes and make sure n of them fit.
+        memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->start = 0;
+        if (reader->capacity < n) {
+            uint8_t *grown = __map_realloc(reader->map, reader->buffer, reader->capacity, n);
+            if (grown == NULL) return MAP_ERR_NO_MEM;
+            reader->buffer = grown;
+            reader->capacity = n;
+        }
+        while (reader->end < n) {
+            ssize_t got_now = read(reader->fd, reader->buffer + reader->end,
+                                   reader->capacity - reader->end);
+            if (got_now < 0) {
+                if (errno == EINTR) continue;
+                return MAP_ERR_IO;
+            }
+            if (got_now == 0) return MAP_OK; // Short: end of file.
+            reader->end += (size_t)got_now;
+        }
+    }
+
+    *out = reader->buffer + reader->start;
+    reader->start += n;
+    reader->offset += (off_t)n;
+    *got = 1;
+    return MAP_OK;
+}
+
+// Read the next whole, intact record. *got is 0 at the end of the valid
+// part of the log.
+static map_error_t wal_next_record(wal_reader_t *reader, const uint8_t **out_record,
+                                   size_t *out_len, int *got) {
+    const uint8_t *header = NULL;
+    map_error_t result = wal_read(reader, WAL_HEADER_SIZE, &header, got);
+    if (result != MAP_OK || !*got) return result;
+
+    uint8_t op = header[0];
+    size_t key_len = wal_get_u32(header + 1);
+    size_t value_len = wal_get_u32(header + 5);
+    *got = 0;
+    if ((op != MAP_WAL_INSERT && op != MAP_WAL_REMOVE) ||
+        (op == MAP_WAL_REMOVE && value_len != 0)) {
+        return MAP_OK;
+    }
+
+    // Re-read the header together with the rest, so the record is contiguous.
+    reader->start -= WAL_HEADER_SIZE;
+    reader->offset -= WAL_HEADER_SIZE;
+    size_t len = WAL_HEADER_SIZE + key_len + value_len + WAL_CHECKSUM_SIZE;
+    if ((uint64_t)len > (uint64_t)(reader->size - reader->offset)) return MAP_OK; // Torn.
+    const uint8_t *record = NULL;
+    result = wal_read(reader, len, &record, got);
+    if (result != MAP_OK || !*got) return result;
+
+    size_t body = len - WAL_CHECKSUM_SIZE;
+    *got = wal_checksum(record, body) == wal_get_u32(record + body);
+    *out_record = record;
+    *out_len = len;
+    return MAP_OK;
+}
+
+static map_error_t wal_reader_start(wal_reader_t *reader) {
+    struct stat st;
+    if (fstat(reader->fd, &st) != 0 || lseek(reader->fd, WAL_MAGIC_SIZE, SEEK_SET) < 0) {
+        return MAP_ERR_IO;
+    }
+    reader->start = reader->end = 0;
+    reader->offset = WAL_MAGIC_SIZE;
+    reader->size = st.st_size;
+    return MAP_OK;
+}
+
+// Apply one record to map. Decoded objects are temporaries: the map keeps
+// its own clones.
+static map_error_t wal_apply(map_t *map, const map_wal_options_t *options,
+                             const uint8_t *record) {
+    size_t key_len = wal_get_u32(record + 1);
+    size_t value_len = wal_get_u32(record + 5);
+    void *key = options->decode_key(record + WAL_HEADER_SIZE, key_len);
+    if (key == NULL) return MAP_ERR_NO_MEM;
+
+    map_error_t result;
+    if (record[0] == MAP_WAL_REMOVE) {
+        result = map_remove(map, key);
+        if (result == MAP_ERR_NOT_FOUND) result = MAP_OK;
+    } else {
+        void *value = options->decode_value(record + WAL_HEADER_SIZE + key_len, value_len);
+        result = value != NULL ? map_insert(map, key, value) : MAP_ERR_NO_MEM;
+        if (value != NULL) map->usr_free_value(value);
+    }
+    map->usr_free_key(key);
+    return result;
+}
+
+// Replay the log in two passes: the first finds where the intact records
+// end and counts the inserts, so the map is sized once; the second applies
+// them. A torn tail is cut off.
+static map_error_t wal_replay(map_t *map, int fd, const map_wal_options_t *options) {
+    wal_reader_t reader = {map, fd, NULL, 0, 0, 0, 0, 0};
+    reader.buffer = __map_alloc(map, WAL_READ_CHUNK);
+    if (reader.buffer == NULL) return MAP_ERR_NO_MEM;
+    reader.capacity = WAL_READ_CHUNK;
+
+    const uint8_t *record = NULL;
+    size_t len = 0;
+    int got = 0;
+    size_t inserts = 0;
+    off_t valid_end = WAL_MAGIC_SIZE;
+    map_error_t result = wal_reader_start(&reader);
+    while (result == MAP_OK) {
+        result = wal_next_record(&reader, &record, &len, &got);
+        if (result != MAP_OK || !got) break;
+        inserts += record[0] == MAP_WAL_INSERT;
+        valid_end = reader.offset;
+    }
+
+    // Presize like a bulk insert would end up, without the resizes.
+    if (result == MAP_OK && map->ops == NULL && map->snapshots == NULL) {
+        double target = (double)(inserts + map->num_entries) / map->max_load_factor;
+        if (target > map->num_buckets) {
+            result = __map_resize(map, (float)(target / map->num_buckets) * 1.01f);
+        }
+    }
+
+    if (result == MAP_OK) result = wal_reader_start(&reader);
+    while (result == MAP_OK && reader.offset < valid_end) {
+        result = wal_next_record(&reader, &record, &len, &got);
+        if (result == MAP_OK) result = wal_apply(map, options, record);
+    }
+    __map_free(map, reader.buffer, reader.capacity);
+
+    if (result == MAP_OK) {
+        struct stat st;
+        if (fstat(fd, &st) != 0) return MAP_ERR_IO;
+        if (st.st_size > valid_end && (ftruncate(fd, valid_end) != 0 || fsync(fd) != 0)) {
+            return MAP_ERR_IO;
+        }
+    }
+    return result;
+}
+
+// Open (creating if needed) the log file at path and check its magic.
+static map_error_t wal_open_file(const char *path, int flags, int *out_fd) {
+    int fd = open(path, O_RDWR | O_CREAT | O_APPEND | flags, 0644);
+    if (fd < 0) return MAP_ERR_IO;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return MAP_ERR_IO;
+    }
+
+    if (st.st_size < WAL_MAGIC_SIZE) {
+        // New, or torn while being created.
+        if (ftruncate(fd, 0) != 0 ||
+            wal_write_all(fd, (const uint8_t *)WAL_MAGIC, WAL_MAGIC_SIZE) != MAP_OK ||
+            fsync(fd) != 0) {
+            close(fd);
+            return MAP_ERR_IO;
+        }
+        wal_sync_dir(path);
+    } else {
+        char magic[WAL_MAGIC_SIZE];
+        if (pread(fd, magic, WAL_MAGIC_SIZE, 0) != WAL_MAGIC_SIZE ||
+            memcmp(magic, WAL_MAGIC, WAL_MAGIC_SIZE) != 0) {
+            close(fd);
+            return MAP_ERR_IO; // Not a log.
+        }
+    }
+
+    *out_fd = fd;
+    return MAP_OK;
+}
+
+// WAL Options Init Function
+void map_wal_options_init(map_wal_options_t *options) {
+    if (options == NULL) return;
+    memset(options, 0, sizeof(*options));
+    options->sync_every_records = 1;
+    options->buffer_size = WAL_DEFAULT_BUFFER;
+}
+
+// WAL Open Function
+map_error_t map_wal_open(map_t *map, const char *path, const map_wal_options_t *options) {
+    if (map == NULL || path == NULL || options == NULL || map->wal != NULL ||
+        map->cache_referenced != NULL || map->ttl != NULL || map->key_mode != MAP_KEY_USER ||
+        __map_is_set(map) || // Replayed values would be kept and never freed.
+        !options->encode_key || !options->decode_key || !options->encode_value ||
+        !options->decode_value) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    int fd;
+    map_error_t result = wal_open_file(path, 0, &fd);
+    if (result != MAP_OK) return result;
+
+    result = wal_replay(map, fd, options);
+    off_t file_size = result == MAP_OK ? lseek(fd, 0, SEEK_END) : -1;
+    if (result == MAP_OK && file_size < 0) result = MAP_ERR_IO;
+    if (result != MAP_OK) {
+        close(fd);
+        return result;
+    }
+
+    map_wal_t *wal = __map_calloc(map, 1, sizeof(map_wal_t));
+    size_t path_size = strlen(path) + 1;
+    char *path_copy = __map_alloc(map, path_size);
+    size_t buffer_size = options->buffer_size != 0 ? options->buffer_size : WAL_DEFAULT_BUFFER;
+    uint8_t *buffer = __map_alloc(map, buffer_size);
+    if (wal == NULL || path_copy == NULL || buffer == NULL) {
+        __map_free(map, wal, sizeof(map_wal_t));
+        __map_free(map, path_copy, path_size);
+        __map_free(map, buffer, buffer_size);
+        close(fd);
+        return MAP_ERR_NO_MEM;
+    }
+
+    memcpy(path_copy, path, path_size);
+    wal->fd = fd;
+    wal->path = path_copy;
+    wal->buffer = buffer;
+    wal->buffer_capacity = buffer_size;
+    wal->options = *options;
+    wal->last_sync_ms = wal_now_ms();
+    wal->file_size = (uint64_t)file_size;
+    map->wal = wal;
+    return MAP_OK;
+}
+
+// WAL Sync Function
+map_error_t map_wal_sync(map_t *map) {
+    if (map == NULL || map->wal == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+    return wal_commit(map->wal);
+}
+
+// WAL Compact Function. Writes the entries to path.compact next to the log
+// and renames it over the log once it is durable.
+map_error_t map_wal_compact(map_t *map) {
+    if (map == NULL || map->wal == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    map_wal_t *wal = map->wal;
+    map_error_t result = wal_commit(wal);
+    if (result != MAP_OK) return result;
+
+    size_t path_len = strlen(wal->path);
+    char *tmp_path = __map_alloc(map, path_len + sizeof(".compact"));
+    if (tmp_path == NULL) return MAP_ERR_NO_MEM;
+    memcpy(tmp_path, wal->path, path_len);
+    memcpy(tmp_path + path_len, ".compact", sizeof(".compact"));
+
+    int fd;
+    result = wal_open_file(tmp_path, O_TRUNC, &fd);
+    if (result == MAP_OK) {
+        int old_fd = wal->fd;
+        uint64_t old_size = wal->file_size;
+        wal->fd = fd;
+        wal->file_size = WAL_MAGIC_SIZE;
+
+        map_iterator_t iter;
+        void *key, *value;
+        if (map_iter_start(map, &iter) == MAP_OK) {
+            size_t len;
+            while (result == MAP_OK && map_iter_next(map, &iter, &key, &value) == MAP_OK) {
+                result = wal_encode(map, MAP_WAL_INSERT, key, value, &len);
+            }
+            map_iter_end(map, &iter);
+        }
+        if (result == MAP_OK) result = wal_commit(wal);
+        if (result == MAP_OK && rename(tmp_path, wal->path) != 0) result = MAP_ERR_IO;
+
+        if (result == MAP_OK) {
+            wal_sync_dir(wal->path);
+            close(old_fd);
+        } else {
+            // Nothing of the rewrite may reach the old log.
+            wal->buffer_used = 0;
+            wal->fd = old_fd;
+            wal->file_size = old_size;
+            wal->failed = 0; // Only the rewrite could have failed.
+            close(fd);
+            unlink(tmp_path);
+        }
+    }
+
+    __map_free(map, tmp_path, path_len + sizeof(".compact"));
+    return result;
+}
+
+// WAL Close Function
+map_error_t map_wal_close(map_t *map) {
+    if (map == NULL || map->wal == NULL) {
+        return MAP_ERR_INVALID_ARG;
+    }
+
+    map_wal_t *wal = map->wal;
+    map_error_t result = wal_commit(wal);
+    if (close(wal->fd) != 0 && result == MAP_OK) result = MAP_ERR_IO;
+    __map_free(map, wal->buffer, wal->buffer_capacity);
+    __map_free(map, wal->path, strlen(wal->path) + 1);
+    __map_free(map, wal, sizeof(map_wal_t));
+    map->wal = NULL;
+    return result;
+}
@@ -0,0 +1,74 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include <map.h>
+
+// Duplicating a populated map: iterate + insert into a fresh map versus
+// map_clone() on 1, 2 and 4 threads. Pass the number of keys as the first
+// argument for a bigger run.
+
+#define DEFAULT_ENTRIES 100000
+
+void* int_clone(void *ptr) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)ptr;
+    return copy;
+}
+
+uint64_t hash(void *key) { return map_hash_u32(key); }
+
+char* stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+int32_t compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void free_fn(void *ptr) { free(ptr); }
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : DEFAULT_ENTRIES;
+
+    map_t *src;
+    assert(map_create(&src, int_clone, int_clone, hash, stringify, compare, free_fn,
+                      free_fn) == MAP_OK);
+    for (int i = 0; i < n; i++) assert(map_insert(src, &i, &i) == MAP_OK);
+    printf("Copying a map of %d entries:\n", n);
+
+    map_t *dst;
+    double start = now();
+    assert(map_create(&dst, int_clone, int_clone, hash, stringify, compare, free_fn,
+                      free_fn) == MAP_OK);
+    map_iterator_t iter;
+    void *key, *value;
+    map_iter_start(src, &iter);
+    while (map_iter_next(src, &iter, &key, &value) == MAP_OK) {
+        assert(map_insert(dst, key, value) == MAP_OK);
+    }
+    printf("  %-22s %.3fs\n", "iterate + map_insert", now() - start);
+    map_destroy(&dst);
+
+    int threads[] = {1, 2, 4};
+    for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+        start = now();
+        assert(map_clone(src, &dst, threads[t]) == MAP_OK);
+        printf("  map_clone, %d thread(s)  %.3fs\n", threads[t], now() - start);
+        map_destroy(&dst);
+    }
+
+    map_destroy(&src);
+    return 0;
+}
@@ -0,0 +1,77 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include <map.h>
+
+// Inserts and lookups when every key has the same hash, for growing key
+// counts. Long chains are searched through their sorted index, so the cost
+// per lookup should grow with log n rather than n. Pass the largest number
+// of keys as the first argument for a bigger run.
+
+#define DEFAULT_ENTRIES 4000
+
+static size_t compares;
+
+void* int_clone(void *ptr) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)ptr;
+    return copy;
+}
+
+uint64_t hash(void *key) {
+    (void)key;
+    return 42;
+}
+
+char* stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+int32_t compare(void *key1, void *key2) {
+    compares++;
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void free_fn(void *ptr) { free(ptr); }
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void run(int n) {
+    map_t *map;
+    assert(map_create(&map, int_clone, int_clone, hash, stringify, compare, free_fn,
+                      free_fn) == MAP_OK);
+
+    double start = now();
+    for (int i = 0; i < n; i++) assert(map_insert(map, &i, &i) == MAP_OK);
+    double insert = now() - start;
+
+    compares = 0;
+    start = now();
+    for (int i = 0; i < 2 * n; i++) {
+        void *value;
+        assert(map_get(map, &i, &value) == (i < n ? MAP_OK : MAP_ERR_NOT_FOUND));
+    }
+    double lookup = now() - start;
+
+    printf("  %7d keys  insert %7.1f ns  lookup %7.1f ns  %5.1f compares/lookup\n", n,
+           insert * 1e9 / n, lookup * 1e9 / (2.0 * n), (double)compares / (2.0 * n));
+    map_destroy(&map);
+}
+
+int main(int argc, char **argv) {
+    int max = argc > 1 ? atoi(argv[1]) : DEFAULT_ENTRIES;
+
+    printf("All keys in one chain:\n");
+    for (int n = max / 16 > 0 ? max / 16 : 1; n <= max; n *= 4) run(n);
+    return 0;
+}
@@ -0,0 +1,100 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include <map.h>
+
+// Worst-case map_get latency, chaining vs. cuckoo, with a well-spread hash
+// and with a hash that clusters (every hash a multiple of 1024). Pass the
+// number of keys as the first argument for a bigger run.
+
+#define DEFAULT_ENTRIES 20000
+
+void* int_clone(void *ptr) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)ptr;
+    return copy;
+}
+
+uint64_t spread_hash(void *key) {
+    return map_hash_u32(key);
+}
+
+uint64_t cluster_hash(void *key) {
+    return (uint64_t)(*(int *)key) * 1024;
+}
+
+char* stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+int32_t compare(void *key1, void *key2) {
+    int a = *(int *)key1;
+    int b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void free_fn(void *ptr) { free(ptr); }
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void run(const char *label, map_engine_t engine, uint64_t (*hash)(void *key),
+                int n, uint64_t *samples) {
+    map_options_t options;
+    map_options_init(&options);
+    options.engine = engine;
+
+    map_t *map;
+    assert(map_create_ex(&map, &options, int_clone, int_clone, hash, stringify,
+                         compare, free_fn, free_fn) == MAP_OK);
+    for (int i = 0; i < n; i++) {
+        assert(map_insert(map, &i, &i) == MAP_OK);
+    }
+
+    srand(1);
+    for (int i = 0; i < n; i++) {
+        int key = rand() % n;
+        void *value;
+        uint64_t start = now_ns();
+        map_error_t result = map_get(map, &key, &value);
+        samples[i] = now_ns() - start;
+        assert(result == MAP_OK && *(int *)value == key);
+    }
+    qsort(samples, (size_t)n, sizeof(uint64_t), cmp_u64);
+
+    printf("  %-22s p50 %6llu ns  p99 %6llu ns  p99.99 %8llu ns  max %8llu ns\n",
+           label,
+           (unsigned long long)samples[n / 2],
+           (unsigned long long)samples[(size_t)(n * 0.99)],
+           (unsigned long long)samples[(size_t)(n * 0.9999)],
+           (unsigned long long)samples[n - 1]);
+    map_destroy(&map);
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : DEFAULT_ENTRIES;
+    uint64_t *samples = malloc((size_t)n * sizeof(uint64_t));
+    assert(samples);
+
+    printf("map_get latency over %d random lookups:\n", n);
+    run("chaining, spread hash", MAP_ENGINE_CHAINING, spread_hash, n, samples);
+    run("cuckoo,   spread hash", MAP_ENGINE_CUCKOO, spread_hash, n, samples);
+    run("chaining, clustered", MAP_ENGINE_CHAINING, cluster_hash, n, samples);
+    run("cuckoo,   clustered", MAP_ENGINE_CUCKOO, cluster_hash, n, samples);
+
+    free(samples);
+    return 0;
+}
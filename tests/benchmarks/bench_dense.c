@@ -0,0 +1,110 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include <map.h>
+
+// Full iteration and lookup time, chaining vs. dense, plus the bytes each
+// engine allocates for itself per entry (keys and values excluded; the
+// malloc header on every chaining node is not counted either). Pass the
+// number of keys as the first argument for a bigger run.
+
+#define DEFAULT_ENTRIES 100000
+#define ITERATION_PASSES 10
+
+void* int_clone(void *ptr) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)ptr;
+    return copy;
+}
+
+uint64_t hash(void *key) { return map_hash_u32(key); }
+
+char* stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+int32_t compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void free_fn(void *ptr) { free(ptr); }
+
+// malloc-backed allocator that tracks how much is live.
+static size_t live_bytes;
+
+static void *counting_alloc(void *ctx, size_t size) {
+    (void)ctx;
+    live_bytes += size;
+    return malloc(size);
+}
+
+static void *counting_realloc(void *ctx, void *ptr, size_t old_size, size_t new_size) {
+    (void)ctx;
+    live_bytes += new_size - old_size;
+    return realloc(ptr, new_size);
+}
+
+static void counting_free(void *ctx, void *ptr, size_t size) {
+    (void)ctx;
+    live_bytes -= size;
+    free(ptr);
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void run(const char *label, map_engine_t engine, int n) {
+    map_allocator_t allocator = {counting_alloc, counting_realloc, counting_free, NULL};
+    map_options_t options;
+    map_options_init(&options);
+    options.engine = engine;
+    options.allocator = &allocator;
+
+    live_bytes = 0;
+    map_t *map;
+    assert(map_create_ex(&map, &options, int_clone, int_clone, hash, stringify, compare,
+                         free_fn, free_fn) == MAP_OK);
+    for (int i = 0; i < n; i++) assert(map_insert(map, &i, &i) == MAP_OK);
+
+    double start = now();
+    long sum = 0;
+    for (int pass = 0; pass < ITERATION_PASSES; pass++) {
+        map_iterator_t iter;
+        void *key, *value;
+        map_iter_start(map, &iter);
+        while (map_iter_next(map, &iter, &key, &value) == MAP_OK) sum += *(int *)value;
+    }
+    double iterate = (now() - start) / ITERATION_PASSES;
+    assert(sum == (long)ITERATION_PASSES * ((long)n * (n - 1) / 2));
+
+    srand(1);
+    start = now();
+    for (int i = 0; i < n; i++) {
+        int key = rand() % n;
+        void *value;
+        assert(map_get(map, &key, &value) == MAP_OK);
+    }
+    double lookup = now() - start;
+
+    printf("  %-9s iterate %7.2f ms  %d lookups %7.2f ms  %5.1f bytes/entry\n", label,
+           iterate * 1e3, n, lookup * 1e3, (double)live_bytes / n);
+    map_destroy(&map);
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : DEFAULT_ENTRIES;
+
+    printf("Maps of %d entries:\n", n);
+    run("chaining", MAP_ENGINE_CHAINING, n);
+    run("dense", MAP_ENGINE_DENSE, n);
+    return 0;
+}
@@ -0,0 +1,128 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <map.h>
+
+// Insert, full iteration and random lookup time of the in-memory chaining
+// engine against the disk engine, once with a budget that holds every
+// partition and once with a smaller one, so partitions are spilled and
+// faulted back in. Pass the number of keys and the RAM budget in KiB as
+// arguments for a different run; the default budget is about a quarter of
+// what the entries are charged. Files go under $TMPDIR (or /tmp).
+
+#define DEFAULT_ENTRIES 20000
+#define PARTITIONS 64
+
+void* int_clone(void *ptr) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)ptr;
+    return copy;
+}
+
+uint64_t hash(void *key) { return map_hash_u32(key); }
+
+char* stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+int32_t compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void free_fn(void *ptr) { free(ptr); }
+
+size_t int_encode(void *obj, uint8_t *buf, size_t cap) {
+    if (cap >= sizeof(int)) memcpy(buf, obj, sizeof(int));
+    return sizeof(int);
+}
+
+void* int_decode(const uint8_t *buf, size_t len) {
+    (void)len;
+    int *obj = malloc(sizeof(int));
+    if (obj) memcpy(obj, buf, sizeof(int));
+    return obj;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void run(const char *label, const char *dir, size_t budget, int n) {
+    map_disk_options_t disk;
+    map_disk_options_init(&disk);
+    disk.dir = dir;
+    disk.ram_budget = budget;
+    disk.partitions = PARTITIONS;
+    disk.encode_key = disk.encode_value = int_encode;
+    disk.decode_key = disk.decode_value = int_decode;
+    map_options_t options;
+    map_options_init(&options);
+    if (dir != NULL) {
+        options.engine = MAP_ENGINE_DISK;
+        options.disk = &disk;
+    }
+
+    map_t *map;
+    assert(map_create_ex(&map, &options, int_clone, int_clone, hash, stringify, compare,
+                         free_fn, free_fn) == MAP_OK);
+    double start = now();
+    for (int i = 0; i < n; i++) assert(map_insert(map, &i, &i) == MAP_OK);
+    double insert = now() - start;
+
+    start = now();
+    long sum = 0;
+    map_iterator_t iter;
+    void *key, *value;
+    map_iter_start(map, &iter);
+    while (map_iter_next(map, &iter, &key, &value) == MAP_OK) sum += *(int *)value;
+    double iterate = now() - start;
+    assert(sum == (long)n * (n - 1) / 2);
+
+    srand(1);
+    start = now();
+    for (int i = 0; i < n; i++) {
+        int k = rand() % n;
+        assert(map_get(map, &k, &value) == MAP_OK);
+    }
+    double lookup = now() - start;
+
+    printf("  %-14s insert %8.1f ns  iterate %6.1f ns  lookup %8.1f ns", label,
+           insert * 1e9 / n, iterate * 1e9 / n, lookup * 1e9 / n);
+    map_disk_stats_t stats;
+    if (map_disk_stats(map, &stats) == MAP_OK) {
+        printf("  %zu faults, %.1f MiB written", stats.faults,
+               (double)stats.bytes_written / (1024 * 1024));
+    }
+    printf("\n");
+    map_destroy(&map);
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : DEFAULT_ENTRIES;
+    // Four bytes of key and of value, plus the per-entry overhead.
+    size_t charged = (size_t)n * (8 + sizeof(map_disk_entry_t) + 2 * sizeof(uint32_t));
+    size_t budget = argc > 2 ? (size_t)atol(argv[2]) * 1024 : charged / 4;
+
+    const char *tmp = getenv("TMPDIR") != NULL ? getenv("TMPDIR") : "/tmp";
+    char dir[4096];
+    snprintf(dir, sizeof(dir), "%s/bench_disk_XXXXXX", tmp);
+    assert(mkdtemp(dir) != NULL);
+
+    printf("Maps of %d entries, about %zu KiB charged:\n", n, charged / 1024);
+    run("chaining", NULL, 0, n);
+    run("disk, all", dir, SIZE_MAX, n);
+    char label[64];
+    snprintf(label, sizeof(label), "disk, %zu KiB", budget / 1024);
+    run(label, dir, budget, n);
+    rmdir(dir);
+    return 0;
+}
@@ -0,0 +1,113 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <map.h>
+
+// Time to dump a map to /dev/null: map_print(), which mallocs a string per
+// entry through usr_stringify and printf()s it, against map_export() in
+// each format, on one thread and on four. Pass the number of entries as
+// the first argument for a bigger run.
+
+#define DEFAULT_ENTRIES 200000
+#define THREADS 4
+
+void* int_clone(void *ptr) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)ptr;
+    return copy;
+}
+
+uint64_t hash(void *key) { return map_hash_u32(key); }
+
+char* stringify(void *key, void *value) {
+    char *str = malloc(100);
+    if (str) snprintf(str, 100, "(Key: %d, Value: %d)", *(int *)key, *(int *)value);
+    return str;
+}
+
+int32_t compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void free_fn(void *ptr) { free(ptr); }
+
+// Decimal text of a non-negative int, without going through printf.
+static size_t encode_int(void *obj, uint8_t *buf, size_t cap) {
+    uint8_t text[16];
+    size_t len = 0;
+    unsigned v = (unsigned)*(int *)obj;
+    do {
+        text[sizeof(text) - ++len] = (uint8_t)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    if (len <= cap) memcpy(buf, text + sizeof(text) - len, len);
+    return len;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static double time_print(const map_t *map) {
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    assert(saved >= 0 && freopen("/dev/null", "w", stdout) != NULL);
+    double start = now();
+    assert(map_print(map) == MAP_OK);
+    fflush(stdout);
+    double elapsed = now() - start;
+    assert(dup2(saved, STDOUT_FILENO) >= 0);
+    close(saved);
+    return elapsed;
+}
+
+static double time_export(const map_t *map, map_export_format_t format, int nthreads) {
+    FILE *null = fopen("/dev/null", "w");
+    assert(null != NULL);
+    map_export_options_t options;
+    map_export_options_init(&options);
+    options.format = format;
+    options.encode_key = encode_int;
+    options.encode_value = encode_int;
+    options.write = map_export_file_writer;
+    options.write_ctx = null;
+    double start = now();
+    assert(map_export(map, &options, nthreads) == MAP_OK);
+    fflush(null);
+    double elapsed = now() - start;
+    fclose(null);
+    return elapsed;
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : DEFAULT_ENTRIES;
+    map_t *map;
+    assert(map_create(&map, int_clone, int_clone, hash, stringify, compare, free_fn,
+                      free_fn) == MAP_OK);
+    for (int i = 0; i < n; i++) {
+        int value = i * 3;
+        assert(map_insert(map, &i, &value) == MAP_OK);
+    }
+
+    double print = time_print(map);
+    printf("Dumping %d entries:\n", n);
+    printf("  %-20s %7.1f ns/entry\n", "map_print", print * 1e9 / n);
+    static const char *names[] = {"csv", "json", "binary"};
+    map_export_format_t formats[] = {MAP_EXPORT_CSV, MAP_EXPORT_JSON, MAP_EXPORT_BINARY};
+    for (int f = 0; f < 3; f++) {
+        char label[32];
+        snprintf(label, sizeof(label), "export %s", names[f]);
+        printf("  %-20s %7.1f ns/entry", label, time_export(map, formats[f], 1) * 1e9 / n);
+        printf("  %d threads %7.1f ns/entry\n", THREADS,
+               time_export(map, formats[f], THREADS) * 1e9 / n);
+    }
+    map_destroy(&map);
+    return 0;
+}
@@ -0,0 +1,94 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include <map.h>
+
+// Lookups where 90% of the keys are absent, on chaining maps with and
+// without the negative lookup filter, for integer and string keys. Pass
+// the number of keys as the first argument for a bigger run.
+
+#define DEFAULT_ENTRIES 20000
+#define LOOKUP_PASSES 10
+
+void* int_clone(void *ptr) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)ptr;
+    return copy;
+}
+
+uint64_t hash(void *key) { return map_hash_u32(key); }
+
+char* stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+int32_t compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void free_fn(void *ptr) { free(ptr); }
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Keys 0..n-1 are stored; lookups cover 0..10n-1.
+static void run(const char *label, map_key_mode_t key_mode, int enable_filter, int n) {
+    map_options_t options;
+    map_options_init(&options);
+    options.key_mode = key_mode;
+    options.enable_filter = enable_filter;
+
+    map_t *map;
+    int strings = key_mode == MAP_KEY_STRING;
+    assert(map_create_ex(&map, &options, strings ? NULL : int_clone, int_clone,
+                         strings ? NULL : hash, stringify, strings ? NULL : compare,
+                         strings ? NULL : free_fn, free_fn) == MAP_OK);
+
+    char name[32];
+    for (int i = 0; i < n; i++) {
+        snprintf(name, sizeof(name), "customer/%08d", i);
+        assert(map_insert(map, strings ? (void *)name : (void *)&i, &i) == MAP_OK);
+    }
+
+    // Keys are built up front so only the lookups are timed.
+    int total = 10 * n;
+    char (*names)[32] = strings ? malloc((size_t)total * sizeof(*names)) : NULL;
+    for (int i = 0; strings && i < total; i++) {
+        snprintf(names[i], sizeof(names[i]), "customer/%08d", i);
+    }
+
+    int hits = 0;
+    double start = now();
+    for (int pass = 0; pass < LOOKUP_PASSES; pass++) {
+        for (int i = 0; i < total; i++) {
+            void *value;
+            hits += map_get(map, strings ? (void *)names[i] : (void *)&i, &value) == MAP_OK;
+        }
+    }
+    double elapsed = now() - start;
+    assert(hits == LOOKUP_PASSES * n);
+
+    printf("  %-22s %6.1f ns/lookup\n", label, elapsed * 1e9 / ((double)LOOKUP_PASSES * total));
+    free(names);
+    map_destroy(&map);
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : DEFAULT_ENTRIES;
+
+    printf("Maps of %d entries, %d lookups per pass, 90%% misses:\n", n, 10 * n);
+    run("int keys", MAP_KEY_USER, 0, n);
+    run("int keys, filter", MAP_KEY_USER, 1, n);
+    run("string keys", MAP_KEY_STRING, 0, n);
+    run("string keys, filter", MAP_KEY_STRING, 1, n);
+    return 0;
+}
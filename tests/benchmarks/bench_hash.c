@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include <map.h>
+
+// Compares the built-in hashes against the hashes the tests have been
+// using (djb2 for strings, modulus for ints). Pass a repetition count as
+// the first argument for a longer run.
+
+#define DEFAULT_ROUNDS 20000
+#define NUM_MAP_KEYS 20000
+
+// djb2, as in test_count_unique.c / test_mega_map.c
+uint64_t djb2_hash(void *key) {
+    char *str = (char *)key;
+    uint64_t hash = 5381;
+    int c;
+    while ((c = *str++)) {
+        hash = ((hash << 5) + hash) + c;
+    }
+    return hash;
+}
+
+// Simple Modulus Hashing, as in test_map_torture.c
+uint64_t modulus_hash(void *key) {
+    return (*(int *)key) % 1000003;
+}
+
+// Clone string key
+void* key_clone(void *key) {
+    char *copy = malloc(strlen((char*)key) + 1);
+    if (copy) strcpy(copy, (char*)key);
+    return copy;
+}
+
+// Clone integer value
+void* value_clone(void *value) {
+    int *new_value = malloc(sizeof(int));
+    if (new_value) *new_value = *(int *)value;
+    return new_value;
+}
+
+char* stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+int32_t compare(void *key1, void *key2) {
+    int result = strcmp((char *)key1, (char *)key2);
+    return (result > 0) - (result < 0);
+}
+
+void free_fn(void *ptr) { free(ptr); }
+
+static double seconds_since(clock_t start) {
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// Hash a small rotating set of strings `rounds` times and report throughput.
+static void bench_string(const char *label, uint64_t (*hash)(void *key),
+                         char **strs, size_t len, long rounds) {
+    uint64_t sink = 0;
+    clock_t start = clock();
+    for (long i = 0; i < rounds; i++) {
+        sink += hash(strs[i & 15]);
+    }
+    double secs = seconds_since(start);
+    printf("  %-10s len %5zu: %8.1f MB/s  (%llx)\n", label, len,
+           secs > 0 ? (double)len * rounds / secs / 1e6 : 0.0,
+           (unsigned long long)(sink & 0xff));
+}
+
+// Insert and look up string keys with the given hash.
+static void bench_map(const char *label, uint64_t (*hash)(void *key), char **keys) {
+    map_t *map;
+    assert(map_create(&map, key_clone, value_clone, hash, stringify, compare,
+                      free_fn, free_fn) == MAP_OK);
+    clock_t start = clock();
+    for (int i = 0; i < NUM_MAP_KEYS; i++) {
+        assert(map_insert(map, keys[i], &i) == MAP_OK);
+    }
+    for (int round = 0; round < 5; round++) {
+        for (int i = 0; i < NUM_MAP_KEYS; i++) {
+            void *value;
+            assert(map_get(map, keys[i], &value) == MAP_OK && *(int *)value == i);
+        }
+    }
+    printf("  %-10s %d inserts + %d gets: %.3fs\n", label, NUM_MAP_KEYS,
+           5 * NUM_MAP_KEYS, seconds_since(start));
+    map_destroy(&map);
+}
+
+int main(int argc, char **argv) {
+    long rounds = argc > 1 ? atol(argv[1]) : DEFAULT_ROUNDS;
+    size_t lengths[] = {8, 24, 64, 256, 4096};
+
+    printf("String hash throughput (%ld rounds):\n", rounds);
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        size_t len = lengths[l];
+        char *strs[16];
+        for (int s = 0; s < 16; s++) {
+            strs[s] = malloc(len + 1);
+            assert(strs[s]);
+            for (size_t i = 0; i < len; i++) strs[s][i] = (char)('a' + (i + s) % 26);
+            strs[s][len] = '\0';
+        }
+
+        bench_string("djb2", djb2_hash, strs, len, rounds);
+        bench_string("map_hash", map_hash_str, strs, len, rounds);
+        for (int s = 0; s < 16; s++) free(strs[s]);
+    }
+
+    printf("Integer hash throughput (%ld rounds):\n", rounds * 50);
+    uint64_t sink = 0;
+    clock_t start = clock();
+    for (int i = 0; i < rounds * 50; i++) sink += modulus_hash(&i);
+    printf("  %-10s %.3fs\n", "modulus", seconds_since(start));
+    start = clock();
+    for (int i = 0; i < rounds * 50; i++) sink += map_hash_u32(&i);
+    printf("  %-10s %.3fs  (%llx)\n", "map_u32", seconds_since(start),
+           (unsigned long long)(sink & 0xff));
+
+    // URL-like keys through a full map
+    char **keys = malloc(NUM_MAP_KEYS * sizeof(char *));
+    assert(keys);
+    for (int i = 0; i < NUM_MAP_KEYS; i++) {
+        keys[i] = malloc(96);
+        assert(keys[i]);
+        snprintf(keys[i], 96, "https://example.com/api/v1/resources/%d/items?page=%d",
+                 i * 7919, i % 13);
+    }
+    printf("String-keyed map:\n");
+    bench_map("djb2", djb2_hash, keys);
+    bench_map("map_hash", map_hash_str, keys);
+    for (int i = 0; i < NUM_MAP_KEYS; i++) free(keys[i]);
+    free(keys);
+
+    return 0;
+}
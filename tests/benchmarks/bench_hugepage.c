@@ -0,0 +1,116 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include <map.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+// Random map_get over a large string-keyed table, libc allocator vs. the
+// huge-page allocator, counting dTLB load misses with perf_event_open when
+// the kernel allows it. String keys live in the map's key arena, so buckets,
+// nodes and keys all come from the allocator under test. The effect only
+// shows once the table is far bigger than the TLB reach of 4K pages; pass
+// the number of keys (e.g. 20000000) as the first argument for a
+// meaningful run.
+
+#define DEFAULT_ENTRIES 50000
+
+void* int_clone(void *ptr) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)ptr;
+    return copy;
+}
+
+char* stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+void free_fn(void *ptr) { free(ptr); }
+
+static int open_tlb_counter(void) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void run(const char *label, const map_allocator_t *allocator, int n) {
+    map_options_t options;
+    map_options_init(&options);
+    options.key_mode = MAP_KEY_STRING;
+    options.allocator = allocator;
+
+    map_t *map;
+    char key[16];
+    assert(map_create_ex(&map, &options, NULL, int_clone, NULL, stringify, NULL, NULL,
+                         free_fn) == MAP_OK);
+    for (int i = 0; i < n; i++) {
+        snprintf(key, sizeof(key), "%d", i);
+        assert(map_insert(map, key, &i) == MAP_OK);
+    }
+
+    int fd = open_tlb_counter();
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    srand(1);
+    clock_t start = clock();
+    for (int i = 0; i < n; i++) {
+        void *value;
+        snprintf(key, sizeof(key), "%d", rand() % n);
+        assert(map_get(map, key, &value) == MAP_OK);
+    }
+    double secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    long long misses = -1;
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, &misses, sizeof(misses)) != (ssize_t)sizeof(misses)) misses = -1;
+        close(fd);
+    }
+
+    if (misses >= 0) {
+        printf("  %-10s %.3fs  %.1f ns/get  dTLB misses/get %.2f\n", label, secs,
+               secs * 1e9 / n, (double)misses / n);
+    } else {
+        printf("  %-10s %.3fs  %.1f ns/get  dTLB misses n/a\n", label, secs, secs * 1e9 / n);
+    }
+    map_destroy(&map);
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : DEFAULT_ENTRIES;
+
+    map_hugepage_t *hp;
+    map_hugepage_options_t hp_options;
+    map_hugepage_options_init(&hp_options);
+    hp_options.explicit_huge_pages = 1;
+    hp_options.numa_policy = MAP_NUMA_INTERLEAVE;
+    assert(map_hugepage_create(&hp, &hp_options) == MAP_OK);
+    map_allocator_t huge;
+    assert(map_hugepage_allocator(hp, &huge) == MAP_OK);
+
+    printf("%d random map_get calls:\n", n);
+    run("libc", NULL, n);
+    run("hugepage", &huge, n);
+    printf("  (%zu hugetlb mappings, %d NUMA node(s), %zu placement failures)\n",
+           hp->hugetlb_mappings, hp->numa_nodes, hp->numa_failures);
+
+    map_hugepage_destroy(&hp);
+    return 0;
+}
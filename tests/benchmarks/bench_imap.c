@@ -0,0 +1,160 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include <map.h>
+
+// The torture test's phases timed on a map_t with uint64_t keys and values
+// and on a map_imap_t: insert rand() keys with twice the key as value,
+// rewrite every value to three times the key while iterating, verify them,
+// look up a fifth of the keys again, and remove everything while
+// iterating. Pass the number of entries as the first argument for a bigger
+// run.
+
+#define DEFAULT_ENTRIES 200000
+
+void* u64_clone(void *ptr) {
+    uint64_t *copy = malloc(sizeof(uint64_t));
+    if (copy) *copy = *(uint64_t *)ptr;
+    return copy;
+}
+
+uint64_t hash(void *key) { return map_hash_u64(key); }
+
+char* stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+int32_t compare(void *key1, void *key2) {
+    uint64_t a = *(uint64_t *)key1, b = *(uint64_t *)key2;
+    return (a > b) - (a < b);
+}
+
+void free_fn(void *ptr) { free(ptr); }
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void report(const char *label, const double *phases, int n) {
+    static const char *names[] = {"insert", "modify", "verify", "get", "remove"};
+    double total = 0;
+    printf("  %-6s", label);
+    for (int i = 0; i < 5; i++) {
+        printf("  %s %6.1f", names[i], phases[i] * 1e9 / n);
+        total += phases[i];
+    }
+    printf("  ns/entry, %.3f s\n", total);
+}
+
+static void run_map(int n) {
+    double phases[5];
+    map_t *map;
+    assert(map_create(&map, u64_clone, u64_clone, hash, stringify, compare, free_fn,
+                      free_fn) == MAP_OK);
+
+    srand(0);
+    double start = now();
+    for (int i = 0; i < n; i++) {
+        uint64_t key = (uint64_t)rand(), value = key * 2;
+        assert(map_insert(map, &key, &value) == MAP_OK);
+    }
+    phases[0] = now() - start;
+
+    map_iterator_t iter;
+    void *key, *value;
+    start = now();
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    while (map_iter_next(map, &iter, &key, &value) == MAP_OK) {
+        *(uint64_t *)value = *(uint64_t *)key * 3;
+    }
+    phases[1] = now() - start;
+
+    start = now();
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    while (map_iter_next(map, &iter, &key, &value) == MAP_OK) {
+        assert(*(uint64_t *)value == *(uint64_t *)key * 3);
+    }
+    phases[2] = now() - start;
+
+    srand(0);
+    start = now();
+    for (int i = 0; i < n / 5; i++) {
+        uint64_t search = (uint64_t)rand();
+        assert(map_get(map, &search, &value) == MAP_OK && *(uint64_t *)value == search * 3);
+    }
+    phases[3] = now() - start;
+
+    start = now();
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    while (map_iter_next(map, &iter, &key, &value) == MAP_OK) {
+        assert(map_iter_remove(map, &iter) == MAP_OK);
+    }
+    phases[4] = now() - start;
+    size_t remaining;
+    assert(map_get_size(map, &remaining) == MAP_OK && remaining == 0);
+    report("map", phases, n);
+    map_destroy(&map);
+}
+
+static void run_imap(int n) {
+    double phases[5];
+    map_imap_t *imap;
+    assert(map_imap_create(&imap, 0) == MAP_OK);
+
+    srand(0);
+    double start = now();
+    for (int i = 0; i < n; i++) {
+        uint64_t key = (uint64_t)rand();
+        assert(map_imap_insert(imap, key, key * 2) == MAP_OK);
+    }
+    phases[0] = now() - start;
+
+    // Overwriting a key never rehashes, so the iterator stays valid.
+    map_iterator_t iter;
+    uint64_t key, value;
+    start = now();
+    assert(map_imap_iter_start(imap, &iter) == MAP_OK);
+    while (map_imap_iter_next(imap, &iter, &key, &value) == MAP_OK) {
+        assert(map_imap_insert(imap, key, key * 3) == MAP_OK);
+    }
+    phases[1] = now() - start;
+
+    start = now();
+    assert(map_imap_iter_start(imap, &iter) == MAP_OK);
+    while (map_imap_iter_next(imap, &iter, &key, &value) == MAP_OK) assert(value == key * 3);
+    phases[2] = now() - start;
+
+    srand(0);
+    start = now();
+    for (int i = 0; i < n / 5; i++) {
+        uint64_t search = (uint64_t)rand();
+        assert(map_imap_get(imap, search, &value) == MAP_OK && value == search * 3);
+    }
+    phases[3] = now() - start;
+
+    start = now();
+    assert(map_imap_iter_start(imap, &iter) == MAP_OK);
+    while (map_imap_iter_next(imap, &iter, &key, &value) == MAP_OK) {
+        assert(map_imap_remove(imap, key) == MAP_OK);
+    }
+    phases[4] = now() - start;
+    size_t remaining;
+    assert(map_imap_get_size(imap, &remaining) == MAP_OK && remaining == 0);
+    report("imap", phases, n);
+    map_imap_destroy(&imap);
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : DEFAULT_ENTRIES;
+    printf("Torture phases over %d random keys:\n", n);
+    run_map(n);
+    run_imap(n);
+    return 0;
+}
@@ -0,0 +1,110 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include <map.h>
+
+// Build and probe time of a hash join: a chaining map loaded with
+// map_insert() and probed one map_get() at a time, against map_join_t's
+// bulk build and batched, prefetching probe. The map is given unique build
+// keys, because it can only hold one row per key. The join is also run
+// with four rows per key, where a quarter of the probe rows match four
+// rows each. Pass the number of build rows as the first argument for a
+// bigger run.
+
+#define DEFAULT_ROWS 200000
+#define DUPLICATES 4
+
+void* int_clone(void *ptr) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)ptr;
+    return copy;
+}
+
+uint64_t hash(void *key) { return map_hash_u32(key); }
+
+char* stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+int32_t compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void free_fn(void *ptr) { free(ptr); }
+
+static map_error_t count_pair(void *ctx, void *build_row, void *probe_row) {
+    (void)build_row;
+    (void)probe_row;
+    (*(size_t *)ctx)++;
+    return MAP_OK;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void run_map(int *keys, int n) {
+    map_t *map;
+    assert(map_create(&map, int_clone, int_clone, hash, stringify, compare, free_fn,
+                      free_fn) == MAP_OK);
+    double start = now();
+    for (int i = 0; i < n; i++) assert(map_insert(map, &keys[i], &i) == MAP_OK);
+    double build = now() - start;
+
+    start = now();
+    size_t pairs = 0;
+    for (int i = 0; i < n; i++) {
+        void *value;
+        if (map_get(map, &keys[n - 1 - i], &value) == MAP_OK) pairs++;
+    }
+    double probe = now() - start;
+    assert(pairs == (size_t)n);
+    printf("  %-16s build %7.1f ns/row  probe %7.1f ns/row\n", "map insert/get",
+           build * 1e9 / n, probe * 1e9 / n);
+    map_destroy(&map);
+}
+
+static void run_join(const char *label, int *keys, int n, int duplicates) {
+    void **build_keys = malloc((size_t)n * sizeof(void *));
+    void **probe_keys = malloc((size_t)n * sizeof(void *));
+    for (int i = 0; i < n; i++) {
+        build_keys[i] = &keys[i / duplicates];
+        probe_keys[i] = &keys[n - 1 - i];
+    }
+
+    map_join_t *join;
+    double start = now();
+    assert(map_join_build(&join, build_keys, NULL, (size_t)n, hash, compare) == MAP_OK);
+    double build = now() - start;
+
+    start = now();
+    size_t pairs = 0;
+    assert(map_join_probe(join, probe_keys, NULL, (size_t)n, count_pair, &pairs) == MAP_OK);
+    double probe = now() - start;
+    printf("  %-16s build %7.1f ns/row  probe %7.1f ns/row  %zu pairs\n", label,
+           build * 1e9 / n, probe * 1e9 / n, pairs);
+    map_join_destroy(&join);
+    free(build_keys);
+    free(probe_keys);
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : DEFAULT_ROWS;
+    int *keys = malloc((size_t)n * sizeof(int));
+    for (int i = 0; i < n; i++) keys[i] = (int)((unsigned)i * 7919u); // Distinct, not in order.
+
+    printf("Hash join of %d build rows with %d probe rows:\n", n, n);
+    run_map(keys, n);
+    run_join("join, unique", keys, n, 1);
+    run_join("join, 4 per key", keys, n, DUPLICATES);
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,163 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <map.h>
+
+// Counting distinct values on several threads, as test_count_unique.c does
+// on one: a single map behind a mutex, against a map_reducer_t whose
+// threads count into their own maps, once draining them every
+// DRAIN_EVERY values and once merging them all with map_reducer_finish().
+// Each thread counts an equal slice of the input. Pass the number of
+// values and of threads as arguments for a bigger run.
+
+#define DEFAULT_VALUES 400000
+#define DEFAULT_THREADS 4
+#define DISTINCT_DIVISOR 4 // About a quarter of the values are distinct.
+#define DRAIN_EVERY 20000
+
+void* int_clone(void *ptr) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)ptr;
+    return copy;
+}
+
+uint64_t hash(void *key) { return map_hash_u32(key); }
+
+char* stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+int32_t compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void free_fn(void *ptr) { free(ptr); }
+
+static void *add_counts(void *ctx, void *key, void *dst_value, void *src_value) {
+    (void)ctx;
+    (void)key;
+    *(int *)dst_value += *(int *)src_value;
+    return dst_value;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static map_t *make_map(void) {
+    map_t *map;
+    assert(map_create(&map, int_clone, int_clone, hash, stringify, compare, free_fn,
+                      free_fn) == MAP_OK);
+    return map;
+}
+
+static void count(map_t *map, int value) {
+    void *freq;
+    int one = 1;
+    if (map_get(map, &value, &freq) == MAP_OK) {
+        (*(int *)freq)++;
+    } else {
+        assert(map_insert(map, &value, &one) == MAP_OK);
+    }
+}
+
+typedef struct {
+    const int *values;
+    int begin;
+    int end;
+    map_t *shared;
+    pthread_mutex_t *lock;
+    map_reducer_t *reducer;
+    int local;
+    int drain;
+} worker_t;
+
+static void *count_locked(void *arg) {
+    worker_t *w = (worker_t *)arg;
+    for (int i = w->begin; i < w->end; i++) {
+        pthread_mutex_lock(w->lock);
+        count(w->shared, w->values[i]);
+        pthread_mutex_unlock(w->lock);
+    }
+    return NULL;
+}
+
+static void *count_local(void *arg) {
+    worker_t *w = (worker_t *)arg;
+    map_t *local;
+    assert(map_reducer_local(w->reducer, w->local, &local) == MAP_OK);
+    for (int i = w->begin; i < w->end; i++) {
+        count(local, w->values[i]);
+        if (w->drain && (i - w->begin) % DRAIN_EVERY == DRAIN_EVERY - 1) {
+            assert(map_reducer_drain(w->reducer, w->local) == MAP_OK);
+            assert(map_reducer_local(w->reducer, w->local, &local) == MAP_OK);
+        }
+    }
+    return NULL;
+}
+
+static void run(const char *label, const int *values, int n, int nthreads, int mode,
+                size_t *out_distinct) {
+    pthread_mutex_t lock;
+    pthread_mutex_init(&lock, NULL);
+    map_t *shared = make_map();
+    map_reducer_t *reducer = NULL;
+    if (mode > 0) assert(map_reducer_create(&reducer, shared, nthreads, add_counts, NULL) == MAP_OK);
+
+    worker_t *workers = malloc((size_t)nthreads * sizeof(worker_t));
+    pthread_t *threads = malloc((size_t)nthreads * sizeof(pthread_t));
+    double start = now();
+    for (int t = 0; t < nthreads; t++) {
+        workers[t].values = values;
+        workers[t].begin = (int)((long long)n * t / nthreads);
+        workers[t].end = (int)((long long)n * (t + 1) / nthreads);
+        workers[t].shared = shared;
+        workers[t].lock = &lock;
+        workers[t].reducer = reducer;
+        workers[t].local = t;
+        workers[t].drain = mode == 2;
+        assert(pthread_create(&threads[t], NULL, mode > 0 ? count_local : count_locked,
+                              &workers[t]) == 0);
+    }
+    for (int t = 0; t < nthreads; t++) pthread_join(threads[t], NULL);
+    double counted = now() - start;
+    if (mode > 0) assert(map_reducer_finish(&reducer, nthreads, &shared) == MAP_OK);
+    double total = now() - start;
+
+    size_t distinct;
+    assert(map_get_size(shared, &distinct) == MAP_OK);
+    printf("  %-22s count %6.3f s  merge %6.3f s  total %6.3f s  %zu distinct\n", label,
+           counted, total - counted, total, distinct);
+    if (*out_distinct != 0) assert(distinct == *out_distinct);
+    *out_distinct = distinct;
+
+    map_destroy(&shared);
+    pthread_mutex_destroy(&lock);
+    free(workers);
+    free(threads);
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : DEFAULT_VALUES;
+    int nthreads = argc > 2 ? atoi(argv[2]) : DEFAULT_THREADS;
+    int *values = malloc((size_t)n * sizeof(int));
+    srand(0);
+    for (int i = 0; i < n; i++) values[i] = rand() % (n / DISTINCT_DIVISOR + 1);
+
+    printf("Counting %d values on %d threads:\n", n, nthreads);
+    size_t distinct = 0;
+    run("mutex, one map", values, n, nthreads, 0, &distinct);
+    run("reducer, drained", values, n, nthreads, 2, &distinct);
+    run("reducer, merged once", values, n, nthreads, 1, &distinct);
+    free(values);
+    return 0;
+}
@@ -0,0 +1,105 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <map.h>
+
+// Insert throughput with a write-ahead log on a local file, for several
+// group commit settings, plus the time to replay the log into a new map.
+// Pass the number of inserts as the first argument for a bigger run.
+
+#define DEFAULT_ENTRIES 2000
+
+void* int_clone(void *ptr) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)ptr;
+    return copy;
+}
+
+uint64_t hash(void *key) { return map_hash_u32(key); }
+
+char* stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+int32_t compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void free_fn(void *ptr) { free(ptr); }
+
+size_t int_encode(void *obj, uint8_t *buf, size_t cap) {
+    if (cap >= sizeof(int)) memcpy(buf, obj, sizeof(int));
+    return sizeof(int);
+}
+
+void* int_decode(const uint8_t *buf, size_t len) {
+    (void)len;
+    int *obj = malloc(sizeof(int));
+    if (obj) memcpy(obj, buf, sizeof(int));
+    return obj;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static map_t *open_logged(const char *path, size_t records, uint32_t ms) {
+    map_t *map;
+    assert(map_create(&map, int_clone, int_clone, hash, stringify, compare, free_fn,
+                      free_fn) == MAP_OK);
+    map_wal_options_t options;
+    map_wal_options_init(&options);
+    options.encode_key = int_encode;
+    options.decode_key = int_decode;
+    options.encode_value = int_encode;
+    options.decode_value = int_decode;
+    options.sync_every_records = records;
+    options.sync_every_ms = ms;
+    assert(map_wal_open(map, path, &options) == MAP_OK);
+    return map;
+}
+
+static void run(const char *path, const char *label, size_t records, uint32_t ms, int n) {
+    unlink(path);
+    map_t *map = open_logged(path, records, ms);
+    double start = now();
+    for (int i = 0; i < n; i++) assert(map_insert(map, &i, &i) == MAP_OK);
+    assert(map_wal_sync(map) == MAP_OK);
+    double elapsed = now() - start;
+    map_destroy(&map);
+
+    start = now();
+    map = open_logged(path, records, ms);
+    double replay = now() - start;
+    size_t size;
+    assert(map_get_size(map, &size) == MAP_OK && size == (size_t)n);
+    map_destroy(&map);
+
+    printf("  %-22s %10.0f inserts/s  replay %7.2f ms\n", label, n / elapsed, replay * 1e3);
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : DEFAULT_ENTRIES;
+    const char *dir = getenv("TMPDIR") != NULL ? getenv("TMPDIR") : "/tmp";
+    char path[512];
+    snprintf(path, sizeof(path), "%s/bench_wal_%ld.log", dir, (long)getpid());
+
+    printf("%d logged inserts:\n", n);
+    run(path, "fsync every record", 1, 0, n);
+    run(path, "fsync every 16", 16, 0, n);
+    run(path, "fsync every 256", 256, 0, n);
+    run(path, "fsync every 4096", 4096, 0, n);
+    run(path, "fsync every 10 ms", 0, 10, n);
+    run(path, "fsync only at the end", 0, 0, n);
+    unlink(path);
+    return 0;
+}
@@ -75,7 +75,7 @@ int main(void) {
     }
 
     printf("All elements inserted successfully!\n");
-    printf("Entries: %d, Buckets: %d\n", map->num_entries, map->num_buckets);
+    printf("Entries: %zu, Buckets: %zu\n", map->num_entries, map->num_buckets);
 
     // Retrieve all inserted elements
     for (int i = 0; i < 1000; i++) {
@@ -112,7 +112,7 @@ int main(void) {
 		assert(result == MAP_OK && "Failed to remove key");
 	}
 	printf("Elemnts in the range 250-750 removed successfully!\n");
-	printf("Entries: %d, Buckets: %d\n", map->num_entries, map->num_buckets);
+	printf("Entries: %zu, Buckets: %zu\n", map->num_entries, map->num_buckets);
 
 	// Iterating again
 	count = 0;
@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <map.h>
+
+// Counts past 2^31. Growing a chaining map beyond INT32_MAX buckets needs
+// a 16+ GiB bucket array, so that part only runs with MAP_LARGE_TEST set
+// in the environment; the overflow checks always run.
+
+#define LARGE_ENTRIES 1500000
+#define LARGE_LOAD_FACTOR 0.001f
+
+// Clone integer key/value
+void* dummy_clone(void *value) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)value;
+    return copy;
+}
+
+// Spread keys over the whole 64-bit range, so high bucket indexes get used.
+uint64_t dummy_hash(void *key) {
+    uint64_t x = (uint64_t)*(int *)key + 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+char* dummy_stringify(void *key, void *value) {
+    char *str = malloc(64);
+    if (str) snprintf(str, 64, "(Key: %d, Value: %d)", *(int *)key, *(int *)value);
+    return str;
+}
+
+int32_t dummy_compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void dummy_free(void *ptr) { free(ptr); }
+
+static map_t *make_map(const map_options_t *options) {
+    map_t *map;
+    assert(map_create_ex(&map, options, dummy_clone, dummy_clone, dummy_hash,
+                         dummy_stringify, dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    return map;
+}
+
+static void test_overflow(void) {
+    // A bucket array no size_t can hold is refused up front.
+    map_options_t options;
+    map_options_init(&options);
+    options.max_entries = SIZE_MAX / 2;
+    map_t *map;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash,
+                         dummy_stringify, dummy_compare, dummy_free, dummy_free) ==
+           MAP_ERR_OVERFLOW);
+    assert(map == NULL);
+
+    // A resize that would overflow is reported; the entry still goes in.
+    map = make_map(NULL);
+    assert(map_configure(map, 1.0f, 0.0f, 1e30f) == MAP_OK);
+    size_t buckets;
+    map_get_num_buckets(map, &buckets);
+    int key;
+    for (key = 0; (size_t)key < buckets; key++) {
+        assert(map_insert(map, &key, &key) == MAP_OK);
+    }
+    assert(map_insert(map, &key, &key) == MAP_ERR_OVERFLOW);
+    size_t size, after;
+    map_get_num_buckets(map, &after);
+    assert(after == buckets);
+    assert(map_get_size(map, &size) == MAP_OK && size == buckets + 1);
+    void *value;
+    assert(map_get(map, &key, &value) == MAP_OK && *(int *)value == key);
+    map_destroy(&map);
+    printf("Overflowing sizes are reported.\n");
+}
+
+static void test_large(void) {
+    map_t *map = make_map(NULL);
+    assert(map_configure(map, LARGE_LOAD_FACTOR, 0.0f, 2.0f) == MAP_OK);
+    for (int i = 0; i < LARGE_ENTRIES; i++) {
+        assert(map_insert(map, &i, &i) == MAP_OK);
+    }
+
+    size_t buckets, size;
+    assert(map_get_num_buckets(map, &buckets) == MAP_OK && buckets > (size_t)INT32_MAX);
+    assert(map_get_size(map, &size) == MAP_OK && size == LARGE_ENTRIES);
+    printf("Map holds %zu entries in %zu buckets.\n", size, buckets);
+
+    // Some entries hash past bucket 2^31.
+    size_t high = 0;
+    for (size_t i = (size_t)INT32_MAX + 1; i < buckets; i++) {
+        high += map->buckets[i] != NULL;
+    }
+    assert(high > 0);
+
+    for (int i = 0; i < LARGE_ENTRIES; i++) {
+        void *value;
+        assert(map_get(map, &i, &value) == MAP_OK && *(int *)value == i);
+    }
+
+    // The iterator walks bucket indexes beyond INT32_MAX.
+    char *seen = calloc(LARGE_ENTRIES, 1);
+    map_iterator_t iter;
+    void *key, *value;
+    size_t visited = 0;
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    while (map_iter_next(map, &iter, &key, &value) == MAP_OK) {
+        int k = *(int *)key;
+        assert(k >= 0 && k < LARGE_ENTRIES && !seen[k]);
+        seen[k] = 1;
+        visited++;
+    }
+    assert(map_iter_end(map, &iter) == MAP_OK);
+    assert(visited == LARGE_ENTRIES);
+    free(seen);
+
+    // Removing through the iterator in the high buckets.
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    while (map_iter_next(map, &iter, &key, &value) == MAP_OK) {
+        if (iter.current_bucket > (size_t)INT32_MAX) {
+            assert(map_iter_remove(map, &iter) == MAP_OK);
+            visited--;
+        }
+    }
+    assert(map_iter_end(map, &iter) == MAP_OK);
+    assert(map_get_size(map, &size) == MAP_OK && size == visited);
+    map_destroy(&map);
+}
+
+int main(void) {
+    test_overflow();
+
+    if (getenv("MAP_LARGE_TEST") == NULL) {
+        printf("Set MAP_LARGE_TEST to build a table with more than 2^31 buckets.\n");
+        return MAP_OK;
+    }
+    test_large();
+
+    printf("All large map tests passed.\n");
+    return MAP_OK;
+}
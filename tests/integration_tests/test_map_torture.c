@@ -116,9 +116,11 @@ int main(void) {
     printf("Removing all elements...\n");
     iter_result = map_iter_start(map, &iter);
     while ((iter_result = map_iter_next(map, &iter, &key, &value)) == MAP_OK) {
-        result = map_remove(map, key);
-        assert(result == MAP_OK && "map_remove() failed!");
+        result = map_iter_remove(map, &iter);
+        assert(result == MAP_OK && "map_iter_remove() failed!");
     }
+    size_t remaining;
+    assert(map_get_size(map, &remaining) == MAP_OK && remaining == 0 && "Iteration skipped elements!");
     printf("All elements removed successfully.\n");
 
 
@@ -0,0 +1,205 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <map.h>
+
+#define NUM_KEYS 20000
+#define NUM_ROWS 100000
+#define RAM_BUDGET (64 * 1024)
+
+// Per-group sum and count of the added values.
+typedef struct {
+    long sum;
+    long count;
+} agg_state_t;
+
+// Clone integer key
+void* dummy_clone(void *key) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)key;
+    return copy;
+}
+
+uint64_t dummy_hash(void *key) { return (uint64_t)(*(int *)key); }
+
+int32_t dummy_compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void dummy_free(void *ptr) { free(ptr); }
+
+void* state_init(void *ctx, void *key) {
+    (void)ctx;
+    (void)key;
+    return calloc(1, sizeof(agg_state_t));
+}
+
+void state_update(void *ctx, void *state, void *value) {
+    (void)ctx;
+    ((agg_state_t *)state)->sum += *(int *)value;
+    ((agg_state_t *)state)->count++;
+}
+
+void state_merge(void *ctx, void *state, void *other) {
+    (void)ctx;
+    ((agg_state_t *)state)->sum += ((agg_state_t *)other)->sum;
+    ((agg_state_t *)state)->count += ((agg_state_t *)other)->count;
+}
+
+size_t int_encode(void *obj, uint8_t *buf, size_t cap) {
+    if (cap >= sizeof(int)) memcpy(buf, obj, sizeof(int));
+    return sizeof(int);
+}
+
+void* int_decode(const uint8_t *buf, size_t len) {
+    if (len != sizeof(int)) return NULL;
+    int *obj = malloc(sizeof(int));
+    if (obj) memcpy(obj, buf, sizeof(int));
+    return obj;
+}
+
+size_t state_encode(void *obj, uint8_t *buf, size_t cap) {
+    if (cap >= sizeof(agg_state_t)) memcpy(buf, obj, sizeof(agg_state_t));
+    return sizeof(agg_state_t);
+}
+
+void* state_decode(const uint8_t *buf, size_t len) {
+    if (len != sizeof(agg_state_t)) return NULL;
+    agg_state_t *obj = malloc(sizeof(agg_state_t));
+    if (obj) memcpy(obj, buf, sizeof(agg_state_t));
+    return obj;
+}
+
+// What finalize handed out, one slot per key.
+typedef struct {
+    agg_state_t *seen;
+    int *emitted;
+    int stop_after; // Fail the emit after this many groups; 0 for never.
+    int calls;
+} result_t;
+
+map_error_t collect(void *ctx, void *key, void *state) {
+    result_t *result = (result_t *)ctx;
+    int k = *(int *)key;
+    assert(k >= 0 && k < NUM_KEYS);
+    result->seen[k] = *(agg_state_t *)state;
+    result->emitted[k]++;
+    if (result->stop_after > 0 && ++result->calls == result->stop_after) {
+        return MAP_ERR_UNKNOWN;
+    }
+    return MAP_OK;
+}
+
+static map_agg_t *make_agg(const char *dir, size_t budget, uint32_t partitions) {
+    map_agg_options_t options;
+    map_agg_options_init(&options);
+    options.dir = dir;
+    options.ram_budget = budget;
+    options.partitions = partitions;
+    options.init = state_init;
+    options.update = state_update;
+    options.merge = state_merge;
+    options.free_state = dummy_free;
+    options.encode_key = int_encode;
+    options.decode_key = int_decode;
+    options.encode_state = state_encode;
+    options.decode_state = state_decode;
+    map_agg_t *agg;
+    assert(map_agg_create(&agg, &options, dummy_clone, dummy_hash, dummy_compare,
+                          dummy_free) == MAP_OK);
+    return agg;
+}
+
+static uint64_t rng_state = 11;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// Group NUM_ROWS random rows and check every group came out once, right.
+static map_agg_stats_t run(const char *dir, size_t budget, uint32_t partitions, int nthreads) {
+    agg_state_t *expected = calloc(NUM_KEYS, sizeof(agg_state_t));
+    result_t result = {calloc(NUM_KEYS, sizeof(agg_state_t)), calloc(NUM_KEYS, sizeof(int)), 0, 0};
+    map_agg_t *agg = make_agg(dir, budget, partitions);
+    for (int row = 0; row < NUM_ROWS; row++) {
+        int key = (int)(next_random() % NUM_KEYS);
+        int value = (int)(next_random() % 100);
+        assert(map_agg_add(agg, &key, &value) == MAP_OK);
+        expected[key].sum += value;
+        expected[key].count++;
+    }
+    assert(map_agg_finalize(agg, nthreads, collect, &result) == MAP_OK);
+    for (int k = 0; k < NUM_KEYS; k++) {
+        assert(result.emitted[k] == (expected[k].count > 0));
+        assert(result.seen[k].sum == expected[k].sum && result.seen[k].count == expected[k].count);
+    }
+
+    int key = 0;
+    assert(map_agg_add(agg, &key, &key) == MAP_ERR_INVALID_ARG);
+    assert(map_agg_finalize(agg, 1, collect, &result) == MAP_ERR_INVALID_ARG);
+    map_agg_stats_t stats;
+    assert(map_agg_stats(agg, &stats) == MAP_OK);
+    assert(stats.groups == 0 && stats.bytes == 0);
+    map_agg_destroy(&agg);
+    free(result.seen);
+    free(result.emitted);
+    free(expected);
+    return stats;
+}
+
+int main(void) {
+    const char *tmp = getenv("TMPDIR") != NULL ? getenv("TMPDIR") : "/tmp";
+    char dir[4096];
+    snprintf(dir, sizeof(dir), "%s/test_map_agg_XXXXXX", tmp);
+    assert(mkdtemp(dir) != NULL);
+
+    // Settings are checked up front.
+    map_agg_options_t options;
+    map_agg_options_init(&options);
+    map_agg_t *agg;
+    assert(map_agg_create(&agg, &options, dummy_clone, dummy_hash, dummy_compare,
+                          dummy_free) == MAP_ERR_INVALID_ARG);
+    assert(agg == NULL);
+    agg = make_agg(dir, RAM_BUDGET, 16);
+    map_agg_destroy(&agg);
+    assert(map_agg_create(&agg, NULL, dummy_clone, dummy_hash, dummy_compare, dummy_free) ==
+           MAP_ERR_INVALID_ARG);
+
+    // Everything fits: no files at all.
+    map_agg_stats_t stats = run(dir, (size_t)64 * 1024 * 1024, 16, 1);
+    assert(stats.spills == 0 && stats.bytes_written == 0 && stats.max_level == 0);
+
+    // Spilled partitions merge within the budget, on one or more threads.
+    stats = run(dir, RAM_BUDGET, 16, 1);
+    printf("Group-by: %zu spills, %zu bytes written, %zu read, %u levels.\n", stats.spills,
+           stats.bytes_written, stats.bytes_read, (unsigned)stats.max_level);
+    assert(stats.spills > 0 && stats.bytes_read == stats.bytes_written);
+    assert(stats.max_level >= 1);
+    stats = run(dir, RAM_BUDGET, 16, 4);
+    assert(stats.bytes_read == stats.bytes_written);
+
+    // Partitions that still don't fit are split again.
+    stats = run(dir, 4 * 1024, 2, 1);
+    assert(stats.max_level > 1 && stats.bytes_read == stats.bytes_written);
+
+    // An emit error stops finalizing; destroy still cleans up.
+    agg = make_agg(dir, RAM_BUDGET, 16);
+    for (int k = 0; k < NUM_KEYS; k++) assert(map_agg_add(agg, &k, &k) == MAP_OK);
+    result_t result = {calloc(NUM_KEYS, sizeof(agg_state_t)), calloc(NUM_KEYS, sizeof(int)), 10, 0};
+    assert(map_agg_finalize(agg, 1, collect, &result) == MAP_ERR_UNKNOWN);
+    assert(result.calls == 10);
+    map_agg_destroy(&agg);
+    free(result.seen);
+    free(result.emitted);
+    assert(rmdir(dir) == 0);
+
+    printf("All group-by tests passed.\n");
+    return MAP_OK;
+}
@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <map.h>
+
+#define NUM_ENTRIES 5000
+
+// Accounting allocator: tracks live blocks and bytes, checking that every
+// free reports the size the block was allocated with.
+typedef struct {
+    long allocs;
+    long frees;
+    long live_bytes;
+} counting_ctx_t;
+
+typedef struct {
+    size_t size;
+    size_t pad;
+} block_header_t;
+
+void *counting_alloc(void *ctx, size_t size) {
+    counting_ctx_t *c = ctx;
+    block_header_t *header = malloc(sizeof(block_header_t) + size);
+    if (header == NULL) return NULL;
+    header->size = size;
+    c->allocs++;
+    c->live_bytes += (long)size;
+    return header + 1;
+}
+
+void counting_free(void *ctx, void *ptr, size_t size) {
+    counting_ctx_t *c = ctx;
+    block_header_t *header = (block_header_t *)ptr - 1;
+    assert(header->size == size && "Free size mismatch");
+    c->frees++;
+    c->live_bytes -= (long)size;
+    free(header);
+}
+
+void *counting_realloc(void *ctx, void *ptr, size_t old_size, size_t new_size) {
+    void *moved = counting_alloc(ctx, new_size);
+    if (moved != NULL && ptr != NULL) {
+        memcpy(moved, ptr, old_size < new_size ? old_size : new_size);
+        counting_free(ctx, ptr, old_size);
+    }
+    return moved;
+}
+
+// Clone integer key/value
+void* dummy_clone(void *value) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)value;
+    return copy;
+}
+
+uint64_t dummy_hash(void *key) { return map_hash_u32(key); }
+
+char* dummy_stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+int32_t dummy_compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void dummy_free(void *ptr) { free(ptr); }
+
+// Values for arena-backed maps come from the same arena.
+static map_arena_t *value_arena;
+
+void* arena_value_clone(void *value) {
+    int *copy = map_arena_alloc(value_arena, sizeof(int));
+    if (copy) *copy = *(int *)value;
+    return copy;
+}
+
+void arena_free_value(void *value) { (void)value; }
+
+static void check_counting(map_engine_t engine, map_key_mode_t key_mode) {
+    counting_ctx_t ctx = {0, 0, 0};
+    map_allocator_t allocator = {counting_alloc, counting_realloc, counting_free, &ctx};
+    map_options_t options;
+    map_options_init(&options);
+    options.engine = engine;
+    options.key_mode = key_mode;
+    options.allocator = &allocator;
+
+    map_t *map;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone,
+                         key_mode == MAP_KEY_STRING ? NULL : dummy_hash, dummy_stringify,
+                         dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    assert(ctx.allocs > 0 && "Map struct not allocated through the allocator");
+
+    char key[32];
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        snprintf(key, sizeof(key), "%d", i);
+        assert(map_insert(map, key_mode == MAP_KEY_STRING ? (void *)key : (void *)&i,
+                          &i) == MAP_OK);
+    }
+    for (int i = 0; i < NUM_ENTRIES; i += 2) {
+        snprintf(key, sizeof(key), "%d", i);
+        assert(map_remove(map, key_mode == MAP_KEY_STRING ? (void *)key : (void *)&i) ==
+               MAP_OK);
+    }
+    if (key_mode == MAP_KEY_STRING) assert(map_compact_keys(map) == MAP_OK);
+    assert(ctx.live_bytes > 0);
+
+    map_destroy(&map);
+    assert(ctx.live_bytes == 0 && ctx.allocs == ctx.frees && "Allocator leak");
+}
+
+int main(void) {
+    map_t *map;
+    map_options_t options;
+    void *value;
+
+    // Every map allocation is routed through the allocator and given back.
+    check_counting(MAP_ENGINE_CHAINING, MAP_KEY_USER);
+    check_counting(MAP_ENGINE_CHAINING, MAP_KEY_STRING);
+    check_counting(MAP_ENGINE_CUCKOO, MAP_KEY_USER);
+    printf("Counting allocator balanced for all engines.\n");
+
+    // Perfect tables inherit the allocator of the map they were built from.
+    counting_ctx_t ctx = {0, 0, 0};
+    map_allocator_t allocator = {counting_alloc, counting_realloc, counting_free, &ctx};
+    map_options_init(&options);
+    options.allocator = &allocator;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash,
+                         dummy_stringify, dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    for (int i = 0; i < NUM_ENTRIES; i++) assert(map_insert(map, &i, &i) == MAP_OK);
+    map_perfect_t *pmap;
+    assert(map_build_perfect(&map, &pmap) == MAP_OK);
+    int probe = 17;
+    assert(map_perfect_get(pmap, &probe, &value) == MAP_OK && *(int *)value == 17);
+    map_perfect_destroy(&pmap);
+    assert(ctx.live_bytes == 0 && ctx.allocs == ctx.frees);
+    printf("Perfect table returned its memory to the allocator.\n");
+
+    // Incomplete allocators are rejected.
+    allocator.realloc = NULL;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash,
+                         dummy_stringify, dummy_compare, dummy_free,
+                         dummy_free) == MAP_ERR_INVALID_ARG);
+
+    // Bump arena: per-request maps thrown away without map_destroy().
+    assert(map_arena_create(&value_arena, 0) == MAP_OK);
+    map_allocator_t arena_allocator;
+    assert(map_arena_allocator(value_arena, &arena_allocator) == MAP_OK);
+    map_options_init(&options);
+    options.key_mode = MAP_KEY_STRING;
+    options.allocator = &arena_allocator;
+
+    char key[32];
+    for (int request = 0; request < 3; request++) {
+        assert(map_create_ex(&map, &options, NULL, arena_value_clone, NULL, dummy_stringify,
+                             NULL, NULL, arena_free_value) == MAP_OK);
+        for (int i = 0; i < NUM_ENTRIES; i++) {
+            snprintf(key, sizeof(key), "req%d-key%d", request, i);
+            assert(map_insert(map, key, &i) == MAP_OK);
+        }
+        for (int i = 0; i < NUM_ENTRIES; i++) {
+            snprintf(key, sizeof(key), "req%d-key%d", request, i);
+            assert(map_get(map, key, &value) == MAP_OK && *(int *)value == i);
+        }
+        assert(map_arena_reset(value_arena) == MAP_OK);
+        assert(value_arena->chunks != NULL && value_arena->chunks->next == NULL);
+    }
+    printf("Arena-backed maps discarded in bulk.\n");
+
+    // map_destroy() still works on arena-backed maps.
+    options.key_mode = MAP_KEY_USER;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash,
+                         dummy_stringify, dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    for (int i = 0; i < NUM_ENTRIES; i++) assert(map_insert(map, &i, &i) == MAP_OK);
+    assert(map_destroy(&map) == MAP_OK && map == NULL);
+
+    // Arena realloc grows the latest block in place and copies otherwise.
+    char *a = arena_allocator.alloc(arena_allocator.ctx, 16);
+    memcpy(a, "0123456789abcde", 16);
+    char *grown = arena_allocator.realloc(arena_allocator.ctx, a, 16, 64);
+    assert(grown == a);
+    char *b = arena_allocator.alloc(arena_allocator.ctx, 8);
+    assert(((uintptr_t)b & 15) == 0 && "Arena allocations are 16-byte aligned");
+    char *moved = arena_allocator.realloc(arena_allocator.ctx, grown, 64, 128);
+    assert(moved != grown && memcmp(moved, "0123456789abcde", 16) == 0);
+    char *big = map_arena_alloc(value_arena, 1 << 20);
+    assert(big != NULL);
+    memset(big, 0xab, 1 << 20);
+
+    assert(map_arena_destroy(&value_arena) == MAP_OK && value_arena == NULL);
+    assert(map_arena_create(NULL, 0) == MAP_ERR_INVALID_ARG);
+    printf("All allocator tests passed.\n");
+
+    return MAP_OK;
+}
@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <map.h>
+
+// Clone integer key/value
+void* dummy_clone(void *value) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)value;
+    return copy;
+}
+
+uint64_t dummy_hash(void *key) { return map_hash_u32(key); }
+
+char* dummy_stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+int32_t dummy_compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void dummy_free(void *ptr) { free(ptr); }
+
+// Values are their own size in bytes.
+size_t value_size(void *key, void *value) {
+    (void)key;
+    return (size_t)*(int *)value;
+}
+
+// Count evictions and sum the evicted values.
+void count_evict(void *ctx, void *key, void *value) {
+    (void)key;
+    long *seen = (long *)ctx;
+    seen[0]++;
+    seen[1] += *(int *)value;
+}
+
+// Sum as a fresh value, which the set operations have to store.
+void* sum_new(void *ctx, void *key, void *dst_value, void *src_value) {
+    (void)ctx;
+    (void)key;
+    int sum = *(int *)dst_value + *(int *)src_value;
+    return dummy_clone(&sum);
+}
+
+static map_t *make_cache(const map_options_t *options) {
+    map_t *map;
+    assert(map_create_ex(&map, options, dummy_clone, dummy_clone, dummy_hash,
+                         dummy_stringify, dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    return map;
+}
+
+int main(void) {
+    map_options_t options;
+    map_cache_stats_t stats;
+    long seen[2] = {0, 0};
+    size_t size;
+    void *value;
+
+    // An entry limit holds, with one callback per eviction.
+    map_options_init(&options);
+    options.max_entries = 100;
+    options.on_evict = count_evict;
+    options.evict_ctx = seen;
+    map_t *map = make_cache(&options);
+    size_t num_buckets;
+    assert(map_get_num_buckets(map, &num_buckets) == MAP_OK && num_buckets == 100);
+    for (int i = 0; i < 1000; i++) {
+        assert(map_insert(map, &i, &i) == MAP_OK);
+        assert(map_get_size(map, &size) == MAP_OK && size <= 100);
+    }
+    assert(map_get_size(map, &size) == MAP_OK && size == 100);
+    assert(map_cache_stats(map, &stats) == MAP_OK && stats.evictions == 900);
+    assert(seen[0] == 900);
+    assert(map_get_num_buckets(map, &num_buckets) == MAP_OK && num_buckets == 100);
+
+    // An insert that evicts ends an iteration, whichever entry goes.
+    map_iterator_t iter;
+    void *out_key;
+    int fresh = 1000;
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    assert(map_iter_next(map, &iter, &out_key, &value) == MAP_OK);
+    assert(map_insert(map, &fresh, &fresh) == MAP_OK);
+    assert(map_iter_next(map, &iter, &out_key, &value) == MAP_ERR_STALE_ITERATOR);
+    map_destroy(&map);
+    printf("Entry limit enforced.\n");
+
+    // Keys that keep getting hit survive a stream of one-off inserts, once
+    // the hand has been around and cleared the marks left by the fill.
+    map_options_init(&options);
+    options.max_entries = 1000;
+    map = make_cache(&options);
+    for (int i = 0; i < 1000; i++) assert(map_insert(map, &i, &i) == MAP_OK);
+    for (int i = 1000; i < 5000; i++) {
+        assert(map_insert(map, &i, &i) == MAP_OK);
+        for (int hot = 0; hot < 100; hot += 7) {
+            map_error_t result = map_get(map, &hot, &value);
+            assert(result == MAP_OK || i < 2000);
+            if (result != MAP_OK) assert(map_insert(map, &hot, &hot) == MAP_OK);
+        }
+    }
+    int missing = 4999;
+    assert(map_get(map, &missing, &value) == MAP_OK);
+    missing = 500;
+    assert(map_get(map, &missing, &value) == MAP_ERR_NOT_FOUND);
+    assert(map_cache_stats(map, &stats) == MAP_OK);
+    assert(stats.hits + stats.misses == 4000 * 15 + 2 && stats.misses < 100);
+    map_destroy(&map);
+    printf("Recently used entries are kept.\n");
+
+    // A byte budget, with overwrites and removes changing the charge.
+    map_options_init(&options);
+    options.max_bytes = 1000;
+    options.entry_size = value_size;
+    options.on_evict = count_evict;
+    options.evict_ctx = seen;
+    seen[0] = seen[1] = 0;
+    map = make_cache(&options);
+    int hundred = 100, big = 550, huge = 5000;
+    for (int i = 0; i < 50; i++) {
+        assert(map_insert(map, &i, &hundred) == MAP_OK);
+        assert(map_cache_stats(map, &stats) == MAP_OK && stats.bytes <= 1000);
+    }
+    assert(map_get_size(map, &size) == MAP_OK && size == 10 && seen[1] == 4000);
+    int key = 49;
+    assert(map_insert(map, &key, &big) == MAP_OK);
+    assert(map_cache_stats(map, &stats) == MAP_OK && stats.bytes == 950);
+    assert(map_get_size(map, &size) == MAP_OK && size == 5);
+    assert(map_remove(map, &key) == MAP_OK);
+    assert(map_cache_stats(map, &stats) == MAP_OK && stats.bytes == 400);
+    assert(map_insert(map, &key, &huge) == MAP_OK); // Alone over budget, but kept.
+    assert(map_get_size(map, &size) == MAP_OK && size == 1);
+    assert(map_get(map, &key, &value) == MAP_OK && *(int *)value == 5000);
+    map_destroy(&map);
+
+    // Intersecting with bigger combined values evicts keys whose new
+    // value is still to be stored.
+    options.on_evict = NULL;
+    map = make_cache(&options);
+    map_t *other = make_cache(&options);
+    for (int i = 0; i < 10; i++) {
+        assert(map_insert(map, &i, &hundred) == MAP_OK);
+        assert(map_insert(other, &i, &hundred) == MAP_OK);
+    }
+    assert(map_intersect(map, other, sum_new, NULL) == MAP_OK);
+    assert(map_cache_stats(map, &stats) == MAP_OK && stats.bytes <= 1000);
+    assert(map_get_size(map, &size) == MAP_OK && size == 5);
+    map_destroy(&other);
+    map_destroy(&map);
+    printf("Byte budget enforced.\n");
+
+    // Evictions under a snapshot leave the snapshot intact; clones keep limits.
+    map_options_init(&options);
+    options.max_entries = 64;
+    map = make_cache(&options);
+    for (int i = 0; i < 64; i++) assert(map_insert(map, &i, &i) == MAP_OK);
+    map_snapshot_t *snap;
+    assert(map_snapshot(map, &snap) == MAP_OK);
+    for (int i = 64; i < 256; i++) assert(map_insert(map, &i, &i) == MAP_OK);
+    assert(map_get_size(map, &size) == MAP_OK && size == 64);
+    for (int i = 0; i < 64; i++) {
+        assert(map_snapshot_get(snap, &i, &value) == MAP_OK && *(int *)value == i);
+    }
+    map_snapshot_release(&snap);
+    map_t *copy;
+    assert(map_clone(map, &copy, 1) == MAP_OK);
+    for (int i = 256; i < 512; i++) assert(map_insert(copy, &i, &i) == MAP_OK);
+    assert(map_get_size(copy, &size) == MAP_OK && size == 64);
+    map_destroy(&copy);
+    map_destroy(&map);
+    printf("Snapshots and clones of caches work.\n");
+
+    // String keys are charged their node and arena record by default.
+    map_options_init(&options);
+    options.key_mode = MAP_KEY_STRING;
+    options.max_bytes = 64 * 1024;
+    assert(map_create_ex(&map, &options, NULL, dummy_clone, NULL, dummy_stringify, NULL,
+                         NULL, dummy_free) == MAP_OK);
+    char name[32];
+    for (int i = 0; i < 10000; i++) {
+        snprintf(name, sizeof(name), "session-%d", i);
+        assert(map_insert(map, name, &i) == MAP_OK);
+    }
+    assert(map_cache_stats(map, &stats) == MAP_OK && stats.bytes <= 64 * 1024);
+    assert(map_get_size(map, &size) == MAP_OK && size > 1000 && size < 2000);
+    assert(map_get(map, "session-9999", &value) == MAP_OK);
+    map_destroy(&map);
+
+    // Only the chaining engine has a cache mode.
+    map_options_init(&options);
+    options.engine = MAP_ENGINE_CUCKOO;
+    options.max_entries = 10;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash,
+                         dummy_stringify, dummy_compare, dummy_free,
+                         dummy_free) == MAP_ERR_INVALID_ARG);
+    map = make_cache(NULL);
+    assert(map_cache_stats(map, &stats) == MAP_ERR_INVALID_ARG);
+    map_destroy(&map);
+    printf("All cache tests passed.\n");
+
+    return MAP_OK;
+}
@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <map.h>
+
+#define NUM_ENTRIES 2000
+#define NUM_RANDOM 20000
+
+static size_t compares = 0;
+
+// Clone integer key/value
+void* dummy_clone(void *value) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)value;
+    return copy;
+}
+
+// Every key collides.
+uint64_t same_hash(void *key) {
+    (void)key;
+    return 42;
+}
+
+// Four hashes for all keys, so chains hold runs of equal hashes.
+uint64_t weak_hash(void *key) { return (uint64_t)(*(int *)key & 3) * 1000; }
+
+char* dummy_stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+int32_t dummy_compare(void *key1, void *key2) {
+    compares++;
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void dummy_free(void *ptr) { free(ptr); }
+
+void* string_clone(void *ptr) {
+    char *copy = malloc(strlen((char *)ptr) + 1);
+    if (copy) strcpy(copy, (char *)ptr);
+    return copy;
+}
+
+// strcmp()'s raw result, which can be any int.
+int32_t string_compare(void *key1, void *key2) { return strcmp((char *)key1, (char *)key2); }
+
+// Tells equal from unequal, nothing more.
+int32_t string_equal(void *key1, void *key2) { return strcmp((char *)key1, (char *)key2) != 0; }
+
+// Calls every unequal pair "less", whichever way round it is asked.
+int32_t string_less(void *key1, void *key2) { return -(strcmp((char *)key1, (char *)key2) != 0); }
+
+// User string keys through a given compare, all colliding; every one must
+// be found after inserts and removes.
+static void test_string_compare(int32_t (*compare)(void *, void *), int ordered) {
+    map_t *map;
+    assert(map_create(&map, string_clone, dummy_clone, same_hash, dummy_stringify, compare,
+                      dummy_free, dummy_free) == MAP_OK);
+    char name[32];
+    for (int i = 0; i < 200; i++) {
+        snprintf(name, sizeof(name), "key-%d", i * 37 % 200);
+        int value = i * 37 % 200;
+        assert(map_insert(map, name, &value) == MAP_OK);
+    }
+    for (int i = 0; i < 200; i += 3) {
+        snprintf(name, sizeof(name), "key-%d", i);
+        assert(map_remove(map, name) == MAP_OK);
+    }
+    for (int i = 0; i < 300; i++) {
+        void *value;
+        snprintf(name, sizeof(name), "key-%d", i);
+        if (i < 200 && i % 3 != 0) {
+            assert(map_get(map, name, &value) == MAP_OK && *(int *)value == i);
+        } else {
+            assert(map_get(map, name, &value) == MAP_ERR_NOT_FOUND);
+        }
+    }
+    assert(map->chain_index_off == !ordered);
+    map_destroy(&map);
+}
+
+static map_t *make_map(uint64_t (*hash)(void *key), size_t max_entries) {
+    map_options_t options;
+    map_options_init(&options);
+    options.max_entries = max_entries;
+    map_t *map;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, hash, dummy_stringify,
+                         dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    return map;
+}
+
+// Key i must be present exactly when present[i], holding i.
+static void check(map_t *map, const char *present, int n) {
+    size_t live = 0;
+    for (int i = 0; i < n; i++) {
+        void *value;
+        if (present[i]) {
+            assert(map_get(map, &i, &value) == MAP_OK && *(int *)value == i);
+            live++;
+        } else {
+            assert(map_get(map, &i, &value) == MAP_ERR_NOT_FOUND);
+        }
+    }
+    size_t size;
+    assert(map_get_size(map, &size) == MAP_OK && size == live);
+}
+
+static uint64_t rng_state = 11;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static void test_hash(uint64_t (*hash)(void *key), const char *name) {
+    static char present[NUM_ENTRIES];
+    map_t *map = make_map(hash, 0);
+    assert(map_configure(map, 1000, 0.75, 2.0) == MAP_OK);
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        assert(map_insert(map, &i, &i) == MAP_OK);
+        present[i] = 1;
+    }
+
+    // A lookup costs O(log n) compares, not a walk of the chain.
+    size_t before = compares;
+    check(map, present, NUM_ENTRIES);
+    size_t per_lookup = (compares - before) / NUM_ENTRIES;
+    printf("%s: %zu compares per lookup in chains of up to %d.\n", name, per_lookup,
+           NUM_ENTRIES);
+    assert(per_lookup <= 16);
+
+    // Random inserts and removes, with resizes in between.
+    assert(map_configure(map, 200, 50, 2.0) == MAP_OK);
+    for (int step = 0; step < NUM_RANDOM; step++) {
+        int k = (int)(next_random() % NUM_ENTRIES);
+        if (next_random() % 2 == 0) {
+            assert(map_remove(map, &k) == (present[k] ? MAP_OK : MAP_ERR_NOT_FOUND));
+            present[k] = 0;
+        } else {
+            assert(map_insert(map, &k, &k) == MAP_OK);
+            present[k] = 1;
+        }
+    }
+    check(map, present, NUM_ENTRIES);
+
+    // Removing while iterating, then a snapshot over the indexed chains.
+    map_iterator_t iter;
+    void *key, *value;
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    while (map_iter_next(map, &iter, &key, &value) == MAP_OK) {
+        if (*(int *)key % 3 == 0) {
+            present[*(int *)key] = 0;
+            assert(map_iter_remove(map, &iter) == MAP_OK);
+        }
+    }
+    check(map, present, NUM_ENTRIES);
+
+    map_snapshot_t *snap;
+    assert(map_snapshot(map, &snap) == MAP_OK);
+    int first = -1;
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        if (present[i] && first < 0) first = i;
+        if (i % 3 == 0) {
+            assert(map_insert(map, &i, &i) == MAP_OK);
+            present[i] = 1;
+        }
+    }
+    assert(map_remove(map, &first) == MAP_OK);
+    present[first] = 0;
+    check(map, present, NUM_ENTRIES);
+    assert(map_snapshot_get(snap, &first, &value) == MAP_OK && *(int *)value == first);
+    int removed_before = 0;
+    assert(map_snapshot_get(snap, &removed_before, &value) == MAP_ERR_NOT_FOUND);
+    map_snapshot_release(&snap);
+
+    // Clones and merges (which take the public calls here) stay searchable.
+    map_t *copy;
+    assert(map_clone(map, &copy, 1) == MAP_OK);
+    check(copy, present, NUM_ENTRIES);
+    map_t *other = make_map(hash, 0);
+    for (int i = 0; i < NUM_ENTRIES; i += 7) {
+        assert(map_insert(other, &i, &i) == MAP_OK);
+        present[i] = 1;
+    }
+    assert(map_merge(copy, other, NULL, NULL) == MAP_OK);
+    check(copy, present, NUM_ENTRIES);
+
+    // Shrinking back to short chains.
+    for (int i = 0; i < NUM_ENTRIES - 3; i++) {
+        if (present[i]) assert(map_remove(copy, &i) == MAP_OK);
+        present[i] = 0;
+    }
+    check(copy, present, NUM_ENTRIES);
+
+    map_destroy(&copy);
+    map_destroy(&other);
+    map_destroy(&map);
+}
+
+int main(void) {
+    test_hash(same_hash, "Colliding keys");
+    test_hash(weak_hash, "Weak hash");
+
+    // Caches evict out of long chains.
+    map_t *cache = make_map(same_hash, 100);
+    for (int i = 0; i < 1000; i++) assert(map_insert(cache, &i, &i) == MAP_OK);
+    int found = 0;
+    for (int i = 0; i < 1000; i++) {
+        void *value;
+        if (map_get(cache, &i, &value) == MAP_OK) {
+            assert(*(int *)value == i);
+            found++;
+        }
+    }
+    assert(found == 100);
+    map_destroy(&cache);
+
+    // String keys order by length, then bytes.
+    map_options_t options;
+    map_options_init(&options);
+    options.key_mode = MAP_KEY_STRING;
+    map_t *map;
+    assert(map_create_ex(&map, &options, NULL, dummy_clone, same_hash, dummy_stringify, NULL,
+                         NULL, dummy_free) == MAP_OK);
+    assert(map_configure(map, 1000, 0.75, 2.0) == MAP_OK);
+    char name[32];
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        snprintf(name, sizeof(name), "k%d", i);
+        assert(map_insert(map, name, &i) == MAP_OK);
+    }
+    for (int i = 0; i < NUM_ENTRIES; i += 2) {
+        snprintf(name, sizeof(name), "k%d", i);
+        assert(map_remove(map, name) == MAP_OK);
+    }
+    for (int i = 0; i < 2 * NUM_ENTRIES; i++) {
+        void *value;
+        snprintf(name, sizeof(name), "k%d", i);
+        if (i < NUM_ENTRIES && i % 2 == 1) {
+            assert(map_get(map, name, &value) == MAP_OK && *(int *)value == i);
+        } else {
+            assert(map_get(map, name, &value) == MAP_ERR_NOT_FOUND);
+        }
+    }
+    map_destroy(&map);
+
+    // Compares are read by sign, and one that can't order keys turns the
+    // indexes off instead of hiding keys.
+    test_string_compare(string_compare, 1);
+    test_string_compare(string_equal, 0);
+    test_string_compare(string_less, 0);
+
+    printf("All chain index tests passed.\n");
+    return MAP_OK;
+}
@@ -97,10 +97,10 @@ int main(void) {
     map_print(map);
 
     // Verify size after removal
-    int size;
+    size_t size;
     assert(map_get_size(map, &size) == MAP_OK);
     assert(size == 4);
-    printf("\n Map size after removal: %d\n", size);
+    printf("\n Map size after removal: %zu\n", size);
 
     // Cleanup
     assert(map_destroy(&map) == MAP_OK);
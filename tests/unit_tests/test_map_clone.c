@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <map.h>
+
+#define NUM_ENTRIES 50000
+
+static int fail_after = -1; // Make the Nth value clone fail, -1 for never.
+
+// Clone integer key/value
+void* dummy_clone(void *value) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)value;
+    return copy;
+}
+
+void* failing_clone(void *value) {
+    if (fail_after == 0) return NULL;
+    if (fail_after > 0) fail_after--;
+    return dummy_clone(value);
+}
+
+uint64_t dummy_hash(void *key) { return map_hash_u32(key); }
+
+char* dummy_stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+int32_t dummy_compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void dummy_free(void *ptr) { free(ptr); }
+
+// The clone must hold the same entries in the same layout, in memory of
+// its own.
+static void check_clone(map_t *src, map_t *dst) {
+    size_t src_size, dst_size, src_buckets, dst_buckets;
+    map_get_size(src, &src_size);
+    map_get_size(dst, &dst_size);
+    map_get_num_buckets(src, &src_buckets);
+    map_get_num_buckets(dst, &dst_buckets);
+    assert(src_size == dst_size && src_buckets == dst_buckets);
+
+    map_iterator_t src_iter, dst_iter;
+    void *src_key, *src_value, *dst_key, *dst_value;
+    size_t count = 0;
+    map_iter_start(src, &src_iter);
+    map_iter_start(dst, &dst_iter);
+    while (map_iter_next(src, &src_iter, &src_key, &src_value) == MAP_OK) {
+        assert(map_iter_next(dst, &dst_iter, &dst_key, &dst_value) == MAP_OK);
+        assert(src_key != dst_key && src_value != dst_value && "Clone shares entries");
+        assert(*(int *)src_value == *(int *)dst_value);
+        count++;
+    }
+    assert(map_iter_next(dst, &dst_iter, &dst_key, &dst_value) == MAP_ERR_END_OF_MAP);
+    assert(count == src_size);
+}
+
+static void check_engine(map_engine_t engine, int nthreads) {
+    map_options_t options;
+    map_options_init(&options);
+    options.engine = engine;
+
+    map_t *src, *dst;
+    assert(map_create_ex(&src, &options, dummy_clone, dummy_clone, dummy_hash,
+                         dummy_stringify, dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    for (int i = 0; i < NUM_ENTRIES; i++) assert(map_insert(src, &i, &i) == MAP_OK);
+
+    assert(map_clone(src, &dst, nthreads) == MAP_OK);
+    check_clone(src, dst);
+
+    // The two maps are independent afterwards.
+    for (int i = 0; i < NUM_ENTRIES; i += 2) assert(map_remove(src, &i) == MAP_OK);
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        void *value;
+        assert(map_get(dst, &i, &value) == MAP_OK && *(int *)value == i);
+    }
+    map_destroy(&src);
+    map_destroy(&dst);
+}
+
+int main(void) {
+    map_t *src, *dst;
+
+    check_engine(MAP_ENGINE_CHAINING, 1);
+    check_engine(MAP_ENGINE_CHAINING, 4);
+    check_engine(MAP_ENGINE_CUCKOO, 1);
+    check_engine(MAP_ENGINE_CUCKOO, 4);
+    printf("Chaining and cuckoo maps cloned on 1 and 4 threads.\n");
+
+    // String keys are copied into the clone's own arena.
+    map_options_t options;
+    map_options_init(&options);
+    options.key_mode = MAP_KEY_STRING;
+    assert(map_create_ex(&src, &options, NULL, dummy_clone, NULL, dummy_stringify, NULL,
+                         NULL, dummy_free) == MAP_OK);
+    char key[32];
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        snprintf(key, sizeof(key), "key-%d", i);
+        assert(map_insert(src, key, &i) == MAP_OK);
+    }
+    for (int i = 0; i < NUM_ENTRIES; i += 3) {
+        snprintf(key, sizeof(key), "key-%d", i);
+        assert(map_remove(src, key) == MAP_OK);
+    }
+    assert(map_clone(src, &dst, 4) == MAP_OK);
+    check_clone(src, dst);
+    assert(dst->key_live_bytes == src->key_live_bytes && dst->key_dead_bytes == 0);
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        void *value;
+        snprintf(key, sizeof(key), "key-%d", i);
+        assert(map_get(dst, key, &value) == (i % 3 == 0 ? MAP_ERR_NOT_FOUND : MAP_OK));
+    }
+    map_destroy(&src);
+    map_destroy(&dst);
+    printf("String-keyed map cloned.\n");
+
+    // A failing clone callback leaves nothing behind.
+    assert(map_create(&src, dummy_clone, failing_clone, dummy_hash, dummy_stringify,
+                      dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    for (int i = 0; i < 1000; i++) assert(map_insert(src, &i, &i) == MAP_OK);
+    dst = NULL;
+    fail_after = 500;
+    assert(map_clone(src, &dst, 1) == MAP_ERR_NO_MEM && dst == NULL);
+    fail_after = -1;
+    map_destroy(&src);
+
+    assert(map_clone(NULL, &dst, 1) == MAP_ERR_INVALID_ARG);
+    printf("All clone tests passed.\n");
+
+    return MAP_OK;
+}
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <map.h>
+
+#define NUM_ENTRIES 50000
+
+// Dummy key clone function
+void* dummy_key_clone(void *key) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int*)key;
+    return copy;
+}
+
+// Dummy value clone function
+void* dummy_value_clone(void *value) {
+    int *new_value = malloc(sizeof(int));
+    if (new_value) *new_value = *(int *)value;
+    return new_value;
+}
+
+// Simple Modulus Hashing
+uint64_t dummy_hash(void *key) {
+    return (*(int *)key) % 1000003;
+}
+
+// Keys below 100 all land in the same two buckets
+uint64_t clustered_hash(void *key) {
+    return *(int *)key < 100 ? 42 : dummy_hash(key);
+}
+
+// Only sixteen distinct hashes, for a stash that has to stay short
+uint64_t sixteen_hash(void *key) {
+    return (uint64_t)(*(int *)key % 16);
+}
+
+// Dummy stringify function
+char* dummy_stringify(void *key, void *value) {
+    char *str = malloc(100 * sizeof(char));
+    if (str) snprintf(str, 100, "(Key: %d, Value: %d)", *(int *)key, *(int *)value);
+    return str;
+}
+
+// Dummy compare function
+int32_t dummy_compare(void *key1, void *key2) {
+    int a = *(int*)key1;
+    int b = *(int*)key2;
+    return (a > b) - (a < b);
+}
+
+// Compare that counts its calls
+static size_t compares = 0;
+int32_t counting_compare(void *key1, void *key2) {
+    compares++;
+    return dummy_compare(key1, key2);
+}
+
+// Dummy free functions
+void dummy_free_key(void *key) { free(key); }
+void dummy_free_value(void *value) { free(value); }
+
+int main(void) {
+    map_t *map;
+    map_options_t options;
+    map_error_t result;
+
+    // Unknown engines are rejected
+    map_options_init(&options);
+    options.engine = (map_engine_t)42;
+    result = map_create_ex(&map, &options, dummy_key_clone, dummy_value_clone, dummy_hash,
+                           dummy_stringify, dummy_compare, dummy_free_key, dummy_free_value);
+    assert(result == MAP_ERR_INVALID_ARG && "Unknown engine should be rejected");
+
+    // Create a cuckoo map
+    map_options_init(&options);
+    options.engine = MAP_ENGINE_CUCKOO;
+    result = map_create_ex(&map, &options, dummy_key_clone, dummy_value_clone, dummy_hash,
+                           dummy_stringify, dummy_compare, dummy_free_key, dummy_free_value);
+    assert(result == MAP_OK && "Cuckoo map creation failed");
+    assert(map->engine == MAP_ENGINE_CUCKOO);
+    printf("Cuckoo map created successfully!\n");
+
+    // Insert, tracking how full the table gets before each growth
+    double worst_load_at_growth = 1.0;
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        size_t before_entries = map->num_entries;
+        size_t before_buckets = map->num_buckets;
+        int value = i * 2;
+        result = map_insert(map, &i, &value);
+        assert(result == MAP_OK && "Cuckoo insertion failed");
+
+        if (map->num_buckets != before_buckets && before_buckets >= 256) {
+            double load = (double)before_entries / (before_buckets * MAP_CUCKOO_SLOTS);
+            if (load < worst_load_at_growth) worst_load_at_growth = load;
+        }
+    }
+    printf("Inserted %d elements, lowest load at growth: %.3f\n", NUM_ENTRIES,
+           worst_load_at_growth);
+    assert(worst_load_at_growth > 0.9 && "Cuckoo table should fill past 90% before growing");
+
+    size_t size;
+    assert(map_get_size(map, &size) == MAP_OK && size == NUM_ENTRIES);
+
+    // Overwrite existing keys
+    for (int i = 0; i < NUM_ENTRIES; i += 10) {
+        int value = -i;
+        assert(map_insert(map, &i, &value) == MAP_OK);
+    }
+    assert(map_get_size(map, &size) == MAP_OK && size == NUM_ENTRIES);
+
+    // Retrieve everything, and miss on absent keys
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        void *value;
+        result = map_get(map, &i, &value);
+        assert(result == MAP_OK && "Cuckoo get failed");
+        assert(*(int *)value == (i % 10 == 0 ? -i : i * 2) && "Cuckoo value mismatch");
+    }
+    int missing = NUM_ENTRIES + 5;
+    void *value;
+    assert(map_get(map, &missing, &value) == MAP_ERR_NOT_FOUND);
+    assert(map_remove(map, &missing) == MAP_ERR_NOT_FOUND);
+    printf("All elements retrieved.\n");
+
+    // Remove the odd keys, then iterate over the rest
+    for (int i = 1; i < NUM_ENTRIES; i += 2) {
+        assert(map_remove(map, &i) == MAP_OK && "Cuckoo remove failed");
+    }
+    map_iterator_t iter;
+    void *key;
+    int count = 0;
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    while (map_iter_next(map, &iter, &key, &value) == MAP_OK) {
+        assert(*(int *)key % 2 == 0 && "Removed key still present");
+        count++;
+    }
+    assert(count == NUM_ENTRIES / 2 && "Iteration count mismatch");
+    printf("Iterated over %d remaining elements.\n", count);
+
+    // Remove the rest; the table should shrink back down
+    for (int i = 0; i < NUM_ENTRIES; i += 2) {
+        assert(map_remove(map, &i) == MAP_OK);
+    }
+    assert(map_get_size(map, &size) == MAP_OK && size == 0);
+    assert(map->num_buckets < 64 && "Cuckoo table should shrink when empty");
+    assert(map_iter_start(map, &iter) == MAP_ERR_END_OF_MAP);
+
+    assert(map_destroy(&map) == MAP_OK && map == NULL);
+    printf("Cuckoo map destroyed successfully.\n");
+
+    // Keys that all hash alike overflow their two buckets at low load;
+    // none is rejected, and they survive growth, cloning and removal.
+    map_options_init(&options);
+    options.engine = MAP_ENGINE_CUCKOO;
+    result = map_create_ex(&map, &options, dummy_key_clone, dummy_value_clone, clustered_hash,
+                           dummy_stringify, dummy_compare, dummy_free_key, dummy_free_value);
+    assert(result == MAP_OK);
+    for (int i = 0; i < 100; i++) {
+        int value = i * 2;
+        assert(map_insert(map, &i, &value) == MAP_OK && "Colliding key rejected");
+    }
+    for (int i = 100; i < 2100; i++) {
+        int value = i * 2;
+        assert(map_insert(map, &i, &value) == MAP_OK);
+    }
+    int fifty = 50, overwrite = -1;
+    assert(map_insert(map, &fifty, &overwrite) == MAP_OK);
+    assert(map_get_size(map, &size) == MAP_OK && size == 100 + 2000);
+
+    map_t *copy;
+    assert(map_clone(map, &copy, 1) == MAP_OK);
+    for (int i = 0; i < 100; i++) {
+        assert(map_get(copy, &i, &value) == MAP_OK);
+        assert(*(int *)value == (i == 50 ? -1 : i * 2));
+    }
+    assert(map_destroy(&copy) == MAP_OK);
+
+    count = 0;
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    while (map_iter_next(map, &iter, &key, &value) == MAP_OK) {
+        if (*(int *)key < 100) {
+            assert(map_iter_remove(map, &iter) == MAP_OK);
+            count++;
+        }
+    }
+    map_iter_end(map, &iter);
+    assert(count == 100 && "Iteration missed stashed keys");
+    assert(map_get_size(map, &size) == MAP_OK && size == 2000);
+    for (int i = 0; i < 100; i++) {
+        assert(map_get(map, &i, &value) == MAP_ERR_NOT_FOUND);
+    }
+    assert(map_destroy(&map) == MAP_OK);
+    printf("Colliding keys stashed.\n");
+
+    // Sixteen hashes for many keys: stashed keys are told apart by hash
+    // before usr_compare runs, so each lookup compares only keys sharing
+    // its hash rather than the whole stash.
+    map_options_init(&options);
+    options.engine = MAP_ENGINE_CUCKOO;
+    result = map_create_ex(&map, &options, dummy_key_clone, dummy_value_clone, sixteen_hash,
+                           dummy_stringify, counting_compare, dummy_free_key, dummy_free_value);
+    assert(result == MAP_OK);
+    const int clustered = 4000;
+    for (int i = 0; i < clustered; i++) {
+        int value = i * 2;
+        assert(map_insert(map, &i, &value) == MAP_OK);
+    }
+    for (int i = 0; i < clustered; i++) {
+        assert(map_get(map, &i, &value) == MAP_OK && *(int *)value == i * 2);
+    }
+    size_t per_hash = (size_t)clustered / 16;
+    assert(compares < 2 * (size_t)clustered * per_hash && "Stash compared across hashes");
+    assert(map->num_buckets <= 2 * (size_t)clustered && "Stash cap grew the table too far");
+    for (int i = 0; i < clustered; i += 2) {
+        assert(map_remove(map, &i) == MAP_OK);
+    }
+    for (int i = 0; i < clustered; i++) {
+        assert(map_get(map, &i, &value) == (i % 2 ? MAP_OK : MAP_ERR_NOT_FOUND));
+    }
+    assert(map_destroy(&map) == MAP_OK);
+    printf("Clustered hashes looked up in %zu compares.\n", compares);
+
+    return MAP_OK;
+}
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <map.h>
+
+#define NUM_ENTRIES 50000
+
+// Clone integer key/value
+void* dummy_clone(void *value) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)value;
+    return copy;
+}
+
+// Weak hash on purpose: the engine must post-mix it.
+uint64_t dummy_hash(void *key) { return (uint64_t)(*(int *)key) * 1024; }
+
+char* dummy_stringify(void *key, void *value) {
+    char *str = malloc(64);
+    if (str) snprintf(str, 64, "(Key: %d, Value: %d)", *(int *)key, *(int *)value);
+    return str;
+}
+
+int32_t dummy_compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void dummy_free(void *ptr) { free(ptr); }
+
+// Iteration must yield exactly `expected`, in that order.
+static void check_order(map_t *map, const int *expected, int count) {
+    map_iterator_t iter;
+    void *key, *value;
+    int seen = 0;
+    if (map_iter_start(map, &iter) == MAP_OK) {
+        while (map_iter_next(map, &iter, &key, &value) == MAP_OK) {
+            assert(seen < count && *(int *)key == expected[seen]);
+            assert(*(int *)value == expected[seen] * 2);
+            seen++;
+        }
+    }
+    assert(seen == count);
+}
+
+int main(void) {
+    map_options_t options;
+    map_options_init(&options);
+    options.engine = MAP_ENGINE_DENSE;
+
+    map_t *map;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash,
+                         dummy_stringify, dummy_compare, dummy_free, dummy_free) == MAP_OK);
+
+    // Insert in a scrambled order; iteration follows it, through every
+    // index width and rebuild.
+    int *order = malloc(NUM_ENTRIES * sizeof(int));
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        order[i] = (int)(((uint64_t)i * 7919) % NUM_ENTRIES);
+        int value = order[i] * 2;
+        assert(map_insert(map, &order[i], &value) == MAP_OK);
+    }
+    check_order(map, order, NUM_ENTRIES);
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        void *value;
+        assert(map_get(map, &i, &value) == MAP_OK && *(int *)value == i * 2);
+    }
+    int missing = -1;
+    void *value;
+    assert(map_get(map, &missing, &value) == MAP_ERR_NOT_FOUND);
+    printf("Dense map iterates in insertion order.\n");
+
+    // Overwrites keep their place; removes leave the rest in order; a
+    // removed key comes back at the end.
+    int twice = order[10] * 2;
+    assert(map_insert(map, &order[10], &twice) == MAP_OK);
+    int kept = 0;
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        if (i % 3 == 0) assert(map_remove(map, &order[i]) == MAP_OK);
+        else order[kept++] = order[i];
+    }
+    assert(map_remove(map, &missing) == MAP_ERR_NOT_FOUND);
+    int back = 0, back_value = 0;
+    assert(map_insert(map, &back, &back_value) == MAP_OK);
+    order[kept++] = 0;
+    check_order(map, order, kept);
+    size_t size;
+    assert(map_get_size(map, &size) == MAP_OK && size == (size_t)kept);
+
+    // Filling the holes compacts the array and keeps the order.
+    for (int i = NUM_ENTRIES; i < NUM_ENTRIES + 20000; i++) {
+        int v = i * 2;
+        assert(map_insert(map, &i, &v) == MAP_OK);
+        order[kept++] = i;
+        if (kept == NUM_ENTRIES) break;
+    }
+    check_order(map, order, kept);
+
+    // Clones keep the order, on any number of threads.
+    map_t *copy;
+    assert(map_clone(map, &copy, 4) == MAP_OK);
+    check_order(copy, order, kept);
+    map_destroy(&copy);
+
+    // Shrinks back down as it empties.
+    size_t big_buckets, small_buckets;
+    map_get_num_buckets(map, &big_buckets);
+    for (int i = 0; i < kept - 3; i++) assert(map_remove(map, &order[i]) == MAP_OK);
+    map_get_num_buckets(map, &small_buckets);
+    assert(small_buckets < big_buckets / 100);
+    check_order(map, order + kept - 3, 3);
+    assert(map_print(map) == MAP_OK);
+    map_destroy(&map);
+    free(order);
+    printf("All dense engine tests passed.\n");
+
+    return MAP_OK;
+}
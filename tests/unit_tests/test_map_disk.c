@@ -0,0 +1,255 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+#include <map.h>
+
+#define NUM_ENTRIES 4000
+#define NUM_RANDOM 8000
+#define RAM_BUDGET (32 * 1024)
+
+// Clone integer key/value
+void* dummy_clone(void *value) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)value;
+    return copy;
+}
+
+uint64_t dummy_hash(void *key) { return (uint64_t)(*(int *)key); }
+
+char* dummy_stringify(void *key, void *value) {
+    char *str = malloc(64);
+    if (str) snprintf(str, 64, "(Key: %d, Value: %d)", *(int *)key, *(int *)value);
+    return str;
+}
+
+int32_t dummy_compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void dummy_free(void *ptr) { free(ptr); }
+
+// Sum as a fresh value, which the set operations have to store.
+void* sum_new(void *ctx, void *key, void *dst_value, void *src_value) {
+    (void)ctx;
+    (void)key;
+    int sum = *(int *)dst_value + *(int *)src_value;
+    return dummy_clone(&sum);
+}
+
+size_t int_encode(void *obj, uint8_t *buf, size_t cap) {
+    if (cap >= sizeof(int)) memcpy(buf, obj, sizeof(int));
+    return sizeof(int);
+}
+
+void* int_decode(const uint8_t *buf, size_t len) {
+    if (len != sizeof(int)) return NULL;
+    int *obj = malloc(sizeof(int));
+    if (obj) memcpy(obj, buf, sizeof(int));
+    return obj;
+}
+
+static map_t *make_map(const char *dir, size_t budget, uint32_t partitions) {
+    map_disk_options_t disk;
+    map_disk_options_init(&disk);
+    disk.dir = dir;
+    disk.ram_budget = budget;
+    disk.partitions = partitions;
+    disk.encode_key = int_encode;
+    disk.decode_key = int_decode;
+    disk.encode_value = int_encode;
+    disk.decode_value = int_decode;
+
+    map_options_t options;
+    map_options_init(&options);
+    options.engine = MAP_ENGINE_DISK;
+    options.disk = &disk;
+    map_t *map;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash,
+                         dummy_stringify, dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    return map;
+}
+
+// Key i must hold expected[i], or be absent when expected[i] < 0.
+static void check(map_t *map, const int *expected, int n) {
+    size_t live = 0;
+    for (int i = 0; i < n; i++) {
+        void *value;
+        if (expected[i] < 0) {
+            assert(map_get(map, &i, &value) == MAP_ERR_NOT_FOUND);
+        } else {
+            assert(map_get(map, &i, &value) == MAP_OK && *(int *)value == expected[i]);
+            live++;
+        }
+    }
+    size_t size;
+    assert(map_get_size(map, &size) == MAP_OK && size == live);
+
+    // Iteration sees every live entry once.
+    char *seen = calloc((size_t)n, 1);
+    map_iterator_t iter;
+    void *key, *value;
+    size_t visited = 0;
+    if (map_iter_start(map, &iter) == MAP_OK) {
+        while (map_iter_next(map, &iter, &key, &value) == MAP_OK) {
+            int k = *(int *)key;
+            assert(k >= 0 && k < n && !seen[k] && expected[k] == *(int *)value);
+            seen[k] = 1;
+            visited++;
+        }
+    }
+    assert(visited == live);
+    free(seen);
+}
+
+static uint64_t rng_state = 5;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+int main(void) {
+    const char *tmp = getenv("TMPDIR") != NULL ? getenv("TMPDIR") : "/tmp";
+    char dir[4096];
+    snprintf(dir, sizeof(dir), "%s/test_map_disk_XXXXXX", tmp);
+    assert(mkdtemp(dir) != NULL);
+
+    // Settings are checked up front.
+    map_disk_options_t disk;
+    map_disk_options_init(&disk);
+    disk.dir = dir;
+    map_options_t options;
+    map_options_init(&options);
+    options.engine = MAP_ENGINE_DISK;
+    map_t *map;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash, dummy_stringify,
+                         dummy_compare, dummy_free, dummy_free) == MAP_ERR_INVALID_ARG);
+    options.disk = &disk;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash, dummy_stringify,
+                         dummy_compare, dummy_free, dummy_free) == MAP_ERR_INVALID_ARG);
+    disk.encode_key = disk.encode_value = int_encode;
+    disk.decode_key = disk.decode_value = int_decode;
+    disk.partitions = 12;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash, dummy_stringify,
+                         dummy_compare, dummy_free, dummy_free) == MAP_ERR_INVALID_ARG);
+    map_disk_stats_t stats;
+    map_t *plain;
+    assert(map_create_ex(&plain, NULL, dummy_clone, dummy_clone, dummy_hash, dummy_stringify,
+                         dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    assert(map_disk_stats(plain, &stats) == MAP_ERR_INVALID_ARG);
+    map_destroy(&plain);
+
+    // Far more entries than the budget holds.
+    map = make_map(dir, RAM_BUDGET, 32);
+    int *expected = malloc(NUM_ENTRIES * sizeof(int));
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        assert(map_insert(map, &i, &i) == MAP_OK);
+        expected[i] = i;
+    }
+    for (int i = 0; i < NUM_ENTRIES; i += 4) {
+        int value = i + NUM_ENTRIES;
+        assert(map_insert(map, &i, &value) == MAP_OK);
+        expected[i] = value;
+    }
+    check(map, expected, NUM_ENTRIES);
+    size_t partitions;
+    assert(map_get_num_buckets(map, &partitions) == MAP_OK && partitions == 32);
+    assert(map_disk_stats(map, &stats) == MAP_OK);
+    printf("Disk map: %zu faults, %zu spills, %zu bytes written, %zu resident in %zu "
+           "partitions.\n", stats.faults, stats.spills, stats.bytes_written,
+           stats.resident_bytes, stats.resident_partitions);
+    assert(stats.faults > 0 && stats.spills > 0 && stats.bytes_written > 0);
+    assert(stats.resident_partitions < partitions);
+    assert(stats.resident_bytes <= RAM_BUDGET + RAM_BUDGET / 2);
+
+    // Random removes and inserts.
+    for (int step = 0; step < NUM_RANDOM; step++) {
+        int k = (int)(next_random() % NUM_ENTRIES);
+        if (next_random() % 2 == 0) {
+            assert(map_remove(map, &k) == (expected[k] >= 0 ? MAP_OK : MAP_ERR_NOT_FOUND));
+            expected[k] = -1;
+        } else {
+            assert(map_insert(map, &k, &k) == MAP_OK);
+            expected[k] = k;
+        }
+    }
+    check(map, expected, NUM_ENTRIES);
+
+    // Removing while iterating, with lookups in between that spill the
+    // partition being walked: positions survive the round trip.
+    map_iterator_t iter;
+    void *key, *value;
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    int step = 0;
+    while (map_iter_next(map, &iter, &key, &value) == MAP_OK) {
+        int k = *(int *)key;
+        int probe = (int)(next_random() % NUM_ENTRIES);
+        if (k % 3 == 0) {
+            if (step++ % 2 == 0) map_get(map, &probe, &value);
+            assert(map_iter_remove(map, &iter) == MAP_OK);
+            assert(map_iter_remove(map, &iter) == MAP_ERR_NOT_FOUND);
+            expected[k] = -1;
+        }
+    }
+    check(map, expected, NUM_ENTRIES);
+
+    // Clones copy spilled partitions file to file.
+    map_t *copy;
+    assert(map_clone(map, &copy, 4) == MAP_OK);
+    check(copy, expected, NUM_ENTRIES);
+    for (int i = 0; i < NUM_ENTRIES; i += 2) {
+        if (expected[i] >= 0) assert(map_remove(copy, &i) == MAP_OK);
+    }
+    check(map, expected, NUM_ENTRIES);
+    map_destroy(&copy);
+
+    // Emptying it out.
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        if (expected[i] >= 0) assert(map_remove(map, &i) == MAP_OK);
+        expected[i] = -1;
+    }
+    check(map, expected, NUM_ENTRIES);
+    assert(map_iter_start(map, &iter) == MAP_ERR_END_OF_MAP);
+    int one = 1;
+    assert(map_insert(map, &one, &one) == MAP_OK);
+    expected[1] = 1;
+    check(map, expected, NUM_ENTRIES);
+    map_destroy(&map);
+    free(expected);
+
+    // A budget of zero keeps only the partition in use; destroy leaves
+    // nothing behind.
+    map = make_map(dir, 0, 4);
+    for (int i = 0; i < 1000; i++) assert(map_insert(map, &i, &i) == MAP_OK);
+    assert(map_disk_stats(map, &stats) == MAP_OK && stats.resident_partitions == 1);
+    assert(map_print(map) == MAP_OK);
+    map_destroy(&map);
+
+    // Intersecting with combined values stores them after the walk, when
+    // the partitions it walked may have spilled.
+    map = make_map(dir, RAM_BUDGET / 8, 16);
+    map_t *other;
+    assert(map_create(&other, dummy_clone, dummy_clone, dummy_hash, dummy_stringify,
+                      dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        assert(map_insert(map, &i, &i) == MAP_OK);
+        if (i % 2 == 0) assert(map_insert(other, &i, &i) == MAP_OK);
+    }
+    assert(map_intersect(map, other, sum_new, NULL) == MAP_OK);
+    expected = malloc(NUM_ENTRIES * sizeof(int));
+    for (int i = 0; i < NUM_ENTRIES; i++) expected[i] = i % 2 == 0 ? 2 * i : -1;
+    check(map, expected, NUM_ENTRIES);
+    free(expected);
+    map_destroy(&other);
+    map_destroy(&map);
+    assert(rmdir(dir) == 0);
+
+    printf("All disk engine tests passed.\n");
+    return MAP_OK;
+}
@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <map.h>
+
+#define NUM_KEYS 20000
+
+void* dummy_clone(void *ptr) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)ptr;
+    return copy;
+}
+
+uint64_t dummy_hash(void *key) { return map_hash_u32(key); }
+
+char* dummy_stringify(void *key, void *value) {
+    char *str = malloc(64);
+    if (str) snprintf(str, 64, "(Key: %d, Value: %d)", *(int *)key, *(int *)value);
+    return str;
+}
+
+int32_t dummy_compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void* string_clone(void *ptr) {
+    char *copy = malloc(strlen((char *)ptr) + 1);
+    if (copy) strcpy(copy, (char *)ptr);
+    return copy;
+}
+
+void dummy_free(void *ptr) { free(ptr); }
+
+// Decimal text of an int.
+static size_t encode_int(void *obj, uint8_t *buf, size_t cap) {
+    char text[16];
+    size_t len = (size_t)sprintf(text, "%d", *(int *)obj);
+    if (len <= cap) memcpy(buf, text, len);
+    return len;
+}
+
+static size_t encode_string(void *obj, uint8_t *buf, size_t cap) {
+    size_t len = strlen((const char *)obj);
+    if (len <= cap) memcpy(buf, obj, len);
+    return len;
+}
+
+// Everything written, in one growing buffer. fail_after > 0 fails that
+// many writes in.
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    size_t writes;
+    size_t fail_after;
+} sink_t;
+
+static map_error_t sink_write(void *ctx, const uint8_t *buf, size_t len) {
+    sink_t *sink = (sink_t *)ctx;
+    if (sink->fail_after > 0 && sink->writes == sink->fail_after) return MAP_ERR_IO;
+    sink->writes++;
+    if (sink->len + len + 1 > sink->cap) {
+        sink->cap = (sink->len + len + 1) * 2;
+        sink->data = realloc(sink->data, sink->cap);
+        assert(sink->data != NULL);
+    }
+    memcpy(sink->data + sink->len, buf, len);
+    sink->len += len;
+    sink->data[sink->len] = '\0';
+    return MAP_OK;
+}
+
+static map_t *make_map(map_engine_t engine, int n) {
+    map_options_t options;
+    map_options_init(&options);
+    options.engine = engine;
+    map_t *map;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash, dummy_stringify,
+                         dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    for (int i = 0; i < n; i++) {
+        int value = i * 3;
+        assert(map_insert(map, &i, &value) == MAP_OK);
+    }
+    return map;
+}
+
+static sink_t export_ints(const map_t *map, map_export_format_t format, size_t buffer_size,
+                          int nthreads) {
+    map_export_options_t options;
+    map_export_options_init(&options);
+    options.format = format;
+    options.encode_key = encode_int;
+    options.encode_value = encode_int;
+    options.write = sink_write;
+    sink_t sink = {NULL, 0, 0, 0, 0};
+    options.write_ctx = &sink;
+    if (buffer_size > 0) options.buffer_size = buffer_size;
+    assert(map_export(map, &options, nthreads) == MAP_OK);
+    return sink;
+}
+
+// Every key once, with value key * 3.
+static void check_csv(const sink_t *sink, int n) {
+    char *seen = calloc((size_t)n, 1);
+    assert(strncmp(sink->data, "key,value\n", 10) == 0);
+    int lines = 0;
+    for (char *line = sink->data + 10; *line != '\0'; line = strchr(line, '\n') + 1) {
+        int key, value;
+        assert(sscanf(line, "%d,%d", &key, &value) == 2);
+        assert(key >= 0 && key < n && !seen[key] && value == key * 3);
+        seen[key] = 1;
+        lines++;
+    }
+    assert(lines == n);
+    free(seen);
+}
+
+static void check_json(const sink_t *sink, int n) {
+    char *seen = calloc((size_t)n, 1);
+    assert(sink->data[0] == '{' && strcmp(sink->data + sink->len - 3, "\n}\n") == 0);
+    int entries = 0;
+    char *at = sink->data + 1;
+    for (int key, value, used; sscanf(at, "\n\"%d\":\"%d\"%n", &key, &value, &used) == 2;) {
+        assert(key >= 0 && key < n && !seen[key] && value == key * 3);
+        seen[key] = 1;
+        entries++;
+        at += used;
+        if (*at == ',') at++;
+    }
+    assert(entries == n && strcmp(at, "\n}\n") == 0);
+    free(seen);
+}
+
+static void check_binary(const sink_t *sink, int n) {
+    char *seen = calloc((size_t)n, 1);
+    int records = 0;
+    for (size_t at = 0; at < sink->len; records++) {
+        uint32_t lengths[2];
+        char text[16];
+        int key, value;
+        memcpy(lengths, sink->data + at, 8);
+        assert(lengths[0] < sizeof(text) && lengths[1] < sizeof(text));
+        memcpy(text, sink->data + at + 8, lengths[0]);
+        text[lengths[0]] = '\0';
+        key = atoi(text);
+        memcpy(text, sink->data + at + 8 + lengths[0], lengths[1]);
+        text[lengths[1]] = '\0';
+        value = atoi(text);
+        assert(key >= 0 && key < n && !seen[key] && value == key * 3);
+        seen[key] = 1;
+        at += 8 + lengths[0] + lengths[1];
+    }
+    assert(records == n);
+    free(seen);
+}
+
+int main(void) {
+    // Chaining maps, on one thread and on several, with a buffer big
+    // enough for everything and one that fills every few entries.
+    map_t *map = make_map(MAP_ENGINE_CHAINING, NUM_KEYS);
+    int threads[] = {1, 4};
+    size_t buffers[] = {0, 64};
+    for (int t = 0; t < 2; t++) {
+        for (int b = 0; b < 2; b++) {
+            sink_t sink = export_ints(map, MAP_EXPORT_CSV, buffers[b], threads[t]);
+            check_csv(&sink, NUM_KEYS);
+            free(sink.data);
+            sink = export_ints(map, MAP_EXPORT_JSON, buffers[b], threads[t]);
+            check_json(&sink, NUM_KEYS);
+            free(sink.data);
+            sink = export_ints(map, MAP_EXPORT_BINARY, buffers[b], threads[t]);
+            check_binary(&sink, NUM_KEYS);
+            free(sink.data);
+        }
+    }
+    printf("Chaining maps export in every format.\n");
+
+    // A failing write stops the export and is returned.
+    map_export_options_t options;
+    map_export_options_init(&options);
+    options.encode_key = encode_int;
+    options.encode_value = encode_int;
+    options.write = sink_write;
+    options.buffer_size = 64;
+    sink_t sink = {NULL, 0, 0, 0, 10};
+    options.write_ctx = &sink;
+    assert(map_export(map, &options, 4) == MAP_ERR_IO);
+    assert(sink.writes == 10);
+    free(sink.data);
+    map_destroy(&map);
+
+    // Other engines go through their iterator; an empty map is still a
+    // complete document.
+    map = make_map(MAP_ENGINE_DENSE, 1000);
+    sink = export_ints(map, MAP_EXPORT_JSON, 0, 4);
+    check_json(&sink, 1000);
+    free(sink.data);
+    map_destroy(&map);
+    map = make_map(MAP_ENGINE_CHAINING, 0);
+    sink = export_ints(map, MAP_EXPORT_JSON, 0, 1);
+    assert(strcmp(sink.data, "{\n}\n") == 0);
+    free(sink.data);
+    map_destroy(&map);
+
+    // Quoting and escaping, with string keys written as they are.
+    map_options_t map_options;
+    map_options_init(&map_options);
+    map_options.key_mode = MAP_KEY_STRING;
+    assert(map_create_ex(&map, &map_options, NULL, string_clone, NULL,
+                         dummy_stringify, NULL, NULL, dummy_free) == MAP_OK);
+    assert(map_insert(map, "a,\"b\"", "line\nbreak\t\x01") == MAP_OK);
+    options.encode_key = NULL;
+    options.encode_value = encode_string;
+    options.buffer_size = 0;
+    memset(&sink, 0, sizeof(sink));
+    options.format = MAP_EXPORT_CSV;
+    assert(map_export(map, &options, 1) == MAP_OK);
+    assert(strcmp(sink.data, "key,value\n\"a,\"\"b\"\"\",\"line\nbreak\t\x01\"\n") == 0);
+    sink.len = 0;
+    options.format = MAP_EXPORT_JSON;
+    assert(map_export(map, &options, 1) == MAP_OK);
+    const char *json = "{\n\"a,\\\"b\\\"\":\"line\\nbreak\\t\\u0001\"\n}\n";
+    assert(strcmp(sink.data, json) == 0);
+    free(sink.data);
+
+    // The file writer.
+    FILE *file = tmpfile();
+    assert(file != NULL);
+    options.write = map_export_file_writer;
+    options.write_ctx = file;
+    assert(map_export(map, &options, 1) == MAP_OK);
+    assert(ftell(file) == (long)strlen(json));
+    fclose(file);
+
+    assert(map_export(NULL, &options, 1) == MAP_ERR_INVALID_ARG);
+    assert(map_export(map, &options, 0) == MAP_ERR_INVALID_ARG);
+    options.encode_value = NULL;
+    assert(map_export(map, &options, 1) == MAP_ERR_INVALID_ARG);
+    map_destroy(&map);
+    map = make_map(MAP_ENGINE_CHAINING, 1);
+    options.encode_value = encode_int;
+    assert(map_export(map, &options, 1) == MAP_ERR_INVALID_ARG); // Needs encode_key.
+    map_destroy(&map);
+
+    printf("All export tests passed.\n");
+    return MAP_OK;
+}
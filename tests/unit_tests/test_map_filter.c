@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <map.h>
+
+#define NUM_ENTRIES 4000
+#define NUM_RANDOM 20000
+
+static size_t compares = 0;
+static uint64_t fake_now = 1000;
+
+uint64_t fake_clock(void *ctx) {
+    (void)ctx;
+    return fake_now;
+}
+
+// Clone integer key/value
+void* dummy_clone(void *value) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)value;
+    return copy;
+}
+
+uint64_t dummy_hash(void *key) { return map_hash_u32(key); }
+
+char* dummy_stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+int32_t dummy_compare(void *key1, void *key2) {
+    compares++;
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void dummy_free(void *ptr) { free(ptr); }
+
+static map_t *make_map(int enable_filter) {
+    map_options_t options;
+    map_options_init(&options);
+    options.enable_filter = enable_filter;
+    map_t *map;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash,
+                         dummy_stringify, dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    return map;
+}
+
+// usr_compare calls made by NUM_ENTRIES lookups of absent keys.
+static size_t miss_compares(map_t *map) {
+    void *value;
+    size_t before = compares;
+    for (int i = NUM_ENTRIES; i < 2 * NUM_ENTRIES; i++) {
+        assert(map_get(map, &i, &value) == MAP_ERR_NOT_FOUND);
+    }
+    return compares - before;
+}
+
+static uint64_t rng_state = 7;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+int main(void) {
+    void *value;
+
+    // Misses skip the chains: far fewer compares than without the filter.
+    map_t *plain = make_map(0);
+    map_t *map = make_map(1);
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        assert(map_insert(plain, &i, &i) == MAP_OK);
+        assert(map_insert(map, &i, &i) == MAP_OK);
+    }
+    size_t without = miss_compares(plain);
+    size_t with = miss_compares(map);
+    assert(without > NUM_ENTRIES / 2);
+    assert(with * 10 < without);
+    printf("Miss compares: %zu without the filter, %zu with it.\n", without, with);
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        assert(map_get(map, &i, &value) == MAP_OK && *(int *)value == i);
+    }
+
+    // Removed keys stop passing; the rest still pass.
+    for (int i = 0; i < NUM_ENTRIES; i += 2) assert(map_remove(map, &i) == MAP_OK);
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        assert(map_get(map, &i, &value) == (i % 2 == 0 ? MAP_ERR_NOT_FOUND : MAP_OK));
+    }
+    int key = 0;
+    assert(map_remove(map, &key) == MAP_ERR_NOT_FOUND);
+    map_destroy(&plain);
+
+    // No false negatives through random inserts, removes and resizes.
+    char present[NUM_ENTRIES];
+    memset(present, 0, sizeof(present));
+    for (int i = 0; i < NUM_ENTRIES; i++) present[i] = i % 2 == 1;
+    for (int step = 0; step < NUM_RANDOM; step++) {
+        int k = (int)(next_random() % NUM_ENTRIES);
+        if (next_random() % 3 == 0) {
+            assert(map_remove(map, &k) == (present[k] ? MAP_OK : MAP_ERR_NOT_FOUND));
+            present[k] = 0;
+        } else {
+            assert(map_insert(map, &k, &k) == MAP_OK);
+            present[k] = 1;
+        }
+    }
+    map_iterator_t iter;
+    void *iter_key;
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    while (map_iter_next(map, &iter, &iter_key, &value) == MAP_OK) {
+        if (*(int *)iter_key % 5 == 0) {
+            present[*(int *)iter_key] = 0;
+            assert(map_iter_remove(map, &iter) == MAP_OK);
+        }
+    }
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        assert(map_get(map, &i, &value) == (present[i] ? MAP_OK : MAP_ERR_NOT_FOUND));
+    }
+
+    // Clones carry the filter; set operations on a filtered dst keep it exact.
+    map_t *copy;
+    assert(map_clone(map, &copy, 1) == MAP_OK);
+    map_t *other = make_map(0);
+    for (int i = 0; i < NUM_ENTRIES; i += 3) assert(map_insert(other, &i, &i) == MAP_OK);
+    assert(map_merge(copy, other, NULL, NULL) == MAP_OK);
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        int expected = present[i] || i % 3 == 0;
+        assert(map_get(copy, &i, &value) == (expected ? MAP_OK : MAP_ERR_NOT_FOUND));
+    }
+    assert(map_difference(copy, other) == MAP_OK);
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        int expected = present[i] && i % 3 != 0;
+        assert(map_get(copy, &i, &value) == (expected ? MAP_OK : MAP_ERR_NOT_FOUND));
+    }
+    map_destroy(&copy);
+    map_destroy(&other);
+    map_destroy(&map);
+
+    // Evicted and expired entries leave the filter too.
+    map_options_t options;
+    map_options_init(&options);
+    options.enable_filter = 1;
+    options.max_entries = 100;
+    options.enable_ttl = 1;
+    options.clock = fake_clock;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash,
+                         dummy_stringify, dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    for (int i = 0; i < 1000; i++) assert(map_insert_ttl(map, &i, &i, 10) == MAP_OK);
+    size_t size;
+    assert(map_get_size(map, &size) == MAP_OK && size == 100);
+    int found = 0;
+    for (int i = 0; i < 1000; i++) found += map_get(map, &i, &value) == MAP_OK;
+    assert(found == 100);
+    fake_now += 20;
+    size_t expired;
+    assert(map_expire(map, fake_now, 1000000, &expired) == MAP_OK && expired == 100);
+    size_t before = compares;
+    for (int i = 0; i < 1000; i++) assert(map_get(map, &i, &value) == MAP_ERR_NOT_FOUND);
+    assert(compares == before);
+    map_destroy(&map);
+
+    // String keys.
+    options.max_entries = 0;
+    options.enable_ttl = 0;
+    options.key_mode = MAP_KEY_STRING;
+    assert(map_create_ex(&map, &options, NULL, dummy_clone, NULL, dummy_stringify, NULL,
+                         NULL, dummy_free) == MAP_OK);
+    char name[32];
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        snprintf(name, sizeof(name), "key-%d", i);
+        assert(map_insert(map, name, &i) == MAP_OK);
+    }
+    for (int i = 0; i < NUM_ENTRIES; i += 2) {
+        snprintf(name, sizeof(name), "key-%d", i);
+        assert(map_remove(map, name) == MAP_OK);
+    }
+    for (int i = 0; i < 2 * NUM_ENTRIES; i++) {
+        snprintf(name, sizeof(name), "key-%d", i);
+        int expected = i < NUM_ENTRIES && i % 2 == 1;
+        assert(map_get(map, name, &value) == (expected ? MAP_OK : MAP_ERR_NOT_FOUND));
+    }
+    map_destroy(&map);
+
+    // Chaining engine only.
+    map_options_init(&options);
+    options.enable_filter = 1;
+    options.engine = MAP_ENGINE_CUCKOO;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash, dummy_stringify,
+                         dummy_compare, dummy_free, dummy_free) == MAP_ERR_INVALID_ARG);
+    options.engine = MAP_ENGINE_DENSE;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash, dummy_stringify,
+                         dummy_compare, dummy_free, dummy_free) == MAP_ERR_INVALID_ARG);
+
+    printf("All filter tests passed.\n");
+    return MAP_OK;
+}
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <map.h>
+
+// Clone string key
+void* dummy_key_clone(void *key) {
+    char *copy = malloc(strlen((char*)key) + 1);
+    if (copy) {
+        strcpy(copy, (char*)key);
+    }
+    return copy;
+}
+
+// Clone integer value
+void* dummy_value_clone(void *value) {
+    int *new_value = malloc(sizeof(int));
+    if (new_value) *new_value = *(int *)value;
+    return new_value;
+}
+
+// Stringify key-value pair for display
+char* dummy_stringify(void *key, void *value) {
+    char *str = malloc(100 * sizeof(char));
+    if (str) snprintf(str, 100, "(Key: %s, Value: %d)", (char *)key, *(int *)value);
+    return str;
+}
+
+// String compare function
+int32_t dummy_compare(void *key1, void *key2) {
+    int result = strcmp((char *)key1, (char *)key2);
+    return (result > 0) - (result < 0);
+}
+
+// Free functions
+void dummy_free_key(void *key) { free(key); }
+void dummy_free_value(void *value) { free(value); }
+
+int main(void) {
+    uint64_t (*hash)(void *key);
+
+    // Name lookup
+    assert(map_hash_from_name("str", &hash) == MAP_OK && hash == map_hash_str);
+    assert(map_hash_from_name("u64", &hash) == MAP_OK && hash == map_hash_u64);
+    assert(map_hash_from_name("u32", &hash) == MAP_OK && hash == map_hash_u32);
+    assert(map_hash_from_name("int", &hash) == MAP_OK && hash == map_hash_u32);
+    assert(map_hash_from_name("djb2", &hash) == MAP_ERR_NOT_FOUND);
+    assert(map_hash_from_name(NULL, &hash) == MAP_ERR_INVALID_ARG);
+    printf("Hash name lookup works.\n");
+
+    // The vectorized stripe loop must agree with the scalar reference
+    uint8_t buf[4096];
+    for (size_t i = 0; i < sizeof(buf); i++) {
+        buf[i] = (uint8_t)(i * 131 + 7);
+    }
+    for (size_t stripes = 0; stripes <= sizeof(buf) / MAP_HASH_STRIPE; stripes++) {
+        uint64_t a[MAP_HASH_LANES] = {1, 2, 3, 4, 5, 6, 7, 8};
+        uint64_t b[MAP_HASH_LANES] = {1, 2, 3, 4, 5, 6, 7, 8};
+        __map_hash_stripes_scalar(a, buf, stripes, 12345);
+        __map_hash_stripes(b, buf, stripes, 12345);
+        assert(memcmp(a, b, sizeof(a)) == 0 && "SIMD stripe loop mismatch");
+    }
+    printf("SIMD and scalar stripe loops agree.\n");
+
+    // Length-awareness and sensitivity to every byte, across all size classes
+    for (size_t len = 1; len < sizeof(buf); len += (len < 300 ? 1 : 97)) {
+        uint64_t h = map_hash_bytes(buf, len, 0);
+        assert(h == map_hash_bytes(buf, len, 0) && "Hash must be deterministic");
+        assert(h != map_hash_bytes(buf, len - 1, 0) && "Length must matter");
+        assert(h != map_hash_bytes(buf, len, 1) && "Seed must matter");
+
+        buf[len / 2] ^= 1;
+        assert(h != map_hash_bytes(buf, len, 0) && "Every byte must matter");
+        buf[len / 2] ^= 1;
+    }
+    printf("Byte hash is length-aware and seed-dependent.\n");
+
+    // Integer mixers spread consecutive keys across buckets
+    int hits[64] = {0};
+    for (uint32_t i = 0; i < 6400; i++) {
+        hits[map_hash_u32(&i) % 64]++;
+        uint64_t k = i;
+        assert(map_hash_u64(&k) != map_hash_u64(&(uint64_t){k + 1}));
+    }
+    for (int i = 0; i < 64; i++) {
+        assert(hits[i] > 50 && hits[i] < 150 && "u32 mixer badly distributed");
+    }
+    printf("Integer mixers distribute keys evenly.\n");
+
+    // Built-in hashes plug straight into map_create
+    map_t *map;
+    assert(map_hash_from_name("str", &hash) == MAP_OK);
+    assert(map_create(&map, dummy_key_clone, dummy_value_clone, hash, dummy_stringify,
+                      dummy_compare, dummy_free_key, dummy_free_value) == MAP_OK);
+    for (int i = 0; i < 1000; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "key-%d", i);
+        assert(map_insert(map, key, &i) == MAP_OK);
+    }
+    for (int i = 0; i < 1000; i++) {
+        char key[32];
+        void *value;
+        snprintf(key, sizeof(key), "key-%d", i);
+        assert(map_get(map, key, &value) == MAP_OK && *(int *)value == i);
+    }
+    map_destroy(&map);
+    printf("Map with built-in string hash works.\n");
+
+    return MAP_OK;
+}
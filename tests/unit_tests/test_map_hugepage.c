@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <map.h>
+
+#define NUM_ENTRIES 100000
+
+// Clone integer key/value
+void* dummy_clone(void *value) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)value;
+    return copy;
+}
+
+uint64_t dummy_hash(void *key) { return map_hash_u32(key); }
+
+char* dummy_stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+int32_t dummy_compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void dummy_free(void *ptr) { free(ptr); }
+
+// Fill a map backed by hp, with a low load factor so the bucket array is
+// large enough for a mapping of its own.
+static void fill_and_check(map_hugepage_t *hp, map_engine_t engine) {
+    map_allocator_t allocator;
+    assert(map_hugepage_allocator(hp, &allocator) == MAP_OK);
+
+    map_options_t options;
+    map_options_init(&options);
+    options.engine = engine;
+    options.allocator = &allocator;
+
+    map_t *map;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash,
+                         dummy_stringify, dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    if (engine == MAP_ENGINE_CHAINING) assert(map_configure(map, 0.5, 0.1, 2.0) == MAP_OK);
+
+    for (int i = 0; i < NUM_ENTRIES; i++) assert(map_insert(map, &i, &i) == MAP_OK);
+    assert(hp->mapped_bytes > 0 && hp->mapped_bytes % MAP_HUGE_PAGE_SIZE == 0);
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        void *value;
+        assert(map_get(map, &i, &value) == MAP_OK && *(int *)value == i);
+    }
+    for (int i = 0; i < NUM_ENTRIES; i += 3) assert(map_remove(map, &i) == MAP_OK);
+    size_t size;
+    assert(map_get_size(map, &size) == MAP_OK && size == NUM_ENTRIES - (NUM_ENTRIES + 2) / 3);
+    map_destroy(&map);
+}
+
+int main(void) {
+    map_hugepage_t *hp;
+    map_hugepage_options_t options;
+
+    // Defaults: transparent huge pages, kernel placement.
+    assert(map_hugepage_create(&hp, NULL) == MAP_OK);
+    fill_and_check(hp, MAP_ENGINE_CHAINING);
+    fill_and_check(hp, MAP_ENGINE_CUCKOO);
+
+    // Once the maps are gone only the node slabs remain mapped.
+    size_t slab_bytes = hp->mapped_bytes;
+    map_allocator_t allocator;
+    assert(map_hugepage_allocator(hp, &allocator) == MAP_OK);
+
+    // Freed blocks are reused by the same size class.
+    void *a = allocator.alloc(allocator.ctx, 24);
+    allocator.free(allocator.ctx, a, 24);
+    void *b = allocator.alloc(allocator.ctx, 32);
+    assert(a == b && "Size class free list not reused");
+    assert(((uintptr_t)b & 15) == 0);
+
+    // Large blocks get 2MB-aligned mappings and are unmapped on free.
+    char *big = allocator.alloc(allocator.ctx, 3 * 1024 * 1024);
+    assert(big != NULL && ((uintptr_t)big % MAP_HUGE_PAGE_SIZE) == 0);
+    memset(big, 1, 3 * 1024 * 1024);
+    assert(hp->mapped_bytes == slab_bytes + 2 * MAP_HUGE_PAGE_SIZE);
+    big = allocator.realloc(allocator.ctx, big, 3 * 1024 * 1024, 5 * 1024 * 1024);
+    assert(big != NULL && big[3 * 1024 * 1024 - 1] == 1);
+    allocator.free(allocator.ctx, big, 5 * 1024 * 1024);
+    assert(hp->mapped_bytes == slab_bytes);
+    allocator.free(allocator.ctx, b, 32);
+
+    // Blocks past 256KB get a mapping of their own, not half a slab.
+    void *half = allocator.alloc(allocator.ctx, 1024 * 1024);
+    assert(hp->mapped_bytes == slab_bytes + MAP_HUGE_PAGE_SIZE);
+    allocator.free(allocator.ctx, half, 1024 * 1024);
+    assert(hp->mapped_bytes == slab_bytes);
+    assert(map_hugepage_destroy(&hp) == MAP_OK);
+
+    // The largest class fills a slab seven times over, and the slab's tail
+    // goes to smaller classes once the next slab starts.
+    assert(map_hugepage_create(&hp, NULL) == MAP_OK);
+    assert(map_hugepage_allocator(hp, &allocator) == MAP_OK);
+    char *blocks[8];
+    for (int i = 0; i < 8; i++) blocks[i] = allocator.alloc(allocator.ctx, 256 * 1024);
+    assert(hp->mapped_bytes == 2 * MAP_HUGE_PAGE_SIZE);
+    uintptr_t first_slab = (uintptr_t)blocks[0] & ~(uintptr_t)(MAP_HUGE_PAGE_SIZE - 1);
+    for (int i = 1; i < 7; i++) {
+        assert(((uintptr_t)blocks[i] & ~(uintptr_t)(MAP_HUGE_PAGE_SIZE - 1)) == first_slab);
+    }
+    char *tail = allocator.alloc(allocator.ctx, 128 * 1024);
+    assert(((uintptr_t)tail & ~(uintptr_t)(MAP_HUGE_PAGE_SIZE - 1)) == first_slab &&
+           "Slab tail not reused");
+    assert(tail >= blocks[6] + 256 * 1024);
+    assert(hp->mapped_bytes == 2 * MAP_HUGE_PAGE_SIZE);
+    assert(map_hugepage_destroy(&hp) == MAP_OK && hp == NULL);
+    printf("Huge-page allocator with default options works.\n");
+
+    // Explicit huge pages and interleaving fall back gracefully when the
+    // system has no reserved pages or a single node.
+    map_hugepage_options_init(&options);
+    options.explicit_huge_pages = 1;
+    options.numa_policy = MAP_NUMA_INTERLEAVE;
+    assert(map_hugepage_create(&hp, &options) == MAP_OK);
+    fill_and_check(hp, MAP_ENGINE_CHAINING);
+    printf("Explicit pages: %zu hugetlb mappings, %d NUMA node(s), %zu placement failures.\n",
+           hp->hugetlb_mappings, hp->numa_nodes, hp->numa_failures);
+    map_hugepage_destroy(&hp);
+
+    options.numa_policy = MAP_NUMA_BIND;
+    options.numa_node = 0;
+    assert(map_hugepage_create(&hp, &options) == MAP_OK);
+    fill_and_check(hp, MAP_ENGINE_CHAINING);
+    map_hugepage_destroy(&hp);
+
+    // Binding to a node that doesn't exist is an error.
+    options.numa_node = 4096;
+    assert(map_hugepage_create(&hp, &options) == MAP_ERR_INVALID_ARG);
+    assert(map_hugepage_create(NULL, NULL) == MAP_ERR_INVALID_ARG);
+    printf("All huge-page allocator tests passed.\n");
+
+    return MAP_OK;
+}
@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <map.h>
+
+#define NUM_KEYS 5000
+#define NUM_RANDOM 200000
+
+// Key number k of the test's key space. The first two are the keys that
+// double as slot markers.
+static uint64_t key_of(int k) {
+    if (k == 0) return MAP_IMAP_EMPTY;
+    if (k == 1) return MAP_IMAP_DELETED;
+    return (uint64_t)k * 0x9e3779b97f4a7c15ULL;
+}
+
+static int index_of(uint64_t key) {
+    for (int k = 0; k < NUM_KEYS; k++) {
+        if (key_of(k) == key) return k;
+    }
+    return -1;
+}
+
+static uint64_t rng_state = 7;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// Key k must map to values[k], or be absent when present[k] is 0.
+static void check(const map_imap_t *imap, const uint64_t *values, const char *present) {
+    size_t live = 0;
+    for (int k = 0; k < NUM_KEYS; k++) {
+        uint64_t value;
+        if (present[k]) {
+            assert(map_imap_get(imap, key_of(k), &value) == MAP_OK && value == values[k]);
+            live++;
+        } else {
+            assert(map_imap_get(imap, key_of(k), &value) == MAP_ERR_NOT_FOUND);
+        }
+    }
+    size_t size;
+    assert(map_imap_get_size(imap, &size) == MAP_OK && size == live);
+
+    char *seen = calloc(NUM_KEYS, 1);
+    map_iterator_t iter;
+    uint64_t key, value;
+    size_t visited = 0;
+    if (map_imap_iter_start(imap, &iter) == MAP_OK) {
+        while (map_imap_iter_next(imap, &iter, &key, &value) == MAP_OK) {
+            int k = index_of(key);
+            assert(k >= 0 && present[k] && !seen[k] && values[k] == value);
+            seen[k] = 1;
+            visited++;
+        }
+    }
+    assert(visited == live);
+    free(seen);
+}
+
+int main(void) {
+    map_imap_t *imap;
+    assert(map_imap_create(&imap, 0) == MAP_OK);
+    uint64_t *values = calloc(NUM_KEYS, sizeof(uint64_t));
+    char *present = calloc(NUM_KEYS, 1);
+    check(imap, values, present);
+
+    // Random inserts, overwrites and removes, including the marker keys.
+    for (int step = 0; step < NUM_RANDOM; step++) {
+        int k = (int)(next_random() % NUM_KEYS);
+        if (next_random() % 3 == 0) {
+            assert(map_imap_remove(imap, key_of(k)) == (present[k] ? MAP_OK : MAP_ERR_NOT_FOUND));
+            present[k] = 0;
+        } else {
+            values[k] = next_random();
+            assert(map_imap_insert(imap, key_of(k), values[k]) == MAP_OK);
+            present[k] = 1;
+        }
+        if (step % 20000 == 0) check(imap, values, present);
+    }
+    check(imap, values, present);
+    printf("Integer map holds %zu entries in %zu slots.\n", imap->size, imap->capacity);
+
+    // Overwriting and removing while iterating.
+    map_iterator_t iter;
+    uint64_t key, value;
+    assert(map_imap_iter_start(imap, &iter) == MAP_OK);
+    while (map_imap_iter_next(imap, &iter, &key, &value) == MAP_OK) {
+        int k = index_of(key);
+        if (k % 2 == 0) {
+            assert(map_imap_remove(imap, key) == MAP_OK);
+            present[k] = 0;
+        } else {
+            values[k] = value + 1;
+            assert(map_imap_insert(imap, key, values[k]) == MAP_OK);
+        }
+    }
+    check(imap, values, present);
+
+    // A growing insert ends iteration.
+    size_t capacity = imap->capacity;
+    assert(map_imap_iter_start(imap, &iter) == MAP_OK);
+    uint64_t fresh = 1;
+    for (size_t i = 0; imap->capacity == capacity; i++) {
+        fresh = (uint64_t)(i + 2) << 32; // Not in the key space.
+        assert(map_imap_insert(imap, fresh, i) == MAP_OK);
+    }
+    assert(map_imap_iter_next(imap, &iter, &key, &value) == MAP_ERR_STALE_ITERATOR);
+    map_imap_destroy(&imap);
+    assert(imap == NULL);
+
+    // Removing everything and filling again reuses the deleted slots.
+    assert(map_imap_create(&imap, NUM_KEYS) == MAP_OK);
+    capacity = imap->capacity;
+    for (int round = 0; round < 10; round++) {
+        for (int k = 0; k < NUM_KEYS; k++) assert(map_imap_insert(imap, key_of(k), k) == MAP_OK);
+        for (int k = 0; k < NUM_KEYS; k++) assert(map_imap_remove(imap, key_of(k)) == MAP_OK);
+    }
+    assert(imap->capacity == capacity && imap->size == 0);
+    assert(map_imap_iter_start(imap, &iter) == MAP_ERR_END_OF_MAP);
+    map_imap_destroy(&imap);
+
+    assert(map_imap_create(NULL, 0) == MAP_ERR_INVALID_ARG);
+    assert(map_imap_insert(NULL, 1, 1) == MAP_ERR_INVALID_ARG);
+    assert(map_imap_destroy(&imap) == MAP_ERR_INVALID_ARG);
+    free(values);
+    free(present);
+
+    printf("All integer map tests passed.\n");
+    return MAP_OK;
+}
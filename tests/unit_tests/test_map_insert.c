@@ -79,11 +79,11 @@ int main(void) {
     printf("Inserted 5 elements.\n");
 
     // Validate Size After Insertion
-    int size;
+    size_t size;
     result = map_get_size(map, &size);
     assert(result == MAP_OK && "map_get_size failed");
     assert(size == 5 && "Map size incorrect after initial insertion");
-    printf("Map size is correct: %d\n", size);
+    printf("Map size is correct: %zu\n", size);
 
     // Force Resize by Adding More Elements (up to 50)
     for (int i = 6; i <= 50; i++) {
@@ -98,14 +98,14 @@ int main(void) {
     result = map_get_size(map, &size);
     assert(result == MAP_OK && "map_get_size failed");
     assert(size == 50 && "Map size incorrect after resizing");
-    printf("Map resized and size is correct: %d\n", size);
+    printf("Map resized and size is correct: %zu\n", size);
 
 	// Validate number of buckets after resizing
-	int numbuckets;
+	size_t numbuckets;
 	result = map_get_num_buckets(map, &numbuckets);
 	assert(result == MAP_OK && "map_get_num_buckets failed");
 	assert(numbuckets == 40 && "Number of buckets is correct after resizing");
-	printf("Map resized and number of buckets is correct: %d\n", numbuckets);
+	printf("Map resized and number of buckets is correct: %zu\n", numbuckets);
     // Test Broken usr_key_clone
     map_t *broken_map;
     result = map_create(&broken_map, broken_key_clone, dummy_value_clone, dummy_hash,
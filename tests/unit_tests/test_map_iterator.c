@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <map.h>
+
+#define NUM_ENTRIES 20000
+
+// Clone integer key/value
+void* dummy_clone(void *value) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)value;
+    return copy;
+}
+
+uint64_t dummy_hash(void *key) { return map_hash_u32(key); }
+
+char* dummy_stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+int32_t dummy_compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void dummy_free(void *ptr) { free(ptr); }
+
+static map_t *make_map(map_engine_t engine) {
+    map_options_t options;
+    map_options_init(&options);
+    options.engine = engine;
+
+    map_t *map;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash,
+                         dummy_stringify, dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    for (int i = 0; i < NUM_ENTRIES; i++) assert(map_insert(map, &i, &i) == MAP_OK);
+    return map;
+}
+
+static int map_size(map_t *map) {
+    size_t size;
+    assert(map_get_size(map, &size) == MAP_OK);
+    return size;
+}
+
+static int map_buckets(map_t *map) {
+    size_t buckets;
+    assert(map_get_num_buckets(map, &buckets) == MAP_OK);
+    return buckets;
+}
+
+static void test_engine(map_engine_t engine, const char *name) {
+    map_iterator_t iter;
+    void *key, *value;
+    char *seen = calloc(NUM_ENTRIES, 1);
+
+    // map_iter_remove() on every entry visits each one exactly once; the
+    // map only shrinks after the walk.
+    map_t *map = make_map(engine);
+    int full_buckets = map_buckets(map);
+    int visited = 0;
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    while (map_iter_next(map, &iter, &key, &value) == MAP_OK) {
+        int k = *(int *)key;
+        assert(!seen[k]);
+        seen[k] = 1;
+        visited++;
+        assert(map_iter_remove(map, &iter) == MAP_OK);
+        assert(map_buckets(map) == full_buckets);
+    }
+    assert(visited == NUM_ENTRIES && map_size(map) == 0);
+    assert(map_buckets(map) < full_buckets);
+    map_destroy(&map);
+
+    // map_iter_remove() drops the odd keys in the same pass.
+    map = make_map(engine);
+    memset(seen, 0, NUM_ENTRIES);
+    visited = 0;
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    assert(map_iter_remove(map, &iter) == MAP_ERR_NOT_FOUND); // Nothing returned yet
+    while (map_iter_next(map, &iter, &key, &value) == MAP_OK) {
+        int k = *(int *)key;
+        assert(!seen[k]);
+        seen[k] = 1;
+        visited++;
+        if (k % 2 == 1) {
+            assert(map_iter_remove(map, &iter) == MAP_OK);
+            assert(map_iter_remove(map, &iter) == MAP_ERR_NOT_FOUND);
+        }
+    }
+    assert(visited == NUM_ENTRIES && map_size(map) == NUM_ENTRIES / 2);
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        assert((map_get(map, &i, &value) == MAP_OK) == (i % 2 == 0));
+    }
+    assert(map_iter_remove(map, &iter) == MAP_ERR_INVALID_ARG); // Iterator is done
+
+    // map_remove() under an iterator ends the iteration, whichever entry
+    // it takes.
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    assert(map_iter_next(map, &iter, &key, &value) == MAP_OK);
+    int gone = *(int *)key;
+    assert(map_remove(map, &gone) == MAP_OK);
+    assert(map_iter_next(map, &iter, &key, &value) == MAP_ERR_STALE_ITERATOR);
+    assert(map_iter_next(map, &iter, &key, &value) == MAP_ERR_END_OF_MAP);
+    assert(map_insert(map, &gone, &gone) == MAP_OK);
+
+    // An iterator dropped early, or restarted, holds nothing up: removes
+    // shrink the map as they go.
+    int half_buckets = map_buckets(map);
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    assert(map_iter_next(map, &iter, &key, &value) == MAP_OK);
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    assert(map_iter_next(map, &iter, &key, &value) == MAP_OK);
+    for (int i = 0; i < NUM_ENTRIES; i += 2) assert(map_remove(map, &i) == MAP_OK);
+    assert(map_size(map) == 0 && map_buckets(map) < half_buckets);
+    assert(map_iter_next(map, &iter, &key, &value) == MAP_ERR_STALE_ITERATOR);
+    map_destroy(&map);
+
+    // Leaving a map_iter_remove() loop early shrinks on map_iter_end().
+    map = make_map(engine);
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    for (int i = 0; i < NUM_ENTRIES - 10; i++) {
+        assert(map_iter_next(map, &iter, &key, &value) == MAP_OK);
+        assert(map_iter_remove(map, &iter) == MAP_OK);
+    }
+    assert(map_buckets(map) == full_buckets);
+    assert(map_iter_end(map, &iter) == MAP_OK);
+    assert(map_size(map) == 10 && map_buckets(map) < full_buckets);
+    assert(map_iter_end(map, &iter) == MAP_OK);
+
+    // Growing under an iterator is reported, not papered over. Pool nodes
+    // stay where they are as the map grows, so the pool has nothing to
+    // report.
+    if (engine != MAP_ENGINE_POOL) {
+        int next = NUM_ENTRIES;
+        assert(map_insert(map, &next, &next) == MAP_OK);
+        assert(map_iter_start(map, &iter) == MAP_OK);
+        map_error_t result;
+        while ((result = map_iter_next(map, &iter, &key, &value)) == MAP_OK) {
+            for (int i = 0; i < 64; i++) {
+                next++;
+                assert(map_insert(map, &next, &next) == MAP_OK);
+            }
+        }
+        assert(result == MAP_ERR_STALE_ITERATOR);
+        assert(map_iter_next(map, &iter, &key, &value) == MAP_ERR_END_OF_MAP);
+        assert(map_iter_remove(map, &iter) == MAP_ERR_INVALID_ARG);
+    }
+    map_destroy(&map);
+
+    free(seen);
+    printf("%s iterators survive removals.\n", name);
+}
+
+int main(void) {
+    test_engine(MAP_ENGINE_CHAINING, "Chaining");
+    test_engine(MAP_ENGINE_CUCKOO, "Cuckoo");
+    test_engine(MAP_ENGINE_DENSE, "Dense");
+    test_engine(MAP_ENGINE_POOL, "Pool");
+
+    // Snapshotted maps copy chains on write; removal goes through them.
+    map_t *map = make_map(MAP_ENGINE_CHAINING);
+    map_snapshot_t *snap;
+    assert(map_snapshot(map, &snap) == MAP_OK);
+    map_iterator_t iter;
+    void *key, *value;
+    int visited = 0;
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    while (map_iter_next(map, &iter, &key, &value) == MAP_OK) {
+        visited++;
+        assert(map_iter_remove(map, &iter) == MAP_OK);
+    }
+    assert(visited == NUM_ENTRIES && map_size(map) == 0);
+    int key0 = 0;
+    assert(map_snapshot_get(snap, &key0, &value) == MAP_OK);
+    map_snapshot_release(&snap);
+    map_destroy(&map);
+
+    printf("All iterator tests passed.\n");
+    return MAP_OK;
+}
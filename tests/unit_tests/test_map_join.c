@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <map.h>
+
+#define NUM_BUILD 20000
+#define NUM_PROBE 30000
+#define BUILD_KEYS 5000
+#define PROBE_KEYS 8000
+
+typedef struct {
+    int key;
+    int id; // Position in its input.
+} row_t;
+
+uint64_t dummy_hash(void *key) { return (uint64_t)(*(int *)key); }
+
+// Few distinct hashes, so groups share slots and tags.
+uint64_t weak_hash(void *key) { return (uint64_t)(*(int *)key % 7); }
+
+int32_t dummy_compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+typedef struct {
+    size_t pairs;
+    int last_probe;
+    int last_build;
+    size_t stop_after; // Fail the emit after this many pairs; 0 for never.
+} result_t;
+
+map_error_t check_pair(void *ctx, void *build_row, void *probe_row) {
+    result_t *result = (result_t *)ctx;
+    const row_t *build = (const row_t *)build_row, *probe = (const row_t *)probe_row;
+    assert(build->key == probe->key);
+    // Probe order first, then build order.
+    assert(probe->id > result->last_probe ||
+           (probe->id == result->last_probe && build->id > result->last_build));
+    result->last_probe = probe->id;
+    result->last_build = build->id;
+    result->pairs++;
+    return result->pairs == result->stop_after ? MAP_ERR_UNKNOWN : MAP_OK;
+}
+
+static uint64_t rng_state = 3;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static void test_join(uint64_t (*hash)(void *key)) {
+    row_t *build = malloc(NUM_BUILD * sizeof(row_t));
+    row_t *probe = malloc(NUM_PROBE * sizeof(row_t));
+    void **build_keys = malloc(NUM_BUILD * sizeof(void *));
+    void **build_rows = malloc(NUM_BUILD * sizeof(void *));
+    void **probe_keys = malloc(NUM_PROBE * sizeof(void *));
+    void **probe_rows = malloc(NUM_PROBE * sizeof(void *));
+    size_t *count = calloc(PROBE_KEYS, sizeof(size_t));
+    for (int i = 0; i < NUM_BUILD; i++) {
+        build[i].key = (int)(next_random() % BUILD_KEYS);
+        build[i].id = i;
+        build_keys[i] = &build[i].key;
+        build_rows[i] = &build[i];
+        count[build[i].key]++;
+    }
+    size_t expected = 0;
+    for (int i = 0; i < NUM_PROBE; i++) {
+        probe[i].key = (int)(next_random() % PROBE_KEYS);
+        probe[i].id = i;
+        probe_keys[i] = &probe[i].key;
+        probe_rows[i] = &probe[i];
+        expected += count[probe[i].key];
+    }
+
+    map_join_t *join;
+    assert(map_join_build(&join, build_keys, build_rows, NUM_BUILD, hash, dummy_compare) ==
+           MAP_OK);
+    size_t rows, keys = 0;
+    assert(map_join_get_size(join, &rows, &keys) == MAP_OK && rows == NUM_BUILD);
+    size_t distinct = 0;
+    for (int k = 0; k < PROBE_KEYS; k++) distinct += count[k] > 0;
+    assert(keys == distinct);
+
+    // Every key's rows are contiguous and in build order.
+    for (int k = 0; k < PROBE_KEYS; k++) {
+        void *const *matches;
+        size_t n;
+        if (count[k] == 0) {
+            assert(map_join_find(join, &k, &matches, &n) == MAP_ERR_NOT_FOUND);
+            continue;
+        }
+        assert(map_join_find(join, &k, &matches, &n) == MAP_OK && n == count[k]);
+        for (size_t i = 0; i < n; i++) {
+            const row_t *row = (const row_t *)matches[i];
+            assert(row->key == k);
+            assert(i == 0 || row->id > ((const row_t *)matches[i - 1])->id);
+        }
+    }
+
+    result_t result = {0, -1, -1, 0};
+    assert(map_join_probe(join, probe_keys, probe_rows, NUM_PROBE, check_pair, &result) ==
+           MAP_OK);
+    assert(result.pairs == expected);
+    printf("Joined %d build rows (%zu keys) with %d probe rows: %zu pairs.\n", NUM_BUILD, keys,
+           NUM_PROBE, result.pairs);
+
+    // An emit error stops the probe.
+    result_t stopped = {0, -1, -1, 100};
+    assert(map_join_probe(join, probe_keys, probe_rows, NUM_PROBE, check_pair, &stopped) ==
+           MAP_ERR_UNKNOWN);
+    assert(stopped.pairs == 100);
+    map_join_destroy(&join);
+    assert(join == NULL);
+
+    free(build);
+    free(probe);
+    free(build_keys);
+    free(build_rows);
+    free(probe_keys);
+    free(probe_rows);
+    free(count);
+}
+
+map_error_t count_pair(void *ctx, void *build_row, void *probe_row) {
+    assert(*(int *)build_row == *(int *)probe_row);
+    (*(size_t *)ctx)++;
+    return MAP_OK;
+}
+
+int main(void) {
+    test_join(dummy_hash);
+    test_join(weak_hash);
+
+    // Keys double as rows when rows is NULL.
+    int values[] = {1, 2, 2, 3, 3, 3};
+    void *keys[6];
+    for (int i = 0; i < 6; i++) keys[i] = &values[i];
+    map_join_t *join;
+    assert(map_join_build(&join, keys, NULL, 6, dummy_hash, dummy_compare) == MAP_OK);
+    size_t pairs = 0;
+    assert(map_join_probe(join, keys, NULL, 6, count_pair, &pairs) == MAP_OK);
+    assert(pairs == 1 + 2 * 2 + 3 * 3);
+    map_join_destroy(&join);
+
+    // An empty build side matches nothing.
+    assert(map_join_build(&join, NULL, NULL, 0, dummy_hash, dummy_compare) == MAP_OK);
+    pairs = 0;
+    assert(map_join_probe(join, keys, NULL, 6, count_pair, &pairs) == MAP_OK && pairs == 0);
+    map_join_destroy(&join);
+
+    assert(map_join_build(&join, NULL, NULL, 1, dummy_hash, dummy_compare) ==
+           MAP_ERR_INVALID_ARG);
+    assert(map_join_build(&join, keys, NULL, 6, NULL, dummy_compare) == MAP_ERR_INVALID_ARG);
+    assert(join == NULL);
+    assert(map_join_destroy(&join) == MAP_ERR_INVALID_ARG);
+
+    printf("All hash join tests passed.\n");
+    return MAP_OK;
+}
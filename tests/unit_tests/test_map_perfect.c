@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <map.h>
+
+#define NUM_ENTRIES 20000
+
+// Dummy key clone function
+void* dummy_key_clone(void *key) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int*)key;
+    return copy;
+}
+
+// Dummy value clone function
+void* dummy_value_clone(void *value) {
+    int *new_value = malloc(sizeof(int));
+    if (new_value) *new_value = *(int *)value;
+    return new_value;
+}
+
+// Simple Modulus Hashing
+uint64_t dummy_hash(void *key) {
+    return (*(int *)key) % 1000003;
+}
+
+// Fake hash function (returns same hash for all keys)
+uint64_t fake_hash(void *key) {
+    (void)key;
+    return 42;
+}
+
+// Dummy stringify function
+char* dummy_stringify(void *key, void *value) {
+    char *str = malloc(100 * sizeof(char));
+    if (str) snprintf(str, 100, "(Key: %d, Value: %d)", *(int *)key, *(int *)value);
+    return str;
+}
+
+// Dummy compare function
+int32_t dummy_compare(void *key1, void *key2) {
+    int a = *(int*)key1;
+    int b = *(int*)key2;
+    return (a > b) - (a < b);
+}
+
+// Dummy free functions
+void dummy_free_key(void *key) { free(key); }
+void dummy_free_value(void *value) { free(value); }
+
+int main(void) {
+    map_t *map;
+    map_perfect_t *pmap;
+    map_error_t result;
+
+    // Bad arguments
+    assert(map_build_perfect(NULL, &pmap) == MAP_ERR_INVALID_ARG);
+    assert(map_perfect_get(NULL, &result, (void **)&pmap) == MAP_ERR_INVALID_ARG);
+    assert(map_perfect_destroy(NULL) == MAP_ERR_INVALID_ARG);
+
+    // Populate a map, keeping every key odd so even keys are known misses
+    result = map_create(&map, dummy_key_clone, dummy_value_clone, dummy_hash,
+                        dummy_stringify, dummy_compare, dummy_free_key, dummy_free_value);
+    assert(result == MAP_OK && "Map creation failed");
+
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        int key = 2 * i + 1;
+        int value = key * 3;
+        result = map_insert(map, &key, &value);
+        assert(result == MAP_OK && "Map insertion failed");
+    }
+    printf("Inserted %d elements.\n", NUM_ENTRIES);
+
+    // Convert to a perfect hash table
+    result = map_build_perfect(&map, &pmap);
+    assert(result == MAP_OK && "Perfect hash build failed");
+    assert(map == NULL && "Source map should be consumed");
+
+    size_t size;
+    assert(map_perfect_get_size(pmap, &size) == MAP_OK);
+    assert(size == NUM_ENTRIES && "Perfect map size mismatch");
+    printf("Built perfect hash table with %zu entries.\n", size);
+
+    // Every key must be found, every absent key must miss
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        int key = 2 * i + 1;
+        void *value;
+        result = map_perfect_get(pmap, &key, &value);
+        assert(result == MAP_OK && *(int *)value == key * 3 && "Perfect get mismatch");
+
+        key = 2 * i;
+        result = map_perfect_get(pmap, &key, &value);
+        assert(result == MAP_ERR_NOT_FOUND && "Absent key should not be found");
+    }
+    printf("All lookups verified.\n");
+
+    assert(map_perfect_destroy(&pmap) == MAP_OK);
+    assert(pmap == NULL);
+
+    // An empty map converts to an empty table
+    result = map_create(&map, dummy_key_clone, dummy_value_clone, dummy_hash,
+                        dummy_stringify, dummy_compare, dummy_free_key, dummy_free_value);
+    assert(result == MAP_OK);
+    assert(map_build_perfect(&map, &pmap) == MAP_OK);
+    int key = 7;
+    void *value;
+    assert(map_perfect_get(pmap, &key, &value) == MAP_ERR_NOT_FOUND);
+    map_perfect_destroy(&pmap);
+    printf("Empty map handled.\n");
+
+    // Keys with identical hashes cannot be separated; the map must survive
+    result = map_create(&map, dummy_key_clone, dummy_value_clone, fake_hash,
+                        dummy_stringify, dummy_compare, dummy_free_key, dummy_free_value);
+    assert(result == MAP_OK);
+    for (int i = 0; i < 3; i++) {
+        assert(map_insert(map, &i, &i) == MAP_OK);
+    }
+    result = map_build_perfect(&map, &pmap);
+    assert(result == MAP_ERR_INVALID_ARG && "Colliding hashes should be rejected");
+    assert(map != NULL);
+    key = 2;
+    assert(map_get(map, &key, &value) == MAP_OK && *(int *)value == 2);
+    map_destroy(&map);
+    printf("Colliding hashes correctly rejected.\n");
+
+    return MAP_OK;
+}
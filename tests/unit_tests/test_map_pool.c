@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <map.h>
+
+#define NUM_ENTRIES 50000
+#define NUM_RANDOM 100000
+
+// Clone integer key/value
+void* dummy_clone(void *value) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)value;
+    return copy;
+}
+
+// Weak hash on purpose: the engine must post-mix it.
+uint64_t dummy_hash(void *key) { return (uint64_t)(*(int *)key) * 1024; }
+
+char* dummy_stringify(void *key, void *value) {
+    char *str = malloc(64);
+    if (str) snprintf(str, 64, "(Key: %d, Value: %d)", *(int *)key, *(int *)value);
+    return str;
+}
+
+int32_t dummy_compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void dummy_free(void *ptr) { free(ptr); }
+
+// Key i must hold expected[i], or be absent when expected[i] < 0.
+static void check(map_t *map, const int *expected, int n) {
+    size_t live = 0;
+    for (int i = 0; i < n; i++) {
+        void *value;
+        if (expected[i] < 0) {
+            assert(map_get(map, &i, &value) == MAP_ERR_NOT_FOUND);
+        } else {
+            assert(map_get(map, &i, &value) == MAP_OK && *(int *)value == expected[i]);
+            live++;
+        }
+    }
+    size_t size;
+    assert(map_get_size(map, &size) == MAP_OK && size == live);
+
+    // Iteration sees every live entry once.
+    char *seen = calloc((size_t)n, 1);
+    map_iterator_t iter;
+    void *key, *value;
+    size_t visited = 0;
+    if (map_iter_start(map, &iter) == MAP_OK) {
+        while (map_iter_next(map, &iter, &key, &value) == MAP_OK) {
+            int k = *(int *)key;
+            assert(k >= 0 && k < n && !seen[k] && expected[k] == *(int *)value);
+            seen[k] = 1;
+            visited++;
+        }
+    }
+    assert(visited == live);
+    free(seen);
+}
+
+static uint64_t rng_state = 3;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+int main(void) {
+    map_options_t options;
+    map_options_init(&options);
+    options.engine = MAP_ENGINE_POOL;
+
+    map_t *map;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash,
+                         dummy_stringify, dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    int *expected = malloc(NUM_ENTRIES * sizeof(int));
+
+    // Inserts and overwrites, through many head resizes and pool growths.
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        assert(map_insert(map, &i, &i) == MAP_OK);
+        expected[i] = i;
+    }
+    for (int i = 0; i < NUM_ENTRIES; i += 4) {
+        int value = i + NUM_ENTRIES;
+        assert(map_insert(map, &i, &value) == MAP_OK);
+        expected[i] = value;
+    }
+    check(map, expected, NUM_ENTRIES);
+    int missing = -1;
+    void *value;
+    assert(map_get(map, &missing, &value) == MAP_ERR_NOT_FOUND);
+    assert(map_remove(map, &missing) == MAP_ERR_NOT_FOUND);
+    printf("Pool map holds %d entries.\n", NUM_ENTRIES);
+
+    // Random removes and inserts; freed nodes are reused.
+    for (int step = 0; step < NUM_RANDOM; step++) {
+        int k = (int)(next_random() % NUM_ENTRIES);
+        if (next_random() % 2 == 0) {
+            assert(map_remove(map, &k) == (expected[k] >= 0 ? MAP_OK : MAP_ERR_NOT_FOUND));
+            expected[k] = -1;
+        } else {
+            assert(map_insert(map, &k, &k) == MAP_OK);
+            expected[k] = k;
+        }
+    }
+    check(map, expected, NUM_ENTRIES);
+
+    // Removing while iterating, and inserting: the scan is not disturbed
+    // by the heads growing.
+    map_iterator_t iter;
+    void *key;
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    int extra = 0;
+    while (map_iter_next(map, &iter, &key, &value) == MAP_OK) {
+        int k = *(int *)key;
+        if (k % 3 == 0) {
+            assert(map_iter_remove(map, &iter) == MAP_OK);
+            assert(map_iter_remove(map, &iter) == MAP_ERR_NOT_FOUND);
+            expected[k] = -1;
+        }
+        while (extra < NUM_ENTRIES && expected[extra] >= 0) extra++;
+        if (extra < NUM_ENTRIES && extra % 3 != 0) {
+            assert(map_insert(map, &extra, &extra) == MAP_OK);
+            expected[extra] = extra;
+        }
+        extra++;
+    }
+    check(map, expected, NUM_ENTRIES);
+
+    // Clones copy heads and links as they are, on any number of threads.
+    map_t *copy;
+    assert(map_clone(map, &copy, 4) == MAP_OK);
+    check(copy, expected, NUM_ENTRIES);
+    for (int i = 0; i < NUM_ENTRIES; i += 2) {
+        if (expected[i] >= 0) assert(map_remove(copy, &i) == MAP_OK);
+    }
+    check(map, expected, NUM_ENTRIES);
+    map_destroy(&copy);
+
+    // Shrinks back down as it empties, even under an iterator, which then
+    // reports that compaction moved its nodes.
+    size_t big_buckets, small_buckets;
+    map_get_num_buckets(map, &big_buckets);
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    assert(map_iter_next(map, &iter, &key, &value) == MAP_OK);
+    for (int i = 0; i < NUM_ENTRIES - 3; i++) {
+        if (expected[i] >= 0) assert(map_remove(map, &i) == MAP_OK);
+        expected[i] = -1;
+    }
+    map_get_num_buckets(map, &small_buckets);
+    assert(small_buckets < big_buckets / 100);
+    assert(map_iter_next(map, &iter, &key, &value) == MAP_ERR_STALE_ITERATOR);
+    check(map, expected, NUM_ENTRIES);
+    assert(map_print(map) == MAP_OK);
+    map_destroy(&map);
+    free(expected);
+
+    printf("All pool engine tests passed.\n");
+    return MAP_OK;
+}
@@ -0,0 +1,197 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <pthread.h>
+#include <map.h>
+
+#define NUM_SOURCES 4
+#define NUM_KEYS 20000
+#define NUM_THREADS 4
+#define NUM_ADDS 50000
+#define DRAIN_EVERY 1000
+
+void* dummy_clone(void *ptr) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)ptr;
+    return copy;
+}
+
+uint64_t dummy_hash(void *key) { return map_hash_u32(key); }
+
+char* dummy_stringify(void *key, void *value) {
+    char *str = malloc(64);
+    if (str) snprintf(str, 64, "(Key: %d, Value: %d)", *(int *)key, *(int *)value);
+    return str;
+}
+
+int32_t dummy_compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void dummy_free(void *ptr) { free(ptr); }
+
+// Add the counts; with a non-NULL ctx, fail on that key.
+static void *add_counts(void *ctx, void *key, void *dst_value, void *src_value) {
+    if (ctx != NULL && *(int *)key == *(int *)ctx) return NULL;
+    *(int *)dst_value += *(int *)src_value;
+    return dst_value;
+}
+
+static map_t *make_map(map_engine_t engine) {
+    map_options_t options;
+    map_options_init(&options);
+    options.engine = engine;
+    map_t *map;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash, dummy_stringify,
+                         dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    return map;
+}
+
+// Source s counts key k s + 1 times when k % (s + 2) == 0.
+static void fill_sources(map_t **srcs) {
+    for (int s = 0; s < NUM_SOURCES; s++) {
+        srcs[s] = make_map(MAP_ENGINE_CHAINING);
+        for (int k = 0; k < NUM_KEYS; k += s + 2) {
+            int count = s + 1;
+            assert(map_insert(srcs[s], &k, &count) == MAP_OK);
+        }
+    }
+}
+
+static int expected_count(int key) {
+    int count = 0;
+    for (int s = 0; s < NUM_SOURCES; s++) {
+        if (key % (s + 2) == 0) count += s + 1;
+    }
+    return count;
+}
+
+static void check_counts(map_t *map, int (*expected)(int key), int range) {
+    size_t entries = 0;
+    for (int k = 0; k < range; k++) {
+        void *value;
+        if (expected(k) == 0) {
+            assert(map_get(map, &k, &value) == MAP_ERR_NOT_FOUND);
+        } else {
+            assert(map_get(map, &k, &value) == MAP_OK && *(int *)value == expected(k));
+            entries++;
+        }
+    }
+    size_t size;
+    assert(map_get_size(map, &size) == MAP_OK && size == entries);
+}
+
+static int merged_count(int key) { return expected_count(key) + (key == 0); }
+
+static void test_merge(map_engine_t engine, int nthreads) {
+    map_t *dst = make_map(engine);
+    int one = 1, zero = 0;
+    assert(map_insert(dst, &zero, &one) == MAP_OK); // Already counted once.
+    map_t *srcs[NUM_SOURCES];
+    fill_sources(srcs);
+    assert(map_merge_parallel(dst, srcs, NUM_SOURCES, nthreads, add_counts, NULL) == MAP_OK);
+    for (int s = 0; s < NUM_SOURCES; s++) assert(srcs[s] == NULL);
+
+    check_counts(dst, merged_count, NUM_KEYS);
+    map_destroy(&dst);
+}
+
+typedef struct {
+    map_reducer_t *reducer;
+    int local;
+} counter_t;
+
+// Thread t counts keys i * NUM_THREADS + t, wrapped to NUM_KEYS.
+static void *count_keys(void *arg) {
+    counter_t *counter = (counter_t *)arg;
+    for (int i = 0; i < NUM_ADDS; i++) {
+        int key = (i * NUM_THREADS + counter->local) % NUM_KEYS, one = 1;
+        map_t *local;
+        void *value;
+        assert(map_reducer_local(counter->reducer, counter->local, &local) == MAP_OK);
+        if (map_get(local, &key, &value) == MAP_OK) {
+            (*(int *)value)++;
+        } else {
+            assert(map_insert(local, &key, &one) == MAP_OK);
+        }
+        if (i % DRAIN_EVERY == DRAIN_EVERY - 1 && i < NUM_ADDS / 2) {
+            assert(map_reducer_drain(counter->reducer, counter->local) == MAP_OK);
+        }
+    }
+    return NULL;
+}
+
+static int reduced_count(int key) {
+    // Adds cover NUM_ADDS * NUM_THREADS slots of the key space in order.
+    int total = NUM_ADDS * NUM_THREADS;
+    return total / NUM_KEYS + (key < total % NUM_KEYS);
+}
+
+static void test_reducer(void) {
+    map_reducer_t *reducer;
+    assert(map_reducer_create(&reducer, make_map(MAP_ENGINE_CHAINING), NUM_THREADS, add_counts,
+                              NULL) == MAP_OK);
+    pthread_t threads[NUM_THREADS];
+    counter_t counters[NUM_THREADS];
+    for (int t = 0; t < NUM_THREADS; t++) {
+        counters[t].reducer = reducer;
+        counters[t].local = t;
+        assert(pthread_create(&threads[t], NULL, count_keys, &counters[t]) == 0);
+    }
+    for (int t = 0; t < NUM_THREADS; t++) pthread_join(threads[t], NULL);
+
+    // Half the adds were drained as they went.
+    size_t drained;
+    assert(map_get_size(reducer->global, &drained) == MAP_OK && drained > 0);
+
+    map_t *global;
+    assert(map_reducer_finish(&reducer, NUM_THREADS, &global) == MAP_OK);
+    assert(reducer == NULL);
+    check_counts(global, reduced_count, NUM_KEYS);
+    map_destroy(&global);
+}
+
+int main(void) {
+    test_merge(MAP_ENGINE_CHAINING, 1);
+    test_merge(MAP_ENGINE_CHAINING, NUM_THREADS);
+    test_merge(MAP_ENGINE_DENSE, NUM_THREADS); // Merged one source at a time.
+    printf("Parallel merges add up.\n");
+
+    test_reducer();
+    printf("Streaming reduction adds up.\n");
+
+    // A failing combine still consumes every source.
+    int bad = 60;
+    map_t *dst = make_map(MAP_ENGINE_CHAINING);
+    map_t *srcs[NUM_SOURCES];
+    fill_sources(srcs);
+    assert(map_merge_parallel(dst, srcs, NUM_SOURCES, NUM_THREADS, add_counts, &bad) ==
+           MAP_ERR_NO_MEM);
+    for (int s = 0; s < NUM_SOURCES; s++) assert(srcs[s] == NULL);
+    map_destroy(&dst);
+
+    // Bad arguments.
+    dst = make_map(MAP_ENGINE_CHAINING);
+    map_t *twice[2] = {dst, dst};
+    assert(map_merge_parallel(dst, twice, 1, 1, NULL, NULL) == MAP_ERR_INVALID_ARG);
+    fill_sources(srcs);
+    twice[0] = twice[1] = srcs[0];
+    assert(map_merge_parallel(dst, twice, 2, 1, NULL, NULL) == MAP_ERR_INVALID_ARG);
+    assert(map_merge_parallel(dst, srcs, NUM_SOURCES, 0, NULL, NULL) == MAP_ERR_INVALID_ARG);
+    assert(map_merge_parallel(dst, srcs, NUM_SOURCES, 1, NULL, NULL) == MAP_OK);
+    map_reducer_t *reducer;
+    assert(map_reducer_create(&reducer, dst, NUM_THREADS, NULL, NULL) == MAP_ERR_INVALID_ARG);
+    map_destroy(&dst);
+
+    dst = make_map(MAP_ENGINE_CHAINING);
+    assert(map_reducer_create(&reducer, dst, 2, NULL, NULL) == MAP_OK);
+    assert(map_reducer_drain(reducer, 2) == MAP_ERR_INVALID_ARG);
+    assert(map_reducer_drain(reducer, 1) == MAP_OK); // Empty: nothing to do.
+    assert(map_reducer_destroy(&reducer) == MAP_OK && reducer == NULL);
+
+    printf("All reduce tests passed.\n");
+    return MAP_OK;
+}
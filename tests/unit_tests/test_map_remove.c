@@ -78,7 +78,7 @@ int main(void) {
     }
 
     // Check size
-    int size;
+    size_t size;
     assert(map_get_size(map, &size) == MAP_OK);
     assert(size == 5);
 
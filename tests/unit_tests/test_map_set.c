@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <map.h>
+
+#define NUM_KEYS 10000
+
+static size_t clones;
+
+// Clone integer key, counting the calls
+void* dummy_clone(void *key) {
+    clones++;
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)key;
+    return copy;
+}
+
+uint64_t dummy_hash(void *key) { return map_hash_u32(key); }
+
+char* dummy_stringify(void *key, void *value) {
+    (void)value;
+    char *str = malloc(32);
+    if (str) snprintf(str, 32, "(Key: %d)", *(int *)key);
+    return str;
+}
+
+int32_t dummy_compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void dummy_free(void *ptr) { free(ptr); }
+
+static map_set_t *make_set(map_engine_t engine, int from, int to, int step) {
+    map_options_t options;
+    map_options_init(&options);
+    options.engine = engine;
+    map_set_t *set;
+    assert(map_set_create_ex(&set, &options, dummy_clone, dummy_hash, dummy_stringify,
+                             dummy_compare, dummy_free) == MAP_OK);
+    for (int i = from; i < to; i += step) assert(map_set_insert(set, &i) == MAP_OK);
+    return set;
+}
+
+// Check that set holds exactly the keys in [0, NUM_KEYS) that want() accepts.
+static void check(const map_set_t *set, int (*want)(int key)) {
+    size_t expected = 0;
+    for (int i = 0; i < NUM_KEYS; i++) {
+        assert(map_set_contains(set, &i) == (want(i) ? MAP_OK : MAP_ERR_NOT_FOUND));
+        expected += want(i) != 0;
+    }
+    size_t size;
+    assert(map_get_size((map_set_t *)set, &size) == MAP_OK && size == expected);
+
+    map_iterator_t iter;
+    void *key;
+    size_t visited = 0;
+    if (map_iter_start(set, &iter) == MAP_OK) {
+        while (map_set_iter_next(set, &iter, &key) == MAP_OK) {
+            assert(want(*(int *)key));
+            visited++;
+        }
+    }
+    assert(visited == expected);
+}
+
+static int is_even(int key) { return key % 2 == 0; }
+static int is_multiple_of_6(int key) { return key % 6 == 0; }
+static int is_even_not_3(int key) { return key % 2 == 0 && key % 3 != 0; }
+static int is_even_or_3(int key) { return key % 2 == 0 || key % 3 == 0; }
+
+static void test_engine(map_engine_t engine) {
+    // Only keys are cloned, and only once each.
+    clones = 0;
+    map_set_t *evens = make_set(engine, 0, NUM_KEYS, 2);
+    for (int i = 0; i < NUM_KEYS; i += 2) assert(map_set_insert(evens, &i) == MAP_OK);
+    assert(clones == NUM_KEYS / 2);
+    check(evens, is_even);
+
+    map_set_t *threes = make_set(engine, 0, NUM_KEYS, 3);
+    map_set_t *copy;
+    assert(map_clone(evens, &copy, 1) == MAP_OK);
+    assert(map_set_intersect(copy, threes) == MAP_OK);
+    check(copy, is_multiple_of_6);
+    map_destroy(&copy);
+
+    assert(map_clone(evens, &copy, 1) == MAP_OK);
+    assert(map_set_difference(copy, threes) == MAP_OK);
+    check(copy, is_even_not_3);
+    map_destroy(&copy);
+
+    assert(map_set_union(evens, threes) == MAP_OK);
+    check(evens, is_even_or_3);
+
+    // Removing through the map calls and the iterator.
+    map_iterator_t iter;
+    void *key;
+    assert(map_iter_start(evens, &iter) == MAP_OK);
+    while (map_set_iter_next(evens, &iter, &key) == MAP_OK) {
+        if (*(int *)key % 2 != 0) assert(map_iter_remove(evens, &iter) == MAP_OK);
+    }
+    for (int i = 0; i < NUM_KEYS; i += 6) assert(map_remove(evens, &i) == MAP_OK);
+    check(evens, is_even_not_3);
+
+    map_destroy(&evens);
+    map_destroy(&threes);
+}
+
+int main(void) {
+    test_engine(MAP_ENGINE_CHAINING);
+    test_engine(MAP_ENGINE_POOL);
+    test_engine(MAP_ENGINE_DENSE);
+    printf("Set operations work on every engine.\n");
+
+    // String keys live in the set's arena.
+    map_options_t options;
+    map_options_init(&options);
+    options.key_mode = MAP_KEY_STRING;
+    map_set_t *words;
+    assert(map_set_create_ex(&words, &options, NULL, NULL, dummy_stringify, NULL, NULL) ==
+           MAP_OK);
+    const char *list[] = {"apple", "pear", "apple", "fig", "pear"};
+    for (int i = 0; i < 5; i++) assert(map_set_insert(words, (void *)list[i]) == MAP_OK);
+    size_t size;
+    assert(map_get_size(words, &size) == MAP_OK && size == 3);
+    assert(map_set_contains(words, "fig") == MAP_OK);
+    assert(map_set_contains(words, "plum") == MAP_ERR_NOT_FOUND);
+    map_destroy(&words);
+
+    // Sets and maps don't mix.
+    map_set_t *set;
+    assert(map_set_create(&set, dummy_clone, dummy_hash, dummy_stringify, dummy_compare,
+                          dummy_free) == MAP_OK);
+    int one = 1;
+    assert(map_set_insert(set, &one) == MAP_OK);
+    assert(map_print(set) == MAP_OK);
+    map_t *map;
+    assert(map_create(&map, dummy_clone, dummy_clone, dummy_hash, dummy_stringify,
+                      dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    assert(map_set_insert(map, &one) == MAP_ERR_INVALID_ARG);
+    assert(map_set_contains(map, &one) == MAP_ERR_INVALID_ARG);
+    assert(map_set_union(set, map) == MAP_ERR_INVALID_ARG);
+    assert(map_set_difference(map, set) == MAP_ERR_INVALID_ARG);
+    map_destroy(&set);
+    assert(map_set_create(&set, NULL, dummy_hash, dummy_stringify, dummy_compare,
+                          dummy_free) == MAP_ERR_INVALID_ARG);
+    map_destroy(&map);
+    map_options_t disk_options;
+    map_options_init(&disk_options);
+    disk_options.engine = MAP_ENGINE_DISK;
+    assert(map_set_create_ex(&set, &disk_options, dummy_clone, dummy_hash, dummy_stringify,
+                             dummy_compare, dummy_free) == MAP_ERR_INVALID_ARG);
+
+    printf("All set tests passed.\n");
+    return MAP_OK;
+}
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <map.h>
+
+// Clone integer key/value
+void* dummy_clone(void *value) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)value;
+    return copy;
+}
+
+uint64_t dummy_hash(void *key) { return map_hash_u32(key); }
+
+char* dummy_stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+int32_t dummy_compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void dummy_free(void *ptr) { free(ptr); }
+
+// Add the src count into dst, in place.
+void* sum_in_place(void *ctx, void *key, void *dst_value, void *src_value) {
+    (void)key;
+    (*(int *)ctx)++;
+    *(int *)dst_value += *(int *)src_value;
+    return dst_value;
+}
+
+// Product as a fresh value, for maps whose values must not change.
+void* product_new(void *ctx, void *key, void *dst_value, void *src_value) {
+    (void)ctx;
+    (void)key;
+    int product = *(int *)dst_value * *(int *)src_value;
+    return dummy_clone(&product);
+}
+
+static map_t *make_map(map_engine_t engine, int from, int to, int value) {
+    map_options_t options;
+    map_options_init(&options);
+    options.engine = engine;
+
+    map_t *map;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash,
+                         dummy_stringify, dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    for (int i = from; i < to; i++) {
+        int v = value < 0 ? i : value;
+        assert(map_insert(map, &i, &v) == MAP_OK);
+    }
+    return map;
+}
+
+// Check that map holds exactly keys [from, to) with expect(key) values.
+static void check_range(map_t *map, int from, int to, int (*expect)(int key)) {
+    size_t size;
+    assert(map_get_size(map, &size) == MAP_OK && size == (size_t)(to - from));
+    for (int i = from - 10; i < to + 10; i++) {
+        void *value;
+        map_error_t result = map_get(map, &i, &value);
+        if (i < from || i >= to) {
+            assert(result == MAP_ERR_NOT_FOUND);
+        } else {
+            assert(result == MAP_OK && *(int *)value == expect(i));
+        }
+    }
+}
+
+static int merged_sum(int key) { return key >= 500 && key < 1000 ? key + 1 : key < 500 ? key : 1; }
+static int src_wins(int key) { return key >= 500 ? 1 : key; }
+static int doubled(int key) { return key * 2; }
+static int identity(int key) { return key; }
+
+// Merge, intersect and difference on [0, 1000) and [500, 1500), with src
+// either the same size as dst (shared bucket count) or bigger.
+static void check_ops(map_engine_t dst_engine, map_engine_t src_engine, int src_end) {
+    int calls = 0;
+    map_t *dst = make_map(dst_engine, 0, 1000, -1);
+    map_t *src = make_map(src_engine, 500, src_end, 1);
+    assert(map_merge(dst, src, sum_in_place, &calls) == MAP_OK);
+    assert(calls == 500);
+    check_range(dst, 0, src_end, merged_sum);
+    map_destroy(&dst);
+
+    dst = make_map(dst_engine, 0, 1000, -1);
+    assert(map_merge_consume(dst, &src, NULL, NULL) == MAP_OK && src == NULL);
+    check_range(dst, 0, src_end, src_wins);
+    map_destroy(&dst);
+
+    dst = make_map(dst_engine, 0, 1000, -1);
+    src = make_map(src_engine, 500, src_end, 2);
+    assert(map_intersect(dst, src, product_new, NULL) == MAP_OK);
+    check_range(dst, 500, 1000, doubled);
+    map_destroy(&dst);
+
+    dst = make_map(dst_engine, 0, 1000, -1);
+    assert(map_difference(dst, src) == MAP_OK);
+    check_range(dst, 0, 500, identity);
+    map_destroy(&dst);
+    map_destroy(&src);
+}
+
+int main(void) {
+    check_ops(MAP_ENGINE_CHAINING, MAP_ENGINE_CHAINING, 1500);
+    check_ops(MAP_ENGINE_CHAINING, MAP_ENGINE_CHAINING, 4000);
+    check_ops(MAP_ENGINE_CUCKOO, MAP_ENGINE_CHAINING, 1500);
+    check_ops(MAP_ENGINE_CHAINING, MAP_ENGINE_CUCKOO, 4000);
+    printf("Merge, intersect and difference agree across engines.\n");
+
+    // A snapshot of dst keeps seeing the pre-merge state.
+    map_t *dst = make_map(MAP_ENGINE_CHAINING, 0, 1000, -1);
+    map_t *src = make_map(MAP_ENGINE_CHAINING, 500, 1500, 1);
+    map_snapshot_t *snap;
+    assert(map_snapshot(dst, &snap) == MAP_OK);
+    assert(map_merge(dst, src, product_new, NULL) == MAP_OK);
+    assert(map_difference(dst, src) == MAP_OK);
+    check_range(dst, 0, 500, identity);
+    size_t size;
+    void *value;
+    int key = 700;
+    assert(map_snapshot_get_size(snap, &size) == MAP_OK && size == 1000);
+    assert(map_snapshot_get(snap, &key, &value) == MAP_OK && *(int *)value == 700);
+    map_snapshot_release(&snap);
+    map_destroy(&dst);
+    printf("Snapshots are isolated from merges.\n");
+
+    // String keys move into dst's arena when src is consumed.
+    map_options_t options;
+    map_options_init(&options);
+    options.key_mode = MAP_KEY_STRING;
+    map_t *words;
+    assert(map_create_ex(&dst, &options, NULL, dummy_clone, NULL, dummy_stringify, NULL,
+                         NULL, dummy_free) == MAP_OK);
+    assert(map_create_ex(&words, &options, NULL, dummy_clone, NULL, dummy_stringify, NULL,
+                         NULL, dummy_free) == MAP_OK);
+    int one = 1, calls = 0;
+    const char *a[] = {"apple", "banana", "cherry"};
+    const char *b[] = {"banana", "cherry", "date", "elder"};
+    for (int i = 0; i < 3; i++) assert(map_insert(dst, (void *)a[i], &one) == MAP_OK);
+    for (int i = 0; i < 4; i++) assert(map_insert(words, (void *)b[i], &one) == MAP_OK);
+    assert(map_merge_consume(dst, &words, sum_in_place, &calls) == MAP_OK && words == NULL);
+    assert(map_get_size(dst, &size) == MAP_OK && size == 5 && calls == 2);
+    assert(map_get(dst, "cherry", &value) == MAP_OK && *(int *)value == 2);
+    assert(map_get(dst, "elder", &value) == MAP_OK && *(int *)value == 1);
+
+    // Mismatched key modes and self-merges are rejected.
+    assert(map_merge(dst, src, NULL, NULL) == MAP_ERR_INVALID_ARG);
+    assert(map_merge(src, src, NULL, NULL) == MAP_ERR_INVALID_ARG);
+    assert(map_difference(NULL, src) == MAP_ERR_INVALID_ARG);
+    map_destroy(&dst);
+    map_destroy(&src);
+    printf("All set operation tests passed.\n");
+
+    return MAP_OK;
+}
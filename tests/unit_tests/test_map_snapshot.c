@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <map.h>
+
+#define KEY_SPACE 4000
+#define NUM_OPS 20000
+
+// Clone integer key/value
+void* dummy_clone(void *value) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)value;
+    return copy;
+}
+
+uint64_t dummy_hash(void *key) { return map_hash_u32(key); }
+
+char* dummy_stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+int32_t dummy_compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void dummy_free(void *ptr) { free(ptr); }
+
+// Reference model: value of each key, -1 when absent.
+typedef struct {
+    int values[KEY_SPACE];
+    size_t size;
+} model_t;
+
+static void random_ops(map_t *map, model_t *model, int ops) {
+    for (int n = 0; n < ops; n++) {
+        int key = rand() % KEY_SPACE;
+        if (rand() % 3 == 0) {
+            map_error_t result = map_remove(map, &key);
+            assert(result == (model->values[key] >= 0 ? MAP_OK : MAP_ERR_NOT_FOUND));
+            if (model->values[key] >= 0) model->size--;
+            model->values[key] = -1;
+        } else {
+            int value = rand() % 100000;
+            assert(map_insert(map, &key, &value) == MAP_OK);
+            if (model->values[key] < 0) model->size++;
+            model->values[key] = value;
+        }
+    }
+}
+
+static void check_snapshot(const map_snapshot_t *snap, const model_t *model) {
+    size_t size;
+    assert(map_snapshot_get_size(snap, &size) == MAP_OK && size == model->size);
+
+    for (int key = 0; key < KEY_SPACE; key++) {
+        void *value;
+        map_error_t result = map_snapshot_get(snap, &key, &value);
+        if (model->values[key] < 0) {
+            assert(result == MAP_ERR_NOT_FOUND && "Snapshot sees a later insert");
+        } else {
+            assert(result == MAP_OK && *(int *)value == model->values[key] &&
+                   "Snapshot sees a later write");
+        }
+    }
+
+    map_iterator_t iter;
+    void *key, *value;
+    size_t count = 0;
+    if (map_snapshot_iter_start(snap, &iter) == MAP_OK) {
+        while (map_snapshot_iter_next(snap, &iter, &key, &value) == MAP_OK) {
+            assert(model->values[*(int *)key] == *(int *)value);
+            count++;
+        }
+    }
+    assert(count == model->size && "Snapshot iteration is not point-in-time");
+}
+
+static void check_map(map_t *map, const model_t *model) {
+    size_t size;
+    assert(map_get_size(map, &size) == MAP_OK && size == model->size);
+    for (int key = 0; key < KEY_SPACE; key++) {
+        void *value;
+        map_error_t result = map_get(map, &key, &value);
+        assert(result == (model->values[key] >= 0 ? MAP_OK : MAP_ERR_NOT_FOUND));
+        if (result == MAP_OK) assert(*(int *)value == model->values[key]);
+    }
+}
+
+int main(void) {
+    map_t *map;
+    static model_t live, at_first, at_second;
+
+    srand(42);
+    assert(map_create(&map, dummy_clone, dummy_clone, dummy_hash, dummy_stringify,
+                      dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    for (int key = 0; key < KEY_SPACE; key++) live.values[key] = -1;
+    random_ops(map, &live, NUM_OPS);
+    printf("Map populated with %zu keys.\n", live.size);
+
+    // Two overlapping snapshots taken at different points in time.
+    map_snapshot_t *first, *second;
+    assert(map_snapshot(map, &first) == MAP_OK);
+    at_first = live;
+    size_t buckets_before;
+    map_get_num_buckets(map, &buckets_before);
+
+    random_ops(map, &live, NUM_OPS);
+    assert(map_snapshot(map, &second) == MAP_OK);
+    at_second = live;
+    random_ops(map, &live, NUM_OPS);
+
+    check_snapshot(first, &at_first);
+    check_snapshot(second, &at_second);
+    check_map(map, &live);
+    size_t buckets_during;
+    map_get_num_buckets(map, &buckets_during);
+    assert(buckets_during == buckets_before && "Resize ran while snapshots were live");
+    printf("Snapshots stayed point-in-time across %d writes.\n", 2 * NUM_OPS);
+
+    // Extra references keep a snapshot alive.
+    map_snapshot_t *shared = second;
+    assert(map_snapshot_retain(shared) == MAP_OK);
+    assert(map_snapshot_release(&second) == MAP_OK && second == NULL);
+    check_snapshot(shared, &at_second);
+
+    // Releasing the older snapshot first must not disturb the newer one.
+    assert(map_snapshot_release(&first) == MAP_OK && first == NULL);
+    random_ops(map, &live, NUM_OPS);
+    check_snapshot(shared, &at_second);
+    assert(map_snapshot_release(&shared) == MAP_OK && shared == NULL);
+    assert(map->num_retired == 0 && map->cow_private == NULL);
+
+    // Normal operation (including resizes) resumes.
+    random_ops(map, &live, NUM_OPS);
+    check_map(map, &live);
+    printf("Map consistent after releasing all snapshots.\n");
+
+    // Destroying the map while a snapshot is live defers the teardown.
+    map_snapshot_t *orphan;
+    assert(map_snapshot(map, &orphan) == MAP_OK);
+    at_first = live;
+    random_ops(map, &live, 1000);
+    assert(map_destroy(&map) == MAP_OK && map == NULL);
+    check_snapshot(orphan, &at_first);
+    assert(map_snapshot_release(&orphan) == MAP_OK);
+
+    // String keys: removed keys stay readable and compaction waits.
+    map_options_t options;
+    map_options_init(&options);
+    options.key_mode = MAP_KEY_STRING;
+    assert(map_create_ex(&map, &options, NULL, dummy_clone, NULL, dummy_stringify, NULL,
+                         NULL, dummy_free) == MAP_OK);
+    int one = 1;
+    assert(map_insert(map, "alpha", &one) == MAP_OK);
+    assert(map_snapshot(map, &orphan) == MAP_OK);
+    assert(map_remove(map, "alpha") == MAP_OK);
+    assert(map_compact_keys(map) == MAP_OK);
+    void *value;
+    assert(map_snapshot_get(orphan, "alpha", &value) == MAP_OK && *(int *)value == 1);
+    assert(map_get(map, "alpha", &value) == MAP_ERR_NOT_FOUND);
+    assert(map_snapshot_release(&orphan) == MAP_OK);
+    assert(map_compact_keys(map) == MAP_OK && map->key_dead_bytes == 0);
+    map_destroy(&map);
+
+    // Only the chaining engine supports snapshots.
+    options.key_mode = MAP_KEY_USER;
+    options.engine = MAP_ENGINE_CUCKOO;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash,
+                         dummy_stringify, dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    assert(map_snapshot(map, &orphan) == MAP_ERR_INVALID_ARG);
+    map_destroy(&map);
+    printf("All snapshot tests passed.\n");
+
+    return MAP_OK;
+}
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <map.h>
+
+#define NUM_ENTRIES 5000
+
+static int hash_calls = 0;
+
+// Counting djb2, to check that resizes reuse stored hashes
+uint64_t counting_hash(void *key) {
+    char *str = (char *)key;
+    uint64_t hash = 5381;
+    int c;
+    hash_calls++;
+    while ((c = *str++)) {
+        hash = ((hash << 5) + hash) + c;
+    }
+    return hash;
+}
+
+// Clone integer value
+void* dummy_value_clone(void *value) {
+    int *new_value = malloc(sizeof(int));
+    if (new_value) *new_value = *(int *)value;
+    return new_value;
+}
+
+// Stringify key-value pair for display
+char* dummy_stringify(void *key, void *value) {
+    char *str = malloc(100 * sizeof(char));
+    if (str) snprintf(str, 100, "(Key: %s, Value: %d)", (char *)key, *(int *)value);
+    return str;
+}
+
+void dummy_free_value(void *value) { free(value); }
+
+static void make_key(char *buf, size_t size, int i) {
+    snprintf(buf, size, "https://example.com/items/%d?ref=%d", i, i % 7);
+}
+
+int main(void) {
+    map_t *map;
+    map_options_t options;
+    map_error_t result;
+    char key[128];
+    void *value;
+
+    // String keys require the chaining engine
+    map_options_init(&options);
+    options.key_mode = MAP_KEY_STRING;
+    options.engine = MAP_ENGINE_CUCKOO;
+    result = map_create_ex(&map, &options, NULL, dummy_value_clone, NULL, dummy_stringify,
+                           NULL, NULL, dummy_free_value);
+    assert(result == MAP_ERR_INVALID_ARG);
+
+    // Key callbacks are optional in string mode
+    options.engine = MAP_ENGINE_CHAINING;
+    result = map_create_ex(&map, &options, NULL, dummy_value_clone, counting_hash,
+                           dummy_stringify, NULL, NULL, dummy_free_value);
+    assert(result == MAP_OK && "String map creation failed");
+    printf("String-keyed map created successfully!\n");
+
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        make_key(key, sizeof(key), i);
+        assert(map_insert(map, key, &i) == MAP_OK && "Insert failed");
+    }
+    // One hash per insert: growing the table reused the stored hashes.
+    assert(hash_calls == NUM_ENTRIES && "Resize should not rehash string keys");
+    printf("Inserted %d keys with %d hash calls.\n", NUM_ENTRIES, hash_calls);
+
+    // Keys are copies owned by the map
+    make_key(key, sizeof(key), 42);
+    assert(map_get(map, key, &value) == MAP_OK && *(int *)value == 42);
+    key[0] = 'X';
+    assert(map_get(map, key, &value) == MAP_ERR_NOT_FOUND);
+
+    // Overwrite a value; prefix and extension of an existing key are distinct
+    int updated = -1;
+    make_key(key, sizeof(key), 7);
+    assert(map_insert(map, key, &updated) == MAP_OK);
+    assert(map_get(map, key, &value) == MAP_OK && *(int *)value == -1);
+    key[strlen(key) - 1] = '\0';
+    assert(map_get(map, key, &value) == MAP_ERR_NOT_FOUND);
+    strcat(key, "00");
+    assert(map_get(map, key, &value) == MAP_ERR_NOT_FOUND);
+
+    size_t size;
+    assert(map_get_size(map, &size) == MAP_OK && size == NUM_ENTRIES);
+
+    // Remove most keys, then compact
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        if (i % 10 == 0) continue;
+        make_key(key, sizeof(key), i);
+        assert(map_remove(map, key) == MAP_OK && "Remove failed");
+    }
+    assert(map->key_dead_bytes > 0);
+    size_t live = map->key_live_bytes;
+    assert(map_compact_keys(map) == MAP_OK);
+    assert(map->key_dead_bytes == 0 && map->key_live_bytes == live);
+    assert(map->key_chunks != NULL && map->key_chunks->next == NULL);
+    printf("Compacted arena down to %zu live bytes.\n", live);
+
+    // Everything left is still reachable after compaction
+    for (int i = 0; i < NUM_ENTRIES; i += 10) {
+        make_key(key, sizeof(key), i);
+        assert(map_get(map, key, &value) == MAP_OK && *(int *)value == i);
+    }
+    map_iterator_t iter;
+    void *k;
+    int count = 0;
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    while (map_iter_next(map, &iter, &k, &value) == MAP_OK) {
+        make_key(key, sizeof(key), *(int *)value);
+        assert(strcmp((char *)k, key) == 0 && "Iterated key mismatch");
+        count++;
+    }
+    assert(count == NUM_ENTRIES / 10);
+
+    // New keys can still be added after compaction
+    assert(map_insert(map, "fresh", &count) == MAP_OK);
+    assert(map_get(map, "fresh", &value) == MAP_OK && *(int *)value == count);
+    map_destroy(&map);
+    printf("Compacted map verified.\n");
+
+    // Built-in hash is used when usr_hash is NULL
+    result = map_create_ex(&map, &options, NULL, dummy_value_clone, NULL, dummy_stringify,
+                           NULL, NULL, dummy_free_value);
+    assert(result == MAP_OK);
+    assert(map_insert(map, "alpha", &count) == MAP_OK);
+    assert(map_get(map, "alpha", &value) == MAP_OK);
+    assert(map_compact_keys(map) == MAP_OK);
+    map_destroy(&map);
+
+    // Compaction is only meaningful for string-keyed maps
+    assert(map_compact_keys(NULL) == MAP_ERR_INVALID_ARG);
+    printf("All string key tests passed.\n");
+
+    return MAP_OK;
+}
@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <map.h>
+
+#define NUM_RANDOM 5000
+
+static uint64_t fake_now = 1000;
+
+uint64_t fake_clock(void *ctx) {
+    (void)ctx;
+    return fake_now;
+}
+
+// Clone integer key/value
+void* dummy_clone(void *value) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)value;
+    return copy;
+}
+
+uint64_t dummy_hash(void *key) { return map_hash_u32(key); }
+
+char* dummy_stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+int32_t dummy_compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void dummy_free(void *ptr) { free(ptr); }
+
+// Sum into a new value, so set operations have to store it.
+static void *add_values(void *ctx, void *key, void *dst_value, void *src_value) {
+    (void)ctx;
+    (void)key;
+    int sum = *(int *)dst_value + *(int *)src_value;
+    return dummy_clone(&sum);
+}
+
+static map_t *make_map(size_t max_entries) {
+    map_options_t options;
+    map_options_init(&options);
+    options.enable_ttl = 1;
+    options.clock = fake_clock;
+    options.max_entries = max_entries;
+
+    map_t *map;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash,
+                         dummy_stringify, dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    return map;
+}
+
+static int map_size(map_t *map) {
+    size_t size;
+    assert(map_get_size(map, &size) == MAP_OK);
+    return size;
+}
+
+static uint64_t rng_state = 42;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+int main(void) {
+    size_t expired;
+    void *value;
+
+    // Deadlines are honoured to the tick, in bulk and on lookup.
+    map_t *map = make_map(0);
+    for (int i = 0; i < 1000; i++) assert(map_insert_ttl(map, &i, &i, (uint64_t)i + 1) == MAP_OK);
+    assert(map_expire(map, 1500, 100000, &expired) == MAP_OK && expired == 500);
+    assert(map_size(map) == 500);
+    int key = 499;
+    assert(map_get(map, &key, &value) == MAP_ERR_NOT_FOUND);
+    key = 500;
+    assert(map_get(map, &key, &value) == MAP_OK);
+
+    fake_now = 1600;
+    key = 550;
+    assert(map_get(map, &key, &value) == MAP_ERR_NOT_FOUND && map_size(map) == 499);
+    key = 650;
+    assert(map_get(map, &key, &value) == MAP_OK);
+
+    // A small budget bounds each call; repeated calls finish the job.
+    size_t total = 0;
+    int calls = 0;
+    while (map_size(map) > 0) {
+        assert(map_expire(map, 2000, 16, &expired) == MAP_OK && expired <= 16);
+        total += expired;
+        calls++;
+    }
+    assert(total == 499 && calls >= 32);
+
+    // Plain inserts clear a deadline, TTL inserts refresh it.
+    key = 5;
+    assert(map_insert_ttl(map, &key, &key, 10) == MAP_OK);
+    assert(map_insert(map, &key, &key) == MAP_OK);
+    key = 6;
+    assert(map_insert_ttl(map, &key, &key, 10) == MAP_OK);
+    assert(map_insert_ttl(map, &key, &key, 1000) == MAP_OK);
+    key = 7;
+    assert(map_insert_ttl(map, &key, &key, 10) == MAP_OK);
+    assert(map_remove(map, &key) == MAP_OK);
+    fake_now = 2100;
+    assert(map_expire(map, fake_now, 100, &expired) == MAP_OK && expired == 0);
+    key = 5;
+    assert(map_get(map, &key, &value) == MAP_OK);
+    key = 6;
+    assert(map_get(map, &key, &value) == MAP_OK);
+    map_destroy(&map);
+
+    // Deadlines past the wheel's span are pulled in a budget at a time.
+    map = make_map(0);
+    uint64_t far = (uint64_t)1 << 24;
+    for (int i = 0; i < 1000; i++) assert(map_insert_ttl(map, &i, &i, far + 10) == MAP_OK);
+    calls = 0;
+    for (expired = 0; map_size(map) > 0; calls++) {
+        assert(map_expire(map, fake_now + 2 * far, 16, &expired) == MAP_OK && expired <= 16);
+        if (calls == 0) {
+            int pulling = 0;
+            for (map_ttl_element_t *node = map->ttl->pulling; node != NULL;
+                 node = node->timer_next) {
+                pulling++;
+            }
+            assert(pulling == 1000 - 16);
+        }
+    }
+    assert(calls >= 1000 / 16);
+    map_destroy(&map);
+    printf("Deadlines, budgets and refreshes work.\n");
+
+    // Random deadlines spanning every wheel level and the overflow list,
+    // checked against a plain array.
+    fake_now = 1000;
+    map = make_map(0);
+    uint64_t *deadline = calloc(NUM_RANDOM, sizeof(uint64_t));
+    for (int i = 0; i < NUM_RANDOM; i++) {
+        uint64_t ttl = 1 + next_random() % ((uint64_t)1 << (4 + next_random() % 26));
+        deadline[i] = fake_now + ttl;
+        assert(map_insert_ttl(map, &i, &i, ttl) == MAP_OK);
+    }
+    map_t *copy;
+    assert(map_clone(map, &copy, 1) == MAP_OK);
+
+    uint64_t now = fake_now;
+    int alive = NUM_RANDOM;
+    while (alive > 0) {
+        now += next_random() % ((uint64_t)1 << (next_random() % 28));
+        size_t budget = 1 + next_random() % 64;
+        alive = 0;
+        for (int i = 0; i < NUM_RANDOM; i++) alive += deadline[i] > now;
+        for (int i = 0; map_size(map) > alive; i++) {
+            assert(i < 8 * NUM_RANDOM && map_expire(map, now, budget, &expired) == MAP_OK);
+        }
+
+        // Nothing left is due, so lookups find exactly the live keys.
+        for (int i = 0; i < NUM_RANDOM; i++) {
+            assert((map_get(map, &i, &value) == MAP_OK) == (deadline[i] > now));
+        }
+    }
+
+    // The clone kept every deadline; collect it in one call.
+    assert(map_size(copy) == NUM_RANDOM);
+    assert(map_expire(copy, now, (size_t)-1, &expired) == MAP_OK && expired == NUM_RANDOM);
+    free(deadline);
+    map_destroy(&map);
+    map_destroy(&copy);
+    printf("Random deadlines expire on time.\n");
+
+    // A lookup that drops an expired entry ends an iteration.
+    map = make_map(0);
+    for (int i = 0; i < 100; i++) assert(map_insert_ttl(map, &i, &i, 10) == MAP_OK);
+    map_iterator_t iter;
+    void *out_key;
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    assert(map_iter_next(map, &iter, &out_key, &value) == MAP_OK);
+    fake_now += 10;
+    key = 50;
+    assert(map_get(map, &key, &value) == MAP_ERR_NOT_FOUND);
+    assert(map_iter_next(map, &iter, &out_key, &value) == MAP_ERR_STALE_ITERATOR);
+    map_destroy(&map);
+
+    // Evicted entries leave the wheel too.
+    map = make_map(16);
+    for (int i = 0; i < 100; i++) assert(map_insert_ttl(map, &i, &i, 50) == MAP_OK);
+    assert(map_size(map) == 16);
+    assert(map_expire(map, fake_now + 50, 1000, &expired) == MAP_OK && expired == 16);
+    assert(map_size(map) == 0);
+
+    map_destroy(&map);
+
+    // Values combined by a merge or an intersection keep their deadline.
+    map = make_map(0);
+    map_t *other;
+    assert(map_create(&other, dummy_clone, dummy_clone, dummy_hash, dummy_stringify,
+                      dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    for (int i = 0; i < 100; i++) {
+        assert(map_insert_ttl(map, &i, &i, 20) == MAP_OK);
+        assert(map_insert(other, &i, &i) == MAP_OK);
+    }
+    assert(map_merge(map, other, add_values, NULL) == MAP_OK);
+    assert(map_intersect(map, other, add_values, NULL) == MAP_OK);
+    key = 7;
+    assert(map_get(map, &key, &value) == MAP_OK && *(int *)value == 21);
+    assert(map_expire(map, fake_now + 20, 1000, &expired) == MAP_OK && expired == 100);
+    assert(map_size(map) == 0);
+    map_destroy(&other);
+
+    map_snapshot_t *snap;
+    assert(map_snapshot(map, &snap) == MAP_ERR_INVALID_ARG);
+    map_destroy(&map);
+    assert(map_create(&map, dummy_clone, dummy_clone, dummy_hash, dummy_stringify,
+                      dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    assert(map_insert_ttl(map, &key, &key, 10) == MAP_ERR_INVALID_ARG);
+    assert(map_expire(map, 0, 10, NULL) == MAP_ERR_INVALID_ARG);
+    map_destroy(&map);
+    printf("All TTL tests passed.\n");
+
+    return MAP_OK;
+}
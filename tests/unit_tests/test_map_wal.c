@@ -0,0 +1,270 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <map.h>
+
+#define NUM_ENTRIES 3000
+
+// Clone integer key/value
+void* dummy_clone(void *value) {
+    int *copy = malloc(sizeof(int));
+    if (copy) *copy = *(int *)value;
+    return copy;
+}
+
+uint64_t dummy_hash(void *key) { return map_hash_u32(key); }
+
+char* dummy_stringify(void *key, void *value) {
+    (void)key;
+    (void)value;
+    return NULL;
+}
+
+int32_t dummy_compare(void *key1, void *key2) {
+    int a = *(int *)key1, b = *(int *)key2;
+    return (a > b) - (a < b);
+}
+
+void dummy_free(void *ptr) { free(ptr); }
+
+size_t int_encode(void *obj, uint8_t *buf, size_t cap) {
+    if (cap >= sizeof(int)) memcpy(buf, obj, sizeof(int));
+    return sizeof(int);
+}
+
+void* int_decode(const uint8_t *buf, size_t len) {
+    if (len != sizeof(int)) return NULL;
+    int *obj = malloc(sizeof(int));
+    if (obj) memcpy(obj, buf, sizeof(int));
+    return obj;
+}
+
+static char path[256];
+
+static off_t file_size(const char *name) {
+    struct stat st;
+    return stat(name, &st) == 0 ? st.st_size : -1;
+}
+
+static map_t *open_map(map_engine_t engine, size_t sync_every_records) {
+    map_options_t options;
+    map_options_init(&options);
+    options.engine = engine;
+    map_t *map;
+    assert(map_create_ex(&map, &options, dummy_clone, dummy_clone, dummy_hash,
+                         dummy_stringify, dummy_compare, dummy_free, dummy_free) == MAP_OK);
+
+    map_wal_options_t wal;
+    map_wal_options_init(&wal);
+    wal.encode_key = int_encode;
+    wal.decode_key = int_decode;
+    wal.encode_value = int_encode;
+    wal.decode_value = int_decode;
+    wal.sync_every_records = sync_every_records;
+    wal.buffer_size = 256; // Small, so records straddle buffer flushes.
+    assert(map_wal_open(map, path, &wal) == MAP_OK);
+    return map;
+}
+
+// Key i must hold expected[i], or be absent when expected[i] < 0.
+static void check(map_t *map, const int *expected) {
+    size_t live = 0;
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        void *value;
+        if (expected[i] < 0) {
+            assert(map_get(map, &i, &value) == MAP_ERR_NOT_FOUND);
+        } else {
+            assert(map_get(map, &i, &value) == MAP_OK && *(int *)value == expected[i]);
+            live++;
+        }
+    }
+    size_t size;
+    assert(map_get_size(map, &size) == MAP_OK && size == live);
+}
+
+static void test_engine(map_engine_t engine, const char *name) {
+    int *expected = malloc(NUM_ENTRIES * sizeof(int));
+    unlink(path);
+
+    // Inserts, overwrites and both kinds of removes come back on replay.
+    map_t *map = open_map(engine, 64);
+    for (int i = 0; i < NUM_ENTRIES; i++) {
+        assert(map_insert(map, &i, &i) == MAP_OK);
+        expected[i] = i;
+    }
+    for (int i = 0; i < NUM_ENTRIES; i += 3) {
+        int value = i + NUM_ENTRIES;
+        assert(map_insert(map, &i, &value) == MAP_OK);
+        expected[i] = value;
+    }
+    for (int i = 1; i < NUM_ENTRIES; i += 5) {
+        assert(map_remove(map, &i) == MAP_OK);
+        expected[i] = -1;
+    }
+    map_iterator_t iter;
+    void *key, *value;
+    assert(map_iter_start(map, &iter) == MAP_OK);
+    while (map_iter_next(map, &iter, &key, &value) == MAP_OK) {
+        int k = *(int *)key;
+        if (k % 7 == 2) {
+            assert(map_iter_remove(map, &iter) == MAP_OK);
+            expected[k] = -1;
+        }
+    }
+    map_destroy(&map);
+
+    map = open_map(engine, 64);
+    check(map, expected);
+    map_destroy(&map);
+
+    // A torn last record is dropped and cut off; appends carry on after it.
+    map = open_map(engine, 1);
+    int torn = 1;
+    int torn_value = 12345;
+    assert(map_insert(map, &torn, &torn_value) == MAP_OK);
+    map_destroy(&map);
+    off_t full = file_size(path);
+    assert(truncate(path, full - 3) == 0);
+
+    map = open_map(engine, 1);
+    check(map, expected);
+    assert(file_size(path) < full - 3);
+    int extra = 2;
+    assert(map_insert(map, &extra, &torn_value) == MAP_OK);
+    expected[extra] = torn_value;
+    map_destroy(&map);
+
+    // Junk at the end (a write that never completed) is dropped as well.
+    FILE *file = fopen(path, "ab");
+    assert(file != NULL);
+    fputs("\001junk", file);
+    fclose(file);
+    map = open_map(engine, 1);
+    check(map, expected);
+
+    // Group commit: records wait in the buffer until a sync point.
+    map_destroy(&map);
+    map = open_map(engine, 1000);
+    off_t before = file_size(path);
+    int k = 0, v = 7;
+    assert(map_insert(map, &k, &v) == MAP_OK);
+    expected[k] = v;
+    assert(file_size(path) == before);
+    assert(map_wal_sync(map) == MAP_OK);
+    assert(file_size(path) > before);
+
+    // Compaction leaves one insert per entry.
+    off_t bloated = file_size(path);
+    assert(map_wal_compact(map) == MAP_OK);
+    assert(file_size(path) < bloated);
+    k = 3;
+    assert(map_remove(map, &k) == MAP_OK);
+    expected[k] = -1;
+    assert(map_wal_close(map) == MAP_OK);
+    assert(map_wal_close(map) == MAP_ERR_INVALID_ARG);
+    k = 4;
+    assert(map_remove(map, &k) == MAP_OK); // Not logged any more.
+    map_destroy(&map);
+
+    map = open_map(engine, 1);
+    check(map, expected);
+
+    // A write cut short by the file size limit fails the insert and leaves
+    // no partial record behind, so later records still replay.
+    struct rlimit limit;
+    assert(getrlimit(RLIMIT_FSIZE, &limit) == 0);
+    struct rlimit tight = limit;
+    tight.rlim_cur = (rlim_t)file_size(path) + 30; // One record and a bit.
+    signal(SIGXFSZ, SIG_IGN);
+    assert(setrlimit(RLIMIT_FSIZE, &tight) == 0);
+    k = 5;
+    v = 55;
+    assert(map_insert(map, &k, &v) == MAP_OK);
+    expected[k] = v;
+    k = 6;
+    assert(map_insert(map, &k, &v) == MAP_ERR_IO);
+    check(map, expected);
+    assert(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+    signal(SIGXFSZ, SIG_DFL);
+    k = 7;
+    assert(map_insert(map, &k, &v) == MAP_OK);
+    expected[k] = v;
+    map_destroy(&map);
+
+    map = open_map(engine, 1);
+    check(map, expected);
+    map_destroy(&map);
+
+    free(expected);
+    unlink(path);
+    printf("%s maps replay their log.\n", name);
+}
+
+int main(void) {
+    snprintf(path, sizeof(path), "/tmp/test_map_wal_%ld.log", (long)getpid());
+
+    test_engine(MAP_ENGINE_CHAINING, "Chaining");
+    test_engine(MAP_ENGINE_CUCKOO, "Cuckoo");
+    test_engine(MAP_ENGINE_DENSE, "Dense");
+    test_engine(MAP_ENGINE_POOL, "Pool");
+
+    // Set operations on a logged map are logged too.
+    unlink(path);
+    map_t *map = open_map(MAP_ENGINE_CHAINING, 0);
+    map_t *other;
+    assert(map_create(&other, dummy_clone, dummy_clone, dummy_hash, dummy_stringify,
+                      dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    for (int i = 0; i < 100; i++) {
+        assert(map_insert(map, &i, &i) == MAP_OK);
+        if (i % 2 == 0) assert(map_insert(other, &i, &i) == MAP_OK);
+    }
+    assert(map_intersect(map, other, NULL, NULL) == MAP_OK);
+    map_destroy(&map);
+    map = open_map(MAP_ENGINE_CHAINING, 1);
+    size_t size;
+    assert(map_get_size(map, &size) == MAP_OK && size == 50);
+
+    // Invalid uses.
+    map_wal_options_t wal;
+    map_wal_options_init(&wal);
+    assert(map_wal_open(other, path, &wal) == MAP_ERR_INVALID_ARG); // No codec
+    wal.encode_key = int_encode;
+    wal.decode_key = int_decode;
+    wal.encode_value = int_encode;
+    wal.decode_value = int_decode;
+    assert(map_wal_open(map, path, &wal) == MAP_ERR_INVALID_ARG); // Already open
+    assert(map_wal_open(other, "/nonexistent/dir/log", &wal) == MAP_ERR_IO);
+    map_perfect_t *pmap;
+    assert(map_build_perfect(&map, &pmap) == MAP_ERR_INVALID_ARG);
+
+    FILE *file = fopen(path, "wb");
+    fputs("not a log at all", file);
+    fclose(file);
+    assert(map_wal_open(other, path, &wal) == MAP_ERR_IO);
+
+    map_options_t options;
+    map_options_init(&options);
+    options.max_entries = 10;
+    map_t *cache;
+    assert(map_create_ex(&cache, &options, dummy_clone, dummy_clone, dummy_hash,
+                         dummy_stringify, dummy_compare, dummy_free, dummy_free) == MAP_OK);
+    assert(map_wal_open(cache, path, &wal) == MAP_ERR_INVALID_ARG);
+    map_destroy(&cache);
+    map_set_t *set;
+    assert(map_set_create(&set, dummy_clone, dummy_hash, dummy_stringify, dummy_compare,
+                          dummy_free) == MAP_OK);
+    assert(map_wal_open(set, path, &wal) == MAP_ERR_INVALID_ARG); // Replay would leak values
+    map_destroy(&set);
+    map_destroy(&map);
+    map_destroy(&other);
+    unlink(path);
+
+    printf("All write-ahead log tests passed.\n");
+    return MAP_OK;
+}
@@ -41,7 +41,7 @@ int32_t dummy_compare(void *key1, void *key2) {
 void dummy_free_key(void *key) { free(key); }
 void dummy_free_value(void *value) { free(value); }
 
-int count_unique(int *arr, size_t size) {
+size_t count_unique(int *arr, size_t size) {
     map_t *map;
     map_error_t result;
 
@@ -82,7 +82,7 @@ int count_unique(int *arr, size_t size) {
     }
 
     // Get the number of unique elements
-    int unique_count;
+    size_t unique_count;
     map_get_size(map, &unique_count);
 
     // Destroy hashmap
@@ -107,8 +107,8 @@ int main (void) {
 	}
 	}
 	printf("]\n");
-	int unique_count = count_unique(arr, size);
-	printf("The number of unique elemnts in the array is : %d\n",unique_count);
+	size_t unique_count = count_unique(arr, size);
+	printf("The number of unique elemnts in the array is : %zu\n",unique_count);
 
 
 	return 0;